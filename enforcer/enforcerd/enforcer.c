@@ -427,8 +427,8 @@ int do_keygen(DAEMONCONFIG *config, KSM_POLICY* policy, hsm_ctx_t *ctx)
     /* Create the required keys */
     for (i=new_keys ; i > 0 ; i--){
         if (hsm_supported_algorithm(policy->ksk->algorithm) == 0) {
-            /* NOTE: for now we know that libhsm only supports RSA keys */
-            key = hsm_generate_rsa_key(ctx, policy->ksk->sm_name, policy->ksk->bits);
+            key = hsm_generate_key(ctx, policy->ksk->sm_name,
+                policy->ksk->algorithm, policy->ksk->bits);
             if (key) {
                 log_msg(config, LOG_DEBUG, "Created key in repository %s", policy->ksk->sm_name);
             } else {
@@ -510,8 +510,8 @@ int do_keygen(DAEMONCONFIG *config, KSM_POLICY* policy, hsm_ctx_t *ctx)
     /* Create the required keys */
     for (i = new_keys ; i > 0 ; i--) {
         if (hsm_supported_algorithm(policy->zsk->algorithm) == 0) {
-            /* NOTE: for now we know that libhsm only supports RSA keys */
-            key = hsm_generate_rsa_key(ctx, policy->zsk->sm_name, policy->zsk->bits);
+            key = hsm_generate_key(ctx, policy->zsk->sm_name,
+                policy->zsk->algorithm, policy->zsk->bits);
             if (key) {
                 log_msg(config, LOG_DEBUG, "Created key in repository %s", policy->zsk->sm_name);
             } else {
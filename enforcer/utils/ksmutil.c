@@ -7038,8 +7038,8 @@ int cmd_genkeys()
     /* Create the required keys */
     for (i=new_ksks ; i > 0 ; i--){
         if (hsm_supported_algorithm(policy->ksk->algorithm) == 0) {
-            /* NOTE: for now we know that libhsm only supports RSA keys */
-            key = hsm_generate_rsa_key(ctx, policy->ksk->sm_name, policy->ksk->bits);
+            key = hsm_generate_key(ctx, policy->ksk->sm_name,
+                policy->ksk->algorithm, policy->ksk->bits);
             if (key) {
                 if (verbose_flag) {
                     printf("Created key in repository %s\n", policy->ksk->sm_name);
@@ -7084,8 +7084,8 @@ int cmd_genkeys()
     /* Create the required ZSKs */
     for (i = new_zsks ; i > 0 ; i--) {
         if (hsm_supported_algorithm(policy->zsk->algorithm) == 0) {
-            /* NOTE: for now we know that libhsm only supports RSA keys */
-            key = hsm_generate_rsa_key(ctx, policy->zsk->sm_name, policy->zsk->bits);
+            key = hsm_generate_key(ctx, policy->zsk->sm_name,
+                policy->zsk->algorithm, policy->zsk->bits);
             if (key) {
                 if (verbose_flag) {
                     printf("Created key in repository %s\n", policy->zsk->sm_name);
@@ -30,6 +30,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -42,6 +43,10 @@
 /* Algorithm identifier and name */
 ldns_algorithm  algorithm = LDNS_RSASHA1;
 const char     *algoname  = "RSA/SHA1";
+const char     *keytype   = "RSA";
+
+/* Sign HSM_DIGEST_LANES buffers per call with hsm_sign_data_batch() */
+int batch = 0;
 
 extern char *optarg;
 char *progname = NULL;
@@ -58,7 +63,7 @@ usage ()
 {
     fprintf(stderr,
         "usage: %s "
-        "[-c config] -r repository [-i iterations] [-s keysize] [-t threads]\n",
+        "[-c config] -r repository [-a algorithm] [-b] [-i iterations] [-s keysize] [-t threads]\n",
         progname);
 }
 
@@ -76,6 +81,13 @@ sign (void *arg)
     ldns_status status;
     hsm_sign_params_t *sign_params;
 
+    ldns_buffer *wire = NULL;
+    const unsigned char *data[HSM_DIGEST_LANES];
+    size_t data_len[HSM_DIGEST_LANES];
+    size_t signature_len[HSM_DIGEST_LANES];
+    unsigned char *signatures = NULL;
+    size_t n;
+
     sign_arg_t *sign_arg = arg;
 
     ctx = sign_arg->ctx;
@@ -96,21 +108,54 @@ sign (void *arg)
     dnskey_rr = hsm_get_dnskey(ctx, key, sign_params);
     sign_params->keytag = ldns_calc_keytag(dnskey_rr);
 
-    /* Do some signing */
-    for (i=0; i<iterations; i++) {
-        sig = hsm_sign_rrset(ctx, rrset, key, sign_params);
-        if (! sig) {
-            fprintf(stderr,
-                    "hsm_sign_rrset() returned error: %s in %s\n",
-                    ctx->error_message,
-                    ctx->error_action
-            );
-            break;
+    if (batch) {
+        /* Sign the wire format of the RRset, a full batch at a time */
+        for (i=0; i<ldns_rr_list_rr_count(rrset); i++) {
+            ldns_rr2canonical(ldns_rr_list_rr(rrset, i));
+        }
+        wire = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+        signatures = malloc(HSM_DIGEST_LANES * HSM_MAX_SIGNATURE_LENGTH);
+        if (!wire || !signatures ||
+            ldns_rr_list2buffer_wire(wire, rrset) != LDNS_STATUS_OK) {
+            fprintf(stderr, "Could not prepare the RRset for signing\n");
+            iterations = 0;
+        }
+        for (n=0; n<HSM_DIGEST_LANES; n++) {
+            data[n] = wire ? ldns_buffer_begin(wire) : NULL;
+            data_len[n] = wire ? ldns_buffer_position(wire) : 0;
+        }
+        for (i=0; i<iterations; i+=n) {
+            n = iterations - i;
+            if (n > HSM_DIGEST_LANES) n = HSM_DIGEST_LANES;
+            if (hsm_sign_data_batch(ctx, n, data, data_len, key, algorithm,
+                                    signatures, signature_len) != 0) {
+                fprintf(stderr,
+                        "hsm_sign_data_batch() returned error: %s in %s\n",
+                        ctx->error_message,
+                        ctx->error_action
+                );
+                break;
+            }
+        }
+    } else {
+        /* Do some signing */
+        for (i=0; i<iterations; i++) {
+            sig = hsm_sign_rrset(ctx, rrset, key, sign_params);
+            if (! sig) {
+                fprintf(stderr,
+                        "hsm_sign_rrset() returned error: %s in %s\n",
+                        ctx->error_message,
+                        ctx->error_action
+                );
+                break;
+            }
+            ldns_rr_free(sig);
         }
-        ldns_rr_free(sig);
     }
 
     /* Clean up */
+    if (wire) ldns_buffer_free(wire);
+    free(signatures);
     ldns_rr_list_deep_free(rrset);
     hsm_sign_params_free(sign_params);
     ldns_rr_free(dnskey_rr);
@@ -129,6 +174,7 @@ main (int argc, char *argv[])
 
     hsm_ctx_t *ctx = NULL;
     hsm_key_t *key = NULL;
+    hsm_key_info_t *key_info;
     unsigned int keysize = 1024;
     unsigned int iterations = 1;
     unsigned int threads = 1;
@@ -150,8 +196,48 @@ main (int argc, char *argv[])
 
     progname = argv[0];
 
-    while ((ch = getopt(argc, argv, "c:i:r:s:t:")) != -1) {
+    while ((ch = getopt(argc, argv, "a:bc:i:r:s:t:")) != -1) {
         switch (ch) {
+        case 'a':
+            if (!strcasecmp(optarg, "rsasha1")) {
+                algorithm = LDNS_RSASHA1;
+                algoname = "RSA/SHA1";
+                keytype = "RSA";
+            } else if (!strcasecmp(optarg, "rsasha256")) {
+                algorithm = LDNS_RSASHA256;
+                algoname = "RSA/SHA256";
+                keytype = "RSA";
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+            } else if (!strcasecmp(optarg, "ecdsap256sha256")) {
+                algorithm = LDNS_ECDSAP256SHA256;
+                algoname = "ECDSA P-256/SHA256";
+                keytype = "ECDSA";
+            } else if (!strcasecmp(optarg, "ecdsap384sha384")) {
+                algorithm = LDNS_ECDSAP384SHA384;
+                algoname = "ECDSA P-384/SHA384";
+                keytype = "ECDSA";
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519
+            } else if (!strcasecmp(optarg, "ed25519")) {
+                algorithm = LDNS_ED25519;
+                algoname = "Ed25519";
+                keytype = "EDDSA";
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+            } else if (!strcasecmp(optarg, "ed448")) {
+                algorithm = LDNS_ED448;
+                algoname = "Ed448";
+                keytype = "EDDSA";
+#endif
+            } else {
+                fprintf(stderr, "Unknown algorithm: %s\n", optarg);
+                usage();
+                exit(1);
+            }
+            break;
+        case 'b':
+            batch = 1;
+            break;
         case 'c':
             config = strdup(optarg);
             break;
@@ -202,11 +288,17 @@ main (int argc, char *argv[])
 
     /* Generate a temporary key */
     fprintf(stderr, "Generating temporary key...\n");
-    key = hsm_generate_rsa_key(ctx, repository, keysize);
+    key = hsm_generate_key(ctx, repository, algorithm, keysize);
     if (key) {
         char *id = hsm_get_key_id(ctx, key);
         fprintf(stderr, "Temporary key created: %s\n", id);
         free(id);
+        /* the curve determines the key size of ECDSA and EdDSA keys */
+        key_info = hsm_get_key_info(ctx, key);
+        if (key_info) {
+            keysize = key_info->keysize;
+            hsm_key_info_free(key_info);
+        }
     } else {
         fprintf(stderr, "Could not generate a key pair in repository \"%s\"\n", repository);
         exit(-1);
@@ -258,9 +350,9 @@ main (int argc, char *argv[])
     end.tv_usec-= start.tv_usec;
     elapsed =(double)(end.tv_sec)+(double)(end.tv_usec)*.000001;
     speed = iterations / elapsed * threads;
-    printf("%d %s, %d signatures per thread, %.2f sig/s (RSA %d bits)\n",
+    printf("%d %s, %d signatures per thread, %.2f sig/s (%s %d bits)\n",
         threads, (threads > 1 ? "threads" : "thread"), iterations,
-        speed, keysize);
+        speed, keytype, keysize);
 
     /* Delete temporary key */
     fprintf(stderr, "Deleting temporary key...\n");
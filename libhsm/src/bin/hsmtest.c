@@ -31,18 +31,64 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include <libhsm.h>
 #include <libhsmdns.h>
 
+/* Messages from FIPS 180-2 and their digests */
+static const struct {
+    const char *message;
+    const char *sha1;
+    const char *sha256;
+} hsm_test_digests[] = {
+    { "abc",
+      "a9993e364706816aba3e25717850c26c9cd0d89d",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "",
+      "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "The quick brown fox jumps over the lazy dog",
+      "2fd4e1c67a2d28fced849ee1bb76e7391b93eb12",
+      "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592" }
+};
+
+/* Hashed owner names from RFC 5155, appendix A: salt aabbccdd,
+ * 12 iterations */
+static const struct {
+    const char *name;
+    const char *hash;
+} hsm_test_nsec3[] = {
+    { "example.", "0p9mhaveqvm6t7vbl5lop2u3t2rp3tom" },
+    { "a.example.", "35mthgpgcu1qg68fab165klnsnk3dpvl" },
+    { "ai.example.", "gjeqe526plbf1g8mklp59enfd789njgi" },
+    { "ns1.example.", "2t7b4g4vsa5smi47k61mv5bv1a22bojr" },
+    { "ns2.example.", "q04jkcevqvmu85r014c7dkba38o0ji5r" },
+    { "w.example.", "k8udemvp1j2f7eg6jebps17vp3n8i58h" },
+    { "*.w.example.", "r53bq7cc2uvmubfu5ocmm6pers9tk9en" },
+    { "x.w.example.", "b4um86eghhds6nea196smvmlo4ors995" },
+    { "y.w.example.", "ji6neoaepv8b5o6k4ev33abha8ht9fgc" },
+    { "x.y.w.example.", "2vptu5timamqttgl4luu9kg21e0aor3s" },
+    { "xx.example.", "t644ebqk9bibcna874givr6joj62mlhv" }
+};
+
+#define HSM_TEST_DIGESTS (sizeof(hsm_test_digests) / sizeof(hsm_test_digests[0]))
+#define HSM_TEST_NSEC3 (sizeof(hsm_test_nsec3) / sizeof(hsm_test_nsec3[0]))
+
+/* Longest message for the batch checks, several blocks of padding cases */
+#define HSM_TEST_MAXLEN 200
+
 
 static int
 hsm_test_sign (hsm_ctx_t *ctx, hsm_key_t *key, ldns_algorithm alg)
 {
     int result;
-    ldns_rr_list *rrset;
+    ldns_rr_list *rrset, *keys, *good_keys;
     ldns_rr *rr, *sig, *dnskey_rr;
     ldns_status status;
     hsm_sign_params_t *sign_params;
@@ -63,7 +109,29 @@ hsm_test_sign (hsm_ctx_t *ctx, hsm_key_t *key, ldns_algorithm alg)
 
     sig = hsm_sign_rrset(ctx, rrset, key, sign_params);
     if (sig) {
-        result = 0;
+        /* A wrong signature or DNSKEY encoding (r||s for ECDSA, the raw
+         * public key for EdDSA) only shows when the RRSIG is verified. */
+        keys = ldns_rr_list_new();
+        good_keys = ldns_rr_list_new();
+        if (dnskey_rr && keys && good_keys) {
+            ldns_rr_list_push_rr(keys, dnskey_rr);
+            status = ldns_verify_rrsig_keylist(rrset, sig, keys, good_keys);
+            if (status == LDNS_STATUS_OK) {
+                result = 0;
+            } else if (status == LDNS_STATUS_CRYPTO_UNKNOWN_ALGO ||
+                       status == LDNS_STATUS_CRYPTO_ALGO_NOT_IMPL) {
+                /* ldns was built without this algorithm */
+                printf("not verified, ");
+                result = 0;
+            } else {
+                printf("verify: %s, ", ldns_get_errorstr_by_id(status));
+                result = 1;
+            }
+        } else {
+            result = 1;
+        }
+        ldns_rr_list_free(good_keys);
+        ldns_rr_list_free(keys);
         ldns_rr_free(sig);
     } else {
         result = 1;
@@ -76,6 +144,184 @@ hsm_test_sign (hsm_ctx_t *ctx, hsm_key_t *key, ldns_algorithm alg)
     return result;
 }
 
+static void
+hsm_test_hex(char *dst, const unsigned char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        snprintf(dst + 2 * i, 3, "%02x", src[i]);
+    }
+}
+
+/* Sign a batch with hsm_sign_data_batch() and each buffer with
+ * hsm_sign_data(). RSA signatures are deterministic, so they must be the
+ * same. */
+static int
+hsm_test_sign_batch (hsm_ctx_t *ctx, hsm_key_t *key, ldns_algorithm alg)
+{
+    unsigned char buf[HSM_DIGEST_LANES + 3][HSM_TEST_MAXLEN];
+    const unsigned char *data[HSM_DIGEST_LANES + 3];
+    size_t data_len[HSM_DIGEST_LANES + 3];
+    size_t signature_len[HSM_DIGEST_LANES + 3];
+    unsigned char *signatures;
+    unsigned char signature[HSM_MAX_SIGNATURE_LENGTH];
+    size_t len;
+    size_t i;
+    int result = 0;
+
+    signatures = malloc((HSM_DIGEST_LANES + 3) * HSM_MAX_SIGNATURE_LENGTH);
+    if (!signatures) return 1;
+    for (i = 0; i < HSM_DIGEST_LANES + 3; i++) {
+        data_len[i] = (i * 37) % HSM_TEST_MAXLEN;
+        memset(buf[i], (int) i, data_len[i]);
+        data[i] = buf[i];
+    }
+    if (hsm_sign_data_batch(ctx, HSM_DIGEST_LANES + 3, data, data_len, key,
+                            alg, signatures, signature_len) != 0) {
+        free(signatures);
+        return 1;
+    }
+    for (i = 0; i < HSM_DIGEST_LANES + 3 && !result; i++) {
+        if (hsm_sign_data(ctx, data[i], data_len[i], key, alg,
+                          signature, &len) != 0) {
+            result = 1;
+        } else if (len != signature_len[i] ||
+                   memcmp(signature, signatures + i * HSM_MAX_SIGNATURE_LENGTH,
+                          len) != 0) {
+            printf("signature %u differs, ", (unsigned int) i);
+            result = 1;
+        }
+    }
+    free(signatures);
+    return result;
+}
+
+/* Known answers for hsm_digest_batch(), for every batch size up to
+ * HSM_DIGEST_LANES so that the multi-buffer code runs with empty lanes,
+ * and messages of every length up to HSM_TEST_MAXLEN against the digests
+ * of one message at a time. */
+static int
+hsm_test_digest_type (hsm_digest_type_t type, const char *name)
+{
+    unsigned char buf[HSM_TEST_MAXLEN + 1];
+    const unsigned char *data[HSM_DIGEST_LANES];
+    size_t data_len[HSM_DIGEST_LANES];
+    unsigned char digests[HSM_DIGEST_LANES * 32];
+    unsigned char digest[32];
+    char hex[2 * 32 + 1];
+    const char *expect;
+    size_t digest_len = hsm_digest_length(type);
+    size_t count, i, len;
+    int errors = 0;
+    int failed;
+
+    printf("Hashing (%s) FIPS 180-2 messages in batches... ", name);
+    for (count = 1; count <= HSM_DIGEST_LANES; count++) {
+        for (i = 0; i < count; i++) {
+            data[i] = (const unsigned char *)
+                hsm_test_digests[i % HSM_TEST_DIGESTS].message;
+            data_len[i] = strlen((const char *) data[i]);
+        }
+        if (hsm_digest_batch(type, count, data, data_len, digests) != 0) {
+            errors++;
+            break;
+        }
+        for (i = 0; i < count; i++) {
+            expect = (type == HSM_DIGEST_SHA1) ?
+                hsm_test_digests[i % HSM_TEST_DIGESTS].sha1 :
+                hsm_test_digests[i % HSM_TEST_DIGESTS].sha256;
+            hsm_test_hex(hex, digests + i * digest_len, digest_len);
+            if (strcmp(hex, expect) != 0) {
+                printf("\n  batch of %u, message %u: %s, expected %s",
+                    (unsigned int) count, (unsigned int) i, hex, expect);
+                errors++;
+            }
+        }
+    }
+    printf(errors ? "\nFailed\n" : "OK\n");
+
+    printf("Hashing (%s) messages of 0 to %d bytes in batches... ", name,
+        HSM_TEST_MAXLEN);
+    failed = errors;
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (unsigned char) (i * 7 + 1);
+    }
+    for (len = 0; len + HSM_DIGEST_LANES <= sizeof(buf); len++) {
+        for (i = 0; i < HSM_DIGEST_LANES; i++) {
+            data[i] = buf;
+            data_len[i] = len + i;
+        }
+        if (hsm_digest_batch(type, HSM_DIGEST_LANES, data, data_len,
+                             digests) != 0) {
+            errors++;
+            break;
+        }
+        for (i = 0; i < HSM_DIGEST_LANES; i++) {
+            if (hsm_digest_batch(type, 1, data + i, data_len + i,
+                                 digest) != 0 ||
+                memcmp(digest, digests + i * digest_len, digest_len) != 0) {
+                printf("\n  message of %u bytes differs",
+                    (unsigned int) data_len[i]);
+                errors++;
+            }
+        }
+    }
+    printf(errors > failed ? "\nFailed\n" : "OK\n");
+
+    return errors;
+}
+
+static int
+hsm_test_digest ()
+{
+    const uint8_t salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+    /* all names, and a batch with empty lanes */
+    const size_t counts[] = { HSM_TEST_NSEC3, HSM_DIGEST_LANES / 2 + 1 };
+    ldns_rdf *names[HSM_TEST_NSEC3];
+    const unsigned char *data[HSM_TEST_NSEC3];
+    size_t data_len[HSM_TEST_NSEC3];
+    unsigned char hashes[HSM_TEST_NSEC3 * 20];
+    char b32[64];
+    size_t c, i;
+    int len;
+    int errors = 0;
+    int failed;
+
+    failed = hsm_test_digest_type(HSM_DIGEST_SHA1, "SHA-1");
+    failed += hsm_test_digest_type(HSM_DIGEST_SHA256, "SHA-256");
+
+    printf("Hashing RFC 5155 NSEC3 owner names in batches... ");
+    for (i = 0; i < HSM_TEST_NSEC3; i++) {
+        names[i] = ldns_dname_new_frm_str(hsm_test_nsec3[i].name);
+        data[i] = ldns_rdf_data(names[i]);
+        data_len[i] = ldns_rdf_size(names[i]);
+    }
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        if (hsm_nsec3_hash_batch(counts[c], data, data_len, 12, sizeof(salt),
+                                 salt, hashes) != 0) {
+            errors++;
+            break;
+        }
+        for (i = 0; i < counts[c]; i++) {
+            len = ldns_b32_ntop_extended_hex(hashes + i * 20, 20, b32,
+                                             sizeof(b32));
+            if (len < 0 || strncasecmp(b32, hsm_test_nsec3[i].hash,
+                                       strlen(hsm_test_nsec3[i].hash)) != 0) {
+                printf("\n  %s: %.*s, expected %s", hsm_test_nsec3[i].name,
+                    len < 0 ? 0 : len, b32, hsm_test_nsec3[i].hash);
+                errors++;
+            }
+        }
+    }
+    for (i = 0; i < HSM_TEST_NSEC3; i++) {
+        ldns_rdf_deep_free(names[i]);
+    }
+    printf(errors ? "\nFailed\n" : "OK\n");
+
+    return failed + errors;
+}
+
 static int
 hsm_test_random()
 {
@@ -114,6 +360,19 @@ hsm_test (const char *repository)
     int result;
     const unsigned int rsa_keysizes[] = { 512, 768, 1024, 1536, 2048, 4096 };
     const unsigned int dsa_keysizes[] = { 512, 768, 1024 };
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+    const unsigned int ecdsa_keysizes[] = { 256, 384 };
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+    const unsigned int eddsa_keysizes[] = {
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        255,
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        448,
+#endif
+    };
+#endif
     unsigned int keysize;
 
     hsm_ctx_t *ctx = NULL;
@@ -178,6 +437,26 @@ hsm_test (const char *repository)
             printf("OK\n");
         }
 
+        printf("Signing a batch (RSA/SHA1) with key... ");
+        result = hsm_test_sign_batch(ctx, key, LDNS_RSASHA1);
+        if (result) {
+            errors++;
+            printf("Failed, error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
+        printf("Signing a batch (RSA/SHA256) with key... ");
+        result = hsm_test_sign_batch(ctx, key, LDNS_RSASHA256);
+        if (result) {
+            errors++;
+            printf("Failed, error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
         if ( keysize >= 1024) {
             printf("Signing (RSA/SHA512) with key... ");
             result = hsm_test_sign(ctx, key, LDNS_RSASHA512);
@@ -313,9 +592,136 @@ hsm_test (const char *repository)
         printf("\n");
     }
 
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+    /*
+     * Test key generation, signing and deletion for a number of key size
+     */
+    for (i=0; i<(sizeof(ecdsa_keysizes)/sizeof(unsigned int)); i++) {
+        keysize = ecdsa_keysizes[i];
+
+        printf("Generating %d-bit ECDSA key... ", keysize);
+        key = hsm_generate_ecdsa_key(ctx, repository, keysize);
+        if (!key) {
+            errors++;
+            printf("Failed\n");
+            hsm_print_error(ctx);
+            printf("\n");
+            continue;
+        } else {
+            printf("OK\n");
+        }
+
+        printf("Extracting key identifier... ");
+        id = hsm_get_key_id(ctx, key);
+        if (!id) {
+            errors++;
+            printf("Failed\n");
+            hsm_print_error(ctx);
+            printf("\n");
+        } else {
+            printf("OK, %s\n", id);
+        }
+        free(id);
+
+        if (keysize == 256) {
+            printf("Signing (ECDSA/SHA256) with key... ");
+            result = hsm_test_sign(ctx, key, LDNS_ECDSAP256SHA256);
+        } else {
+            printf("Signing (ECDSA/SHA384) with key... ");
+            result = hsm_test_sign(ctx, key, LDNS_ECDSAP384SHA384);
+        }
+        if (result) {
+            errors++;
+            printf("Failed, error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
+        printf("Deleting key... ");
+        result = hsm_remove_key(ctx, key);
+        if (result) {
+            errors++;
+            printf("Failed: error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
+        free(key);
+
+        printf("\n");
+    }
+#endif
+
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+    /*
+     * Test key generation, signing and deletion for a number of key size
+     */
+    for (i=0; i<(sizeof(eddsa_keysizes)/sizeof(unsigned int)); i++) {
+        keysize = eddsa_keysizes[i];
+
+        printf("Generating %d-bit EdDSA key... ", keysize);
+        key = hsm_generate_eddsa_key(ctx, repository, keysize);
+        if (!key) {
+            errors++;
+            printf("Failed\n");
+            hsm_print_error(ctx);
+            printf("\n");
+            continue;
+        } else {
+            printf("OK\n");
+        }
+
+        printf("Extracting key identifier... ");
+        id = hsm_get_key_id(ctx, key);
+        if (!id) {
+            errors++;
+            printf("Failed\n");
+            hsm_print_error(ctx);
+            printf("\n");
+        } else {
+            printf("OK, %s\n", id);
+        }
+        free(id);
+
+        if (keysize == 255) {
+            printf("Signing (Ed25519) with key... ");
+            result = hsm_test_sign(ctx, key, LDNS_ED25519);
+        } else {
+            printf("Signing (Ed448) with key... ");
+            result = hsm_test_sign(ctx, key, LDNS_ED448);
+        }
+        if (result) {
+            errors++;
+            printf("Failed, error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
+        printf("Deleting key... ");
+        result = hsm_remove_key(ctx, key);
+        if (result) {
+            errors++;
+            printf("Failed: error: %d\n", result);
+            hsm_print_error(ctx);
+        } else {
+            printf("OK\n");
+        }
+
+        free(key);
+
+        printf("\n");
+    }
+#endif
+
     if (hsm_test_random()) {
         errors++;
     }
 
+    printf("\n");
+    errors += hsm_test_digest();
+
     return errors;
 }
@@ -63,6 +63,8 @@ usage ()
     fprintf(stderr,"  logout\n");
     fprintf(stderr,"  list [repository]\n");
     fprintf(stderr,"  generate <repository> rsa <keysize>\n");
+    fprintf(stderr,"  generate <repository> ecdsa <256|384>\n");
+    fprintf(stderr,"  generate <repository> eddsa <255|448>\n");
     fprintf(stderr,"  remove <id>\n");
     fprintf(stderr,"  purge <repository>\n");
     fprintf(stderr,"  dnskey <id> <name>\n");
@@ -212,26 +214,36 @@ cmd_generate (int argc, char *argv[])
             keysize, repository);
 
         key = hsm_generate_rsa_key(NULL, repository, keysize);
+    } else if (!strcasecmp(algorithm, "ecdsa")) {
+        printf("Generating %d bit ECDSA key in repository: %s\n",
+            keysize, repository);
 
-        if (key) {
-            hsm_key_info_t *key_info;
-
-            key_info = hsm_get_key_info(NULL, key);
-            printf("Key generation successful: %s\n",
-                key_info ? key_info->id : "NULL");
-            hsm_key_info_free(key_info);
-            if (verbose) hsm_print_key(key);
-            hsm_key_free(key);
-        } else {
-            printf("Key generation failed.\n");
-            return -1;
-        }
+        key = hsm_generate_ecdsa_key(NULL, repository, keysize);
+    } else if (!strcasecmp(algorithm, "eddsa")) {
+        printf("Generating %d bit EdDSA key in repository: %s\n",
+            keysize, repository);
 
+        key = hsm_generate_eddsa_key(NULL, repository, keysize);
     } else {
         printf("Unknown algorithm: %s\n", algorithm);
         return -1;
     }
 
+    if (key) {
+        hsm_key_info_t *key_info;
+
+        key_info = hsm_get_key_info(NULL, key);
+        printf("Key generation successful: %s\n",
+            key_info ? key_info->id : "NULL");
+        hsm_key_info_free(key_info);
+        if (verbose) hsm_print_key(key);
+        hsm_key_free(key);
+    } else {
+        printf("Key generation failed.\n");
+        hsm_print_error(NULL);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -0,0 +1,421 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2009 .SE (The Internet Infrastructure Foundation).
+ * Copyright (c) 2009 NLNet Labs.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <openssl/sha.h>
+
+#include "libhsm.h"
+#include "libhsmdns.h"
+
+/*
+ * Multi-buffer SHA-1 and SHA-256: the messages of a batch are hashed
+ * side by side, one message per 32-bit lane, so the same round function
+ * runs on HSM_DIGEST_LANES messages at once. The lanes are written with
+ * GCC vector extensions. Where the CPU has AVX2 a lane vector fits one
+ * register, otherwise the compiler splits it (SSE2) or falls back to
+ * plain integer code. Compilers without vector extensions hash the
+ * messages one by one with OpenSSL.
+ */
+#if defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HSM_DIGEST_MB 1
+#if defined(__x86_64__) || defined(__i386__)
+#define HSM_DIGEST_MB_AVX2 1
+#endif
+#endif
+
+#ifdef HSM_DIGEST_MB
+
+typedef uint32_t hsm_lanes_t
+    __attribute__ ((vector_size (4 * HSM_DIGEST_LANES)));
+
+/*! Message of one lane, split in whole blocks and the padded tail */
+typedef struct {
+    const unsigned char *data;
+    size_t full;                /*!< whole blocks in data */
+    size_t blocks;              /*!< blocks including the padding */
+    unsigned char tail[128];    /*!< last partial block and padding */
+} hsm_lane_t;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha1_iv[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static inline uint32_t
+hsm_read_be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+           ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static inline void
+hsm_write_be32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char) (v >> 24);
+    p[1] = (unsigned char) (v >> 16);
+    p[2] = (unsigned char) (v >> 8);
+    p[3] = (unsigned char) v;
+}
+
+/* Split the messages over the lanes; unused lanes are zeroed and get no
+ * blocks, hsm_lanes_load() still reads their tail. Returns the largest
+ * number of blocks of a lane. */
+static size_t
+hsm_lanes_init(hsm_lane_t *lanes,
+               size_t count,
+               const unsigned char *const *data,
+               const size_t *data_len)
+{
+    size_t i, rem, tail_len, max_blocks = 0;
+    uint64_t bits;
+
+    for (i = 0; i < HSM_DIGEST_LANES; i++) {
+        if (i >= count) {
+            memset(&lanes[i], 0, sizeof(hsm_lane_t));
+            continue;
+        }
+        lanes[i].data = data[i];
+        lanes[i].full = data_len[i] / 64;
+        rem = data_len[i] % 64;
+        tail_len = (rem + 9 <= 64) ? 64 : 128;
+        memset(lanes[i].tail, 0, tail_len);
+        memcpy(lanes[i].tail, data[i] + lanes[i].full * 64, rem);
+        lanes[i].tail[rem] = 0x80;
+        bits = (uint64_t) data_len[i] * 8;
+        hsm_write_be32(lanes[i].tail + tail_len - 8, (uint32_t) (bits >> 32));
+        hsm_write_be32(lanes[i].tail + tail_len - 4, (uint32_t) bits);
+        lanes[i].blocks = lanes[i].full + tail_len / 64;
+        if (lanes[i].blocks > max_blocks) {
+            max_blocks = lanes[i].blocks;
+        }
+    }
+    return max_blocks;
+}
+
+/* Load block b of every lane into w, transposed so that w[t] holds word
+ * t of all lanes. live has all bits set for the lanes that still have
+ * this block. */
+static inline __attribute__ ((always_inline)) void
+hsm_lanes_load(const hsm_lane_t *lanes, size_t b, hsm_lanes_t *w,
+               hsm_lanes_t *live)
+{
+    const unsigned char *block;
+    size_t i, t;
+
+    for (i = 0; i < HSM_DIGEST_LANES; i++) {
+        if (b < lanes[i].full) {
+            block = lanes[i].data + b * 64;
+            (*live)[i] = 0xffffffff;
+        } else if (b < lanes[i].blocks) {
+            block = lanes[i].tail + (b - lanes[i].full) * 64;
+            (*live)[i] = 0xffffffff;
+        } else {
+            block = lanes[i].tail;
+            (*live)[i] = 0;
+        }
+        for (t = 0; t < 16; t++) {
+            w[t][i] = hsm_read_be32(block + 4 * t);
+        }
+    }
+}
+
+static inline __attribute__ ((always_inline)) void
+hsm_sha256_lanes(hsm_lane_t *lanes, size_t max_blocks, unsigned char *digests,
+                 size_t count)
+{
+    hsm_lanes_t st[8], w[16], live;
+    hsm_lanes_t a, b, c, d, e, f, g, h, t1, t2;
+    size_t blk, i, t;
+
+    for (i = 0; i < 8; i++) {
+        st[i] = (hsm_lanes_t) {0} + sha256_iv[i];
+    }
+    for (blk = 0; blk < max_blocks; blk++) {
+        hsm_lanes_load(lanes, blk, w, &live);
+        a = st[0]; b = st[1]; c = st[2]; d = st[3];
+        e = st[4]; f = st[5]; g = st[6]; h = st[7];
+        for (t = 0; t < 64; t++) {
+            if (t >= 16) {
+                w[t & 15] += (ROTR(w[(t - 2) & 15], 17) ^
+                              ROTR(w[(t - 2) & 15], 19) ^
+                              (w[(t - 2) & 15] >> 10)) +
+                             w[(t - 7) & 15] +
+                             (ROTR(w[(t - 15) & 15], 7) ^
+                              ROTR(w[(t - 15) & 15], 18) ^
+                              (w[(t - 15) & 15] >> 3));
+            }
+            t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) +
+                 ((e & f) ^ (~e & g)) + sha256_k[t] + w[t & 15];
+            t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) +
+                 ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        /* lanes that ran out of blocks keep their state */
+        st[0] += a & live; st[1] += b & live;
+        st[2] += c & live; st[3] += d & live;
+        st[4] += e & live; st[5] += f & live;
+        st[6] += g & live; st[7] += h & live;
+    }
+    for (i = 0; i < count; i++) {
+        for (t = 0; t < 8; t++) {
+            hsm_write_be32(digests + i * 32 + t * 4, st[t][i]);
+        }
+    }
+}
+
+static inline __attribute__ ((always_inline)) void
+hsm_sha1_lanes(hsm_lane_t *lanes, size_t max_blocks, unsigned char *digests,
+               size_t count)
+{
+    hsm_lanes_t st[5], w[16], live;
+    hsm_lanes_t a, b, c, d, e, f, tmp;
+    uint32_t k;
+    size_t blk, i, t;
+
+    for (i = 0; i < 5; i++) {
+        st[i] = (hsm_lanes_t) {0} + sha1_iv[i];
+    }
+    for (blk = 0; blk < max_blocks; blk++) {
+        hsm_lanes_load(lanes, blk, w, &live);
+        a = st[0]; b = st[1]; c = st[2]; d = st[3]; e = st[4];
+        for (t = 0; t < 80; t++) {
+            if (t >= 16) {
+                tmp = w[(t - 3) & 15] ^ w[(t - 8) & 15] ^
+                      w[(t - 14) & 15] ^ w[t & 15];
+                w[t & 15] = ROTL(tmp, 1);
+            }
+            if (t < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (t < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (t < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            tmp = ROTL(a, 5) + f + e + k + w[t & 15];
+            e = d; d = c; c = ROTL(b, 30); b = a; a = tmp;
+        }
+        st[0] += a & live; st[1] += b & live;
+        st[2] += c & live; st[3] += d & live;
+        st[4] += e & live;
+    }
+    for (i = 0; i < count; i++) {
+        for (t = 0; t < 5; t++) {
+            hsm_write_be32(digests + i * 20 + t * 4, st[t][i]);
+        }
+    }
+}
+
+/* The kernels are compiled for the baseline CPU, and once more for AVX2
+ * if the compiler can. */
+static void
+hsm_sha256_lanes_default(hsm_lane_t *lanes, size_t max_blocks,
+                         unsigned char *digests, size_t count)
+{
+    hsm_sha256_lanes(lanes, max_blocks, digests, count);
+}
+
+static void
+hsm_sha1_lanes_default(hsm_lane_t *lanes, size_t max_blocks,
+                       unsigned char *digests, size_t count)
+{
+    hsm_sha1_lanes(lanes, max_blocks, digests, count);
+}
+
+#ifdef HSM_DIGEST_MB_AVX2
+static __attribute__ ((target ("avx2"))) void
+hsm_sha256_lanes_avx2(hsm_lane_t *lanes, size_t max_blocks,
+                      unsigned char *digests, size_t count)
+{
+    hsm_sha256_lanes(lanes, max_blocks, digests, count);
+}
+
+static __attribute__ ((target ("avx2"))) void
+hsm_sha1_lanes_avx2(hsm_lane_t *lanes, size_t max_blocks,
+                    unsigned char *digests, size_t count)
+{
+    hsm_sha1_lanes(lanes, max_blocks, digests, count);
+}
+#endif
+
+#endif /* HSM_DIGEST_MB */
+
+/* One message at a time, for short batches and compilers without
+ * vector extensions. OpenSSL uses the SHA extensions of the CPU where
+ * it has them. */
+static void
+hsm_digest_one(hsm_digest_type_t type,
+               const unsigned char *data,
+               size_t data_len,
+               unsigned char *digest)
+{
+    if (type == HSM_DIGEST_SHA1) {
+        SHA1(data, data_len, digest);
+    } else {
+        SHA256(data, data_len, digest);
+    }
+}
+
+size_t
+hsm_digest_length(hsm_digest_type_t type)
+{
+    switch (type) {
+        case HSM_DIGEST_SHA1:
+            return SHA_DIGEST_LENGTH;
+        case HSM_DIGEST_SHA256:
+            return SHA256_DIGEST_LENGTH;
+        default:
+            return 0;
+    }
+}
+
+int
+hsm_digest_batch(hsm_digest_type_t type,
+                 size_t count,
+                 const unsigned char *const *data,
+                 const size_t *data_len,
+                 unsigned char *digests)
+{
+    size_t digest_len, i, n;
+#ifdef HSM_DIGEST_MB
+    hsm_lane_t lanes[HSM_DIGEST_LANES];
+    size_t max_blocks;
+    void (*kernel)(hsm_lane_t *, size_t, unsigned char *, size_t);
+#endif
+
+    digest_len = hsm_digest_length(type);
+    if (digest_len == 0) return -1;
+    if (count > 0 && (!data || !data_len || !digests)) return -1;
+
+    i = 0;
+#ifdef HSM_DIGEST_MB
+    kernel = (type == HSM_DIGEST_SHA1) ?
+             hsm_sha1_lanes_default : hsm_sha256_lanes_default;
+#ifdef HSM_DIGEST_MB_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = (type == HSM_DIGEST_SHA1) ?
+                 hsm_sha1_lanes_avx2 : hsm_sha256_lanes_avx2;
+    }
+#endif
+    /* a half empty batch is not worth the lanes */
+    for (; count - i >= HSM_DIGEST_LANES / 2; i += n) {
+        n = count - i;
+        if (n > HSM_DIGEST_LANES) n = HSM_DIGEST_LANES;
+        max_blocks = hsm_lanes_init(lanes, n, data + i, data_len + i);
+        kernel(lanes, max_blocks, digests + i * digest_len, n);
+    }
+#endif
+    for (; i < count; i++) {
+        hsm_digest_one(type, data[i], data_len[i],
+                       digests + i * digest_len);
+    }
+    return 0;
+}
+
+int
+hsm_nsec3_hash_batch(size_t count,
+                     const unsigned char *const *names,
+                     const size_t *name_len,
+                     uint16_t iterations,
+                     uint8_t salt_length,
+                     const uint8_t *salt,
+                     unsigned char *hashes)
+{
+    unsigned char buf[HSM_DIGEST_LANES][256 + 255];
+    const unsigned char *data[HSM_DIGEST_LANES];
+    size_t data_len[HSM_DIGEST_LANES];
+    size_t i, j, n;
+    uint32_t it;
+
+    if (count > 0 && (!names || !name_len || !hashes)) return -1;
+    if (salt_length > 0 && !salt) return -1;
+
+    for (i = 0; i < count; i += n) {
+        n = count - i;
+        if (n > HSM_DIGEST_LANES) n = HSM_DIGEST_LANES;
+        /* IH(salt, x, 0) = H(x || salt) */
+        for (j = 0; j < n; j++) {
+            if (name_len[i + j] > 255) return -1;
+            memcpy(buf[j], names[i + j], name_len[i + j]);
+            memcpy(buf[j] + name_len[i + j], salt, salt_length);
+            data[j] = buf[j];
+            data_len[j] = name_len[i + j] + salt_length;
+        }
+        hsm_digest_batch(HSM_DIGEST_SHA1, n, data, data_len,
+                         hashes + i * SHA_DIGEST_LENGTH);
+        /* IH(salt, x, k) = H(IH(salt, x, k-1) || salt) */
+        for (it = 0; it < iterations; it++) {
+            for (j = 0; j < n; j++) {
+                memcpy(buf[j], hashes + (i + j) * SHA_DIGEST_LENGTH,
+                       SHA_DIGEST_LENGTH);
+                memcpy(buf[j] + SHA_DIGEST_LENGTH, salt, salt_length);
+                data_len[j] = SHA_DIGEST_LENGTH + salt_length;
+            }
+            hsm_digest_batch(HSM_DIGEST_SHA1, n, data, data_len,
+                             hashes + i * SHA_DIGEST_LENGTH);
+        }
+    }
+    return 0;
+}
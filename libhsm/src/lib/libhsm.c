@@ -48,9 +48,27 @@
 
 #include <pkcs11.h>
 
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
 /*! Fixed length from PKCS#11 specification */
 #define HSM_TOKEN_LABEL_LENGTH 32
 
+/*! Longest DigestInfo, the SHA-512 identifier and digest */
+#define HSM_MAX_DIGESTINFO_LENGTH (19 + SHA512_DIGEST_LENGTH)
+
+/*! Incremental digest over the data to be signed */
+struct hsm_digest_ctx_struct {
+    /** The DNS signing algorithm identifier */
+    ldns_algorithm algorithm;
+    /** The length of the digest */
+    size_t digest_len;
+    /** Non-zero if the HSM computes the digest */
+    int through_hsm;
+    /** The running digest, if computed locally */
+    EVP_MD_CTX *md_ctx;
+};
+
 /*! Global (initial) context */
 hsm_ctx_t *_hsm_ctx;
 
@@ -932,12 +950,66 @@ hsm_get_key_size_dsa(hsm_ctx_t *ctx, const hsm_session_t *session,
     return template2[0].ulValueLen * 8;
 }
 
+/* DER encoded OIDs of the curves used by ECDSA (RFC 6605) and EdDSA
+ * (RFC 8080) in DNSSEC */
+static const CK_BYTE hsm_oid_p256[] = { 0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x03, 0x01, 0x07 };
+static const CK_BYTE hsm_oid_p384[] = { 0x06, 0x05, 0x2B, 0x81, 0x04, 0x00, 0x22 };
+static const CK_BYTE hsm_oid_ed25519[] = { 0x06, 0x03, 0x2B, 0x65, 0x70 };
+static const CK_BYTE hsm_oid_ed448[] = { 0x06, 0x03, 0x2B, 0x65, 0x71 };
+/* PKCS#11 v3.0 also allows the curve name as a PrintableString */
+static const CK_BYTE hsm_name_ed25519[] = { 0x13, 0x0C, 'e', 'd', 'w', 'a', 'r', 'd', 's', '2', '5', '5', '1', '9' };
+static const CK_BYTE hsm_name_ed448[] = { 0x13, 0x0A, 'e', 'd', 'w', 'a', 'r', 'd', 's', '4', '4', '8' };
+
+#define HSM_EC_PARAMS_IS(params, len, curve) \
+    ((len) == sizeof(curve) && memcmp((params), (curve), sizeof(curve)) == 0)
+
+/* returns a CK_ULONG with the key size of the given ECDSA or EdDSA key.
+ * The key is not checked for type. The curve (CKA_EC_PARAMS) determines
+ * the key size: 256 for P-256, 384 for P-384, 255 for Ed25519 and 448
+ * for Ed448. Other curves have size 0.
+ */
+static CK_ULONG
+hsm_get_key_size_ec(hsm_ctx_t *ctx, const hsm_session_t *session,
+                    const hsm_key_t *key)
+{
+    CK_RV rv;
+    CK_BYTE params[16];
+
+    CK_ATTRIBUTE template[] = {
+        {CKA_EC_PARAMS, params, sizeof(params)}
+    };
+
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GetAttributeValue(
+                                      session->session,
+                                      key->private_key,
+                                      template,
+                                      1);
+    if (hsm_pkcs11_check_error(ctx, rv, "Could not get the curve of the private key")) {
+        return 0;
+    }
+
+    if (HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_oid_p256)) {
+        return 256;
+    }
+    if (HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_oid_p384)) {
+        return 384;
+    }
+    if (HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_oid_ed25519) ||
+        HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_name_ed25519)) {
+        return 255;
+    }
+    if (HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_oid_ed448) ||
+        HSM_EC_PARAMS_IS(params, template[0].ulValueLen, hsm_name_ed448)) {
+        return 448;
+    }
+    return 0;
+}
+
 /* Wrapper for specific key size functions */
 static CK_ULONG
 hsm_get_key_size(hsm_ctx_t *ctx, const hsm_session_t *session,
                  const hsm_key_t *key, const unsigned long algorithm)
 {
-    /* TODO: Add ECDSA */
     switch (algorithm) {
         case CKK_RSA:
             return hsm_get_key_size_rsa(ctx, session, key);
@@ -949,6 +1021,10 @@ hsm_get_key_size(hsm_ctx_t *ctx, const hsm_session_t *session,
             /* GOST public keys always have a size of 512 bits */
             return 512;
             break;
+        case CKK_EC:
+        case CKK_EC_EDWARDS:
+            return hsm_get_key_size_ec(ctx, session, key);
+            break;
         default:
             return 0;
     }
@@ -1596,11 +1672,178 @@ hsm_get_key_rdata_gost(hsm_ctx_t *ctx, hsm_session_t *session,
     return rdf;
 }
 
+static ldns_rdf *
+hsm_get_key_rdata_ecdsa(hsm_ctx_t *ctx, hsm_session_t *session,
+                  const hsm_key_t *key)
+{
+    CK_RV rv;
+    CK_BYTE_PTR value = NULL;
+    CK_ULONG value_len = 0;
+    CK_BYTE_PTR point;
+    CK_ULONG point_len;
+    CK_ULONG size;
+
+    CK_ATTRIBUTE template[] = {
+        {CKA_EC_POINT, NULL, 0},
+    };
+    ldns_rdf *rdf;
+
+    if (!session || !session->module) {
+        return NULL;
+    }
+
+    size = hsm_get_key_size_ec(ctx, session, key);
+    if (size != 256 && size != 384) {
+        hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_ecdsa()",
+            "Unknown curve");
+        return NULL;
+    }
+    size /= 8;
+
+    /* ECDSA needs the public key compared with RSA */
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GetAttributeValue(
+                                      session->session,
+                                      key->public_key,
+                                      template,
+                                      1);
+    if (hsm_pkcs11_check_error(ctx, rv, "C_GetAttributeValue")) {
+        return NULL;
+    }
+    value_len = template[0].ulValueLen;
+
+    value = template[0].pValue = malloc(value_len);
+    if (!value) {
+        hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_ecdsa()",
+            "Error allocating memory for value");
+        return NULL;
+    }
+
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GetAttributeValue(
+                                      session->session,
+                                      key->public_key,
+                                      template,
+                                      1);
+    if (hsm_pkcs11_check_error(ctx, rv, "get attribute value")) {
+        free(value);
+        return NULL;
+    }
+
+    /* CKA_EC_POINT is a DER OCTET STRING holding the uncompressed point
+     * 04 || X || Y, some tokens leave out the OCTET STRING. The DNSKEY
+     * has X || Y (RFC 6605). */
+    point = value;
+    point_len = value_len;
+    if (point_len != 2 * size + 1 && point_len > 2 && point[0] == 0x04) {
+        if (point[1] < 0x80) {
+            point_len = point[1];
+            point += 2;
+        } else if (point[1] == 0x81 && value_len > 3) {
+            point_len = point[2];
+            point += 3;
+        }
+        if (point + point_len != value + value_len) {
+            point_len = 0;
+        }
+    }
+    if (point_len != 2 * size + 1 || point[0] != 0x04) {
+        hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_ecdsa()",
+            "Public key is not an uncompressed point");
+        free(value);
+        return NULL;
+    }
+
+    rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, 2 * size, point + 1);
+    free(value);
+    return rdf;
+}
+
+static ldns_rdf *
+hsm_get_key_rdata_eddsa(hsm_ctx_t *ctx, hsm_session_t *session,
+                  const hsm_key_t *key)
+{
+    CK_RV rv;
+    CK_BYTE_PTR value = NULL;
+    CK_ULONG value_len = 0;
+    CK_BYTE_PTR point;
+    CK_ULONG point_len;
+    CK_ULONG size;
+
+    CK_ATTRIBUTE template[] = {
+        {CKA_EC_POINT, NULL, 0},
+    };
+    ldns_rdf *rdf;
+
+    if (!session || !session->module) {
+        return NULL;
+    }
+
+    /* the public key is 32 bytes for Ed25519 and 57 for Ed448 */
+    switch (hsm_get_key_size_ec(ctx, session, key)) {
+        case 255:
+            size = 32;
+            break;
+        case 448:
+            size = 57;
+            break;
+        default:
+            hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_eddsa()",
+                "Unknown curve");
+            return NULL;
+    }
+
+    /* EdDSA needs the public key compared with RSA */
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GetAttributeValue(
+                                      session->session,
+                                      key->public_key,
+                                      template,
+                                      1);
+    if (hsm_pkcs11_check_error(ctx, rv, "C_GetAttributeValue")) {
+        return NULL;
+    }
+    value_len = template[0].ulValueLen;
+
+    value = template[0].pValue = malloc(value_len);
+    if (!value) {
+        hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_eddsa()",
+            "Error allocating memory for value");
+        return NULL;
+    }
+
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GetAttributeValue(
+                                      session->session,
+                                      key->public_key,
+                                      template,
+                                      1);
+    if (hsm_pkcs11_check_error(ctx, rv, "get attribute value")) {
+        free(value);
+        return NULL;
+    }
+
+    /* CKA_EC_POINT is a DER OCTET STRING holding the public key, some
+     * tokens leave out the OCTET STRING. The DNSKEY has the public key
+     * itself (RFC 8080). */
+    point = value;
+    point_len = value_len;
+    if (point_len == size + 2 && point[0] == 0x04 && point[1] == size) {
+        point += 2;
+        point_len -= 2;
+    }
+    if (point_len != size) {
+        hsm_ctx_set_error(ctx, -1, "hsm_get_key_rdata_eddsa()",
+            "Public key has the wrong length");
+        free(value);
+        return NULL;
+    }
+
+    rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, size, point);
+    free(value);
+    return rdf;
+}
+
 static ldns_rdf *
 hsm_get_key_rdata(hsm_ctx_t *ctx, hsm_session_t *session,
                   const hsm_key_t *key)
 {
-    /* TODO: Add ECDSA */
     switch (hsm_get_key_algorithm(ctx, session, key)) {
         case CKK_RSA:
             return hsm_get_key_rdata_rsa(ctx, session, key);
@@ -1611,48 +1854,44 @@ hsm_get_key_rdata(hsm_ctx_t *ctx, hsm_session_t *session,
         case CKK_GOSTR3410:
             return hsm_get_key_rdata_gost(ctx, session, key);
             break;
+        case CKK_EC:
+            return hsm_get_key_rdata_ecdsa(ctx, session, key);
+            break;
+        case CKK_EC_EDWARDS:
+            return hsm_get_key_rdata_eddsa(ctx, session, key);
+            break;
         default:
             return 0;
     }
 }
 
-/* this function allocates memory for the mechanism ID and enough room
- * to leave the upcoming digest data. It fills in the mechanism id
- * use with care. The returned data must be free'd by the caller.
- * Only used by RSA PKCS. */
-static CK_BYTE *
-hsm_create_prefix(CK_ULONG digest_len,
-                  ldns_algorithm algorithm,
-                  CK_ULONG *data_size)
+/* this function writes the mechanism ID for the digest into data and
+ * returns the length of the prefix. The digest goes right after it, so
+ * data needs room for HSM_MAX_DIGESTINFO_LENGTH bytes.
+ * Only RSA PKCS needs a prefix, for the other algorithms it is empty.
+ * Returns -1 for unsupported algorithms. */
+static int
+hsm_create_prefix(ldns_algorithm algorithm, CK_BYTE *data)
 {
-    CK_BYTE *data;
-    const CK_BYTE RSA_MD5_ID[] = { 0x30, 0x20, 0x30, 0x0C, 0x06, 0x08, 0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x02, 0x05, 0x05, 0x00, 0x04, 0x10 };
-    const CK_BYTE RSA_SHA1_ID[] = { 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2B, 0x0E, 0x03, 0x02, 0x1A, 0x05, 0x00, 0x04, 0x14 };
-    const CK_BYTE RSA_SHA256_ID[] = { 0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
-    const CK_BYTE RSA_SHA512_ID[] = { 0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40 };
+    static const CK_BYTE RSA_MD5_ID[] = { 0x30, 0x20, 0x30, 0x0C, 0x06, 0x08, 0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x02, 0x05, 0x05, 0x00, 0x04, 0x10 };
+    static const CK_BYTE RSA_SHA1_ID[] = { 0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2B, 0x0E, 0x03, 0x02, 0x1A, 0x05, 0x00, 0x04, 0x14 };
+    static const CK_BYTE RSA_SHA256_ID[] = { 0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+    static const CK_BYTE RSA_SHA512_ID[] = { 0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40 };
 
     switch(algorithm) {
         case LDNS_SIGN_RSAMD5:
-            *data_size = sizeof(RSA_MD5_ID) + digest_len;
-            data = malloc(*data_size);
             memcpy(data, RSA_MD5_ID, sizeof(RSA_MD5_ID));
-            break;
+            return sizeof(RSA_MD5_ID);
         case LDNS_SIGN_RSASHA1:
         case LDNS_SIGN_RSASHA1_NSEC3:
-            *data_size = sizeof(RSA_SHA1_ID) + digest_len;
-            data = malloc(*data_size);
             memcpy(data, RSA_SHA1_ID, sizeof(RSA_SHA1_ID));
-            break;
-	case LDNS_SIGN_RSASHA256:
-            *data_size = sizeof(RSA_SHA256_ID) + digest_len;
-            data = malloc(*data_size);
+            return sizeof(RSA_SHA1_ID);
+        case LDNS_SIGN_RSASHA256:
             memcpy(data, RSA_SHA256_ID, sizeof(RSA_SHA256_ID));
-            break;
-	case LDNS_SIGN_RSASHA512:
-            *data_size = sizeof(RSA_SHA512_ID) + digest_len;
-            data = malloc(*data_size);
+            return sizeof(RSA_SHA256_ID);
+        case LDNS_SIGN_RSASHA512:
             memcpy(data, RSA_SHA512_ID, sizeof(RSA_SHA512_ID));
-            break;
+            return sizeof(RSA_SHA512_ID);
         case LDNS_SIGN_DSA:
         case LDNS_SIGN_DSA_NSEC3:
         case LDNS_SIGN_ECC_GOST:
@@ -1660,140 +1899,256 @@ hsm_create_prefix(CK_ULONG digest_len,
         case LDNS_SIGN_ECDSAP256SHA256:
         case LDNS_SIGN_ECDSAP384SHA384:
 #endif
-            *data_size = digest_len;
-            data = malloc(*data_size);
-            break;
+            return 0;
         default:
-            return NULL;
+            return -1;
     }
-    return data;
 }
 
-static CK_BYTE *
-hsm_digest_through_hsm(hsm_ctx_t *ctx,
-                       hsm_session_t *session,
-                       CK_MECHANISM_TYPE mechanism_type,
-                       CK_ULONG digest_len,
-                       ldns_buffer *sign_buf)
+hsm_digest_ctx_t *
+hsm_digest_ctx_new(void)
 {
-    CK_MECHANISM digest_mechanism;
-    CK_BYTE *digest;
-    CK_RV rv;
+    hsm_digest_ctx_t *digest_ctx;
 
-    digest_mechanism.pParameter = NULL;
-    digest_mechanism.ulParameterLen = 0;
-    digest_mechanism.mechanism = mechanism_type;
-    digest = malloc(digest_len);
-    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_DigestInit(session->session,
-                                                 &digest_mechanism);
-    if (hsm_pkcs11_check_error(ctx, rv, "HSM digest init")) {
-        free(digest);
+    digest_ctx = malloc(sizeof(hsm_digest_ctx_t));
+    if (!digest_ctx) return NULL;
+    digest_ctx->md_ctx = EVP_MD_CTX_create();
+    if (!digest_ctx->md_ctx) {
+        free(digest_ctx);
         return NULL;
     }
+    digest_ctx->algorithm = 0;
+    digest_ctx->digest_len = 0;
+    digest_ctx->through_hsm = 0;
+    return digest_ctx;
+}
 
-    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_Digest(session->session,
-                                        ldns_buffer_begin(sign_buf),
-                                        ldns_buffer_position(sign_buf),
-                                        digest,
-                                        &digest_len);
-    if (hsm_pkcs11_check_error(ctx, rv, "HSM digest")) {
-        free(digest);
-        return NULL;
-    }
-    return digest;
+void
+hsm_digest_ctx_free(hsm_digest_ctx_t *digest_ctx)
+{
+    if (!digest_ctx) return;
+    EVP_MD_CTX_destroy(digest_ctx->md_ctx);
+    free(digest_ctx);
 }
 
-static ldns_rdf *
-hsm_sign_buffer(hsm_ctx_t *ctx,
-                ldns_buffer *sign_buf,
+int
+hsm_digest_init(hsm_ctx_t *ctx,
+                hsm_digest_ctx_t *digest_ctx,
                 const hsm_key_t *key,
                 ldns_algorithm algorithm)
 {
+    CK_MECHANISM digest_mechanism;
     CK_RV rv;
-    CK_ULONG signatureLen = HSM_MAX_SIGNATURE_LENGTH;
-    CK_BYTE signature[HSM_MAX_SIGNATURE_LENGTH];
-    CK_MECHANISM sign_mechanism;
-
-    ldns_rdf *sig_rdf;
-    CK_BYTE *digest = NULL;
-    CK_ULONG digest_len;
-
-    CK_BYTE *data = NULL;
-    CK_ULONG data_len = 0;
-
+    const EVP_MD *md = NULL;
     hsm_session_t *session;
 
-    session = hsm_find_key_session(ctx, key);
-    if (!session) return NULL;
+    if (!ctx) ctx = _hsm_ctx;
+    if (!digest_ctx || !key) return -1;
+
+    digest_ctx->algorithm = algorithm;
+    digest_ctx->through_hsm = 0;
 
     /* some HSMs don't really handle CKM_SHA1_RSA_PKCS well, so
-     * we'll do the hashing manually */
-    /* When adding algorithms, remember there is another switch below */
+     * we'll do the hashing manually. The OpenSSL EVP digests pick the
+     * fastest implementation for the CPU (SHA-NI, AVX2) at runtime. */
+    /* When adding algorithms, remember there are switches in
+     * hsm_create_prefix() and hsm_sign_digest() as well */
     switch (algorithm) {
         case LDNS_SIGN_RSAMD5:
-            digest_len = 16;
-            digest = hsm_digest_through_hsm(ctx, session,
-                                            CKM_MD5, digest_len,
-                                            sign_buf);
+            digest_ctx->digest_len = 16;
+            digest_mechanism.mechanism = CKM_MD5;
+            digest_ctx->through_hsm = 1;
             break;
         case LDNS_SIGN_RSASHA1:
         case LDNS_SIGN_RSASHA1_NSEC3:
         case LDNS_SIGN_DSA:
         case LDNS_SIGN_DSA_NSEC3:
-            digest_len = LDNS_SHA1_DIGEST_LENGTH;
-            digest = malloc(digest_len);
-            digest = ldns_sha1(ldns_buffer_begin(sign_buf),
-                               ldns_buffer_position(sign_buf),
-                               digest);
+            md = EVP_sha1();
             break;
-
         case LDNS_SIGN_RSASHA256:
 #if LDNS_BUILD_CONFIG_USE_ECDSA
         case LDNS_SIGN_ECDSAP256SHA256:
 #endif
-            digest_len = LDNS_SHA256_DIGEST_LENGTH;
-            digest = malloc(digest_len);
-            digest = ldns_sha256(ldns_buffer_begin(sign_buf),
-                                 ldns_buffer_position(sign_buf),
-                                 digest);
+            md = EVP_sha256();
             break;
 #if LDNS_BUILD_CONFIG_USE_ECDSA
         case LDNS_SIGN_ECDSAP384SHA384:
-            digest_len = LDNS_SHA384_DIGEST_LENGTH;
-            digest = malloc(digest_len);
-            digest = ldns_sha384(ldns_buffer_begin(sign_buf),
-                                 ldns_buffer_position(sign_buf),
-                                 digest);
+            md = EVP_sha384();
             break;
 #endif
         case LDNS_SIGN_RSASHA512:
-            digest_len = LDNS_SHA512_DIGEST_LENGTH;
-            digest = malloc(digest_len);
-            digest = ldns_sha512(ldns_buffer_begin(sign_buf),
-                                 ldns_buffer_position(sign_buf),
-                                 digest);
+            md = EVP_sha512();
             break;
         case LDNS_SIGN_ECC_GOST:
-            digest_len = 16;
-            digest = hsm_digest_through_hsm(ctx, session,
-                                            CKM_GOSTR3411, digest_len,
-                                            sign_buf);
+            digest_ctx->digest_len = 32;
+            digest_mechanism.mechanism = CKM_GOSTR3411;
+            digest_ctx->through_hsm = 1;
             break;
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_SIGN_ED25519:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_SIGN_ED448:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+            /* EdDSA hashes the whole message itself, in one part */
+            hsm_ctx_set_error(ctx, -1, "hsm_digest_init()",
+                "EdDSA has no separate digest, use hsm_sign_data()");
+            return -1;
+#endif
         default:
             /* log error? or should we not even get here for
              * unsupported algorithms? */
-            return NULL;
+            return -1;
+    }
+
+    if (!digest_ctx->through_hsm) {
+        if (!EVP_DigestInit_ex(digest_ctx->md_ctx, md, NULL)) {
+            hsm_ctx_set_error(ctx, -1, "hsm_digest_init()",
+                "Unable to start the digest");
+            return -1;
+        }
+        digest_ctx->digest_len = EVP_MD_size(md);
+        return 0;
+    }
+
+    session = hsm_find_key_session(ctx, key);
+    if (!session) return -1;
+
+    digest_mechanism.pParameter = NULL;
+    digest_mechanism.ulParameterLen = 0;
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_DigestInit(session->session,
+                                                 &digest_mechanism);
+    if (hsm_pkcs11_check_error(ctx, rv, "HSM digest init")) {
+        return -1;
+    }
+    return 0;
+}
+
+int
+hsm_digest_update(hsm_ctx_t *ctx,
+                  hsm_digest_ctx_t *digest_ctx,
+                  const hsm_key_t *key,
+                  const unsigned char *data,
+                  size_t data_len)
+{
+    CK_RV rv;
+    hsm_session_t *session;
+
+    if (!ctx) ctx = _hsm_ctx;
+    if (!digest_ctx || !key || (!data && data_len > 0)) return -1;
+
+    if (digest_ctx->through_hsm) {
+        session = hsm_find_key_session(ctx, key);
+        if (!session) return -1;
+
+        rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_DigestUpdate(
+                                            session->session,
+                                            (CK_BYTE_PTR) data,
+                                            data_len);
+        if (hsm_pkcs11_check_error(ctx, rv, "HSM digest update")) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (!EVP_DigestUpdate(digest_ctx->md_ctx, data, data_len)) {
+        hsm_ctx_set_error(ctx, -1, "hsm_digest_update()",
+            "Unable to update the digest");
+        return -1;
     }
+    return 0;
+}
+
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+/* read a DER INTEGER at *p, returns its value and moves *p past it */
+static const CK_BYTE *
+hsm_der_integer(const CK_BYTE **p, const CK_BYTE *end, CK_ULONG *len)
+{
+    const CK_BYTE *value;
 
-    if (!digest) {
+    if (end - *p < 2 || (*p)[0] != 0x02 || (*p)[1] >= 0x80 ||
+        (*p)[1] > end - *p - 2) {
         return NULL;
     }
+    *len = (*p)[1];
+    value = *p + 2;
+    *p = value + *len;
+    return value;
+}
 
-    /* CKM_RSA_PKCS does the padding, but cannot know the identifier
-     * prefix, so we need to add that ourselves.
-     * The other algorithms will just get the digest buffer returned. */
-    data = hsm_create_prefix(digest_len, algorithm, &data_len);
-    memcpy(data + data_len - digest_len, digest, digest_len);
+/* DNSSEC wants the ECDSA signature as r || s, both as long as the curve
+ * order (RFC 6605). That is what CKM_ECDSA returns, but some tokens
+ * return a DER SEQUENCE of two INTEGERs, or r and s without leading
+ * zeroes. The signature is rewritten in place. */
+static int
+hsm_ecdsa_raw_signature(CK_BYTE *signature, CK_ULONG *signature_len,
+                        CK_ULONG size)
+{
+    CK_BYTE raw[2 * SHA384_DIGEST_LENGTH];
+    const CK_BYTE *p, *end, *r = NULL, *s = NULL;
+    CK_ULONG r_len = 0, s_len = 0;
+
+    if (*signature_len == 2 * size) {
+        return 0;
+    }
+    if (size > SHA384_DIGEST_LENGTH) {
+        return -1;
+    }
+
+    p = signature;
+    end = signature + *signature_len;
+    if (*signature_len > 2 && p[0] == 0x30 && p[1] < 0x80 &&
+        p[1] == *signature_len - 2) {
+        p += 2;
+        r = hsm_der_integer(&p, end, &r_len);
+        if (r) s = hsm_der_integer(&p, end, &s_len);
+        if (p != end) s = NULL;
+    }
+    if (!r || !s) {
+        if (*signature_len % 2 || *signature_len > 2 * size) {
+            return -1;
+        }
+        r = signature;
+        s = signature + *signature_len / 2;
+        r_len = s_len = *signature_len / 2;
+    }
+    while (r_len > size && *r == 0) {
+        r++;
+        r_len--;
+    }
+    while (s_len > size && *s == 0) {
+        s++;
+        s_len--;
+    }
+    if (r_len > size || s_len > size) {
+        return -1;
+    }
+
+    memset(raw, 0, 2 * size);
+    memcpy(raw + size - r_len, r, r_len);
+    memcpy(raw + 2 * size - s_len, s, s_len);
+    memcpy(signature, raw, 2 * size);
+    *signature_len = 2 * size;
+    return 0;
+}
+#endif
+
+/* sign the DigestInfo (or plain digest) in data with the key, for EdDSA
+ * data is the message itself */
+static int
+hsm_sign_digestinfo(hsm_ctx_t *ctx,
+                    hsm_session_t *session,
+                    const hsm_key_t *key,
+                    ldns_algorithm algorithm,
+                    CK_BYTE *data,
+                    CK_ULONG data_len,
+                    unsigned char *signature,
+                    size_t *signature_len)
+{
+    CK_RV rv;
+    CK_ULONG signatureLen = HSM_MAX_SIGNATURE_LENGTH;
+    CK_MECHANISM sign_mechanism;
 
     sign_mechanism.pParameter = NULL;
     sign_mechanism.ulParameterLen = 0;
@@ -1813,16 +2168,25 @@ hsm_sign_buffer(hsm_ctx_t *ctx,
             sign_mechanism.mechanism = CKM_GOSTR3410;
             break;
 #if LDNS_BUILD_CONFIG_USE_ECDSA
-        /* TODO: Add ECDSA */
         case LDNS_SIGN_ECDSAP256SHA256:
         case LDNS_SIGN_ECDSAP384SHA384:
+            sign_mechanism.mechanism = CKM_ECDSA;
+            break;
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_SIGN_ED25519:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_SIGN_ED448:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+            sign_mechanism.mechanism = CKM_EDDSA;
+            break;
 #endif
         default:
             /* log error? or should we not even get here for
              * unsupported algorithms? */
-            free(data);
-            free(digest);
-            return NULL;
+            return -1;
     }
 
     rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_SignInit(
@@ -1830,29 +2194,236 @@ hsm_sign_buffer(hsm_ctx_t *ctx,
                                       &sign_mechanism,
                                       key->private_key);
     if (hsm_pkcs11_check_error(ctx, rv, "sign init")) {
-        free(data);
-        free(digest);
-        return NULL;
+        return -1;
     }
 
     rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_Sign(session->session, data, data_len,
                                       signature,
                                       &signatureLen);
     if (hsm_pkcs11_check_error(ctx, rv, "sign final")) {
-        free(data);
-        free(digest);
-        return NULL;
+        return -1;
+    }
+
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+    switch(algorithm) {
+        case LDNS_SIGN_ECDSAP256SHA256:
+            rv = hsm_ecdsa_raw_signature(signature, &signatureLen, 32);
+            break;
+        case LDNS_SIGN_ECDSAP384SHA384:
+            rv = hsm_ecdsa_raw_signature(signature, &signatureLen, 48);
+            break;
+        default:
+            rv = 0;
+            break;
+    }
+    if (rv != 0) {
+        hsm_ctx_set_error(ctx, -1, "hsm_sign_digestinfo()",
+            "Unexpected ECDSA signature format");
+        return -1;
+    }
+#endif
+
+    *signature_len = signatureLen;
+    return 0;
+}
+
+int
+hsm_sign_digest(hsm_ctx_t *ctx,
+                hsm_digest_ctx_t *digest_ctx,
+                const hsm_key_t *key,
+                unsigned char *signature,
+                size_t *signature_len)
+{
+    CK_RV rv;
+    CK_BYTE data[HSM_MAX_DIGESTINFO_LENGTH];
+    CK_ULONG digest_len;
+    unsigned int md_len;
+    int prefix_len;
+
+    hsm_session_t *session;
+
+    if (!ctx) ctx = _hsm_ctx;
+    if (!digest_ctx || !key || !signature || !signature_len) return -1;
+
+    session = hsm_find_key_session(ctx, key);
+    if (!session) return -1;
+
+    /* CKM_RSA_PKCS does the padding, but cannot know the identifier
+     * prefix, so we need to add that ourselves.
+     * The other algorithms will just get the digest. */
+    prefix_len = hsm_create_prefix(digest_ctx->algorithm, data);
+    if (prefix_len < 0) {
+        return -1;
+    }
+    digest_len = digest_ctx->digest_len;
+
+    if (digest_ctx->through_hsm) {
+        rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_DigestFinal(
+                                            session->session,
+                                            data + prefix_len,
+                                            &digest_len);
+        if (hsm_pkcs11_check_error(ctx, rv, "HSM digest")) {
+            return -1;
+        }
+    } else {
+        if (!EVP_DigestFinal_ex(digest_ctx->md_ctx, data + prefix_len,
+                                &md_len)) {
+            hsm_ctx_set_error(ctx, -1, "hsm_sign_digest()",
+                "Unable to finish the digest");
+            return -1;
+        }
+        digest_len = md_len;
+    }
+
+    return hsm_sign_digestinfo(ctx, session, key, digest_ctx->algorithm,
+                               data, prefix_len + digest_len,
+                               signature, signature_len);
+}
+
+int
+hsm_sign_data(hsm_ctx_t *ctx,
+              const unsigned char *sign_data,
+              size_t sign_len,
+              const hsm_key_t *key,
+              ldns_algorithm algorithm,
+              unsigned char *signature,
+              size_t *signature_len)
+{
+    hsm_digest_ctx_t *digest_ctx;
+    hsm_session_t *session;
+    int result;
+
+    if (!ctx) ctx = _hsm_ctx;
+    if (!sign_data) return -1;
+
+    switch (algorithm) {
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_SIGN_ED25519:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_SIGN_ED448:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+            /* no digest step, the token signs the message itself */
+            if (!key || !signature || !signature_len) return -1;
+            session = hsm_find_key_session(ctx, key);
+            if (!session) return -1;
+            return hsm_sign_digestinfo(ctx, session, key, algorithm,
+                                       (CK_BYTE *) sign_data, sign_len,
+                                       signature, signature_len);
+#endif
+        default:
+            break;
+    }
+
+    digest_ctx = hsm_digest_ctx_new();
+    if (!digest_ctx) {
+        hsm_ctx_set_error(ctx, -1, "hsm_sign_data()", "Out of memory");
+        return -1;
+    }
+    result = hsm_digest_init(ctx, digest_ctx, key, algorithm);
+    if (result == 0) {
+        result = hsm_digest_update(ctx, digest_ctx, key, sign_data, sign_len);
+    }
+    if (result == 0) {
+        result = hsm_sign_digest(ctx, digest_ctx, key, signature,
+                                 signature_len);
+    }
+    hsm_digest_ctx_free(digest_ctx);
+    return result;
+}
+
+int
+hsm_sign_data_batch(hsm_ctx_t *ctx,
+                    size_t count,
+                    const unsigned char *const *data,
+                    const size_t *data_len,
+                    const hsm_key_t *key,
+                    ldns_algorithm algorithm,
+                    unsigned char *signatures,
+                    size_t *signature_len)
+{
+    CK_BYTE digests[HSM_DIGEST_LANES * SHA256_DIGEST_LENGTH];
+    CK_BYTE info[HSM_MAX_DIGESTINFO_LENGTH];
+    hsm_digest_type_t type;
+    size_t digest_len;
+    size_t i, j, n;
+    int prefix_len;
+
+    hsm_session_t *session;
+
+    if (!ctx) ctx = _hsm_ctx;
+    if (!key || !signatures || !signature_len) return -1;
+    if (count > 0 && (!data || !data_len)) return -1;
+
+    /* only SHA-1 and SHA-256 have a multi-buffer digest */
+    switch (algorithm) {
+        case LDNS_SIGN_RSASHA1:
+        case LDNS_SIGN_RSASHA1_NSEC3:
+        case LDNS_SIGN_DSA:
+        case LDNS_SIGN_DSA_NSEC3:
+            type = HSM_DIGEST_SHA1;
+            break;
+        case LDNS_SIGN_RSASHA256:
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+        case LDNS_SIGN_ECDSAP256SHA256:
+#endif
+            type = HSM_DIGEST_SHA256;
+            break;
+        default:
+            for (i = 0; i < count; i++) {
+                if (hsm_sign_data(ctx, data[i], data_len[i], key, algorithm,
+                                  signatures + i * HSM_MAX_SIGNATURE_LENGTH,
+                                  &signature_len[i]) != 0) {
+                    return -1;
+                }
+            }
+            return 0;
     }
 
-    sig_rdf = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64,
-                                    signatureLen,
-                                    signature);
+    session = hsm_find_key_session(ctx, key);
+    if (!session) return -1;
+
+    prefix_len = hsm_create_prefix(algorithm, info);
+    if (prefix_len < 0) return -1;
+    digest_len = hsm_digest_length(type);
 
-    free(data);
-    free(digest);
+    for (i = 0; i < count; i += n) {
+        n = count - i;
+        if (n > HSM_DIGEST_LANES) n = HSM_DIGEST_LANES;
+        if (hsm_digest_batch(type, n, data + i, data_len + i,
+                             digests) != 0) {
+            return -1;
+        }
+        for (j = 0; j < n; j++) {
+            memcpy(info + prefix_len, digests + j * digest_len, digest_len);
+            if (hsm_sign_digestinfo(ctx, session, key, algorithm,
+                    info, prefix_len + digest_len,
+                    signatures + (i + j) * HSM_MAX_SIGNATURE_LENGTH,
+                    &signature_len[i + j]) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
 
-    return sig_rdf;
+static ldns_rdf *
+hsm_sign_buffer(hsm_ctx_t *ctx,
+                ldns_buffer *sign_buf,
+                const hsm_key_t *key,
+                ldns_algorithm algorithm)
+{
+    unsigned char signature[HSM_MAX_SIGNATURE_LENGTH];
+    size_t signature_len = 0;
 
+    if (hsm_sign_data(ctx, ldns_buffer_begin(sign_buf),
+                      ldns_buffer_position(sign_buf), key, algorithm,
+                      signature, &signature_len) != 0) {
+        return NULL;
+    }
+    return ldns_rdf_new_frm_data(LDNS_RDF_TYPE_B64, signature_len,
+                                 signature);
 }
 
 static int
@@ -2425,6 +2996,19 @@ hsm_generate_dsa_key(hsm_ctx_t *ctx,
         { CKA_PRIME_BITS,          &keysize, sizeof(keysize) }
     };
 
+    if (!ctx) ctx = _hsm_ctx;
+    session = hsm_find_repository_session(ctx, repository);
+    if (!session) return NULL;
+
+    /* check whether this key doesn't happen to exist already */
+
+    do {
+        hsm_random_buffer(ctx, id, 16);
+    } while (hsm_find_key_by_id_bin(ctx, id, 16));
+    /* the CKA_LABEL will contain a hexadecimal string representation
+     * of the id */
+    hsm_hex_unparse(id_str, id, 16);
+
     CK_ATTRIBUTE publicKeyTemplate[] = {
         { CKA_PRIME,               dsa_p,    sizeof(dsa_p)   },
         { CKA_SUBPRIME,            dsa_q,    sizeof(dsa_q)   },
@@ -2451,19 +3035,6 @@ hsm_generate_dsa_key(hsm_ctx_t *ctx,
         { CKA_EXTRACTABLE,         &cfalse,  sizeof(cfalse)  }
     };
 
-    if (!ctx) ctx = _hsm_ctx;
-    session = hsm_find_repository_session(ctx, repository);
-    if (!session) return NULL;
-
-    /* check whether this key doesn't happen to exist already */
-
-    do {
-        hsm_random_buffer(ctx, id, 16);
-    } while (hsm_find_key_by_id_bin(ctx, id, 16));
-    /* the CKA_LABEL will contain a hexadecimal string representation
-     * of the id */
-    hsm_hex_unparse(id_str, id, 16);
-
     /* Generate the domain parameters */
 
     rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GenerateKey(session->session,
@@ -2528,6 +3099,19 @@ hsm_generate_gost_key(hsm_ctx_t *ctx,
 
     CK_BYTE oid[] = { 0x06, 0x07, 0x2A, 0x85, 0x03, 0x02, 0x02, 0x23, 0x01 };
 
+    if (!ctx) ctx = _hsm_ctx;
+    session = hsm_find_repository_session(ctx, repository);
+    if (!session) return NULL;
+
+    /* check whether this key doesn't happen to exist already */
+
+    do {
+        hsm_random_buffer(ctx, id, 16);
+    } while (hsm_find_key_by_id_bin(ctx, id, 16));
+    /* the CKA_LABEL will contain a hexadecimal string representation
+     * of the id */
+    hsm_hex_unparse(id_str, id, 16);
+
     CK_ATTRIBUTE publicKeyTemplate[] = {
         { CKA_GOSTR3410PARAMS,     oid,      sizeof(oid)     },
         { CKA_LABEL,(CK_UTF8CHAR*) id_str,   strlen(id_str)  },
@@ -2552,7 +3136,179 @@ hsm_generate_gost_key(hsm_ctx_t *ctx,
         { CKA_EXTRACTABLE,         &cfalse,  sizeof(cfalse)  }
     };
 
+    /* Generate key pair */
+
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GenerateKeyPair(session->session,
+                                                 &mechanism,
+                                                 publicKeyTemplate,
+                                                 sizeof(publicKeyTemplate)/sizeof(CK_ATTRIBUTE),
+                                                 privateKeyTemplate,
+                                                 sizeof(privateKeyTemplate)/sizeof(CK_ATTRIBUTE),
+                                                 &publicKey,
+                                                 &privateKey);
+    if (hsm_pkcs11_check_error(ctx, rv, "generate key pair")) {
+        return NULL;
+    }
+
+    new_key = hsm_key_new();
+    new_key->module = session->module;
+    new_key->public_key = publicKey;        
+    new_key->private_key = privateKey;
+
+    return new_key;
+}
+
+hsm_key_t *
+hsm_generate_ecdsa_key(hsm_ctx_t *ctx,
+                       const char *repository,
+                       unsigned long keysize)
+{
+    CK_RV rv;
+    hsm_key_t *new_key;
+    hsm_session_t *session;
+    CK_OBJECT_HANDLE publicKey, privateKey;
+    CK_BBOOL ctrue = CK_TRUE;
+    CK_BBOOL cfalse = CK_FALSE;
+    CK_BBOOL ctoken = CK_TRUE;
+    CK_VOID_PTR oid;
+    CK_ULONG oid_len;
+
+    /* ids we create are 16 bytes of data */
+    unsigned char id[16];
+    /* that's 33 bytes in string (16*2 + 1 for \0) */
+    char id_str[33];
+
+    CK_KEY_TYPE keyType = CKK_EC;
+    CK_MECHANISM mechanism = {
+        CKM_EC_KEY_PAIR_GEN, NULL_PTR, 0
+    };
+
+    if (!ctx) ctx = _hsm_ctx;
+
+    /* only the curves with a DNSSEC algorithm */
+    switch (keysize) {
+        case 256:
+            oid = (CK_VOID_PTR) hsm_oid_p256;
+            oid_len = sizeof(hsm_oid_p256);
+            break;
+        case 384:
+            oid = (CK_VOID_PTR) hsm_oid_p384;
+            oid_len = sizeof(hsm_oid_p384);
+            break;
+        default:
+            hsm_ctx_set_error(ctx, -1, "hsm_generate_ecdsa_key()",
+                "Unsupported key size %lu, use 256 or 384", keysize);
+            return NULL;
+    }
+
+    session = hsm_find_repository_session(ctx, repository);
+    if (!session) return NULL;
+
+    /* check whether this key doesn't happen to exist already */
+
+    do {
+        hsm_random_buffer(ctx, id, 16);
+    } while (hsm_find_key_by_id_bin(ctx, id, 16));
+    /* the CKA_LABEL will contain a hexadecimal string representation
+     * of the id */
+    hsm_hex_unparse(id_str, id, 16);
+
+    if (! session->module->config->use_pubkey) {
+        ctoken = CK_FALSE;
+    }
+
+    CK_ATTRIBUTE publicKeyTemplate[] = {
+        { CKA_EC_PARAMS,           oid,      oid_len         },
+        { CKA_LABEL,(CK_UTF8CHAR*) id_str,   strlen(id_str)  },
+        { CKA_ID,                  id,       16              },
+        { CKA_KEY_TYPE,            &keyType, sizeof(keyType) },
+        { CKA_VERIFY,              &ctrue,   sizeof(ctrue)   },
+        { CKA_ENCRYPT,             &cfalse,  sizeof(cfalse)  },
+        { CKA_WRAP,                &cfalse,  sizeof(cfalse)  },
+        { CKA_TOKEN,               &ctoken,  sizeof(ctoken)  }
+    };
+
+    CK_ATTRIBUTE privateKeyTemplate[] = {
+        { CKA_LABEL,(CK_UTF8CHAR*) id_str,   strlen (id_str) },
+        { CKA_ID,                  id,       16              },
+        { CKA_KEY_TYPE,            &keyType, sizeof(keyType) },
+        { CKA_SIGN,                &ctrue,   sizeof(ctrue)   },
+        { CKA_DECRYPT,             &cfalse,  sizeof(cfalse)  },
+        { CKA_UNWRAP,              &cfalse,  sizeof(cfalse)  },
+        { CKA_SENSITIVE,           &ctrue,   sizeof(ctrue)   },
+        { CKA_TOKEN,               &ctrue,   sizeof(ctrue)   },
+        { CKA_PRIVATE,             &ctrue,   sizeof(ctrue)   },
+        { CKA_EXTRACTABLE,         &cfalse,  sizeof(cfalse)  }
+    };
+
+    /* Generate key pair */
+
+    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GenerateKeyPair(session->session,
+                                                 &mechanism,
+                                                 publicKeyTemplate,
+                                                 sizeof(publicKeyTemplate)/sizeof(CK_ATTRIBUTE),
+                                                 privateKeyTemplate,
+                                                 sizeof(privateKeyTemplate)/sizeof(CK_ATTRIBUTE),
+                                                 &publicKey,
+                                                 &privateKey);
+    if (hsm_pkcs11_check_error(ctx, rv, "generate key pair")) {
+        return NULL;
+    }
+
+    new_key = hsm_key_new();
+    new_key->module = session->module;
+    if (session->module->config->use_pubkey) {
+        new_key->public_key = publicKey;
+    } else {
+        new_key->public_key = 0;
+    }
+    new_key->private_key = privateKey;
+
+    return new_key;
+}
+
+hsm_key_t *
+hsm_generate_eddsa_key(hsm_ctx_t *ctx,
+                       const char *repository,
+                       unsigned long keysize)
+{
+    CK_RV rv;
+    hsm_key_t *new_key;
+    hsm_session_t *session;
+    CK_OBJECT_HANDLE publicKey, privateKey;
+    CK_BBOOL ctrue = CK_TRUE;
+    CK_BBOOL cfalse = CK_FALSE;
+    CK_VOID_PTR oid;
+    CK_ULONG oid_len;
+
+    /* ids we create are 16 bytes of data */
+    unsigned char id[16];
+    /* that's 33 bytes in string (16*2 + 1 for \0) */
+    char id_str[33];
+
+    CK_KEY_TYPE keyType = CKK_EC_EDWARDS;
+    CK_MECHANISM mechanism = {
+        CKM_EC_EDWARDS_KEY_PAIR_GEN, NULL_PTR, 0
+    };
+
     if (!ctx) ctx = _hsm_ctx;
+
+    /* Ed25519 (255) and Ed448 (448), the curves of RFC 8080 */
+    switch (keysize) {
+        case 255:
+            oid = (CK_VOID_PTR) hsm_oid_ed25519;
+            oid_len = sizeof(hsm_oid_ed25519);
+            break;
+        case 448:
+            oid = (CK_VOID_PTR) hsm_oid_ed448;
+            oid_len = sizeof(hsm_oid_ed448);
+            break;
+        default:
+            hsm_ctx_set_error(ctx, -1, "hsm_generate_eddsa_key()",
+                "Unsupported key size %lu, use 255 or 448", keysize);
+            return NULL;
+    }
+
     session = hsm_find_repository_session(ctx, repository);
     if (!session) return NULL;
 
@@ -2565,12 +3321,38 @@ hsm_generate_gost_key(hsm_ctx_t *ctx,
      * of the id */
     hsm_hex_unparse(id_str, id, 16);
 
+    CK_ATTRIBUTE publicKeyTemplate[] = {
+        { CKA_EC_PARAMS,           oid,      oid_len         },
+        { CKA_LABEL,(CK_UTF8CHAR*) id_str,   strlen(id_str)  },
+        { CKA_ID,                  id,       16              },
+        { CKA_KEY_TYPE,            &keyType, sizeof(keyType) },
+        { CKA_VERIFY,              &ctrue,   sizeof(ctrue)   },
+        { CKA_ENCRYPT,             &cfalse,  sizeof(cfalse)  },
+        { CKA_WRAP,                &cfalse,  sizeof(cfalse)  },
+        { CKA_TOKEN,               &ctrue,   sizeof(ctrue)   }
+    };
+
+    CK_ATTRIBUTE privateKeyTemplate[] = {
+        { CKA_LABEL,(CK_UTF8CHAR*) id_str,   strlen (id_str) },
+        { CKA_ID,                  id,       16              },
+        { CKA_KEY_TYPE,            &keyType, sizeof(keyType) },
+        { CKA_SIGN,                &ctrue,   sizeof(ctrue)   },
+        { CKA_DECRYPT,             &cfalse,  sizeof(cfalse)  },
+        { CKA_UNWRAP,              &cfalse,  sizeof(cfalse)  },
+        { CKA_SENSITIVE,           &ctrue,   sizeof(ctrue)   },
+        { CKA_TOKEN,               &ctrue,   sizeof(ctrue)   },
+        { CKA_PRIVATE,             &ctrue,   sizeof(ctrue)   },
+        { CKA_EXTRACTABLE,         &cfalse,  sizeof(cfalse)  }
+    };
+
     /* Generate key pair */
 
     rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_GenerateKeyPair(session->session,
                                                  &mechanism,
-                                                 publicKeyTemplate, 10,
-                                                 privateKeyTemplate, 10,
+                                                 publicKeyTemplate,
+                                                 sizeof(publicKeyTemplate)/sizeof(CK_ATTRIBUTE),
+                                                 privateKeyTemplate,
+                                                 sizeof(privateKeyTemplate)/sizeof(CK_ATTRIBUTE),
                                                  &publicKey,
                                                  &privateKey);
     if (hsm_pkcs11_check_error(ctx, rv, "generate key pair")) {
@@ -2579,7 +3361,7 @@ hsm_generate_gost_key(hsm_ctx_t *ctx,
 
     new_key = hsm_key_new();
     new_key->module = session->module;
-    new_key->public_key = publicKey;        
+    new_key->public_key = publicKey;
     new_key->private_key = privateKey;
 
     return new_key;
@@ -2687,7 +3469,6 @@ hsm_get_key_info(hsm_ctx_t *ctx,
                                                          key,
                                                          key_info->algorithm);
 
-    /* TODO: Add ECDSA */
     switch(key_info->algorithm) {
         case CKK_RSA:
             key_info->algorithm_name = strdup("RSA");
@@ -2698,6 +3479,12 @@ hsm_get_key_info(hsm_ctx_t *ctx,
         case CKK_GOSTR3410:
             key_info->algorithm_name = strdup("GOST");
             break;
+        case CKK_EC:
+            key_info->algorithm_name = strdup("ECDSA");
+            break;
+        case CKK_EC_EDWARDS:
+            key_info->algorithm_name = strdup("EDDSA");
+            break;
         default:
             key_info->algorithm_name = malloc(HSM_MAX_ALGONAME);
             snprintf(key_info->algorithm_name, HSM_MAX_ALGONAME,
@@ -2777,57 +3564,6 @@ hsm_sign_rrset(hsm_ctx_t *ctx,
     return signature;
 }
 
-/* returns a newly allocated (not null-terminated!) string containing
- * the message digest of the given source string
- * digest length contains the length of the result
- * caller must free returned data with free()
- * returns NULL (and zero digest length) on error
- */
-static CK_BYTE *
-hsm_digest(hsm_ctx_t *ctx,
-           hsm_session_t *session,
-           CK_MECHANISM digest_mechanism,
-           char *source,
-           size_t length,
-           size_t *digest_length)
-{
-    CK_RV rv;
-    CK_BYTE *digest;
-    CK_ULONG d = 0;
-
-    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_DigestInit(session->session,
-                                                 &digest_mechanism);
-    if (hsm_pkcs11_check_error(ctx, rv, "digest init")) {
-        *digest_length = 0;
-        return NULL;
-    }
-
-    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_Digest(session->session,
-                                        (CK_BYTE *)source,
-                                        length,
-                                        NULL,
-                                        &d);
-
-    if (hsm_pkcs11_check_error(ctx, rv, "digest to determine result size")) {
-        *digest_length = 0;
-        return NULL;
-    }
-    digest = malloc(d);
-    rv = ((CK_FUNCTION_LIST_PTR)session->module->sym)->C_Digest(session->session,
-                                        (CK_BYTE *)source,
-                                        length,
-                                        digest,
-                                        &d);
-    if (hsm_pkcs11_check_error(ctx, rv, "digest")) {
-        *digest_length = 0;
-        free(digest);
-        return NULL;
-    }
-
-    *digest_length = d;
-    return digest;
-}
-
 ldns_rdf *
 hsm_nsec3_hash_name(hsm_ctx_t *ctx,
                     ldns_rdf *name,
@@ -2836,26 +3572,19 @@ hsm_nsec3_hash_name(hsm_ctx_t *ctx,
                     uint8_t salt_length,
                     uint8_t *salt)
 {
-    char *orig_owner_str;
-    size_t hashed_owner_str_len;
     ldns_rdf *hashed_owner;
-    char *hashed_owner_str;
     char *hashed_owner_b32;
     int hashed_owner_b32_len;
-    uint32_t cur_it;
-    char *hash = NULL;
-    size_t hash_length = 0;
+    unsigned char hash[SHA_DIGEST_LENGTH];
+    const unsigned char *owner;
+    size_t owner_len;
     ldns_status status;
-    CK_MECHANISM mechanism;
-    unsigned int i;
-    hsm_session_t *session = NULL;
     char *error_name;
 
+    if (!ctx) ctx = _hsm_ctx;
+
     switch(algorithm) {
     case 1:
-        mechanism.mechanism = CKM_SHA_1;
-        mechanism.pParameter = NULL;
-        mechanism.ulParameterLen = 0;
         break;
     default:
         printf("unknown algo: %u\n", (unsigned int)algorithm);
@@ -2863,57 +3592,30 @@ hsm_nsec3_hash_name(hsm_ctx_t *ctx,
         break;
     }
 
-    /* just use the first available session */
-    if (!ctx) ctx = _hsm_ctx;
-    for (i = 0; i < ctx->session_count; i++) {
-        if (ctx->session[i]) session = ctx->session[i];
-    }
-    if (!session) {
+    /* the hash is computed locally, the same as for signing */
+    owner = ldns_rdf_data(name);
+    owner_len = ldns_rdf_size(name);
+    if (hsm_nsec3_hash_batch(1, &owner, &owner_len, iterations,
+                             salt_length, salt, hash) != 0) {
+        hsm_ctx_set_error(ctx, -1, "hsm_nsec3_hash_name()",
+            "Error hashing owner name");
         return NULL;
     }
 
-    /* prepare the owner name according to the draft section bla */
-    orig_owner_str = ldns_rdf2str(name);
-
-    hashed_owner_str_len = salt_length + ldns_rdf_size(name);
-    hashed_owner_str = LDNS_XMALLOC(char, hashed_owner_str_len);
-    memcpy(hashed_owner_str, ldns_rdf_data(name), ldns_rdf_size(name));
-    memcpy(hashed_owner_str + ldns_rdf_size(name), salt, salt_length);
-
-    for (cur_it = iterations + 1; cur_it > 0; cur_it--) {
-        if (hash != NULL) free(hash);
-        hash = (char *) hsm_digest(ctx,
-                                   session,
-                                   mechanism,
-                                   hashed_owner_str,
-                                   hashed_owner_str_len,
-                                   &hash_length);
-
-        LDNS_FREE(hashed_owner_str);
-        hashed_owner_str_len = salt_length + hash_length;
-        hashed_owner_str = LDNS_XMALLOC(char, hashed_owner_str_len);
-        if (!hashed_owner_str) {
-            hsm_ctx_set_error(ctx, -1, "hsm_nsec3_hash_name()",
-                "Memory error");
-            return NULL;
-        }
-        memcpy(hashed_owner_str, hash, hash_length);
-        memcpy(hashed_owner_str + hash_length, salt, salt_length);
-    }
-
-    LDNS_FREE(hashed_owner_str);
-    hashed_owner_str = hash;
-    hashed_owner_str_len = hash_length;
     hashed_owner_b32 = LDNS_XMALLOC(char,
                               ldns_b32_ntop_calculate_size(
-                                   hashed_owner_str_len) + 1);
-    LDNS_FREE(orig_owner_str);
+                                   sizeof(hash)) + 1);
+    if (!hashed_owner_b32) {
+        hsm_ctx_set_error(ctx, -1, "hsm_nsec3_hash_name()",
+            "Memory error");
+        return NULL;
+    }
     hashed_owner_b32_len =
-        (size_t) ldns_b32_ntop_extended_hex((uint8_t *) hashed_owner_str,
-                                     hashed_owner_str_len,
+        (size_t) ldns_b32_ntop_extended_hex((uint8_t *) hash,
+                                     sizeof(hash),
                                      hashed_owner_b32,
                                      ldns_b32_ntop_calculate_size(
-                                         hashed_owner_str_len));
+                                         sizeof(hash)));
     if (hashed_owner_b32_len < 1) {
         error_name = ldns_rdf2str(name);
         hsm_ctx_set_error(ctx, -1, "hsm_nsec3_hash_name()",
@@ -2924,7 +3626,6 @@ hsm_nsec3_hash_name(hsm_ctx_t *ctx,
         LDNS_FREE(hashed_owner_b32);
         return NULL;
     }
-    hashed_owner_str_len = hashed_owner_b32_len;
     hashed_owner_b32[hashed_owner_b32_len] = '\0';
 
     status = ldns_str2rdf_dname(&hashed_owner, hashed_owner_b32);
@@ -2935,7 +3636,6 @@ hsm_nsec3_hash_name(hsm_ctx_t *ctx,
         return NULL;
     }
 
-    free(hash);
     LDNS_FREE(hashed_owner_b32);
     return hashed_owner;
 }
@@ -3114,6 +3814,48 @@ hsm_token_attached(hsm_ctx_t *ctx, const char *repository)
     return 0;
 }
 
+hsm_key_t *
+hsm_generate_key(hsm_ctx_t *ctx,
+                 const char *repository,
+                 ldns_algorithm algorithm,
+                 unsigned long keysize)
+{
+    if (!ctx) ctx = _hsm_ctx;
+
+    /* for the curves the algorithm determines the key size */
+    switch(algorithm) {
+        case LDNS_SIGN_RSAMD5:
+        case LDNS_SIGN_RSASHA1:
+        case LDNS_SIGN_RSASHA1_NSEC3:
+        case LDNS_SIGN_RSASHA256:
+        case LDNS_SIGN_RSASHA512:
+            return hsm_generate_rsa_key(ctx, repository, keysize);
+        case LDNS_SIGN_DSA:
+        case LDNS_SIGN_DSA_NSEC3:
+            return hsm_generate_dsa_key(ctx, repository, keysize);
+        case LDNS_SIGN_ECC_GOST:
+            return hsm_generate_gost_key(ctx, repository);
+#if LDNS_BUILD_CONFIG_USE_ECDSA
+        case LDNS_SIGN_ECDSAP256SHA256:
+            return hsm_generate_ecdsa_key(ctx, repository, 256);
+        case LDNS_SIGN_ECDSAP384SHA384:
+            return hsm_generate_ecdsa_key(ctx, repository, 384);
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_SIGN_ED25519:
+            return hsm_generate_eddsa_key(ctx, repository, 255);
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_SIGN_ED448:
+            return hsm_generate_eddsa_key(ctx, repository, 448);
+#endif
+        default:
+            hsm_ctx_set_error(ctx, -1, "hsm_generate_key()",
+                "Unsupported algorithm %d", (int) algorithm);
+            return NULL;
+    }
+}
+
 int
 hsm_supported_algorithm(ldns_algorithm algorithm)
 {
@@ -3126,12 +3868,18 @@ hsm_supported_algorithm(ldns_algorithm algorithm)
         case LDNS_SIGN_DSA:
         case LDNS_SIGN_DSA_NSEC3:
         case LDNS_SIGN_ECC_GOST:
-            return 0;
-            break;
 #if LDNS_BUILD_CONFIG_USE_ECDSA
         case LDNS_SIGN_ECDSAP256SHA256:
         case LDNS_SIGN_ECDSAP384SHA384:
 #endif
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_SIGN_ED25519:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_SIGN_ED448:
+#endif
+            return 0;
+            break;
         default:
             return -1;
     }
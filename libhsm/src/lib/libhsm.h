@@ -341,6 +341,40 @@ hsm_key_t *
 hsm_generate_gost_key(hsm_ctx_t *context,
                      const char *repository);
 
+/*! Generate new key pair in HSM
+
+Keys generated by libhsm will have a 16-byte identifier set as CKA_ID
+and the hexadecimal representation of it set as CKA_LABEL.
+
+The returned key structure can be freed with hsm_key_free()
+
+\param context HSM context
+\param repository repository in where to create the key
+\param keysize Size of ECDSA key, 256 (P-256) or 384 (P-384)
+\return return key identifier or NULL if key generation failed
+*/
+hsm_key_t *
+hsm_generate_ecdsa_key(hsm_ctx_t *context,
+                       const char *repository,
+                       unsigned long keysize);
+
+/*! Generate new key pair in HSM
+
+Keys generated by libhsm will have a 16-byte identifier set as CKA_ID
+and the hexadecimal representation of it set as CKA_LABEL.
+
+The returned key structure can be freed with hsm_key_free()
+
+\param context HSM context
+\param repository repository in where to create the key
+\param keysize Size of EdDSA key, 255 (Ed25519) or 448 (Ed448)
+\return return key identifier or NULL if key generation failed
+*/
+hsm_key_t *
+hsm_generate_eddsa_key(hsm_ctx_t *context,
+                       const char *repository,
+                       unsigned long keysize);
+
 /*! Remove a key pair from HSM
 
 When a key is removed, the module pointer is set to NULL, and
@@ -50,6 +50,26 @@ typedef struct {
 } hsm_sign_params_t;
 
 
+/*! Incremental digest over the data to be signed
+
+SHA digests are computed locally, MD5 and GOST R 34.11-94 are computed
+by the HSM that holds the key. The context is opaque, it is created by
+the caller with hsm_digest_ctx_new() and can be reused for any number
+of digests.
+*/
+typedef struct hsm_digest_ctx_struct hsm_digest_ctx_t;
+
+
+/*! Number of messages hashed side by side by hsm_digest_batch() */
+#define HSM_DIGEST_LANES 8
+
+/*! Hash functions for hsm_digest_batch() */
+typedef enum {
+    HSM_DIGEST_SHA1,
+    HSM_DIGEST_SHA256
+} hsm_digest_type_t;
+
+
 /*!
  * Returns an allocated hsm_sign_params_t with some defaults
  */
@@ -85,6 +105,188 @@ hsm_sign_rrset(hsm_ctx_t *ctx,
                const hsm_sign_params_t *sign_params);
 
 
+/*! Sign data using key
+
+Digest and sign data that is already in wire format, such as the RRSIG
+RDATA without the signature followed by the RRset in canonical form.
+This saves building an ldns_rr_list for the RRset. EdDSA has no
+separate digest step, the HSM signs the data itself.
+
+\param ctx HSM context
+\param data the data to sign
+\param data_len the length of the data
+\param key Key pair used to sign
+\param algorithm the DNSSEC algorithm of the key
+\param signature the signature is written here, room for
+                 HSM_MAX_SIGNATURE_LENGTH bytes is needed
+\param signature_len the length of the signature
+\return 0 on success, -1 on error
+*/
+int
+hsm_sign_data(hsm_ctx_t *ctx,
+              const unsigned char *data,
+              size_t data_len,
+              const hsm_key_t *key,
+              ldns_algorithm algorithm,
+              unsigned char *signature,
+              size_t *signature_len);
+
+
+/*! Create a digest context
+
+\return the digest context, or NULL if out of memory
+*/
+hsm_digest_ctx_t *
+hsm_digest_ctx_new(void);
+
+
+/*! Free a digest context
+
+\param digest_ctx the digest context, may be NULL
+*/
+void
+hsm_digest_ctx_free(hsm_digest_ctx_t *digest_ctx);
+
+
+/*! Start a digest for signing with key
+
+The data to be signed is fed in pieces with hsm_digest_update() and
+signed with hsm_sign_digest(). For MD5 and GOST the HSM session of the
+key is busy digesting until hsm_sign_digest() is called. EdDSA signs
+the message in one part (CKM_EDDSA), use hsm_sign_data() for it.
+
+\param ctx HSM context
+\param digest_ctx the digest context to (re)start
+\param key Key pair that will be used to sign
+\param algorithm the DNSSEC algorithm of the key
+\return 0 on success, -1 on error
+*/
+int
+hsm_digest_init(hsm_ctx_t *ctx,
+                hsm_digest_ctx_t *digest_ctx,
+                const hsm_key_t *key,
+                ldns_algorithm algorithm);
+
+
+/*! Add data to the digest
+
+\param ctx HSM context
+\param digest_ctx the digest context
+\param key Key pair that will be used to sign
+\param data the data to add
+\param data_len the length of the data
+\return 0 on success, -1 on error
+*/
+int
+hsm_digest_update(hsm_ctx_t *ctx,
+                  hsm_digest_ctx_t *digest_ctx,
+                  const hsm_key_t *key,
+                  const unsigned char *data,
+                  size_t data_len);
+
+
+/*! Finish the digest and sign it using key
+
+\param ctx HSM context
+\param digest_ctx the digest context
+\param key Key pair used to sign, the same as given to hsm_digest_init()
+\param signature the signature is written here, room for
+                 HSM_MAX_SIGNATURE_LENGTH bytes is needed
+\param signature_len the length of the signature
+\return 0 on success, -1 on error
+*/
+int
+hsm_sign_digest(hsm_ctx_t *ctx,
+                hsm_digest_ctx_t *digest_ctx,
+                const hsm_key_t *key,
+                unsigned char *signature,
+                size_t *signature_len);
+
+
+/*! Sign a batch of data using key
+
+Like hsm_sign_data() for each of the count buffers. For the SHA-1 and
+SHA-256 algorithms the buffers are hashed together with
+hsm_digest_batch(), so feed it at least HSM_DIGEST_LANES buffers at a
+time.
+
+\param ctx HSM context
+\param count the number of buffers
+\param data the buffers to sign
+\param data_len the length of each buffer
+\param key Key pair used to sign
+\param algorithm the DNSSEC algorithm of the key
+\param signatures signature i is written at
+                  i * HSM_MAX_SIGNATURE_LENGTH
+\param signature_len the length of each signature
+\return 0 on success, -1 on error
+*/
+int
+hsm_sign_data_batch(hsm_ctx_t *ctx,
+                    size_t count,
+                    const unsigned char *const *data,
+                    const size_t *data_len,
+                    const hsm_key_t *key,
+                    ldns_algorithm algorithm,
+                    unsigned char *signatures,
+                    size_t *signature_len);
+
+
+/*! Return the digest length of a hash function for hsm_digest_batch()
+
+\param type the hash function
+\return the digest length, 0 if unknown
+*/
+size_t
+hsm_digest_length(hsm_digest_type_t type);
+
+
+/*! Hash a batch of independent messages
+
+The messages are hashed HSM_DIGEST_LANES at a time with a multi-buffer
+implementation (AVX2 where the CPU has it), so this pays off for many
+short messages such as rrsets and NSEC3 owner names. Short batches are
+hashed one message at a time.
+
+\param type the hash function
+\param count the number of messages
+\param data the messages
+\param data_len the length of each message
+\param digests digest i is written at i * hsm_digest_length(type)
+\return 0 on success, -1 on error
+*/
+int
+hsm_digest_batch(hsm_digest_type_t type,
+                 size_t count,
+                 const unsigned char *const *data,
+                 const size_t *data_len,
+                 unsigned char *digests);
+
+
+/*! Compute the NSEC3 hashes of a batch of owner names (RFC 5155)
+
+Only hash algorithm 1 (SHA-1) exists, the names are hashed with
+hsm_digest_batch().
+
+\param count the number of names
+\param names the owner names in canonical wire format
+\param name_len the length of each name
+\param iterations number of additional hash iterations
+\param salt_length the length of the salt
+\param salt the salt
+\param hashes hash i is written at i * 20
+\return 0 on success, -1 on error
+*/
+int
+hsm_nsec3_hash_batch(size_t count,
+                     const unsigned char *const *names,
+                     const size_t *name_len,
+                     uint16_t iterations,
+                     uint8_t salt_length,
+                     const uint8_t *salt,
+                     unsigned char *hashes);
+
+
 /*! Generate a base32 encoded hashed NSEC3 name
 
 \param ctx HSM context
@@ -118,6 +320,25 @@ hsm_get_dnskey(hsm_ctx_t *ctx,
                const hsm_sign_params_t *sign_params);
 
 
+/*! Generate new key pair in HSM for a DNSSEC algorithm
+
+Calls the key generator for the key type of the algorithm. For RSA and
+DSA keysize is the size of the key, for ECDSA, EdDSA and GOST the
+algorithm determines the curve and keysize is ignored.
+
+\param ctx HSM context
+\param repository repository in where to create the key
+\param algorithm the DNSSEC algorithm of the key
+\param keysize Size of RSA or DSA key
+\return return key identifier or NULL if key generation failed
+*/
+hsm_key_t *
+hsm_generate_key(hsm_ctx_t *ctx,
+                 const char *repository,
+                 ldns_algorithm algorithm,
+                 unsigned long keysize);
+
+
 /*! Check if a given DNSSEC algorithm is supported
 
 \param ldns_algorithm algorithm number
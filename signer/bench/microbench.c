@@ -0,0 +1,704 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Microbenchmarks for the signer's core data structures.
+ *
+ */
+
+#include "config.h"
+#include "dns/dname.h"
+#include "dns/dns.h"
+#include "dns/rdata.h"
+#include "dns/rr.h"
+#include "rzonec/zonec.h"
+#include "util/log.h"
+#include "util/region.h"
+#include "util/tree.h"
+#include "wire/buffer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MB_MAXLINE 1024
+#define MB_NAMES 4096
+#define MB_WARMUP 3
+#define MB_SAMPLES 31
+#define MB_MAXSAMPLES 1024
+
+/**
+ * Benchmark case. The function performs a batch of operations and
+ * returns how many it did, so that every sample is a ns/op figure. The
+ * optional setup function prepares the input of each run and is not
+ * timed.
+ *
+ */
+typedef struct mb_case_struct mb_case_type;
+struct mb_case_struct {
+    const char* name;
+    size_t (*run)(void);
+    void (*setup)(void);
+};
+
+/**
+ * Benchmark result.
+ *
+ */
+typedef struct mb_result_struct mb_result_type;
+struct mb_result_struct {
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+static region_type* mb_region = NULL;
+static region_type* mb_scratch = NULL;
+static char* mb_strs[MB_NAMES];
+static dname_type* mb_dnames[MB_NAMES];
+static rr_type mb_rrs[MB_NAMES];
+static tree_type* mb_tree = NULL;
+static tree_node mb_nodes[MB_NAMES];
+static buffer_type* mb_buffer = NULL;
+static volatile uintptr_t mb_sink = 0;
+static uint64_t mb_state = 88172645463325252ULL;
+
+static const char* mb_labels[] = {
+    "www", "mail", "ns1", "ns2", "ftp", "smtp", "imap", "vpn", "api", "cdn",
+    "static", "img", "dev", "test", "shop", "blog", "wiki", "git", "db",
+    "a", "b", "example", "sub", "internal", "corp", "eu", "us", "nl"
+};
+#define MB_LABELS (sizeof(mb_labels) / sizeof(mb_labels[0]))
+
+
+/**
+ * Deterministic pseudo random numbers (xorshift64).
+ *
+ */
+static uint64_t
+mb_rand(void)
+{
+    mb_state ^= mb_state << 13;
+    mb_state ^= mb_state >> 7;
+    mb_state ^= mb_state << 17;
+    return mb_state;
+}
+
+
+/**
+ * Current time in nanoseconds.
+ *
+ */
+static uint64_t
+mb_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+
+/**
+ * Compare doubles, for qsort.
+ *
+ */
+static int
+mb_cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * Compare domain names, for the tree.
+ *
+ */
+static int
+mb_cmp_dname(const void* a, const void* b)
+{
+    return dname_compare((dname_type*) a, (dname_type*) b);
+}
+
+
+/**
+ * Nearest-rank percentile of sorted samples.
+ *
+ */
+static double
+mb_percentile(double* sorted, size_t n, unsigned pct)
+{
+    size_t rank = (pct * n + 99) / 100;
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+
+/**
+ * Set up the input data shared by the benchmarks: random names with
+ * 2-5 labels, MX records below one owner and a tree with all names.
+ *
+ */
+static void
+mb_setup(void)
+{
+    size_t i, j, labels;
+    char buf[MB_MAXLINE];
+    char pref[8];
+    dname_type* owner = NULL;
+    mb_region = region_create();
+    mb_scratch = region_create();
+    if (!mb_region || !mb_scratch) {
+        fprintf(stderr, "microbench: region_create() failed\n");
+        exit(1);
+    }
+    owner = dname_create(mb_region, "example.nl.");
+    for (i = 0; i < MB_NAMES; i++) {
+        buf[0] = '\0';
+        labels = 2 + (size_t) (mb_rand() % 4);
+        for (j = 0; j < labels; j++) {
+            if (j == 0 && (mb_rand() % 2)) {
+                snprintf(buf, sizeof(buf), "h%u.",
+                    (unsigned) (mb_rand() % 100000));
+                continue;
+            }
+            strncat(buf, mb_labels[mb_rand() % MB_LABELS],
+                sizeof(buf) - strlen(buf) - 2);
+            strcat(buf, ".");
+        }
+        mb_strs[i] = strdup(buf);
+        mb_dnames[i] = dname_create(mb_region, buf);
+        if (!mb_strs[i] || !mb_dnames[i]) {
+            fprintf(stderr, "microbench: cannot create name %s\n", buf);
+            exit(1);
+        }
+        mb_rrs[i].owner = owner;
+        mb_rrs[i].type = DNS_TYPE_MX;
+        mb_rrs[i].klass = DNS_CLASS_IN;
+        mb_rrs[i].ttl = 3600;
+        mb_rrs[i].rdlen = 0;
+        mb_rrs[i].rdata = (rdata_type*) region_alloc(mb_region,
+            DNS_RDATA_MAX * sizeof(rdata_type));
+        snprintf(pref, sizeof(pref), "%u", (unsigned) (mb_rand() % 4) * 10);
+        if (!mb_rrs[i].rdata ||
+            !zonec_rdata_add(mb_region, &mb_rrs[i], DNS_RDATA_INT16, NULL,
+                pref, strlen(pref)) ||
+            !zonec_rdata_add(mb_region, &mb_rrs[i],
+                DNS_RDATA_COMPRESSED_DNAME, mb_dnames[i], NULL, 0)) {
+            fprintf(stderr, "microbench: cannot create rr %s\n", buf);
+            exit(1);
+        }
+    }
+    mb_tree = tree_create(mb_region, mb_cmp_dname);
+    for (i = 0; i < MB_NAMES; i++) {
+        memset(&mb_nodes[i], 0, sizeof(tree_node));
+        mb_nodes[i].key = mb_dnames[i];
+        (void) tree_insert(mb_tree, &mb_nodes[i]);
+    }
+    mb_buffer = buffer_create(mb_region, 65535);
+    if (!mb_tree || !mb_buffer) {
+        fprintf(stderr, "microbench: setup failed\n");
+        exit(1);
+    }
+    return;
+}
+
+
+/**
+ * Create domain names from strings.
+ *
+ */
+static size_t
+mb_dname_create(void)
+{
+    size_t i;
+    for (i = 0; i < MB_NAMES; i++) {
+        mb_sink += (uintptr_t) dname_create(mb_scratch, mb_strs[i]);
+    }
+    region_free(mb_scratch);
+    return MB_NAMES;
+}
+
+
+/**
+ * Compare neighbouring domain names.
+ *
+ */
+static size_t
+mb_dname_compare(void)
+{
+    size_t i;
+    int r = 0;
+    for (i = 1; i < MB_NAMES; i++) {
+        r += dname_compare(mb_dnames[i-1], mb_dnames[i]);
+    }
+    mb_sink += (uintptr_t) r;
+    return MB_NAMES - 1;
+}
+
+
+/**
+ * Compare the RDATA of neighbouring MX records.
+ *
+ */
+static size_t
+mb_rr_compare_rdata(void)
+{
+    size_t i;
+    int r = 0;
+    for (i = 1; i < MB_NAMES; i++) {
+        r += rr_compare_rdata(&mb_rrs[i-1], &mb_rrs[i]);
+    }
+    mb_sink += (uintptr_t) r;
+    return MB_NAMES - 1;
+}
+
+
+/**
+ * Insert all names into a new tree.
+ *
+ */
+static size_t
+mb_tree_insert(void)
+{
+    size_t i;
+    tree_type* tree = tree_create(mb_scratch, mb_cmp_dname);
+    tree_node* nodes = (tree_node*) region_alloc(mb_scratch,
+        MB_NAMES * sizeof(tree_node));
+    if (!tree || !nodes) {
+        fprintf(stderr, "microbench: tree setup failed\n");
+        exit(1);
+    }
+    memset(nodes, 0, MB_NAMES * sizeof(tree_node));
+    for (i = 0; i < MB_NAMES; i++) {
+        nodes[i].key = mb_dnames[i];
+        mb_sink += (uintptr_t) tree_insert(tree, &nodes[i]);
+    }
+    tree_cleanup(tree);
+    region_free(mb_scratch);
+    return MB_NAMES;
+}
+
+
+/**
+ * Look up names in the tree, in a scattered order.
+ *
+ */
+static size_t
+mb_tree_search(void)
+{
+    size_t i;
+    for (i = 0; i < MB_NAMES; i++) {
+        mb_sink += (uintptr_t) tree_search(mb_tree,
+            mb_dnames[(i * 7919) % MB_NAMES]);
+    }
+    return MB_NAMES;
+}
+
+
+/**
+ * Allocate small objects of varying sizes from a region.
+ *
+ */
+static size_t
+mb_region_alloc(void)
+{
+    size_t i;
+    for (i = 0; i < MB_NAMES; i++) {
+        mb_sink += (uintptr_t) region_alloc(mb_scratch, 8 + (i % 17) * 8);
+    }
+    region_free(mb_scratch);
+    return MB_NAMES;
+}
+
+
+/**
+ * Allocate objects and hand them back to the region.
+ *
+ */
+static size_t
+mb_region_recycle(void)
+{
+    size_t i, size;
+    void* p = NULL;
+    for (i = 0; i < MB_NAMES; i++) {
+        size = 16 + (i % 4) * 16;
+        p = region_alloc(mb_scratch, size);
+        mb_sink += (uintptr_t) p;
+        region_recycle(mb_scratch, p, size);
+    }
+    region_free(mb_scratch);
+    return MB_NAMES;
+}
+
+
+/**
+ * Write integers and name bytes to a buffer.
+ *
+ */
+static size_t
+mb_buffer_write(void)
+{
+    size_t i;
+    buffer_clear(mb_buffer);
+    for (i = 0; i < MB_NAMES; i++) {
+        buffer_write_u16(mb_buffer, (uint16_t) i);
+        buffer_write_u32(mb_buffer, (uint32_t) i);
+        buffer_write(mb_buffer, mb_dnames[i], 8);
+    }
+    return MB_NAMES;
+}
+
+
+/**
+ * Fill the buffer for mb_buffer_read(), untimed.
+ *
+ */
+static void
+mb_buffer_fill(void)
+{
+    (void) mb_buffer_write();
+    buffer_flip(mb_buffer);
+    return;
+}
+
+
+/**
+ * Read back what mb_buffer_fill() wrote.
+ *
+ */
+static size_t
+mb_buffer_read(void)
+{
+    size_t i;
+    uint8_t data[8];
+    uint32_t r = 0;
+    for (i = 0; i < MB_NAMES; i++) {
+        r += buffer_read_u16(mb_buffer);
+        r += buffer_read_u32(mb_buffer);
+        buffer_read(mb_buffer, data, sizeof(data));
+        r += data[0];
+    }
+    mb_sink += r;
+    return MB_NAMES;
+}
+
+
+/**
+ * Run zonec_rdata_add() for one rdata format over a set of inputs.
+ *
+ */
+static size_t
+mb_zonec(dns_rdata_format rdformat, const char** inputs, size_t count)
+{
+    rdata_type rdata[DNS_RDATA_MAX];
+    rr_type rr;
+    size_t i;
+    memset(&rr, 0, sizeof(rr));
+    rr.rdata = rdata;
+    for (i = 0; i < MB_NAMES; i++) {
+        rr.rdlen = 0;
+        if (!zonec_rdata_add(mb_scratch, &rr, rdformat, NULL,
+            inputs[i % count], strlen(inputs[i % count]))) {
+            fprintf(stderr, "microbench: cannot convert %s\n",
+                inputs[i % count]);
+            exit(1);
+        }
+    }
+    mb_sink += rr.rdlen;
+    region_free(mb_scratch);
+    return MB_NAMES;
+}
+
+static const char* mb_ipv4[] = {
+    "192.0.2.1", "198.51.100.77", "203.0.113.254", "10.1.2.3"
+};
+static const char* mb_ipv6[] = {
+    "2001:db8::1", "2001:db8:1234:5678:9abc:def0:1234:5678", "fe80::1", "::1"
+};
+static const char* mb_int16[] = { "0", "10", "4096", "65535" };
+static const char* mb_text[] = {
+    "v=spf1 -all", "some text", "google-site-verification=abcdefghijk"
+};
+static const char* mb_base64[] = {
+    "AwEAAcMnWBKLuvG/LwnPVykcmpvnntwxfshHlHRhlY0F3oz8AkTuI4Txvvq3rLMg"
+    "eZhRvUXlDIibfV1n8HVnOqiZNK3bvFqbgRn+nRkPEpXm4bSqBjxtsqN2bnyLzu0d",
+    "oJ5Xe6W7Gqxb0iYVTaJkTWfDrRK4U0LETIfDM4Dk5eMr9MKlRy1oTa0SG53kSGOv"
+};
+
+#define MB_COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+/**
+ * Convert IPv4 addresses.
+ *
+ */
+static size_t
+mb_zonec_ipv4(void)
+{
+    return mb_zonec(DNS_RDATA_IPV4, mb_ipv4, MB_COUNT(mb_ipv4));
+}
+
+/**
+ * Convert IPv6 addresses.
+ *
+ */
+static size_t
+mb_zonec_ipv6(void)
+{
+    return mb_zonec(DNS_RDATA_IPV6, mb_ipv6, MB_COUNT(mb_ipv6));
+}
+
+/**
+ * Convert 16-bit integers.
+ *
+ */
+static size_t
+mb_zonec_int16(void)
+{
+    return mb_zonec(DNS_RDATA_INT16, mb_int16, MB_COUNT(mb_int16));
+}
+
+/**
+ * Convert text strings.
+ *
+ */
+static size_t
+mb_zonec_text(void)
+{
+    return mb_zonec(DNS_RDATA_TEXT, mb_text, MB_COUNT(mb_text));
+}
+
+/**
+ * Convert base64 data.
+ *
+ */
+static size_t
+mb_zonec_base64(void)
+{
+    return mb_zonec(DNS_RDATA_BASE64, mb_base64, MB_COUNT(mb_base64));
+}
+
+static mb_case_type mb_cases[] = {
+    { "dname_create", mb_dname_create, NULL },
+    { "dname_compare", mb_dname_compare, NULL },
+    { "rr_compare_rdata", mb_rr_compare_rdata, NULL },
+    { "tree_insert", mb_tree_insert, NULL },
+    { "tree_search", mb_tree_search, NULL },
+    { "region_alloc", mb_region_alloc, NULL },
+    { "region_recycle", mb_region_recycle, NULL },
+    { "buffer_write", mb_buffer_write, NULL },
+    { "buffer_read", mb_buffer_read, mb_buffer_fill },
+    { "zonec_ipv4", mb_zonec_ipv4, NULL },
+    { "zonec_ipv6", mb_zonec_ipv6, NULL },
+    { "zonec_int16", mb_zonec_int16, NULL },
+    { "zonec_text", mb_zonec_text, NULL },
+    { "zonec_base64", mb_zonec_base64, NULL },
+    { NULL, NULL, NULL }
+};
+
+
+/**
+ * Run one benchmark: warm up, then time each sample and compute the
+ * percentiles of the ns/op figures.
+ *
+ */
+static void
+mb_run(mb_case_type* c, size_t samples, mb_result_type* res)
+{
+    static double ns[MB_MAXSAMPLES];
+    uint64_t start;
+    size_t i, ops;
+    for (i = 0; i < MB_WARMUP; i++) {
+        if (c->setup) {
+            c->setup();
+        }
+        (void) c->run();
+    }
+    for (i = 0; i < samples; i++) {
+        if (c->setup) {
+            c->setup();
+        }
+        start = mb_now();
+        ops = c->run();
+        ns[i] = (double) (mb_now() - start) / (double) ops;
+    }
+    qsort(ns, samples, sizeof(double), mb_cmp_double);
+    res->min = ns[0];
+    res->p50 = mb_percentile(ns, samples, 50);
+    res->p90 = mb_percentile(ns, samples, 90);
+    res->p99 = mb_percentile(ns, samples, 99);
+    res->max = ns[samples - 1];
+    return;
+}
+
+
+/**
+ * Look up the median of a benchmark in a baseline file written with -j.
+ *
+ */
+static int
+mb_baseline(const char* file, const char* name, double* p50)
+{
+    char line[MB_MAXLINE];
+    char key[MB_MAXLINE];
+    char* p = NULL;
+    FILE* fd = fopen(file, "r");
+    if (!fd) {
+        return 0;
+    }
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+    while (fgets(line, sizeof(line), fd)) {
+        if (!strstr(line, key)) {
+            continue;
+        }
+        p = strstr(line, "\"p50_ns\":");
+        if (p && sscanf(p + 9, "%lf", p50) == 1) {
+            fclose(fd);
+            return 1;
+        }
+    }
+    fclose(fd);
+    return 0;
+}
+
+
+/**
+ * Print usage.
+ *
+ */
+static void
+usage(FILE* out)
+{
+    fprintf(out, "Usage: ttods-microbench [OPTIONS]\n");
+    fprintf(out, "Microbenchmarks for the signer's core data structures.\n\n");
+    fprintf(out, "Supported options:\n");
+    fprintf(out, " -b <file>    Compare medians with a baseline written "
+        "with -j.\n");
+    fprintf(out, " -f <name>    Only run benchmarks whose name contains "
+        "<name>.\n");
+    fprintf(out, " -h           Show this help screen.\n");
+    fprintf(out, " -j           Print results as JSON, one line per "
+        "benchmark.\n");
+    fprintf(out, " -s <num>     Number of samples (default %d).\n",
+        MB_SAMPLES);
+    fprintf(out, " -t <pct>     Allowed slowdown against the baseline "
+        "(default 10).\n");
+    return;
+}
+
+
+/**
+ * Main. Exits with status 2 if a benchmark regressed against the
+ * baseline.
+ *
+ */
+int
+main(int argc, char* argv[])
+{
+    int c;
+    int json = 0;
+    int regressed = 0;
+    const char* filter = NULL;
+    const char* baseline = NULL;
+    double tolerance = 10.0;
+    double base = 0.0;
+    size_t samples = MB_SAMPLES;
+    mb_case_type* mbc = NULL;
+    mb_result_type res;
+
+    while ((c = getopt(argc, argv, "b:f:hjs:t:")) != -1) {
+        switch (c) {
+            case 'b':
+                baseline = optarg;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'h':
+                usage(stdout);
+                exit(0);
+                break;
+            case 'j':
+                json = 1;
+                break;
+            case 's':
+                samples = (size_t) atoi(optarg);
+                if (samples < 1 || samples > MB_MAXSAMPLES) {
+                    fprintf(stderr, "microbench: samples must be within "
+                        "[1...%d]\n", MB_MAXSAMPLES);
+                    exit(1);
+                }
+                break;
+            case 't':
+                tolerance = atof(optarg);
+                break;
+            default:
+                usage(stderr);
+                exit(1);
+        }
+    }
+    ods_log_init(NULL, 0, 0);
+    mb_setup();
+    if (!json) {
+        printf("%-18s %10s %10s %10s %10s %10s\n", "benchmark (ns/op)",
+            "min", "p50", "p90", "p99", "max");
+    }
+    for (mbc = mb_cases; mbc->name; mbc++) {
+        if (filter && !strstr(mbc->name, filter)) {
+            continue;
+        }
+        mb_run(mbc, samples, &res);
+        if (json) {
+            printf("{\"name\":\"%s\",\"samples\":%u,\"min_ns\":%.2f,"
+                "\"p50_ns\":%.2f,\"p90_ns\":%.2f,\"p99_ns\":%.2f,"
+                "\"max_ns\":%.2f}\n", mbc->name, (unsigned) samples,
+                res.min, res.p50, res.p90, res.p99, res.max);
+        } else {
+            printf("%-18s %10.2f %10.2f %10.2f %10.2f %10.2f\n", mbc->name,
+                res.min, res.p50, res.p90, res.p99, res.max);
+        }
+        if (baseline && mb_baseline(baseline, mbc->name, &base) &&
+            res.p50 > base * (1.0 + tolerance / 100.0)) {
+            fprintf(stderr, "microbench: %s regressed: p50 %.2f ns/op, "
+                "baseline %.2f ns/op\n", mbc->name, res.p50, base);
+            regressed = 1;
+        }
+    }
+    tree_cleanup(mb_tree);
+    region_cleanup(mb_scratch);
+    region_cleanup(mb_region);
+    return regressed ? 2 : 0;
+}
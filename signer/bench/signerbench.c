@@ -0,0 +1,295 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Signer benchmark driver: run the signer once and report the timings.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BENCH_STATSFILE "ttods-signerd.prom"
+#define BENCH_MAXLINE 1024
+
+static const char* bench_phases[] = { "conf", "read", "write" };
+#define BENCH_PHASES (sizeof(bench_phases) / sizeof(bench_phases[0]))
+
+/**
+ * Benchmark results, summed over all zones.
+ *
+ */
+typedef struct bench_struct bench_type;
+struct bench_struct {
+    double wall;
+    double user;
+    double sys;
+    long maxrss;
+    int exit_status;
+    double phase_seconds[BENCH_PHASES];
+    unsigned long long phase_runs[BENCH_PHASES];
+    unsigned long long records_read;
+    unsigned long long bytes_written;
+};
+
+
+/**
+ * Get the phase of a metric line.
+ *
+ */
+static int
+bench_phase(const char* line)
+{
+    const char* p = strstr(line, "phase=\"");
+    size_t i;
+    if (!p) {
+        return -1;
+    }
+    p += 7;
+    for (i=0; i < BENCH_PHASES; i++) {
+        if (strncmp(p, bench_phases[i], strlen(bench_phases[i])) == 0 &&
+            p[strlen(bench_phases[i])] == '"') {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Read the statistics that the signer wrote when it stopped.
+ *
+ */
+static int
+bench_read_stats(const char* workdir, bench_type* bench)
+{
+    char line[BENCH_MAXLINE];
+    char file[BENCH_MAXLINE];
+    const char* value = NULL;
+    FILE* fd = NULL;
+    int phase;
+    (void)snprintf(file, sizeof(file), "%s/%s", workdir, BENCH_STATSFILE);
+    fd = fopen(file, "r");
+    if (!fd) {
+        fprintf(stderr, "ttods-signerbench: cannot read %s: %s\n", file,
+            strerror(errno));
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fd)) {
+        if (line[0] == '#' || !(value = strrchr(line, ' '))) {
+            continue;
+        }
+        value++;
+        phase = bench_phase(line);
+        if (strncmp(line, "ttods_signer_phase_seconds_total{", 33) == 0 &&
+            phase >= 0) {
+            bench->phase_seconds[phase] += strtod(value, NULL);
+        } else if (strncmp(line, "ttods_signer_phase_runs_total{", 30) == 0 &&
+            phase >= 0) {
+            bench->phase_runs[phase] += strtoull(value, NULL, 10);
+        } else if (strncmp(line, "ttods_signer_records_read_total{", 32) == 0) {
+            bench->records_read += strtoull(value, NULL, 10);
+        } else if (strncmp(line, "ttods_signer_bytes_written_total{", 33)
+            == 0) {
+            bench->bytes_written += strtoull(value, NULL, 10);
+        }
+    }
+    fclose(fd);
+    return 1;
+}
+
+
+/**
+ * Run the signer once.
+ *
+ */
+static int
+bench_run(const char* signerd, const char* cfgfile, bench_type* bench)
+{
+    struct timeval start;
+    struct timeval end;
+    struct rusage ru;
+    pid_t pid;
+    int status = 0;
+    (void)gettimeofday(&start, NULL);
+    switch ((pid = fork())) {
+        case -1:
+            fprintf(stderr, "ttods-signerbench: fork failed: %s\n",
+                strerror(errno));
+            return 0;
+        case 0:
+            execl(signerd, signerd, "-d", "-1", "-c", cfgfile, (char*) NULL);
+            fprintf(stderr, "ttods-signerbench: exec %s failed: %s\n",
+                signerd, strerror(errno));
+            _exit(127);
+        default:
+            break;
+    }
+    if (wait4(pid, &status, 0, &ru) < 0) {
+        fprintf(stderr, "ttods-signerbench: wait failed: %s\n",
+            strerror(errno));
+        return 0;
+    }
+    (void)gettimeofday(&end, NULL);
+    bench->wall = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+    bench->user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0;
+    bench->sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+    bench->maxrss = ru.ru_maxrss;
+    bench->exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return 1;
+}
+
+
+/**
+ * Print the results as JSON, one object per run, so that the results of
+ * many runs can be collected in one file.
+ *
+ */
+static void
+bench_print(FILE* out, const char* label, unsigned long names,
+    bench_type* bench)
+{
+    size_t i;
+    fprintf(out, "{\"benchmark\":\"signer\",\"label\":\"%s\","
+        "\"names\":%lu,\"exit_status\":%d,\"wall_seconds\":%.6f,"
+        "\"user_seconds\":%.6f,\"sys_seconds\":%.6f,\"peak_rss_kb\":%ld,",
+        label, names, bench->exit_status, bench->wall, bench->user,
+        bench->sys, bench->maxrss);
+    fprintf(out, "\"phases\":{");
+    for (i=0; i < BENCH_PHASES; i++) {
+        fprintf(out, "%s\"%s\":{\"seconds\":%.6f,\"runs\":%llu}",
+            i ? "," : "", bench_phases[i], bench->phase_seconds[i],
+            bench->phase_runs[i]);
+    }
+    fprintf(out, "},\"records_read\":%llu,\"bytes_written\":%llu}\n",
+        bench->records_read, bench->bytes_written);
+    return;
+}
+
+
+/**
+ * Print usage.
+ *
+ */
+static void
+usage(FILE* out)
+{
+    fprintf(out, "Usage: ttods-signerbench [OPTIONS]\n");
+    fprintf(out, "Run the signer once and report timings as JSON.\n\n");
+    fprintf(out, "Supported options:\n");
+    fprintf(out, " -s <signerd>     Signer engine binary.\n");
+    fprintf(out, " -c <cfgfile>     Signer configuration file.\n");
+    fprintf(out, " -w <workdir>     Signer working directory.\n");
+    fprintf(out, " -l <label>       Label for this run (default bench).\n");
+    fprintf(out, " -n <names>       Number of generated names, for the "
+        "report.\n");
+    fprintf(out, " -o <file>        Append results to file (default "
+        "stdout).\n");
+    fprintf(out, " -h               Show this help and exit.\n");
+    return;
+}
+
+
+/**
+ * Main. Run benchmark.
+ *
+ */
+int
+main(int argc, char* argv[])
+{
+    const char* signerd = NULL;
+    const char* cfgfile = NULL;
+    const char* workdir = ".";
+    const char* label = "bench";
+    const char* outfile = NULL;
+    unsigned long names = 0;
+    bench_type bench;
+    FILE* out = stdout;
+    char file[BENCH_MAXLINE];
+    int c;
+    while ((c = getopt(argc, argv, "s:c:w:l:n:o:h")) != -1) {
+        switch (c) {
+            case 's':
+                signerd = optarg;
+                break;
+            case 'c':
+                cfgfile = optarg;
+                break;
+            case 'w':
+                workdir = optarg;
+                break;
+            case 'l':
+                label = optarg;
+                break;
+            case 'n':
+                names = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case 'h':
+                usage(stdout);
+                exit(0);
+            default:
+                usage(stderr);
+                exit(2);
+        }
+    }
+    if (!signerd || !cfgfile) {
+        usage(stderr);
+        exit(2);
+    }
+    memset(&bench, 0, sizeof(bench));
+    /* do not pick up the statistics of an earlier run */
+    (void)snprintf(file, sizeof(file), "%s/%s", workdir, BENCH_STATSFILE);
+    (void)unlink(file);
+    if (!bench_run(signerd, cfgfile, &bench) ||
+        !bench_read_stats(workdir, &bench)) {
+        exit(1);
+    }
+    if (outfile && !(out = fopen(outfile, "a"))) {
+        fprintf(stderr, "ttods-signerbench: cannot open %s: %s\n", outfile,
+            strerror(errno));
+        exit(1);
+    }
+    bench_print(out, label, names, &bench);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return bench.exit_status == 0 ? 0 : 1;
+}
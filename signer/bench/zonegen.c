@@ -0,0 +1,286 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Synthetic zone generator for the signer benchmarks.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ZONEGEN_MAX_TYPES 8
+
+/**
+ * RRset type and its share of the generated names.
+ *
+ */
+typedef struct zonegen_type_struct zonegen_type;
+struct zonegen_type_struct {
+    const char* name;
+    unsigned weight;
+};
+
+static zonegen_type zonegen_types[ZONEGEN_MAX_TYPES] = {
+    { "A", 50 },
+    { "AAAA", 20 },
+    { "MX", 5 },
+    { "TXT", 10 },
+    { "CNAME", 10 },
+    { "SRV", 5 },
+    { NULL, 0 },
+    { NULL, 0 }
+};
+
+static uint64_t zonegen_state = 0x9e3779b97f4a7c15ULL;
+
+
+/**
+ * Random number (xorshift64*), the same on every platform for the same
+ * seed, so that generated zones can be compared between runs.
+ *
+ */
+static uint32_t
+zonegen_random(void)
+{
+    zonegen_state ^= zonegen_state >> 12;
+    zonegen_state ^= zonegen_state << 25;
+    zonegen_state ^= zonegen_state >> 27;
+    return (uint32_t) ((zonegen_state * 2685821657736338717ULL) >> 32);
+}
+
+
+/**
+ * Parse the rrset mix: a comma separated list of TYPE:WEIGHT.
+ *
+ */
+static int
+zonegen_parse_mix(char* str)
+{
+    char* tok = NULL;
+    char* save = NULL;
+    char* colon = NULL;
+    size_t i;
+    for (i=0; i < ZONEGEN_MAX_TYPES; i++) {
+        zonegen_types[i].weight = 0;
+    }
+    for (tok = strtok_r(str, ",", &save); tok;
+        tok = strtok_r(NULL, ",", &save)) {
+        colon = strchr(tok, ':');
+        if (!colon) {
+            return 0;
+        }
+        *colon = '\0';
+        for (i=0; i < ZONEGEN_MAX_TYPES && zonegen_types[i].name; i++) {
+            if (strcasecmp(zonegen_types[i].name, tok) == 0) {
+                break;
+            }
+        }
+        if (i == ZONEGEN_MAX_TYPES || !zonegen_types[i].name) {
+            fprintf(stderr, "unsupported type %s\n", tok);
+            return 0;
+        }
+        zonegen_types[i].weight = (unsigned) atoi(colon+1);
+    }
+    return 1;
+}
+
+
+/**
+ * Pick an rrset type by weight.
+ *
+ */
+static const char*
+zonegen_pick_type(unsigned total)
+{
+    unsigned r = zonegen_random() % total;
+    size_t i;
+    for (i=0; i < ZONEGEN_MAX_TYPES && zonegen_types[i].name; i++) {
+        if (r < zonegen_types[i].weight) {
+            return zonegen_types[i].name;
+        }
+        r -= zonegen_types[i].weight;
+    }
+    return "A";
+}
+
+
+/**
+ * Print an rrset of the given type.
+ *
+ */
+static void
+zonegen_print_rrset(FILE* out, const char* owner, const char* type,
+    unsigned long n)
+{
+    unsigned count = 1;
+    unsigned i;
+    uint32_t r;
+    if (strcmp(type, "A") == 0 || strcmp(type, "AAAA") == 0 ||
+        strcmp(type, "TXT") == 0) {
+        count = 1 + zonegen_random() % 3;
+    }
+    for (i=0; i < count; i++) {
+        r = zonegen_random();
+        if (strcmp(type, "A") == 0) {
+            fprintf(out, "%s\tIN\tA\t10.%u.%u.%u\n", owner,
+                (r >> 16) & 0xff, (r >> 8) & 0xff, r & 0xff);
+        } else if (strcmp(type, "AAAA") == 0) {
+            fprintf(out, "%s\tIN\tAAAA\t2001:db8:%x:%x::%x\n", owner,
+                (r >> 16) & 0xffff, r & 0xffff, i+1);
+        } else if (strcmp(type, "MX") == 0) {
+            fprintf(out, "%s\tIN\tMX\t10 mail%lu\n", owner, n % 64);
+        } else if (strcmp(type, "TXT") == 0) {
+            fprintf(out, "%s\tIN\tTXT\t\"v=bench%u %08x\"\n", owner, i, r);
+        } else if (strcmp(type, "CNAME") == 0) {
+            fprintf(out, "%s\tIN\tCNAME\thost%lu\n", owner, n / 2);
+        } else if (strcmp(type, "SRV") == 0) {
+            fprintf(out, "%s\tIN\tSRV\t0 5 %u host%lu\n", owner,
+                1024 + (r % 60000), n / 2);
+        }
+    }
+    return;
+}
+
+
+/**
+ * Print usage.
+ *
+ */
+static void
+usage(FILE* out)
+{
+    fprintf(out, "Usage: ttods-zonegen [OPTIONS]\n");
+    fprintf(out, "Write a synthetic zone to standard output.\n\n");
+    fprintf(out, "Supported options:\n");
+    fprintf(out, " -o <origin>      Zone name (default bench.example).\n");
+    fprintf(out, " -n <names>       Number of names (default 10000).\n");
+    fprintf(out, " -m <mix>         RRset mix, TYPE:WEIGHT,... (default "
+        "A:50,AAAA:20,MX:5,TXT:10,CNAME:10,SRV:5).\n");
+    fprintf(out, " -d <percent>     Names that are delegations (default "
+        "5).\n");
+    fprintf(out, " -w <percent>     Names that are wildcards (default 1).\n");
+    fprintf(out, " -s <seed>        Random seed (default 1).\n");
+    fprintf(out, " -h               Show this help and exit.\n");
+    return;
+}
+
+
+/**
+ * Main. Generate zone.
+ *
+ */
+int
+main(int argc, char* argv[])
+{
+    const char* origin = "bench.example";
+    unsigned long names = 10000;
+    unsigned delegations = 5;
+    unsigned wildcards = 1;
+    unsigned long seed = 1;
+    unsigned total = 0;
+    unsigned long n;
+    uint32_t r;
+    char owner[64];
+    size_t i;
+    int c;
+    while ((c = getopt(argc, argv, "o:n:m:d:w:s:h")) != -1) {
+        switch (c) {
+            case 'o':
+                origin = optarg;
+                break;
+            case 'n':
+                names = strtoul(optarg, NULL, 10);
+                break;
+            case 'm':
+                if (!zonegen_parse_mix(optarg)) {
+                    usage(stderr);
+                    exit(2);
+                }
+                break;
+            case 'd':
+                delegations = (unsigned) atoi(optarg);
+                break;
+            case 'w':
+                wildcards = (unsigned) atoi(optarg);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'h':
+                usage(stdout);
+                exit(0);
+            default:
+                usage(stderr);
+                exit(2);
+        }
+    }
+    for (i=0; i < ZONEGEN_MAX_TYPES && zonegen_types[i].name; i++) {
+        total += zonegen_types[i].weight;
+    }
+    if (!total || delegations + wildcards > 100) {
+        usage(stderr);
+        exit(2);
+    }
+    zonegen_state ^= (uint64_t) seed * 0xbf58476d1ce4e5b9ULL;
+    /* apex */
+    fprintf(stdout, "$ORIGIN %s.\n$TTL 3600\n", origin);
+    fprintf(stdout, "@\tIN\tSOA\tns1 hostmaster 1 7200 3600 1209600 3600\n");
+    fprintf(stdout, "@\tIN\tNS\tns1\n@\tIN\tNS\tns2\n");
+    fprintf(stdout, "ns1\tIN\tA\t192.0.2.1\nns2\tIN\tA\t192.0.2.2\n");
+    fprintf(stdout, "@\tIN\tMX\t10 mail0\n");
+    for (n=0; n < 64; n++) {
+        fprintf(stdout, "mail%lu\tIN\tA\t192.0.2.%lu\n", n, 10 + n);
+    }
+    /* names */
+    for (n=0; n < names; n++) {
+        r = zonegen_random() % 100;
+        if (r < delegations) {
+            (void)snprintf(owner, sizeof(owner), "d%lu", n);
+            fprintf(stdout, "%s\tIN\tNS\tns1.%s\n", owner, owner);
+            fprintf(stdout, "%s\tIN\tNS\tns2.%s\n", owner, owner);
+            r = zonegen_random();
+            fprintf(stdout, "ns1.%s\tIN\tA\t10.%u.%u.1\n", owner,
+                (r >> 8) & 0xff, r & 0xff);
+            fprintf(stdout, "ns2.%s\tIN\tA\t10.%u.%u.2\n", owner,
+                (r >> 8) & 0xff, r & 0xff);
+        } else if (r < delegations + wildcards) {
+            (void)snprintf(owner, sizeof(owner), "*.w%lu", n);
+            zonegen_print_rrset(stdout, owner, "A", n);
+        } else {
+            (void)snprintf(owner, sizeof(owner), "host%lu", n);
+            zonegen_print_rrset(stdout, owner, zonegen_pick_type(total), n);
+        }
+    }
+    return 0;
+}
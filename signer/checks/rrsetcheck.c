@@ -0,0 +1,362 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2013 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Check rrset_sign() against hsm_sign_rrset().
+ *
+ * The signer builds the RRSIG input from its own records, libhsm builds
+ * it with ldns from a list that is already in canonical order. RSA
+ * signatures (PKCS #1 v1.5) are deterministic, so with the same key both
+ * signatures match byte for byte only if the signer's input is the
+ * RFC 4034 input: RRSIG RDATA, then the records lowercased, sorted and
+ * without duplicates.
+ *
+ */
+
+#include "config.h"
+#include "dns/dname.h"
+#include "dns/rdata.h"
+#include "dns/rr.h"
+#include "signer/domain.h"
+#include "signer/rrset.h"
+#include "util/region.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libhsm.h>
+#include <libhsmdns.h>
+
+#define CHECK_TTL 3600
+#define CHECK_INCEPTION 1356998400  /* 2013-01-01 */
+#define CHECK_EXPIRATION 1388534400 /* 2014-01-01 */
+/* records in the large rrset, its RDATA does not fit RRSET_SCRATCH_INIT */
+#define CHECK_LARGE 800
+
+extern char *optarg;
+char *progname = NULL;
+
+/**
+ * An rrset as the signer gets it, and as RFC 4034 section 6.3 orders it.
+ *
+ */
+typedef struct check_rrset_struct check_rrset_type;
+struct check_rrset_struct {
+    const char* name;
+    const char* zone[8];
+    const char* canonical[8];
+};
+
+static const check_rrset_type check_rrsets[] = {
+    { "NS, mixed case and a duplicate, shorter labels first",
+      { "Example.NET. 3600 IN NS ns2.Example.net.",
+        "example.net. 3600 IN NS NS1.example.net.",
+        "example.net. 3600 IN NS ns10.example.net.",
+        "example.net. 3600 IN NS ns1.example.net.",
+        NULL },
+      { "example.net. 3600 IN NS ns1.example.net.",
+        "example.net. 3600 IN NS ns2.example.net.",
+        "example.net. 3600 IN NS ns10.example.net.",
+        NULL } },
+    { "MX, sorted on preference first",
+      { "example.net. 3600 IN MX 20 a.example.net.",
+        "example.net. 3600 IN MX 10 Z.example.net.",
+        "example.net. 3600 IN MX 10 b.example.net.",
+        NULL },
+      { "example.net. 3600 IN MX 10 b.example.net.",
+        "example.net. 3600 IN MX 10 z.example.net.",
+        "example.net. 3600 IN MX 20 a.example.net.",
+        NULL } },
+    { "A at a wildcard, one label less",
+      { "*.Wild.example.net. 3600 IN A 192.0.2.2",
+        "*.wild.example.net. 3600 IN A 192.0.2.10",
+        "*.wild.example.net. 3600 IN A 192.0.2.1",
+        NULL },
+      { "*.wild.example.net. 3600 IN A 192.0.2.1",
+        "*.wild.example.net. 3600 IN A 192.0.2.2",
+        "*.wild.example.net. 3600 IN A 192.0.2.10",
+        NULL } },
+    { NULL, { NULL }, { NULL } }
+};
+
+static const ldns_algorithm check_algorithms[] = {
+    LDNS_RSASHA1,
+    LDNS_RSASHA256,
+    LDNS_RSASHA512,
+    0
+};
+
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: %s -c config\n", progname);
+}
+
+
+/**
+ * Convert an ldns record to a signer record.
+ *
+ */
+static rr_type*
+check_rr(region_type* region, ldns_rr* lrr, dname_type* owner)
+{
+    rr_type* rr;
+    ldns_rdf* rdf;
+    size_t i;
+    rr = (rr_type*) region_alloc(region, sizeof(rr_type));
+    rr->owner = owner;
+    rr->type = (uint16_t) ldns_rr_get_type(lrr);
+    rr->klass = (uint16_t) ldns_rr_get_class(lrr);
+    rr->ttl = ldns_rr_ttl(lrr);
+    rr->rdlen = (uint16_t) ldns_rr_rd_count(lrr);
+    rr->rdata = (rdata_type*) region_alloc(region,
+        rr->rdlen * sizeof(rdata_type));
+    for (i=0; i < rr->rdlen; i++) {
+        rdf = ldns_rr_rdf(lrr, i);
+        if (ldns_rdf_get_type(rdf) == LDNS_RDF_TYPE_DNAME) {
+            rr->rdata[i].dname = dname_create_frm_data(region,
+                ldns_rdf_data(rdf));
+        } else {
+            rr->rdata[i].data = rdata_init_data(region, ldns_rdf_data(rdf),
+                ldns_rdf_size(rdf));
+        }
+    }
+    return rr;
+}
+
+
+/**
+ * Sign the rrset with rrset_sign() and the canonical records with
+ * hsm_sign_rrset(), and compare the signatures.
+ *
+ */
+static int
+check_sign(hsm_ctx_t* ctx, hsm_key_t* key, hsm_sign_params_t* sign_params,
+    const char* name, ldns_rr_list* zone, ldns_rr_list* canonical)
+{
+    region_type* region;
+    domain_type domain;
+    rrset_type rrset;
+    rrsig_params_type params;
+    ldns_rr* rrsig;
+    ldns_rdf* expect;
+    uint8_t sig[HSM_MAX_SIGNATURE_LENGTH];
+    size_t siglen = 0;
+    size_t i;
+    int ok = 0;
+
+    region = region_create();
+    memset(&domain, 0, sizeof(domain));
+    memset(&rrset, 0, sizeof(rrset));
+    domain.dname = dname_create_frm_data(region,
+        ldns_rdf_data(ldns_rr_owner(ldns_rr_list_rr(zone, 0))));
+    rrset.domain = &domain;
+    rrset.rrtype = (uint16_t) ldns_rr_get_type(ldns_rr_list_rr(zone, 0));
+    rrset.rr_count = ldns_rr_list_rr_count(zone);
+    rrset.rrs = (record_type*) region_alloc_zero(region,
+        rrset.rr_count * sizeof(record_type));
+    for (i=0; i < rrset.rr_count; i++) {
+        rrset.rrs[i].rr = check_rr(region, ldns_rr_list_rr(zone, i),
+            domain.dname);
+        rrset.rrs[i].exists = 1;
+    }
+    params.signer = dname_create_frm_data(region,
+        ldns_rdf_data(sign_params->owner));
+    params.ttl = CHECK_TTL;
+    params.expiration = sign_params->expiration;
+    params.inception = sign_params->inception;
+    params.keytag = sign_params->keytag;
+    params.algorithm = (uint8_t) sign_params->algorithm;
+
+    rrsig = hsm_sign_rrset(ctx, canonical, key, sign_params);
+    if (!rrsig) {
+        fprintf(stderr, "%s: hsm_sign_rrset failed\n", name);
+        hsm_print_error(ctx);
+    } else if (rrset_sign(ctx, &rrset, key, &params, sig, &siglen) !=
+        ODS_STATUS_OK) {
+        fprintf(stderr, "%s: rrset_sign failed\n", name);
+        hsm_print_error(ctx);
+    } else {
+        expect = ldns_rr_rrsig_sig(rrsig);
+        if (siglen != ldns_rdf_size(expect) ||
+            memcmp(sig, ldns_rdf_data(expect), siglen) != 0) {
+            fprintf(stderr, "%s: signatures differ\n", name);
+        } else {
+            ok = 1;
+        }
+    }
+    fprintf(stdout, "%s %s (algorithm %u)\n", ok ? "ok  " : "FAIL", name,
+        (unsigned int) sign_params->algorithm);
+    if (rrsig) {
+        ldns_rr_free(rrsig);
+    }
+    region_cleanup(region);
+    return ok;
+}
+
+
+/**
+ * Read records from text.
+ *
+ */
+static ldns_rr_list*
+check_rr_list(const char* const* lines)
+{
+    ldns_rr_list* list = ldns_rr_list_new();
+    ldns_rr* rr;
+    size_t i;
+    for (i=0; lines[i]; i++) {
+        if (ldns_rr_new_frm_str(&rr, lines[i], 0, NULL, NULL) !=
+            LDNS_STATUS_OK) {
+            fprintf(stderr, "bad record: %s\n", lines[i]);
+            exit(1);
+        }
+        ldns_rr_list_push_rr(list, rr);
+    }
+    return list;
+}
+
+
+/**
+ * An NS rrset too large for the initial sign buffers. The names are the
+ * same length, so numeric order is canonical order.
+ *
+ */
+static void
+check_large(ldns_rr_list** zone, ldns_rr_list** canonical)
+{
+    char line[128];
+    ldns_rr* rr;
+    int i;
+    *zone = ldns_rr_list_new();
+    *canonical = ldns_rr_list_new();
+    for (i=0; i < CHECK_LARGE; i++) {
+        snprintf(line, sizeof(line),
+            "example.net. 3600 IN NS NS%04d.example.net.", CHECK_LARGE-1-i);
+        (void) ldns_rr_new_frm_str(&rr, line, 0, NULL, NULL);
+        ldns_rr_list_push_rr(*zone, rr);
+        snprintf(line, sizeof(line),
+            "example.net. 3600 IN NS ns%04d.example.net.", i);
+        (void) ldns_rr_new_frm_str(&rr, line, 0, NULL, NULL);
+        ldns_rr_list_push_rr(*canonical, rr);
+    }
+    /* and a duplicate */
+    ldns_rr_list_push_rr(*zone,
+        ldns_rr_clone(ldns_rr_list_rr(*canonical, 0)));
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    hsm_ctx_t *ctx;
+    hsm_key_t *key;
+    hsm_sign_params_t *sign_params;
+    ldns_rr_list *zone, *canonical;
+    ldns_rr *dnskey_rr;
+    char *config = NULL;
+    int failed = 0;
+    int ch;
+    size_t a, i;
+
+    progname = argv[0];
+
+    while ((ch = getopt(argc, argv, "hc:")) != -1) {
+        switch (ch) {
+        case 'c':
+            config = strdup(optarg);
+            break;
+        case 'h':
+            usage();
+            exit(0);
+            break;
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (!config) {
+        usage();
+        exit(1);
+    }
+
+    if (hsm_open(config, hsm_prompt_pin) != HSM_OK) {
+        fprintf(stderr, "unable to open HSM\n");
+        exit(1);
+    }
+    ctx = hsm_create_context();
+    key = hsm_generate_rsa_key(ctx, "default", 1024);
+    if (!key) {
+        fprintf(stderr, "unable to create key\n");
+        hsm_print_error(ctx);
+        exit(1);
+    }
+
+    for (a=0; check_algorithms[a]; a++) {
+        sign_params = hsm_sign_params_new();
+        sign_params->algorithm = check_algorithms[a];
+        sign_params->owner = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME,
+            "example.net.");
+        sign_params->inception = CHECK_INCEPTION;
+        sign_params->expiration = CHECK_EXPIRATION;
+        dnskey_rr = hsm_get_dnskey(ctx, key, sign_params);
+        sign_params->keytag = ldns_calc_keytag(dnskey_rr);
+        ldns_rr_free(dnskey_rr);
+
+        for (i=0; check_rrsets[i].name; i++) {
+            zone = check_rr_list(check_rrsets[i].zone);
+            canonical = check_rr_list(check_rrsets[i].canonical);
+            failed += !check_sign(ctx, key, sign_params,
+                check_rrsets[i].name, zone, canonical);
+            ldns_rr_list_deep_free(zone);
+            ldns_rr_list_deep_free(canonical);
+        }
+        check_large(&zone, &canonical);
+        failed += !check_sign(ctx, key, sign_params,
+            "NS, larger than the initial sign buffers", zone, canonical);
+        ldns_rr_list_deep_free(zone);
+        ldns_rr_list_deep_free(canonical);
+
+        hsm_sign_params_free(sign_params);
+    }
+
+    (void) hsm_remove_key(ctx, key);
+    hsm_key_free(key);
+    hsm_destroy_context(ctx);
+    (void) hsm_close();
+    free(config);
+
+    if (failed) {
+        fprintf(stdout, "%d checks failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
@@ -33,7 +33,10 @@
 
 #include "config.h"
 #include "adapter/adapter.h"
+#include "adapter/addns.h"
 #include "adapter/adfile.h"
+#include "adapter/adupdate.h"
+#include "adapter/adwire.h"
 #include "signer/zone.h"
 #include "util/log.h"
 
@@ -88,9 +91,14 @@ adapter_read(struct zone_struct* zone)
             return ODS_STATUS_NOTIMPL;
             break;
         case ADAPTER_UPDATE:
-            ods_log_warning("[%s] zone %s update input adapter NOTIMPL",
-                logstr, zone->name);
-            return ODS_STATUS_NOTIMPL;
+            ods_log_verbose("[%s] read zone %s from update input adapter %s",
+                logstr, zone->name, zone->adapter_in->configstr);
+            return adupdate_read(zone);
+            break;
+        case ADAPTER_WIRE:
+            ods_log_verbose("[%s] read zone %s from wire input adapter %s",
+                logstr, zone->name, zone->adapter_in->configstr);
+            return adwire_read(zone);
             break;
         default:
             ods_log_error("[%s] read zone %s from adapter failed: unknown "
@@ -122,8 +130,17 @@ adapter_write(struct zone_struct* zone)
             return adfile_write(zone);
             break;
         case ADAPTER_DNS:
+            ods_log_verbose("[%s] write zone %s to dns output adapter %s",
+                logstr, zone->name, zone->adapter_out->configstr);
+            return addns_write(zone);
+            break;
         case ADAPTER_UPDATE:
-            ods_log_warning("[%s] zone %s output adapter NOTIMPL",
+            ods_log_verbose("[%s] write zone %s to update output adapter %s",
+                logstr, zone->name, zone->adapter_out->configstr);
+            return adupdate_write(zone);
+            break;
+        case ADAPTER_WIRE:
+            ods_log_error("[%s] write zone %s to wire output adapter NOTIMPL",
                 logstr, zone->name);
             return ODS_STATUS_NOTIMPL;
             break;
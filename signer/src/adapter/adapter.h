@@ -48,7 +48,8 @@ enum adapter_mode_enum
 {
     ADAPTER_FILE = 1,
     ADAPTER_DNS,
-    ADAPTER_UPDATE
+    ADAPTER_UPDATE,
+    ADAPTER_WIRE
 };
 typedef enum adapter_mode_enum adapter_mode;
 
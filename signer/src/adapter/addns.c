@@ -0,0 +1,66 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * DNS Adapters.
+ *
+ */
+
+#include "config.h"
+#include "adapter/addns.h"
+#include "dns/wf.h"
+#include "signer/zone.h"
+#include "util/log.h"
+
+static const char* logstr = "adapter";
+
+
+/**
+ * Publish zone for outbound zone transfers.
+ *
+ */
+ods_status
+addns_write(struct zone_struct* zone)
+{
+    rr_type* soa;
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    ods_log_assert(zone->adapter_out);
+    soa = zone_lookup_soa(zone);
+    if (!soa) {
+        ods_log_error("[%s] publish zone %s failed: no SOA", logstr,
+            zone->name);
+        zone->xfr_ready = 0;
+        return ODS_STATUS_XFRERR;
+    }
+    zone->outbound_serial = wf_read_uint32(rdata_get_data(&soa->rdata[2]));
+    zone->xfr_ready = 1;
+    ods_log_verbose("[%s] zone %s serial %u available for outbound transfer",
+        logstr, zone->name, zone->outbound_serial);
+    return ODS_STATUS_OK;
+}
@@ -95,6 +95,9 @@ adfile_write(struct zone_struct* zone)
         return ODS_STATUS_FOPENERR;
     }
     status = zone_print(fd, zone);
+    if (status == ODS_STATUS_OK && ftell(fd) > 0) {
+        stats_add(zone->stats.bytes_written, ftell(fd));
+    }
     ods_fclose(fd);
     return status;
 }
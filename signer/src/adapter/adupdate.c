@@ -0,0 +1,148 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Update Adapters.
+ *
+ */
+
+#include "config.h"
+#include "adapter/adupdate.h"
+#include "dns/wf.h"
+#include "rzonec/rzonec.h"
+#include "signer/zone.h"
+#include "util/file.h"
+#include "util/log.h"
+
+#include <errno.h>
+#include <string.h>
+
+static const char* logstr = "adapter";
+
+
+/**
+ * Read differences from update file.
+ *
+ */
+ods_status
+adupdate_read(struct zone_struct* zone)
+{
+    int ret;
+    int done;
+    time_t st_mtime = 0;
+    zparser_type* parser;
+    adapter_type* adapter;
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    ods_log_assert(zone->adapter_in);
+    ods_log_assert(zone->adapter_in->configstr);
+    adapter = zone->adapter_in;
+    /* differences already applied? */
+    st_mtime = ods_fstat(adapter->configstr);
+    if (!st_mtime) {
+        return ODS_STATUS_FOPENERR;
+    }
+    if (st_mtime <= adapter->config_last_modified) {
+        ods_log_verbose("[%s] update file %s not modified since %u", logstr,
+            adapter->configstr, (unsigned) adapter->config_last_modified);
+        return ODS_STATUS_UNCHANGED;
+    }
+    /* create the parser */
+    parser = zparser_create_ixfr(zone);
+    if (!parser) {
+        ods_log_crit("[%s] create zone parser failed", logstr);
+        return ODS_STATUS_ZPARSERERR;
+    }
+    ret = zparser_read_zone(parser, adapter->configstr);
+    done = parser->ixfr_done;
+    zparser_cleanup(parser);
+    if (ret || !done) {
+        ods_log_error("[%s] zone %s update file %s %s", logstr, zone->name,
+            adapter->configstr, ret?"has errors":"is incomplete");
+        zone_rollback_diff(zone);
+        return ODS_STATUS_ZPARSERERR;
+    }
+    zone_commit_diff(zone, 1, 0);
+    adapter->config_last_modified = st_mtime;
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Write differences to update file.
+ *
+ */
+ods_status
+adupdate_write(struct zone_struct* zone)
+{
+    FILE* fd;
+    rr_type* soa;
+    uint32_t serial;
+    ods_status status;
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    ods_log_assert(zone->journal);
+    ods_log_assert(zone->adapter_out);
+    ods_log_assert(zone->adapter_out->configstr);
+    soa = zone_lookup_soa(zone);
+    if (!soa) {
+        ods_log_error("[%s] write zone %s failed: no SOA", logstr,
+            zone->name);
+        return ODS_STATUS_XFRERR;
+    }
+    /* differences since the last write, or all that are kept */
+    if (zone->xfr_ready) {
+        serial = zone->outbound_serial;
+    } else if (zone->journal->count > 0) {
+        serial = zone->journal->entries[0].serial_from;
+    } else {
+        serial = wf_read_uint32(rdata_get_data(&soa->rdata[2]));
+    }
+    if (journal_lookup(zone->journal, serial) < 0) {
+        ods_log_verbose("[%s] zone %s has no differences since serial %u",
+            logstr, zone->name, serial);
+        return ODS_STATUS_OK;
+    }
+    fd = ods_fopen(zone->adapter_out->configstr, NULL, "w");
+    if (!fd) {
+        ods_log_crit("[%s] open file %s for writing failed: %s", logstr,
+            zone->adapter_out->configstr, strerror(errno));
+        return ODS_STATUS_FOPENERR;
+    }
+    status = journal_export(zone->journal, serial, fd);
+    ods_fclose(fd);
+    if (status != ODS_STATUS_OK) {
+        return status;
+    }
+    zone->outbound_serial = wf_read_uint32(rdata_get_data(&soa->rdata[2]));
+    zone->xfr_ready = 1;
+    ods_log_verbose("[%s] zone %s differences %u -> %u written to %s",
+        logstr, zone->name, serial, zone->outbound_serial,
+        zone->adapter_out->configstr);
+    return ODS_STATUS_OK;
+}
@@ -0,0 +1,68 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Update Adapters.
+ *
+ */
+
+#ifndef ADAPTER_ADUPDATE_H
+#define ADAPTER_ADUPDATE_H
+
+#include "config.h"
+#include "util/status.h"
+
+struct zone_struct;
+
+/**
+ * Update adapter structure.
+ *
+ */
+/** NULL */
+
+/**
+ * Read differences from input update adapter. The input is a file with
+ * differences in IXFR format. A file is applied once: it is only read
+ * again if it has been modified since.
+ * @param zone: zone.
+ * @return:     (ods_status) status.
+ *
+ */
+ods_status adupdate_read(struct zone_struct* zone);
+
+/**
+ * Write differences to output update adapter. The differences since the
+ * previous write are taken from the zone journal and written in IXFR
+ * format.
+ * @param zone: zone.
+ * @return:     (ods_status) status.
+ *
+ */
+ods_status adupdate_write(struct zone_struct* zone);
+
+#endif /* ADAPTER_ADUPDATE_H */
@@ -0,0 +1,337 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Wire format Adapters.
+ *
+ */
+
+#include "config.h"
+#include "adapter/adwire.h"
+#include "dns/dname.h"
+#include "dns/dns.h"
+#include "dns/rdata.h"
+#include "dns/rr.h"
+#include "signer/zone.h"
+#include "util/file.h"
+#include "util/log.h"
+#include "wire/buffer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* logstr = "adapter";
+
+
+/**
+ * Read domain name from buffer.
+ *
+ */
+static dname_type*
+adwire_read_dname(region_type* region, buffer_type* buffer)
+{
+    uint8_t wire[MAXDOMAINLEN+1];
+    if (!buffer_read_dname(buffer, wire, 0)) {
+        return NULL;
+    }
+    return dname_create_frm_data(region, wire);
+}
+
+
+/**
+ * Read RDATA from buffer, split up in elements as the zone parser does.
+ *
+ */
+static int
+adwire_read_rdata(region_type* region, rr_type* rr, buffer_type* buffer)
+{
+    rrstruct_type* rrstruct = dns_rrstruct_by_type(rr->type);
+    dns_rdata_format rdformat;
+    unsigned repeat = 0;
+    size_t maximum = rrstruct->maximum;
+    size_t len = 0;
+    const uint8_t* gw = NULL;
+    dname_type* dname = NULL;
+    uint16_t* d = NULL;
+
+    /* text strings and address prefixes are one element each */
+    if (rrstruct->rdata[0] == DNS_RDATA_TEXTS ||
+        rrstruct->rdata[0] == DNS_RDATA_APLS) {
+        repeat = 1;
+        maximum = DNS_RDATA_MAX;
+    }
+    rr->rdata = (rdata_type*) region_alloc(region,
+        DNS_RDATA_MAX * sizeof(rdata_type));
+    rr->rdlen = 0;
+    while (buffer_remaining(buffer) > 0 || rr->rdlen < rrstruct->minimum) {
+        if (rr->rdlen >= maximum) {
+            ods_log_error("[%s] error: too many rdata elements", logstr);
+            return 0;
+        }
+        rdformat = rrstruct->rdata[repeat ? 0 : rr->rdlen];
+        dname = NULL;
+        switch (rdformat) {
+            case DNS_RDATA_INT8:
+            case DNS_RDATA_ALGORITHM:
+                len = 1;
+                break;
+            case DNS_RDATA_INT16:
+            case DNS_RDATA_CERT_TYPE:
+            case DNS_RDATA_RRTYPE:
+                len = 2;
+                break;
+            case DNS_RDATA_IPV4:
+            case DNS_RDATA_INT32:
+            case DNS_RDATA_TIMEF:
+            case DNS_RDATA_DATETIME:
+                len = 4;
+                break;
+            case DNS_RDATA_IPV6:
+                len = DNS_IPV6_ADDRLEN;
+                break;
+            case DNS_RDATA_COMPRESSED_DNAME:
+            case DNS_RDATA_UNCOMPRESSED_DNAME:
+                dname = adwire_read_dname(region, buffer);
+                if (!dname) {
+                    ods_log_error("[%s] error: bad rdata dname", logstr);
+                    return 0;
+                }
+                len = 0;
+                break;
+            case DNS_RDATA_TEXT:
+            case DNS_RDATA_TEXTS:
+            case DNS_RDATA_FLOAT:
+            case DNS_RDATA_HEXLEN:
+                /* the length octet is part of the element */
+                if (!buffer_available(buffer, 1)) {
+                    len = 1;
+                    break;
+                }
+                len = 1 + buffer_current(buffer)[0];
+                break;
+            case DNS_RDATA_BASE32HEX:
+                /* the zone parser keeps the hash without length octet */
+                if (!buffer_available(buffer, 1)) {
+                    len = 1;
+                    break;
+                }
+                len = buffer_read_u8(buffer);
+                break;
+            case DNS_RDATA_APLS:
+                if (!buffer_available(buffer, 4)) {
+                    len = 4;
+                    break;
+                }
+                len = 4 + (buffer_current(buffer)[3] & DNS_APL_AFDLEN_MASK);
+                break;
+            case DNS_RDATA_IPSECGATEWAY:
+                ods_log_assert(rr->rdlen > 1);
+                gw = rdata_get_data(&rr->rdata[1]);
+                if (*gw == 0) {
+                    dname = dname_create(region, ".");
+                    len = 0;
+                } else if (*gw == 1) {
+                    len = DNS_IPV4_ADDRLEN;
+                } else if (*gw == 2) {
+                    len = DNS_IPV6_ADDRLEN;
+                } else if (*gw == 3) {
+                    dname = adwire_read_dname(region, buffer);
+                    len = 0;
+                }
+                if (*gw > 3 || (*gw != 1 && *gw != 2 && !dname)) {
+                    ods_log_error("[%s] error: bad rdata %s", logstr,
+                        dns_rdata_format_str(rdformat));
+                    return 0;
+                }
+                break;
+            case DNS_RDATA_SERVICES:
+            case DNS_RDATA_NSAP:
+            case DNS_RDATA_BASE64:
+            case DNS_RDATA_HEX:
+            case DNS_RDATA_LOC:
+            case DNS_RDATA_NXTBM:
+            case DNS_RDATA_NSECBM:
+            case DNS_RDATA_UNKNOWN:
+            default:
+                /* runs until the end of the rdata */
+                len = buffer_remaining(buffer);
+                break;
+        }
+        if (dname) {
+            rr->rdata[rr->rdlen].dname = dname;
+        } else {
+            if (!buffer_available(buffer, len)) {
+                ods_log_error("[%s] error: rdata %s truncated", logstr,
+                    dns_rdata_format_str(rdformat));
+                return 0;
+            }
+            d = rdata_init_data(region, buffer_current(buffer), len);
+            if (!d) {
+                ods_log_error("[%s] error: bad rdata %s", logstr,
+                    dns_rdata_format_str(rdformat));
+                return 0;
+            }
+            buffer_skip(buffer, len);
+            rr->rdata[rr->rdlen].data = d;
+        }
+        rr->rdlen++;
+    }
+    return 1;
+}
+
+
+/**
+ * Read resource record from buffer.
+ *
+ */
+static int
+adwire_read_rr(region_type* region, rr_type* rr, buffer_type* buffer)
+{
+    uint16_t rdlength;
+    rr->owner = adwire_read_dname(region, buffer);
+    if (!rr->owner) {
+        ods_log_error("[%s] error: bad owner", logstr);
+        return 0;
+    }
+    if (!buffer_available(buffer, 10)) {
+        ods_log_error("[%s] error: record truncated", logstr);
+        return 0;
+    }
+    rr->type = buffer_read_u16(buffer);
+    rr->klass = buffer_read_u16(buffer);
+    rr->ttl = buffer_read_u32(buffer);
+    rdlength = buffer_read_u16(buffer);
+    if (rr->klass != DNS_CLASS_IN) {
+        ods_log_error("[%s] error: class %u is not supported", logstr,
+            (unsigned) rr->klass);
+        return 0;
+    }
+    if (buffer_remaining(buffer) != rdlength) {
+        ods_log_error("[%s] error: rdlength %u does not match record length",
+            logstr, (unsigned) rdlength);
+        return 0;
+    }
+    return adwire_read_rdata(region, rr, buffer);
+}
+
+
+/**
+ * Read zone from wire format file.
+ *
+ */
+ods_status
+adwire_read(struct zone_struct* zone)
+{
+    FILE* fd = NULL;
+    region_type* region = NULL;
+    region_type* rr_region = NULL;
+    buffer_type* buffer = NULL;
+    uint8_t prefix[2];
+    size_t len = 0;
+    size_t got = 0;
+    unsigned int numrrs = 0;
+    unsigned int errors = 0;
+    ods_status status = ODS_STATUS_OK;
+    rr_type rr;
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    ods_log_assert(zone->adapter_in);
+    ods_log_assert(zone->adapter_in->configstr);
+    fd = ods_fopen(zone->adapter_in->configstr, NULL, "r");
+    if (!fd) {
+        return ODS_STATUS_FOPENERR;
+    }
+    (void) setvbuf(fd, NULL, _IOFBF, AD_WIRE_BUFSIZE);
+    region = region_create();
+    rr_region = region_create();
+    buffer = region ? buffer_create(region, MAX_PACKET_SIZE) : NULL;
+    if (!rr_region || !buffer) {
+        ods_log_crit("[%s] read zone %s failed: allocation error", logstr,
+            zone->name);
+        region_cleanup(rr_region);
+        region_cleanup(region);
+        ods_fclose(fd);
+        return ODS_STATUS_MALLOCERR;
+    }
+    /* records are parsed in the scratch region, the zone keeps a copy */
+    while ((got = fread(prefix, 1, sizeof(prefix), fd)) == sizeof(prefix)) {
+        len = read_uint16(prefix);
+        buffer_clear(buffer);
+        if (fread(buffer_begin(buffer), 1, len, fd) != len) {
+            got = 1;
+            break;
+        }
+        buffer_set_limit(buffer, len);
+        memset(&rr, 0, sizeof(rr));
+        if (!adwire_read_rr(rr_region, &rr, buffer)) {
+            ods_log_error("[%s] zone %s wire file %s: bad record %u", logstr,
+                zone->name, zone->adapter_in->configstr, numrrs + errors + 1);
+            errors++;
+        } else if (!dname_is_subdomain(rr.owner, zone->apex)) {
+            ods_log_error("[%s] zone %s wire file %s: record %u is out of "
+                "zone", logstr, zone->name, zone->adapter_in->configstr,
+                numrrs + errors + 1);
+            errors++;
+        } else {
+            status = zone_add_rr(zone, &rr, 1);
+            if (status != ODS_STATUS_OK && status != ODS_STATUS_UNCHANGED) {
+                ods_log_error("[%s] zone %s wire file %s: adding record %u "
+                    "failed: %s", logstr, zone->name,
+                    zone->adapter_in->configstr, numrrs + errors + 1,
+                    ods_status2str(status));
+                errors++;
+            } else {
+                numrrs++;
+            }
+        }
+        region_free(rr_region);
+    }
+    if (got != 0) {
+        ods_log_error("[%s] zone %s wire file %s is truncated", logstr,
+            zone->name, zone->adapter_in->configstr);
+        errors++;
+    } else if (ferror(fd)) {
+        ods_log_error("[%s] zone %s wire file %s: read error: %s", logstr,
+            zone->name, zone->adapter_in->configstr, strerror(errno));
+        errors++;
+    }
+    ods_fclose(fd);
+    region_cleanup(rr_region);
+    region_cleanup(region);
+    if (errors) {
+        ods_log_error("[%s] zone %s wire file %s has %u errors", logstr,
+            zone->name, zone->adapter_in->configstr, errors);
+        zone_rollback_diff(zone);
+        return ODS_STATUS_ZPARSERERR;
+    }
+    ods_log_verbose("[%s] read %u records for zone %s from wire file %s",
+        logstr, numrrs, zone->name, zone->adapter_in->configstr);
+    zone_commit_diff(zone, 0, 0);
+    return ODS_STATUS_OK;
+}
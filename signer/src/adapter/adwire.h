@@ -0,0 +1,58 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Wire format Adapters.
+ *
+ * The input is a stream of resource records in uncompressed wire format.
+ * Each record is preceded by its length as a 16-bit integer in network
+ * byte order, just like DNS messages over TCP:
+ *
+ *     length | owner | type | class | ttl | rdlength | rdata
+ *
+ */
+
+#ifndef ADAPTER_ADWIRE_H
+#define ADAPTER_ADWIRE_H
+
+#include "config.h"
+#include "util/status.h"
+
+#define AD_WIRE_BUFSIZE 65536
+
+struct zone_struct;
+
+/**
+ * Read zone from input wire format adapter.
+ * @param zone: zone.
+ * @return:     (ods_status) status.
+ *
+ */
+ods_status adwire_read(struct zone_struct* zone);
+
+#endif /* ADAPTER_ADWIRE_H */
@@ -41,25 +41,116 @@ static const char b64pad = '=';
 static const char numb64[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-static const uint8_t b64num[] = {
-    ['A'] =  0, ['B'] =  1, ['C'] =  2, ['D'] =  3,
-    ['E'] =  4, ['F'] =  5, ['G'] =  6, ['H'] =  7,
-    ['I'] =  8, ['J'] =  9, ['K'] = 10, ['L'] = 11,
-    ['M'] = 12, ['N'] = 13, ['O'] = 14, ['P'] = 15,
-    ['Q'] = 16, ['R'] = 17, ['S'] = 18, ['T'] = 19,
-    ['U'] = 20, ['V'] = 21, ['W'] = 22, ['X'] = 23,
-    ['Y'] = 24, ['Z'] = 25, ['a'] = 26, ['b'] = 27,
-    ['c'] = 28, ['d'] = 29, ['e'] = 30, ['f'] = 31,
-    ['g'] = 32, ['h'] = 33, ['i'] = 34, ['j'] = 35,
-    ['k'] = 36, ['l'] = 37, ['m'] = 38, ['n'] = 39,
-    ['o'] = 40, ['p'] = 41, ['q'] = 42, ['r'] = 43,
-    ['s'] = 44, ['t'] = 45, ['u'] = 46, ['v'] = 47,
-    ['w'] = 48, ['x'] = 49, ['y'] = 50, ['z'] = 51,
-    ['0'] = 52, ['1'] = 53, ['2'] = 54, ['3'] = 55,
-    ['4'] = 56, ['5'] = 57, ['6'] = 58, ['7'] = 59,
-    ['8'] = 60, ['9'] = 61, ['+'] = 62, ['/'] = 63,
+/* decoded value plus one, zero for characters that are not base64 */
+static const uint8_t b64num[256] = {
+    ['A'] =  1, ['B'] =  2, ['C'] =  3, ['D'] =  4,
+    ['E'] =  5, ['F'] =  6, ['G'] =  7, ['H'] =  8,
+    ['I'] =  9, ['J'] = 10, ['K'] = 11, ['L'] = 12,
+    ['M'] = 13, ['N'] = 14, ['O'] = 15, ['P'] = 16,
+    ['Q'] = 17, ['R'] = 18, ['S'] = 19, ['T'] = 20,
+    ['U'] = 21, ['V'] = 22, ['W'] = 23, ['X'] = 24,
+    ['Y'] = 25, ['Z'] = 26, ['a'] = 27, ['b'] = 28,
+    ['c'] = 29, ['d'] = 30, ['e'] = 31, ['f'] = 32,
+    ['g'] = 33, ['h'] = 34, ['i'] = 35, ['j'] = 36,
+    ['k'] = 37, ['l'] = 38, ['m'] = 39, ['n'] = 40,
+    ['o'] = 41, ['p'] = 42, ['q'] = 43, ['r'] = 44,
+    ['s'] = 45, ['t'] = 46, ['u'] = 47, ['v'] = 48,
+    ['w'] = 49, ['x'] = 50, ['y'] = 51, ['z'] = 52,
+    ['0'] = 53, ['1'] = 54, ['2'] = 55, ['3'] = 56,
+    ['4'] = 57, ['5'] = 58, ['6'] = 59, ['7'] = 60,
+    ['8'] = 61, ['9'] = 62, ['+'] = 63, ['/'] = 64,
 };
 
+/*
+ * Whole blocks of B64_BLOCK characters are decoded side by side with GCC
+ * vector extensions, one character per byte lane. Where the CPU has AVX2
+ * a block fits one register, otherwise the compiler splits it (SSE2) or
+ * falls back to plain integer code. A block with whitespace, padding or
+ * any other character is left to the scalar loop.
+ */
+#if defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define B64_VEC 1
+#if defined(__x86_64__) || defined(__i386__)
+#define B64_VEC_AVX2 1
+#endif
+#endif
+
+#ifdef B64_VEC
+
+#define B64_BLOCK 32
+#define B64_BLOCK_OUT (B64_BLOCK / 4 * 3)
+
+typedef uint8_t b64_bytes_t __attribute__ ((vector_size (B64_BLOCK)));
+typedef uint32_t b64_words_t __attribute__ ((vector_size (B64_BLOCK)));
+
+/* last three bytes of every 24-bit word, most significant first */
+static const b64_bytes_t b64pack = {
+     2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12,
+    18, 17, 16, 22, 21, 20, 26, 25, 24, 30, 29, 28,
+     3,  7, 11, 15, 19, 23, 27, 31
+};
+
+/**
+ * Decode up to blocks whole blocks, return the number decoded.
+ *
+ */
+static inline __attribute__ ((always_inline)) size_t
+b64_pton_blocks(const unsigned char* src, size_t blocks, uint8_t* target)
+{
+    b64_bytes_t c, upper, lower, digit, plus, slash, ok;
+    b64_words_t w;
+    uint64_t okw[B64_BLOCK / 8];
+    size_t n, i;
+    for (n = 0; n < blocks; n++) {
+        memcpy(&c, src, sizeof(c));
+        upper = (b64_bytes_t) (c >= 'A') & (b64_bytes_t) (c <= 'Z');
+        lower = (b64_bytes_t) (c >= 'a') & (b64_bytes_t) (c <= 'z');
+        digit = (b64_bytes_t) (c >= '0') & (b64_bytes_t) (c <= '9');
+        plus = (b64_bytes_t) (c == '+');
+        slash = (b64_bytes_t) (c == '/');
+        ok = upper | lower | digit | plus | slash;
+        memcpy(okw, &ok, sizeof(okw));
+        for (i = 1; i < B64_BLOCK / 8; i++) {
+            okw[0] &= okw[i];
+        }
+        if (okw[0] != ~(uint64_t) 0) {
+            break;
+        }
+        c = (upper & (c - 'A')) | (lower & (c - ('a' - 26))) |
+            (digit & (c + (52 - '0'))) | (plus & 62) | (slash & 63);
+        /* four 6-bit values per word, first character in the low byte */
+        w = (b64_words_t) c;
+        w = ((w & 0xff) << 18) | (((w >> 8) & 0xff) << 12) |
+            (((w >> 16) & 0xff) << 6) | (w >> 24);
+        c = __builtin_shuffle((b64_bytes_t) w, b64pack);
+        memcpy(target, &c, B64_BLOCK_OUT);
+        src += B64_BLOCK;
+        target += B64_BLOCK_OUT;
+    }
+    return n;
+}
+
+static size_t
+b64_pton_blocks_default(const unsigned char* src, size_t blocks,
+    uint8_t* target)
+{
+    return b64_pton_blocks(src, blocks, target);
+}
+
+#ifdef B64_VEC_AVX2
+static __attribute__ ((target ("avx2"))) size_t
+b64_pton_blocks_avx2(const unsigned char* src, size_t blocks,
+    uint8_t* target)
+{
+    return b64_pton_blocks(src, blocks, target);
+}
+#endif
+
+#endif /* B64_VEC */
+
+
 /**
  * Encode to base64.
  *
@@ -71,88 +162,108 @@ b64_pton(char const* src, uint8_t* target, size_t targetsize)
      * src:    00AAAAAA 00BBBBBB 00CCCCCC 00DDDDDD
      * target: AAAAAABB BBBBCCCC CCDDDDDD
      */
-
-    /**
-     * target[0] = ((src[0] & 0x3f) << 2) + ((src[1] & 0x30) >> 4);
-     * target[1] = ((src[1] & 0x0f) << 4) + ((src[2] & 0x3c) >> 2);
-     * target[2] = ((src[2] & 0x03) << 6) + ((src[3] & 0x3f) >> 0);
-     */
-
+    const unsigned char* s = (const unsigned char*) src;
     uint8_t* start = target;
-    size_t target_bytes = 0;
+    uint8_t* end = target + targetsize;
+    uint32_t bits = 0;
     int src_index = 0;
-    int ch;
+    unsigned a, b, c, d;
+#ifdef B64_VEC
+    size_t (*blocks)(const unsigned char*, size_t, uint8_t*) =
+        b64_pton_blocks_default;
+    const unsigned char* s_end = s + strlen(src);
+    size_t n;
+#ifdef B64_VEC_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        blocks = b64_pton_blocks_avx2;
+    }
+#endif
+#endif
 
-    while (*src) {
-        ch = *src;
-        if (ch == b64pad) {
-            /* padding means we are done */
+    while (1) {
+        /* fast path: whole quads, no whitespace or padding */
+        if (src_index == 0) {
+#ifdef B64_VEC
+            n = (size_t) (s_end - s) / B64_BLOCK;
+            if (n > (size_t) (end - target) / B64_BLOCK_OUT) {
+                n = (size_t) (end - target) / B64_BLOCK_OUT;
+            }
+            n = n ? blocks(s, n, target) : 0;
+            s += n * B64_BLOCK;
+            target += n * B64_BLOCK_OUT;
+#endif
+            while (end - target >= 3) {
+                if (!(a = b64num[s[0]]) || !(b = b64num[s[1]]) ||
+                    !(c = b64num[s[2]]) || !(d = b64num[s[3]])) {
+                    break;
+                }
+                bits = ((a-1) << 18) | ((b-1) << 12) | ((c-1) << 6) | (d-1);
+                target[0] = (uint8_t) (bits >> 16);
+                target[1] = (uint8_t) (bits >> 8);
+                target[2] = (uint8_t) bits;
+                target += 3;
+                s += 4;
+            }
+            bits = 0;
+        }
+        if (!*s || *s == b64pad) {
             break;
-        } else if (isspace(ch)) {
+        } else if (isspace(*s)) {
             /* ignore whitespace */
-            src++;
+            s++;
             continue;
+        } else if (!(a = b64num[*s])) {
+            return -2;
         }
-        /* else assert(isbase64(ch)) */
-
-        switch (src_index) {
-            case 0:
-                target_bytes += 3;
-                if (target_bytes >= targetsize) {
-                    return -1;
-                }
-                *target = ((b64num[*src] & 0x3f) << 2);
-                break;
-            case 1:
-                *(target++) |= ((b64num[*src] & 0x30) >> 4);
-                *target = ((b64num[*src] & 0x0f) << 4);
-                break;
-            case 2:
-                *(target++) |= ((b64num[*src] & 0x3c) >> 2);
-                *target = ((b64num[*src] & 0x03) << 6);
-                break;
-            case 3:
-                *(target++) |= (b64num[*src] & 0x3f);
-                break;
-            default:
-                return -2;
-                break;
+        bits = (bits << 6) | (a-1);
+        s++;
+        if (++src_index == 4) {
+            if (end - target < 3) {
+                return -1;
+            }
+            target[0] = (uint8_t) (bits >> 16);
+            target[1] = (uint8_t) (bits >> 8);
+            target[2] = (uint8_t) bits;
+            target += 3;
+            src_index = 0;
         }
-        src++;
-        src_index = (src_index+1) % 4;
     }
 
-    if (ch == b64pad) {
+    if (*s == b64pad) {
+        s++;
         switch (src_index) {
-            case 0:
-            case 1:
-                return -3; /* invalid position for padding */
             case 2:
-                ch = *src++;
-                while (isspace(ch)) {
-                    ch = *src++;
+                while (isspace(*s)) {
+                    s++;
                 }
-                if (ch != b64pad) {
+                if (*s != b64pad) {
                     return -4;
                 }
-            case 3:
-                ch = *src++;
-                while (isspace(ch)) {
-                    ch = *src++;
+                if (bits & 0x0f) {
+                    return -5;
+                }
+                if (end - target < 1) {
+                    return -1;
                 }
-                if (*target != 0) {
+                *target++ = (uint8_t) (bits >> 4);
+                break;
+            case 3:
+                if (bits & 0x03) {
                     return -5;
                 }
+                if (end - target < 2) {
+                    return -1;
+                }
+                *target++ = (uint8_t) (bits >> 10);
+                *target++ = (uint8_t) (bits >> 2);
                 break;
             default:
-                return -6;
-                break;
+                return -3; /* invalid position for padding */
         }
     } else if (src_index != 0) {
         return -7;
     }
-    target_bytes = target - start;
-    return target_bytes;
+    return (int) (target - start);
 }
 
 
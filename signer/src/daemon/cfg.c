@@ -53,46 +53,50 @@ cfg_create(region_type* r, const char* cfgfile, int cmdline_verbosity)
 {
     const char* rngfile = ODS_SE_RNGDIR "/conf.rng";
     ods_status status = ODS_STATUS_OK;
-    FILE* cfgfd = NULL;
+    parser_conf_type conf;
     cfg_type* cfg;
     ods_log_assert(r);
     ods_log_assert(cfgfile);
-    /* check syntax (slows down parsing configuration file) */
-    status = parser_filecheck(cfgfile, rngfile);
+    ods_log_verbose("[%s] read cfgfile: %s", logstr, cfgfile);
+    cfg = (cfg_type*) region_alloc(r, sizeof(cfg_type));
+    cfg->cfg_filename = region_strdup(r, cfgfile);
+    status = parser_conf_read(r, cfgfile, rngfile, &conf);
     if (status != ODS_STATUS_OK) {
-        ods_log_error("[%s] parse error in %s", logstr, cfgfile,
+        ods_log_error("[%s] parse error in %s: %s", logstr, cfgfile,
             ods_status2str(status));
         return NULL;
     }
-    /* open file */
-    cfgfd = ods_fopen(cfgfile, NULL, "r");
-    if (cfgfd) {
-        ods_log_verbose("[%s] read cfgfile: %s", logstr, cfgfile);
-        cfg = (cfg_type*) region_alloc(r, sizeof(cfg_type));
-        cfg->cfg_filename = region_strdup(r, cfgfile);
-        cfg->log_filename = parser_conf_log_filename(r, cfgfile);
-        cfg->zonelist_filename = parser_conf_zonelist_filename(r, cfgfile);
-        cfg->clisock_filename = parser_conf_clisock_filename(r, cfgfile);
-        cfg->notify_command = parser_conf_notify_command(r, cfgfile);
-        cfg->pid_filename = parser_conf_pid_filename(r, cfgfile);
-        cfg->working_dir = parser_conf_working_dir(r, cfgfile);
-        cfg->username = parser_conf_username(r, cfgfile);
-        cfg->group = parser_conf_group(r, cfgfile);
-        cfg->chroot = parser_conf_chroot(r, cfgfile);
-        cfg->use_syslog = parser_conf_use_syslog(cfgfile);
-        cfg->num_worker_threads = parser_conf_worker_threads(cfgfile);
-        cfg->num_signer_threads = parser_conf_signer_threads(cfgfile);
+    /* syslog facility wins over a log file */
+    cfg->use_syslog = conf.syslog_facility != NULL;
+    cfg->log_filename = conf.syslog_facility ? conf.syslog_facility :
+        conf.log_filename;
+    cfg->zonelist_filename = conf.zonelist_filename;
+    if (!cfg->zonelist_filename) {
+        ods_log_error("[%s] no ZoneListFile in %s", logstr, cfgfile);
+    }
+    cfg->clisock_filename = conf.clisock_filename ? conf.clisock_filename :
+        region_strdup(r, ODS_SE_SOCKFILE);
+    cfg->notify_command = conf.notify_command;
+    cfg->pid_filename = conf.pid_filename ? conf.pid_filename :
+        region_strdup(r, ODS_SE_PIDFILE);
+    cfg->working_dir = conf.working_dir ? conf.working_dir :
+        region_strdup(r, ODS_SE_WORKDIR);
+    cfg->username = conf.username;
+    cfg->group = conf.group;
+    cfg->chroot = conf.chroot;
+    cfg->interfaces = conf.interfaces;
+    cfg->num_worker_threads = conf.num_worker_threads >= 0 ?
+        conf.num_worker_threads : ODS_SE_WORKERTHREADS;
+    /* no SignerThreads value configured, look at WorkerThreads */
+    cfg->num_signer_threads = conf.num_signer_threads >= 0 ?
+        conf.num_signer_threads : cfg->num_worker_threads;
+    cfg->verbosity = conf.verbosity >= 0 ? conf.verbosity :
+        ODS_SE_VERBOSITY;
+    /* If any verbosity has been specified at cmd line we will use that */
+    if (cmdline_verbosity > 0) {
         cfg->verbosity = cmdline_verbosity;
-        /* If any verbosity has been specified at cmd line we will use that */
-        if (cmdline_verbosity <= 0) {
-            cfg->verbosity = parser_conf_verbosity(cfgfile);
-        }
-        ods_fclose(cfgfd);
-        return cfg;
     }
-    ods_log_error("[%s] open cfgfile %s failed: %s", logstr, cfgfile,
-        strerror(errno));
-    return NULL;
+    return cfg;
 }
 
 
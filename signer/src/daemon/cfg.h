@@ -36,6 +36,7 @@
 
 #include "util/region.h"
 #include "util/status.h"
+#include "wire/listener.h"
 
 #include <stdio.h>
 
@@ -55,6 +56,7 @@ struct cfg_struct {
     const char* username;
     const char* group;
     const char* chroot;
+    listener_type* interfaces;
     int use_syslog;
     int num_worker_threads;
     int num_signer_threads;
@@ -37,16 +37,21 @@
 #include "util/file.h"
 #include "util/locks.h"
 #include "util/log.h"
+#include "util/str.h"
 #include "util/tree.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
@@ -56,22 +61,77 @@
 #include <sys/types.h>
 
 #define SE_CMDH_CMDLEN 7
+#define SE_CMDH_STREAMLEN (ODS_SE_MAXLINE*8)
+#define SE_CMDH_MAXARGS (ODS_SE_MAXLINE/2)
 
 #ifndef SUN_LEN
 #define SUN_LEN(su)  (sizeof(*(su)) - sizeof((su)->sun_path) + strlen((su)->sun_path))
 #endif
+#ifndef FNM_CASEFOLD
+#define FNM_CASEFOLD 0
+#endif
 
-static int count = 0;
 static char* logstr = "cmdhandler";
 
 
+/**
+ * Queue output for client. If memory runs out the output is dropped and
+ * the client is closed.
+ *
+ */
+static void
+cmdhandler_write(cmdhandler_client_type* client, const char* str, size_t n)
+{
+    char* out = NULL;
+    size_t max = 0;
+    if (client->close_after && !client->out) {
+        return; /* output dropped */
+    }
+    if (client->out_len + n > client->out_max) {
+        max = client->out_max ? client->out_max : SE_CMDH_STREAMLEN;
+        while (client->out_len + n > max) {
+            max *= 2;
+        }
+        out = (char*) realloc(client->out, max);
+        if (!out) {
+            ods_log_crit("[%s] unable to queue output for client %i: "
+                "insufficient memory", logstr, client->fd);
+            free(client->out);
+            client->out = NULL;
+            client->out_len = 0;
+            client->out_pos = 0;
+            client->out_max = 0;
+            client->close_after = 1;
+            return;
+        }
+        client->out = out;
+        client->out_max = max;
+    }
+    memcpy(client->out + client->out_len, str, n);
+    client->out_len += n;
+    return;
+}
+
+
+/**
+ * Queue string for client.
+ *
+ */
+static void
+cmdhandler_print(cmdhandler_client_type* client, const char* str)
+{
+    cmdhandler_write(client, str, strlen(str));
+    return;
+}
+
+
 /**
  * Handle the 'help' command.
  *
  */
 static int
-cmdhandler_handle_cmd_help(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_help(cmdhandler_client_type* client,
+    cmdhandler_type* ATTR_UNUSED(cmdc), const char* cmd, ssize_t n)
 {
     char buf[ODS_SE_MAXLINE];
     if (n != 4 || strncmp(cmd, "help", n) != 0) {
@@ -87,8 +147,12 @@ cmdhandler_handle_cmd_help(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
         "                All signatures will be regenerated on the next "
                          "re-sign.\n"
         "queue           Show the current task queue.\n"
+        "stats [<zone>]  Show the signer statistics of all or some zones.\n"
+        "                Where a <zone> is expected, a list of zone names "
+                         "or glob\n"
+        "                patterns may be given, e.g. 'sign a.nl b.nl *.be'.\n"
     );
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
 
     (void) snprintf(buf, ODS_SE_MAXLINE,
         "flush           Execute all scheduled tasks immediately.\n"
@@ -100,7 +164,7 @@ cmdhandler_handle_cmd_help(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
         "stop            Stop the engine.\n"
         "verbosity <nr>  Set verbosity.\n"
     );
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -110,12 +174,11 @@ cmdhandler_handle_cmd_help(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
  *
  */
 static int
-cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_zones(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
-    size_t i;
     tree_node* node = TREE_NULL;
     zone_type* zone = NULL;
     if (n != 5 || strncmp(cmd, "zones", n) != 0) {
@@ -126,23 +189,20 @@ cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc,
     engine = (engine_type*) cmdc->engine;
     if (!engine->zlist || !engine->zlist->zones) {
         (void)snprintf(buf, ODS_SE_MAXLINE, "I have no zones configured\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
         return 1;
     }
     /* how many zones */
     lock_basic_lock(&engine->zlist->zl_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, "I have %d zones configured\n",
         (int)tree_count(engine->zlist->zones));
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     /* list zones */
     node = tree_first(engine->zlist->zones);
     while (node && node != TREE_NULL) {
         zone = (zone_type*) node->data;
-        for (i=0; i < ODS_SE_MAXLINE; i++) {
-            buf[i] = 0;
-        }
         (void)snprintf(buf, ODS_SE_MAXLINE, "- %s\n", zone->name);
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
         node = tree_next(node);
     }
     lock_basic_unlock(&engine->zlist->zl_lock);
@@ -150,13 +210,202 @@ cmdhandler_handle_cmd_zones(int sockfd, cmdhandler_type* cmdc,
 }
 
 
+/**
+ * Split zone arguments: zone names or glob patterns, separated by white
+ * space or commas.
+ *
+ */
+static size_t
+cmdhandler_zone_args(char* str, char** args)
+{
+    size_t nargs = 0;
+    size_t len;
+    char* tok;
+    char* save = NULL;
+    for (tok = strtok_r(str, " \t,", &save); tok && nargs < SE_CMDH_MAXARGS;
+        tok = strtok_r(NULL, " \t,", &save)) {
+        len = strlen(tok);
+        if (len > 1 && tok[len-1] == '.') {
+            tok[len-1] = '\0';
+        }
+        args[nargs++] = tok;
+    }
+    return nargs;
+}
+
+
+/**
+ * Does the zone match one of the zone arguments?
+ *
+ */
+static int
+cmdhandler_zone_match(const char* name, char** args, size_t nargs,
+    size_t* hits)
+{
+    int match = 0;
+    size_t i;
+    for (i=0; i < nargs; i++) {
+        if (ods_strcmp(args[i], "--all") == 0 ||
+            ods_strcasecmp(args[i], name) == 0 ||
+            (strpbrk(args[i], "*?[") &&
+             fnmatch(args[i], name, FNM_CASEFOLD) == 0)) {
+            hits[i]++;
+            match = 1;
+        }
+    }
+    return match;
+}
+
+
+/**
+ * Clear or reschedule all zones that match the zone arguments. The zone
+ * list and the schedule are each locked once for the whole set.
+ *
+ */
+static void
+cmdhandler_handle_zones(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* str, const char* cmdname,
+    task_id what, int clear)
+{
+    engine_type* engine = NULL;
+    char buf[ODS_SE_MAXLINE];
+    char argbuf[ODS_SE_MAXLINE];
+    char* args[SE_CMDH_MAXARGS];
+    size_t hits[SE_CMDH_MAXARGS];
+    zone_type** zones = NULL;
+    zone_type* zone = NULL;
+    tree_node* node = TREE_NULL;
+    size_t nargs = 0;
+    size_t nzones = 0;
+    size_t pending = 0;
+    size_t failed = 0;
+    size_t i, j;
+    int walk = 0;
+    ods_log_assert(cmdc);
+    ods_log_assert(cmdc->engine);
+    engine = (engine_type*) cmdc->engine;
+    (void)strlcpy(argbuf, str, sizeof(argbuf));
+    nargs = cmdhandler_zone_args(argbuf, args);
+    if (nargs == 0) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Error: %s command missing an "
+            "argument (zone name, pattern or --all).\n", cmdname);
+        cmdhandler_print(client, buf);
+        return;
+    }
+    memset(hits, 0, sizeof(hits));
+    for (i=0; i < nargs; i++) {
+        if (ods_strcmp(args[i], "--all") == 0 || strpbrk(args[i], "*?[")) {
+            walk = 1;
+        }
+    }
+    lock_basic_lock(&engine->zlist->zl_lock);
+    if (engine->zlist->zones && tree_count(engine->zlist->zones) > 0) {
+        zones = (zone_type**) malloc((walk ? tree_count(engine->zlist->zones)
+            : nargs) * sizeof(zone_type*));
+        if (!zones) {
+            lock_basic_unlock(&engine->zlist->zl_lock);
+            (void)snprintf(buf, ODS_SE_MAXLINE, "Error: %s command failed: "
+                "insufficient memory.\n", cmdname);
+            cmdhandler_print(client, buf);
+            return;
+        }
+        if (walk) {
+            node = tree_first(engine->zlist->zones);
+        }
+    }
+    /* only zone names: use the zone index */
+    for (i=0; zones && !walk && i < nargs; i++) {
+        zone = zlist_lookup_zone_by_name(engine->zlist, args[i],
+            LDNS_RR_CLASS_IN);
+        if (zone && zone->zl_status != ZONE_ZL_REMOVED) {
+            hits[i]++;
+            for (j=0; j < nzones && zones[j] != zone; j++) {
+                /* skip duplicates */
+            }
+            if (j == nzones) {
+                zones[nzones++] = zone;
+            }
+        }
+    }
+    /* patterns: walk the zone list once */
+    while (node && node != TREE_NULL) {
+        zone = (zone_type*) node->data;
+        if (zone->zl_status != ZONE_ZL_REMOVED &&
+            cmdhandler_zone_match(zone->name, args, nargs, hits)) {
+            zones[nzones++] = zone;
+        }
+        node = tree_next(node);
+    }
+    if (clear) {
+        /* do not wait for a busy zone, its worker clears it */
+        for (i=0; i < nzones; i++) {
+            if (lock_basic_trylock(&zones[i]->zone_lock)) {
+                zone_clear(zones[i]);
+                lock_basic_unlock(&zones[i]->zone_lock);
+            } else {
+                lock_basic_lock(&engine->taskq->s_lock);
+                zones[i]->clear_pending = 1;
+                lock_basic_unlock(&engine->taskq->s_lock);
+                pending++;
+            }
+        }
+    } else if (nzones > 0) {
+        lock_basic_lock(&engine->taskq->s_lock);
+        for (i=0; i < nzones; i++) {
+            if (!zones[i]->task || zone_reschedule_task_locked(zones[i],
+                engine->taskq, what) != ODS_STATUS_OK) {
+                ods_log_error("[%s] unable to reschedule task for zone %s",
+                    logstr, zones[i]->name);
+                failed++;
+            }
+        }
+        lock_basic_unlock(&engine->taskq->s_lock);
+    }
+    lock_basic_unlock(&engine->zlist->zl_lock);
+    free((void*) zones);
+    if (!clear && nzones > failed) {
+        engine_wakeup_workers(engine);
+    }
+    /* summary */
+    for (i=0; i < nargs; i++) {
+        if (!hits[i]) {
+            (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s not found.\n",
+                args[i]);
+            cmdhandler_print(client, buf);
+        }
+    }
+    if (clear) {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Cleared %u zone(s)",
+            (unsigned) (nzones - pending));
+        if (pending) {
+            (void)snprintf(buf + strlen(buf), ODS_SE_MAXLINE - strlen(buf),
+                ", %u busy zone(s) will be cleared before their next task",
+                (unsigned) pending);
+        }
+        (void)strlcat(buf, ", all signatures will be regenerated on the "
+            "next re-sign.\n", ODS_SE_MAXLINE);
+    } else {
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Scheduled %u zone(s) for "
+            "immediate %s", (unsigned) (nzones - failed),
+            what == TASK_CONF?"update":"re-sign");
+        if (failed) {
+            (void)snprintf(buf + strlen(buf), ODS_SE_MAXLINE - strlen(buf),
+                ", %u failed", (unsigned) failed);
+        }
+        (void)strlcat(buf, ".\n", ODS_SE_MAXLINE);
+    }
+    cmdhandler_print(client, buf);
+    return;
+}
+
+
 /**
  * Handle the 'update' command.
  *
  */
 static int
-cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_update(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -167,9 +416,17 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
     ods_log_assert(cmdc);
     ods_log_assert(cmdc->engine);
     engine = (engine_type*) cmdc->engine;
-
-    (void)snprintf(buf, ODS_SE_MAXLINE, "Update command not implemented.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    if (cmd[6] == '\0' || ods_strcmp(&cmd[7], "--all") == 0) {
+        /* also pick up zone list changes */
+        engine->need_to_reload = 1;
+        lock_basic_lock(&engine->signal_lock);
+        lock_basic_alarm(&engine->signal_cond);
+        lock_basic_unlock(&engine->signal_lock);
+        (void)snprintf(buf, ODS_SE_MAXLINE, "Zone list will be updated.\n");
+        cmdhandler_print(client, buf);
+    }
+    cmdhandler_handle_zones(client, cmdc, cmd[6]?&cmd[7]:"--all", "update",
+        TASK_CONF, 0);
     return 1;
 }
 
@@ -179,20 +436,15 @@ cmdhandler_handle_cmd_update(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_sign(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
-    engine_type* engine = NULL;
-    char buf[ODS_SE_MAXLINE];
     if (n < 4 || strncmp(cmd, "sign", 4) != 0 || cmd[4] != ' ') {
         return 0; /* no match */
     }
     ods_log_assert(cmdc);
     ods_log_assert(cmdc->engine);
-    engine = (engine_type*) cmdc->engine;
-
-    (void)snprintf(buf, ODS_SE_MAXLINE, "Sign command not implemented.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_handle_zones(client, cmdc, &cmd[5], "sign", TASK_READ, 0);
     return 1;
 }
 
@@ -202,20 +454,78 @@ cmdhandler_handle_cmd_sign(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_clear(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
+{
+    if (n < 5 || strncmp(cmd, "clear", 5) != 0 || cmd[5] != ' ') {
+        return 0; /* no match */
+    }
+    ods_log_assert(cmdc);
+    ods_log_assert(cmdc->engine);
+    cmdhandler_handle_zones(client, cmdc, &cmd[6], "clear", TASK_NONE, 1);
+    return 1;
+}
+
+
+/**
+ * Handle the 'stats' command.
+ *
+ */
+static int
+cmdhandler_handle_cmd_stats(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
-    if (n < 5 || strncmp(cmd, "clear", 5) != 0 || cmd[5] != ' ') {
+    char argbuf[ODS_SE_MAXLINE];
+    char* args[SE_CMDH_MAXARGS];
+    size_t hits[SE_CMDH_MAXARGS];
+    region_type* region = NULL;
+    zlist_stats_type* zstats = NULL;
+    size_t nzones = 0;
+    size_t nargs = 0;
+    size_t count = 0;
+    size_t i;
+    if (n < 5 || strncmp(cmd, "stats", 5) != 0 ||
+        (cmd[5] != ' ' && cmd[5] != '\0')) {
         return 0; /* no match */
     }
     ods_log_assert(cmdc);
     ods_log_assert(cmdc->engine);
     engine = (engine_type*) cmdc->engine;
-
-    (void)snprintf(buf, ODS_SE_MAXLINE, "Clear command not implemented.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    if (cmd[5] == ' ') {
+        (void)strlcpy(argbuf, &cmd[6], sizeof(argbuf));
+        nargs = cmdhandler_zone_args(argbuf, args);
+    }
+    region = region_create();
+    if (!region) {
+        cmdhandler_print(client, "Unable to collect statistics: "
+            "out of memory\n");
+        return 1;
+    }
+    /* copy under the zone list lock, print without it */
+    zstats = zlist_stats(engine->zlist, region, &nzones);
+    memset(hits, 0, sizeof(hits));
+    for (i=0; i < nzones; i++) {
+        if (nargs && !cmdhandler_zone_match(zstats[i].name, args, nargs,
+            hits)) {
+            continue;
+        }
+        stats_str(buf, ODS_SE_MAXLINE, zstats[i].name, &zstats[i].stats);
+        cmdhandler_print(client, buf);
+        count++;
+    }
+    region_cleanup(region);
+    for (i=0; i < nargs; i++) {
+        if (!hits[i]) {
+            (void)snprintf(buf, ODS_SE_MAXLINE, "Zone %s not found.\n",
+                args[i]);
+            cmdhandler_print(client, buf);
+        }
+    }
+    if (!count && !nargs) {
+        cmdhandler_print(client, "I have no zones configured\n");
+    }
     return 1;
 }
 
@@ -225,8 +535,8 @@ cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_queue(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char* strtime = NULL;
@@ -242,7 +552,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc,
     engine = (engine_type*) cmdc->engine;
     if (!engine->taskq || !engine->taskq->tasks) {
         (void)snprintf(buf, ODS_SE_MAXLINE, "I have no tasks scheduled.\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
         return 1;
     }
     /* current time */
@@ -250,7 +560,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc,
     strtime = ctime(&now);
     (void)snprintf(buf, ODS_SE_MAXLINE, "It is now %s",
         strtime?strtime:"(null)");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     /* current work */
     lock_basic_lock(&engine->taskq->s_lock);
     for (i=0; i < (size_t) engine->cfg->num_worker_threads; i++) {
@@ -259,22 +569,20 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc,
                 "zone %s\n",
                 task_what2str(engine->workers[i]->working_with),
                 task_who2str(engine->workers[i]->task));
-            ods_writen(sockfd, buf, strlen(buf));
+            cmdhandler_print(client, buf);
         }
     }
     /* how many tasks */
     (void)snprintf(buf, ODS_SE_MAXLINE, "\nI have %i tasks scheduled.\n",
         (int)tree_count(engine->taskq->tasks));
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     /* list tasks */
     node = tree_first(engine->taskq->tasks);
     while (node && node != TREE_NULL) {
         task_type* task = (task_type*) node->data;
-        for (i=0; i < ODS_SE_MAXLINE; i++) {
-            buf[i] = 0;
-        }
+        buf[0] = '\0';
         (void)task2str(task, (char*) &buf[0]);
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
         node = tree_next(node);
     }
     lock_basic_unlock(&engine->taskq->s_lock);
@@ -287,8 +595,8 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_flush(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -300,7 +608,7 @@ cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc,
     engine = (engine_type*) cmdc->engine;
 
     (void)snprintf(buf, ODS_SE_MAXLINE, "Flush command not implemented.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -310,8 +618,8 @@ cmdhandler_handle_cmd_flush(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_reload(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -326,7 +634,7 @@ cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc,
     lock_basic_alarm(&engine->signal_cond);
     lock_basic_unlock(&engine->signal_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, "Reload signer engine.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -336,8 +644,8 @@ cmdhandler_handle_cmd_reload(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_stop(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     engine_type* engine = NULL;
     char buf[ODS_SE_MAXLINE];
@@ -352,7 +660,7 @@ cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc,
     lock_basic_alarm(&engine->signal_cond);
     lock_basic_unlock(&engine->signal_lock);
     (void)snprintf(buf, ODS_SE_MAXLINE, "Signer engine shut down.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -362,15 +670,15 @@ cmdhandler_handle_cmd_stop(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_start(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_start(cmdhandler_client_type* client,
+    cmdhandler_type* ATTR_UNUSED(cmdc), const char* cmd, ssize_t n)
 {
     char buf[ODS_SE_MAXLINE];
     if (n != 5 || strncmp(cmd, "start", 5) != 0) {
         return 0; /* no match */
     }
     (void)snprintf(buf, ODS_SE_MAXLINE, "Signer engine already running.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -380,15 +688,15 @@ cmdhandler_handle_cmd_start(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
  *
  */
 static int
-cmdhandler_handle_cmd_running(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_running(cmdhandler_client_type* client,
+    cmdhandler_type* ATTR_UNUSED(cmdc), const char* cmd, ssize_t n)
 {
     char buf[ODS_SE_MAXLINE];
     if (n != 7 || strncmp(cmd, "running", 7) != 0) {
         return 0; /* no match */
     }
     (void)snprintf(buf, ODS_SE_MAXLINE, "Signer engine is running.\n");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -398,8 +706,8 @@ cmdhandler_handle_cmd_running(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
  *
  */
 static int
-cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc,
-    const char* cmd, ssize_t n)
+cmdhandler_handle_cmd_verbosity(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc, const char* cmd, ssize_t n)
 {
     char buf[ODS_SE_MAXLINE];
     if (n < 9 || strncmp(cmd, "verbosity", 9) != 0 || cmd[9] != ' ') {
@@ -410,18 +718,13 @@ cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc,
     if (cmd[9] == '\0') {
         (void)snprintf(buf, ODS_SE_MAXLINE, "Error: verbosity command missing "
             "an argument (verbosity level).\n");
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
     } else {
-        engine_type* engine = (engine_type*) cmdc->engine;
         int val = atoi(&cmd[10]);
-        engine = (engine_type*) cmdc->engine;
-        ods_log_assert(engine);
-        ods_log_assert(engine->cfg);
-        ods_log_init(engine->cfg->log_filename,
-                     engine->cfg->use_syslog, val);
+        ods_log_set_verbosity(val);
         (void)snprintf(buf, ODS_SE_MAXLINE, "Verbosity level set to %i.\n",
             val);
-        ods_writen(sockfd, buf, strlen(buf));
+        cmdhandler_print(client, buf);
     }
     return 1;
 }
@@ -432,13 +735,13 @@ cmdhandler_handle_cmd_verbosity(int sockfd, cmdhandler_type* cmdc,
  *
  */
 static int
-cmdhandler_handle_cmd_unknown(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
-    const char* cmd, ssize_t ATTR_UNUSED(n))
+cmdhandler_handle_cmd_unknown(cmdhandler_client_type* client,
+    cmdhandler_type* ATTR_UNUSED(cmdc), const char* cmd, ssize_t ATTR_UNUSED(n))
 {
     char buf[ODS_SE_MAXLINE];
     (void)snprintf(buf, ODS_SE_MAXLINE, "Unknown command: %s.\n",
         cmd?cmd:"(null)");
-    ods_writen(sockfd, buf, strlen(buf));
+    cmdhandler_print(client, buf);
     return 1;
 }
 
@@ -448,16 +751,17 @@ cmdhandler_handle_cmd_unknown(int sockfd, cmdhandler_type* ATTR_UNUSED(cmdc),
  *
  */
 static void
-cmdhandler_handle_cmd(int sockfd, cmdhandler_type* cmdc, const char* buf,
-    ssize_t n)
+cmdhandler_handle_cmd(cmdhandler_client_type* client, cmdhandler_type* cmdc,
+    const char* buf, ssize_t n)
 {
     cmdhandler_handle_cmd_func cmds[] = {
         cmdhandler_handle_cmd_help,
         cmdhandler_handle_cmd_zones, /* notimpl */
-        cmdhandler_handle_cmd_update, /* notimpl */
-        cmdhandler_handle_cmd_sign, /* notimpl */
-        cmdhandler_handle_cmd_clear, /* notimpl */
+        cmdhandler_handle_cmd_update,
+        cmdhandler_handle_cmd_sign,
+        cmdhandler_handle_cmd_clear,
         cmdhandler_handle_cmd_queue, /* notimpl */
+        cmdhandler_handle_cmd_stats,
         cmdhandler_handle_cmd_flush, /* notimpl */
         cmdhandler_handle_cmd_stop,
         cmdhandler_handle_cmd_start,
@@ -470,7 +774,7 @@ cmdhandler_handle_cmd(int sockfd, cmdhandler_type* cmdc, const char* buf,
     int ret;
     ods_log_verbose("[%s] received command %s[%i]", logstr, buf, n);
     for (i=0; i < sizeof(cmds) / sizeof(cmdhandler_handle_cmd_func); i++) {
-        if ((ret = cmds[i](sockfd, cmdc, buf, n))) {
+        if ((ret = cmds[i](client, cmdc, buf, n))) {
             break;
         }
     }
@@ -480,36 +784,212 @@ cmdhandler_handle_cmd(int sockfd, cmdhandler_type* cmdc, const char* buf,
 
 
 /**
- * Handle client conversation.
+ * Close client connection.
  *
  */
 static void
-cmdhandler_handle_conversation(cmdhandler_type* cmdc)
+cmdhandler_client_close(cmdhandler_type* cmdhandler,
+    cmdhandler_client_type* client)
+{
+    ods_log_debug("[%s] close client %i", logstr, client->fd);
+#ifdef HAVE_SYS_EPOLL_H
+    (void)epoll_ctl(cmdhandler->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+#endif
+    shutdown(client->fd, SHUT_RDWR);
+    close(client->fd);
+    free(client->out);
+    client->out = NULL;
+    client->out_len = 0;
+    client->out_pos = 0;
+    client->out_max = 0;
+    client->want_out = 0;
+    client->close_after = 0;
+    client->fd = -1;
+    client->len = 0;
+    return;
+}
+
+
+/**
+ * Wait for the client socket to become readable, or writable if there is
+ * output queued.
+ *
+ */
+static void
+cmdhandler_client_want(cmdhandler_type* cmdhandler,
+    cmdhandler_client_type* client, int out)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+    if (client->want_out == (out?1:0)) {
+        return;
+    }
+    client->want_out = (out?1:0);
+#ifdef HAVE_SYS_EPOLL_H
+    memset(&ev, 0, sizeof(ev));
+    ev.events = out?EPOLLOUT:EPOLLIN;
+    ev.data.ptr = client;
+    if (epoll_ctl(cmdhandler->epoll_fd, EPOLL_CTL_MOD, client->fd,
+        &ev) != 0) {
+        ods_log_error("[%s] epoll_ctl() error: %s", logstr, strerror(errno));
+    }
+#endif
+    return;
+}
+
+
+/**
+ * Send queued output without blocking.
+ * Returns 0 if all is sent, 1 if output is still queued, -1 on error.
+ *
+ */
+static int
+cmdhandler_client_flush(cmdhandler_client_type* client)
 {
     ssize_t n;
-    int sockfd;
-    char buf[ODS_SE_MAXLINE];
-    ods_log_assert(cmdc);
-    sockfd = cmdc->client_fd;
+    while (client->out_pos < client->out_len) {
+        n = write(client->fd, client->out + client->out_pos,
+            client->out_len - client->out_pos);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            if (errno != EPIPE && errno != ECONNRESET) {
+                ods_log_error("[%s] write error: %s", logstr,
+                    strerror(errno));
+            }
+            return -1;
+        }
+        client->out_pos += n;
+    }
+    client->out_len = 0;
+    client->out_pos = 0;
+    if (client->out_max > SE_CMDH_STREAMLEN) {
+        /* do not keep a large buffer around */
+        free(client->out);
+        client->out = NULL;
+        client->out_max = 0;
+    }
+    return 0;
+}
 
-cmdhandler_handle_conversation:
-    n = read(sockfd, buf, ODS_SE_MAXLINE);
-    if (n <= 0) {
-        if (n == 0 || errno == ECONNRESET) {
-            ods_log_debug("[%s] done handling client: %s", logstr,
-                strerror(errno));
-        } else if (errno == EINTR || errno == EWOULDBLOCK ||
-            errno == EAGAIN) {
-            goto cmdhandler_handle_conversation;
-        } else {
-            ods_log_error("[%s] read error: %s", logstr, strerror(errno));
+
+/**
+ * Handle every complete command in the client buffer, until output has
+ * to wait for the client.
+ *
+ */
+static void
+cmdhandler_client_run(cmdhandler_type* cmdhandler,
+    cmdhandler_client_type* client)
+{
+    ssize_t n;
+    size_t i;
+    size_t start = 0;
+    int ret = 0;
+    char term;
+    char* line;
+    for (i=0; i < client->len && ret == 0; i++) {
+        if (client->buf[i] != '\n' && client->buf[i] != '\0') {
+            continue;
         }
-    } else {
-        buf[--n] = '\0';
+        term = client->buf[i];
+        client->buf[i] = '\0';
+        line = &client->buf[start];
+        n = (ssize_t) (i - start);
+        if (n > 0 && line[n-1] == '\r') {
+            line[--n] = '\0';
+        }
+        start = i+1;
         if (n > 0) {
-            cmdhandler_handle_cmd(sockfd, cmdc, buf, n);
-            /*goto cmdhandler_handle_conversation;*/
+            cmdhandler_handle_cmd(client, cmdhandler, line, n);
         }
+        if (term == '\0') {
+            /* one shot client */
+            client->close_after = 1;
+        } else if (n > 0) {
+            cmdhandler_write(client, "", 1);
+        }
+        ret = client->close_after ? 1 : cmdhandler_client_flush(client);
+    }
+    if (start > 0) {
+        memmove(client->buf, client->buf + start, client->len - start);
+        client->len -= start;
+    }
+    if (client->close_after) {
+        ret = cmdhandler_client_flush(client);
+        if (ret == 0) {
+            ret = -1;
+        }
+    } else if (ret == 0 && client->len == ODS_SE_MAXLINE) {
+        ods_log_error("[%s] client %i command too long", logstr, client->fd);
+        ret = -1;
+    }
+    if (ret < 0) {
+        cmdhandler_client_close(cmdhandler, client);
+        return;
+    }
+    cmdhandler_client_want(cmdhandler, client, ret);
+    return;
+}
+
+
+/**
+ * Handle client input.
+ *
+ */
+static void
+cmdhandler_client_read(cmdhandler_type* cmdhandler,
+    cmdhandler_client_type* client)
+{
+    ssize_t n;
+    if (client->fd < 0) {
+        return; /* closed earlier in this round */
+    }
+    n = read(client->fd, client->buf + client->len,
+        ODS_SE_MAXLINE - client->len);
+    if (n <= 0) {
+        if (n < 0 && (errno == EINTR || errno == EWOULDBLOCK ||
+            errno == EAGAIN)) {
+            return;
+        }
+        if (n < 0 && errno != ECONNRESET) {
+            ods_log_error("[%s] read error: %s", logstr, strerror(errno));
+        }
+        cmdhandler_client_close(cmdhandler, client);
+        return;
+    }
+    client->len += n;
+    cmdhandler_client_run(cmdhandler, client);
+    return;
+}
+
+
+/**
+ * Client is writable: send queued output, then handle the commands that
+ * waited for it.
+ *
+ */
+static void
+cmdhandler_client_write(cmdhandler_type* cmdhandler,
+    cmdhandler_client_type* client)
+{
+    int ret;
+    if (client->fd < 0) {
+        return; /* closed earlier in this round */
+    }
+    ret = cmdhandler_client_flush(client);
+    if (ret == 0 && client->close_after) {
+        ret = -1;
+    }
+    if (ret < 0) {
+        cmdhandler_client_close(cmdhandler, client);
+    } else if (ret == 0) {
+        cmdhandler_client_run(cmdhandler, client);
     }
     return;
 }
@@ -519,20 +999,59 @@ cmdhandler_handle_conversation:
  * Accept client.
  *
  */
-static void*
-cmdhandler_accept_client(void* arg)
+static void
+cmdhandler_accept_client(cmdhandler_type* cmdhandler)
 {
-    cmdhandler_type* cmdc = (cmdhandler_type*) arg;
-    ods_thread_blocksigs();
-    ods_thread_detach(cmdc->thread_id);
-    ods_log_debug("[%s] accept client %i", logstr, cmdc->client_fd);
-    cmdhandler_handle_conversation(cmdc);
-    if (cmdc->client_fd) {
-        shutdown(cmdc->client_fd, SHUT_RDWR);
-        close(cmdc->client_fd);
-    }
-    count--;
-    return NULL;
+    struct sockaddr_un cliaddr;
+    socklen_t clilen = sizeof(cliaddr);
+    cmdhandler_client_type* client = NULL;
+    int connfd;
+    int flags;
+    size_t i;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
+    connfd = accept(cmdhandler->listen_fd, (struct sockaddr *) &cliaddr,
+        &clilen);
+    if (connfd < 0) {
+        if (errno != EINTR && errno != EWOULDBLOCK) {
+            ods_log_warning("[%s] accept() error: %s", logstr,
+                strerror(errno));
+        }
+        return;
+    }
+    for (i=0; i < ODS_SE_MAX_CLIENTS; i++) {
+        if (cmdhandler->clients[i].fd < 0) {
+            client = &cmdhandler->clients[i];
+            break;
+        }
+    }
+    if (!client) {
+        ods_log_warning("[%s] too many clients, refusing client", logstr);
+        close(connfd);
+        return;
+    }
+    /* a stuck client must not block the command handler */
+    flags = fcntl(connfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(connfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ods_log_error("[%s] set fcntl failed: %s", logstr, strerror(errno));
+        close(connfd);
+        return;
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = client;
+    if (epoll_ctl(cmdhandler->epoll_fd, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+        ods_log_error("[%s] epoll_ctl() error: %s", logstr, strerror(errno));
+        close(connfd);
+        return;
+    }
+#endif
+    client->fd = connfd;
+    client->len = 0;
+    ods_log_debug("[%s] accept client %i", logstr, connfd);
+    return;
 }
 
 
@@ -548,6 +1067,10 @@ cmdhandler_create(region_type* r, const char* filename)
     int listenfd = 0;
     int flags = 0;
     int ret = 0;
+    size_t i;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev;
+#endif
     ods_log_assert(r);
     ods_log_assert(filename);
     /* new socket */
@@ -596,8 +1119,38 @@ cmdhandler_create(region_type* r, const char* filename)
     }
     /* all ok */
     cmdh = (cmdhandler_type*) region_alloc(r, sizeof(cmdhandler_type));
+    cmdh->clients = (cmdhandler_client_type*) region_alloc(r,
+        ODS_SE_MAX_CLIENTS * sizeof(cmdhandler_client_type));
+    for (i=0; i < ODS_SE_MAX_CLIENTS; i++) {
+        cmdh->clients[i].fd = -1;
+        cmdh->clients[i].len = 0;
+        cmdh->clients[i].out = NULL;
+        cmdh->clients[i].out_len = 0;
+        cmdh->clients[i].out_pos = 0;
+        cmdh->clients[i].out_max = 0;
+        cmdh->clients[i].want_out = 0;
+        cmdh->clients[i].close_after = 0;
+    }
     cmdh->listen_fd = listenfd;
     cmdh->listen_addr = servaddr;
+    cmdh->epoll_fd = -1;
+#ifdef HAVE_SYS_EPOLL_H
+    cmdh->epoll_fd = epoll_create(ODS_SE_MAX_CLIENTS + 1);
+    if (cmdh->epoll_fd < 0) {
+        ods_log_crit("[%s] epoll_create failed: %s", logstr, strerror(errno));
+        close(listenfd);
+        return NULL;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; /* listening socket */
+    if (epoll_ctl(cmdh->epoll_fd, EPOLL_CTL_ADD, listenfd, &ev) != 0) {
+        ods_log_crit("[%s] epoll_ctl failed: %s", logstr, strerror(errno));
+        close(cmdh->epoll_fd);
+        close(listenfd);
+        return NULL;
+    }
+#endif
     cmdh->need_to_exit = 0;
     return cmdh;
 }
@@ -610,23 +1163,59 @@ cmdhandler_create(region_type* r, const char* filename)
 void
 cmdhandler_start(cmdhandler_type* cmdhandler)
 {
-    struct sockaddr_un cliaddr;
-    socklen_t clilen;
-    cmdhandler_type* cmdc = NULL;
     engine_type* engine = NULL;
-    fd_set rset;
-    int connfd = 0;
+    cmdhandler_client_type* client = NULL;
+    size_t i;
     int ret = 0;
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event events[ODS_SE_MAX_CLIENTS + 1];
+    int j;
+#else
+    fd_set rset;
+    fd_set wset;
+    int maxfd;
+#endif
     ods_log_assert(cmdhandler);
     ods_log_assert(cmdhandler->engine);
     ods_log_debug("[%s] start", logstr);
     engine = (engine_type*) cmdhandler->engine;
     ods_thread_detach(cmdhandler->thread_id);
-    FD_ZERO(&rset);
     while (cmdhandler->need_to_exit == 0) {
-        clilen = sizeof(cliaddr);
+#ifdef HAVE_SYS_EPOLL_H
+        ret = epoll_wait(cmdhandler->epoll_fd, events,
+            ODS_SE_MAX_CLIENTS + 1, -1);
+        if (ret < 0) {
+            if (errno != EINTR) {
+                ods_log_warning("[%s] epoll_wait() error: %s", logstr,
+                   strerror(errno));
+            }
+            continue;
+        }
+        for (j=0; j < ret && !cmdhandler->need_to_exit; j++) {
+            client = (cmdhandler_client_type*) events[j].data.ptr;
+            if (!client) {
+                cmdhandler_accept_client(cmdhandler);
+            } else if (client->want_out) {
+                cmdhandler_client_write(cmdhandler, client);
+            } else {
+                cmdhandler_client_read(cmdhandler, client);
+            }
+        }
+#else
+        FD_ZERO(&rset);
+        FD_ZERO(&wset);
         FD_SET(cmdhandler->listen_fd, &rset);
-        ret = select(cmdhandler->listen_fd+1, &rset, NULL, NULL, NULL);
+        maxfd = cmdhandler->listen_fd;
+        for (i=0; i < ODS_SE_MAX_CLIENTS; i++) {
+            client = &cmdhandler->clients[i];
+            if (client->fd >= 0) {
+                FD_SET(client->fd, client->want_out ? &wset : &rset);
+                if (client->fd > maxfd) {
+                    maxfd = client->fd;
+                }
+            }
+        }
+        ret = select(maxfd+1, &rset, &wset, NULL, NULL);
         if (ret < 0) {
             if (errno != EINTR && errno != EWOULDBLOCK) {
                 ods_log_warning("[%s] select() error: %s", logstr,
@@ -634,28 +1223,28 @@ cmdhandler_start(cmdhandler_type* cmdhandler)
             }
             continue;
         }
-        if (FD_ISSET(cmdhandler->listen_fd, &rset)) {
-            connfd = accept(cmdhandler->listen_fd,
-                (struct sockaddr *) &cliaddr, &clilen);
-            if (connfd < 0) {
-                if (errno != EINTR && errno != EWOULDBLOCK) {
-                    ods_log_warning("[%s] accept() error: %s", logstr,
-                        strerror(errno));
-                }
+        for (i=0; i < ODS_SE_MAX_CLIENTS && !cmdhandler->need_to_exit; i++) {
+            client = &cmdhandler->clients[i];
+            if (client->fd < 0) {
                 continue;
             }
-            /* client accepted, create new thread */
-            cmdc = (cmdhandler_type*) region_alloc(engine->region,
-                sizeof(cmdhandler_type));
-            cmdc->listen_fd = cmdhandler->listen_fd;
-            cmdc->client_fd = connfd;
-            cmdc->listen_addr = cmdhandler->listen_addr;
-            cmdc->engine = cmdhandler->engine;
-            cmdc->need_to_exit = cmdhandler->need_to_exit;
-            ods_thread_create(&cmdc->thread_id, &cmdhandler_accept_client,
-                (void*) cmdc);
-            count++;
-            ods_log_debug("[%s] %i clients in progress...", logstr, count);
+            if (client->want_out && FD_ISSET(client->fd, &wset)) {
+                cmdhandler_client_write(cmdhandler, client);
+            } else if (!client->want_out && FD_ISSET(client->fd, &rset)) {
+                cmdhandler_client_read(cmdhandler, client);
+            }
+        }
+        if (FD_ISSET(cmdhandler->listen_fd, &rset)) {
+            cmdhandler_accept_client(cmdhandler);
+        }
+#endif
+    }
+    for (i=0; i < ODS_SE_MAX_CLIENTS; i++) {
+        client = &cmdhandler->clients[i];
+        if (client->fd >= 0) {
+            /* last try for queued output, such as the reply to stop */
+            (void)cmdhandler_client_flush(client);
+            cmdhandler_client_close(cmdhandler, client);
         }
     }
     ods_log_debug("[%s] done", logstr);
@@ -676,6 +1265,9 @@ cmdhandler_cleanup(cmdhandler_type* cmdhandler)
         return;
     }
     close(cmdhandler->listen_fd);
+    if (cmdhandler->epoll_fd >= 0) {
+        close(cmdhandler->epoll_fd);
+    }
     return;
 }
 
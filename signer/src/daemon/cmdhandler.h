@@ -42,21 +42,49 @@
 struct engine_struct;
 
 #define ODS_SE_MAX_HANDLERS 5
+#define ODS_SE_MAX_CLIENTS 64
+#define ODS_SE_CMD_TIMEOUT 10
+
+/**
+ * Client connection. Commands are newline-delimited and may be pipelined;
+ * the connection stays open and every response ends with a NUL byte.
+ * A command terminated with a NUL byte gets its response and the
+ * connection is closed.
+ *
+ * Responses are queued in out and sent when the socket is writable, so
+ * no lock is held and no other client waits while a client is slow to
+ * read. The next command is only handled once the queue is empty.
+ *
+ */
+typedef struct cmdhandler_client_struct cmdhandler_client_type;
+struct cmdhandler_client_struct {
+    int fd;
+    size_t len;
+    char buf[ODS_SE_MAXLINE];
+    char* out;
+    size_t out_len;
+    size_t out_pos;
+    size_t out_max;
+    unsigned want_out : 1;
+    unsigned close_after : 1;
+};
 
 typedef struct cmdhandler_struct cmdhandler_type;
 struct cmdhandler_struct {
     struct engine_struct* engine;
     struct sockaddr_un listen_addr;
     ods_thread_type thread_id;
+    cmdhandler_client_type* clients;
     int listen_fd;
-    int client_fd;
+    int epoll_fd;
     int need_to_exit;
 
-    /* 1x ptr, 1x struct, 4x int */
-    /* est.mem: CMD: 128 bytes */
+    /* 2x ptr, 1x struct, 4x int */
+    /* est.mem: CMD: 128 bytes + 64*CL */
 };
 
-typedef int (*cmdhandler_handle_cmd_func)(int sockfd, cmdhandler_type* cmdc,
+typedef int (*cmdhandler_handle_cmd_func)(cmdhandler_client_type* client,
+    cmdhandler_type* cmdc,
     const char* cmd, ssize_t n);
 
 /**
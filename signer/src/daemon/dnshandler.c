@@ -0,0 +1,824 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * DNS handler.
+ *
+ */
+
+#include "config.h"
+#include "daemon/dnshandler.h"
+#include "daemon/engine.h"
+#include "dns/dns.h"
+#include "dns/rr.h"
+#include "dns/wf.h"
+#include "signer/journal.h"
+#include "signer/zlist.h"
+#include "signer/zone.h"
+#include "util/file.h"
+#include "util/log.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static const char* logstr = "dnshandler";
+
+
+/**
+ * Create dns handler.
+ *
+ */
+dnshandler_type*
+dnshandler_create(region_type* r, listener_type* interfaces)
+{
+    dnshandler_type* dnshandler;
+    ods_log_assert(r);
+    ods_log_assert(interfaces);
+    dnshandler = (dnshandler_type*) region_alloc(r, sizeof(dnshandler_type));
+    dnshandler->engine = NULL;
+    dnshandler->interfaces = interfaces;
+    dnshandler->num_clients = 0;
+    dnshandler->need_to_exit = 0;
+    lock_basic_init(&dnshandler->client_lock);
+    return dnshandler;
+}
+
+
+/**
+ * Open the listening sockets.
+ *
+ */
+ods_status
+dnshandler_listen(dnshandler_type* dnshandler)
+{
+    struct addrinfo hints;
+    struct addrinfo* res = NULL;
+    interface_type* ifs = NULL;
+    size_t i = 0;
+    int on = 1;
+    int ret = 0;
+    ods_log_assert(dnshandler);
+    ods_log_assert(dnshandler->interfaces);
+    for (i=0; i < dnshandler->interfaces->count; i++) {
+        ifs = &dnshandler->interfaces->interfaces[i];
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        ret = getaddrinfo(ifs->address, ifs->port, &hints, &res);
+        if (ret != 0) {
+            ods_log_error("[%s] getaddrinfo(%s, %s) failed: %s", logstr,
+                ifs->address?ifs->address:"*", ifs->port, gai_strerror(ret));
+            return ODS_STATUS_SOCKERR;
+        }
+        ifs->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (ifs->fd < 0) {
+            ods_log_error("[%s] socket() failed: %s", logstr,
+                strerror(errno));
+            freeaddrinfo(res);
+            return ODS_STATUS_SOCKERR;
+        }
+        if (setsockopt(ifs->fd, SOL_SOCKET, SO_REUSEADDR, &on,
+            sizeof(on)) < 0) {
+            ods_log_warning("[%s] setsockopt(SO_REUSEADDR) failed: %s",
+                logstr, strerror(errno));
+        }
+#ifdef IPV6_V6ONLY
+        if (res->ai_family == AF_INET6 && setsockopt(ifs->fd, IPPROTO_IPV6,
+            IPV6_V6ONLY, &on, sizeof(on)) < 0) {
+            ods_log_warning("[%s] setsockopt(IPV6_V6ONLY) failed: %s",
+                logstr, strerror(errno));
+        }
+#endif /* IPV6_V6ONLY */
+        if (bind(ifs->fd, res->ai_addr, res->ai_addrlen) != 0) {
+            ods_log_error("[%s] bind() to %s port %s failed: %s", logstr,
+                ifs->address?ifs->address:"*", ifs->port, strerror(errno));
+            freeaddrinfo(res);
+            return ODS_STATUS_SOCKERR;
+        }
+        freeaddrinfo(res);
+        res = NULL;
+        if (listen(ifs->fd, DNS_TCP_BACKLOG) != 0) {
+            ods_log_error("[%s] listen() failed: %s", logstr,
+                strerror(errno));
+            return ODS_STATUS_SOCKERR;
+        }
+        ods_log_verbose("[%s] listening on %s port %s", logstr,
+            ifs->address?ifs->address:"*", ifs->port);
+    }
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Read exactly n bytes from file descriptor.
+ *
+ */
+static ssize_t
+dnshandler_readn(int fd, void* vptr, size_t n)
+{
+    size_t nleft = n;
+    ssize_t nread;
+    char* ptr = vptr;
+    while (nleft > 0) {
+        if ((nread = read(fd, ptr, nleft)) < 0) {
+            if (errno == EINTR) {
+                nread = 0; /* and call read again */
+            } else {
+                return -1; /* error or timeout */
+            }
+        } else if (nread == 0) {
+            return -1; /* connection closed */
+        }
+        nleft -= nread;
+        ptr += nread;
+    }
+    return n;
+}
+
+
+/**
+ * Prepare an answer message for the query. Copies the query header and
+ * the first qend bytes of the query (the question section, if any).
+ *
+ */
+static void
+dnshandler_answer_start(dnshandler_client_type* client, size_t qend)
+{
+    buffer_type* answer = client->answer;
+    buffer_clear(answer);
+    buffer_set_limit(answer, MAX_PACKET_SIZE);
+    buffer_write(answer, buffer_begin(client->query), qend);
+    buffer_pkt_set_qr(answer);
+    buffer_pkt_set_aa(answer);
+    TC_CLR(answer);
+    RA_CLR(answer);
+    AD_CLR(answer);
+    RCODE_SET(answer, DNS_RCODE_NOERROR);
+    buffer_pkt_set_qdcount(answer, qend > BUFFER_PKT_HEADER_SIZE ? 1 : 0);
+    buffer_pkt_set_ancount(answer, 0);
+    buffer_pkt_set_nscount(answer, 0);
+    buffer_pkt_set_arcount(answer, 0);
+    return;
+}
+
+
+/**
+ * Queue the answer message, it is sent by dnshandler_answer_flush().
+ *
+ */
+static int
+dnshandler_answer_send(dnshandler_client_type* client, uint16_t ancount)
+{
+    buffer_type* answer = client->answer;
+    dnshandler_msg_type* msg = NULL;
+    buffer_pkt_set_ancount(answer, ancount);
+    msg = (dnshandler_msg_type*) region_alloc(client->msg_region,
+        sizeof(dnshandler_msg_type));
+    if (!msg) {
+        return -1;
+    }
+    msg->len = buffer_position(answer);
+    msg->data = (uint8_t*) region_alloc_init(client->msg_region,
+        buffer_begin(answer), msg->len);
+    if (!msg->data) {
+        return -1;
+    }
+    msg->next = NULL;
+    if (client->msgs_last) {
+        client->msgs_last->next = msg;
+    } else {
+        client->msgs = msg;
+    }
+    client->msgs_last = msg;
+    return 0;
+}
+
+
+/**
+ * Drop the queued answer messages.
+ *
+ */
+static void
+dnshandler_answer_drop(dnshandler_client_type* client)
+{
+    client->msgs = NULL;
+    client->msgs_last = NULL;
+    region_free(client->msg_region);
+    return;
+}
+
+
+/**
+ * Send the queued answer messages over TCP. No locks are held, so a slow
+ * client only holds up its own thread.
+ *
+ */
+static int
+dnshandler_answer_flush(dnshandler_client_type* client)
+{
+    dnshandler_msg_type* msg = client->msgs;
+    uint16_t len = 0;
+    int ret = 0;
+    while (msg) {
+        len = htons((uint16_t) msg->len);
+        if (ods_writen(client->fd, &len, sizeof(len)) == -1 ||
+            ods_writen(client->fd, msg->data, msg->len) == -1) {
+            ods_log_warning("[%s] write answer failed: %s", logstr,
+                strerror(errno));
+            ret = -1;
+            break;
+        }
+        msg = msg->next;
+    }
+    dnshandler_answer_drop(client);
+    return ret;
+}
+
+
+/**
+ * Send an error answer.
+ *
+ */
+static int
+dnshandler_answer_error(dnshandler_client_type* client, int rcode,
+    size_t qend)
+{
+    dnshandler_answer_start(client, qend);
+    AA_CLR(client->answer);
+    RCODE_SET(client->answer, rcode);
+    return dnshandler_answer_send(client, 0);
+}
+
+
+/**
+ * Add rr to the transfer, send the current message if it is full.
+ *
+ */
+static int
+dnshandler_xfr_rr(dnshandler_client_type* client, rr_type* rr,
+    uint16_t* count)
+{
+    if (rr_write_wire(rr, client->answer)) {
+        (*count)++;
+        return 0;
+    }
+    /* message is full, continue in a new one */
+    if (dnshandler_answer_send(client, *count) != 0) {
+        return -1;
+    }
+    dnshandler_answer_start(client, BUFFER_PKT_HEADER_SIZE);
+    *count = 0;
+    if (!rr_write_wire(rr, client->answer)) {
+        rr_log(rr, "[dnshandler] rr too large for message", LOG_ERR);
+        return -1;
+    }
+    (*count)++;
+    return 0;
+}
+
+
+/**
+ * Transfer zone. If soa_only is set, only the SOA is given.
+ *
+ */
+static int
+dnshandler_xfr(dnshandler_client_type* client, zone_type* zone,
+    size_t qend, int soa_only)
+{
+    tree_node* node = TREE_NULL;
+    domain_type* domain = NULL;
+    rrset_type* rrset = NULL;
+    rr_type* soa = NULL;
+    uint16_t count = 0;
+    uint32_t total = 0;
+    size_t i = 0;
+    soa = zone_lookup_soa(zone);
+    if (!soa) {
+        return dnshandler_answer_error(client, DNS_RCODE_SERVFAIL,
+            qend);
+    }
+    dnshandler_answer_start(client, qend);
+    if (dnshandler_xfr_rr(client, soa, &count) != 0) {
+        return -1;
+    }
+    total++;
+    if (soa_only) {
+        return dnshandler_answer_send(client, count);
+    }
+    node = tree_first(zone->namedb->domains);
+    while (node && node != TREE_NULL) {
+        domain = (domain_type*) node->data;
+        rrset = domain->rrsets;
+        while (rrset) {
+            if (!domain->is_apex || rrset->rrtype != DNS_TYPE_SOA) {
+                for (i=0; i < rrset->rr_count; i++) {
+                    if (rrset->rrs[i].is_removed) {
+                        continue;
+                    }
+                    if (dnshandler_xfr_rr(client, rrset->rrs[i].rr,
+                        &count) != 0) {
+                        return -1;
+                    }
+                    total++;
+                }
+            }
+            rrset = rrset->next;
+        }
+        node = tree_next(node);
+    }
+    if (dnshandler_xfr_rr(client, soa, &count) != 0) {
+        return -1;
+    }
+    total++;
+    ods_log_verbose("[%s] zone %s transferred serial %u (%u rrs)", logstr,
+        zone->name, zone->outbound_serial, total);
+    return dnshandler_answer_send(client, count);
+}
+
+
+/**
+ * Incremental zone transfer, starting at the journal entry idx.
+ *
+ */
+static int
+dnshandler_ixfr(dnshandler_client_type* client, zone_type* zone,
+    size_t qend, int idx)
+{
+    journal_type* journal = zone->journal;
+    region_type* tmpregion = NULL;
+    rr_type* soa = NULL;
+    rr_type* rr = NULL;
+    FILE* jfd = NULL;
+    uint16_t count = 0;
+    uint32_t total = 0;
+    uint32_t j = 0;
+    size_t i = 0;
+    soa = zone_lookup_soa(zone);
+    tmpregion = region_create();
+    if (!tmpregion) {
+        ods_log_crit("[%s] region create failed", logstr);
+        return dnshandler_answer_error(client, DNS_RCODE_SERVFAIL,
+            qend);
+    }
+    dnshandler_answer_start(client, qend);
+    if (dnshandler_xfr_rr(client, soa, &count) != 0) {
+        goto ixfr_failed;
+    }
+    for (i=(size_t) idx; i < journal->count; i++) {
+        jfd = journal_open_entry(journal, i);
+        if (!jfd) {
+            goto ixfr_failed;
+        }
+        for (j=0; j < journal->entries[i].num_del +
+            journal->entries[i].num_add; j++) {
+            rr = journal_read_rr(jfd, tmpregion);
+            if (!rr || dnshandler_xfr_rr(client, rr, &count) != 0) {
+                goto ixfr_failed;
+            }
+            region_free(tmpregion);
+            total++;
+        }
+        ods_fclose(jfd);
+        jfd = NULL;
+    }
+    if (dnshandler_xfr_rr(client, soa, &count) != 0) {
+        goto ixfr_failed;
+    }
+    region_cleanup(tmpregion);
+    ods_log_verbose("[%s] zone %s incrementally transferred serial %u -> %u "
+        "(%u rrs)", logstr, zone->name, journal->entries[idx].serial_from,
+        journal->entries[journal->count-1].serial_to, total + 2);
+    return dnshandler_answer_send(client, count);
+
+ixfr_failed:
+    ods_log_error("[%s] incremental transfer of zone %s failed", logstr,
+        zone->name);
+    if (jfd) {
+        ods_fclose(jfd);
+    }
+    region_cleanup(tmpregion);
+    return -1;
+}
+
+
+/**
+ * Read the serial of the SOA in the authority section of an IXFR query.
+ * Returns 0 if the query does not have one.
+ *
+ */
+static int
+dnshandler_ixfr_serial(buffer_type* query, uint32_t* serial)
+{
+    uint8_t wire[MAXDOMAINLEN+1];
+    if (buffer_pkt_nscount(query) < 1 ||
+        !buffer_read_dname(query, wire, 1) || !buffer_available(query, 10)) {
+        return 0;
+    }
+    if (buffer_read_u16(query) != DNS_TYPE_SOA) {
+        return 0;
+    }
+    buffer_skip(query, 8); /* class, ttl, rdlength */
+    if (!buffer_read_dname(query, wire, 1) ||
+        !buffer_read_dname(query, wire, 1) || !buffer_available(query, 4)) {
+        return 0;
+    }
+    *serial = buffer_read_u32(query);
+    return 1;
+}
+
+
+/**
+ * Process query. The answer messages are queued, only the zone is locked
+ * while they are rendered.
+ *
+ */
+static int
+dnshandler_process_query(dnshandler_client_type* client)
+{
+    engine_type* engine = (engine_type*) client->dnshandler->engine;
+    buffer_type* query = client->query;
+    region_type* tmpregion = NULL;
+    dname_type* qname = NULL;
+    zone_type* zone = NULL;
+    uint8_t wire[MAXDOMAINLEN+1];
+    uint16_t qtype = 0;
+    uint16_t qclass = 0;
+    rr_type* soa = NULL;
+    uint32_t serial = 0;
+    uint32_t current = 0;
+    size_t qend = 0;
+    int idx = -1;
+    size_t i = 0;
+    size_t j = 0;
+    int ret = 0;
+    if (buffer_pkt_qr(query)) {
+        return 0; /* not a query, ignore */
+    }
+    if (OPCODE(query) != DNS_OPCODE_QUERY) {
+        return dnshandler_answer_error(client, DNS_RCODE_NOTIMPL,
+            BUFFER_PKT_HEADER_SIZE);
+    }
+    if (buffer_pkt_qdcount(query) != 1) {
+        return dnshandler_answer_error(client, DNS_RCODE_FORMERR,
+            BUFFER_PKT_HEADER_SIZE);
+    }
+    /* question */
+    buffer_set_position(query, BUFFER_PKT_HEADER_SIZE);
+    if (!buffer_read_dname(query, wire, 0) || !buffer_available(query, 4)) {
+        return dnshandler_answer_error(client, DNS_RCODE_FORMERR,
+            BUFFER_PKT_HEADER_SIZE);
+    }
+    qtype = buffer_read_u16(query);
+    qclass = buffer_read_u16(query);
+    qend = buffer_position(query);
+    if (qtype == DNS_TYPE_IXFR && !dnshandler_ixfr_serial(query, &serial)) {
+        return dnshandler_answer_error(client, DNS_RCODE_FORMERR,
+            qend);
+    }
+    /* zone names are stored in lower case */
+    for (i=0; wire[i]; i += wire[i] + 1) {
+        for (j=1; j <= wire[i]; j++) {
+            wire[i+j] = (uint8_t) tolower((int) wire[i+j]);
+        }
+    }
+    tmpregion = region_create();
+    if (!tmpregion) {
+        ods_log_crit("[%s] region create failed", logstr);
+        return dnshandler_answer_error(client, DNS_RCODE_SERVFAIL,
+            qend);
+    }
+    qname = dname_create_frm_data(tmpregion, wire);
+    if (!qname) {
+        region_cleanup(tmpregion);
+        return dnshandler_answer_error(client, DNS_RCODE_FORMERR,
+            qend);
+    }
+    /* zone */
+    lock_basic_lock(&engine->zlist->zl_lock);
+    zone = zlist_lookup_zone_by_dname(engine->zlist, qname, qclass);
+    region_cleanup(tmpregion);
+    if (!zone || !zone->adapter_out ||
+        zone->adapter_out->type != ADAPTER_DNS) {
+        lock_basic_unlock(&engine->zlist->zl_lock);
+        return dnshandler_answer_error(client, DNS_RCODE_NOTAUTH,
+            qend);
+    }
+    /* holding the zone lock keeps the zone from being removed */
+    lock_basic_lock(&zone->zone_lock);
+    lock_basic_unlock(&engine->zlist->zl_lock);
+    soa = zone_lookup_soa(zone);
+    if (soa && qtype == DNS_TYPE_IXFR) {
+        current = wf_read_uint32(rdata_get_data(&soa->rdata[2]));
+        if (serial != current && zone->journal->count > 0 &&
+            zone->journal->entries[zone->journal->count-1].serial_to ==
+            current) {
+            idx = journal_lookup(zone->journal, serial);
+        }
+    }
+    if (!zone->xfr_ready || !soa) {
+        ret = dnshandler_answer_error(client, DNS_RCODE_SERVFAIL,
+            qend);
+    } else if (qtype == DNS_TYPE_IXFR && serial == current) {
+        /* up to date */
+        ret = dnshandler_xfr(client, zone, qend, 1);
+    } else if (qtype == DNS_TYPE_IXFR && idx >= 0) {
+        ret = dnshandler_ixfr(client, zone, qend, idx);
+    } else if (qtype == DNS_TYPE_AXFR || qtype == DNS_TYPE_IXFR) {
+        /* serial not in journal: answer IXFR with the full zone */
+        ret = dnshandler_xfr(client, zone, qend, 0);
+    } else if (qtype == DNS_TYPE_SOA) {
+        ret = dnshandler_xfr(client, zone, qend, 1);
+    } else {
+        ret = dnshandler_answer_error(client, DNS_RCODE_REFUSED,
+            qend);
+    }
+    lock_basic_unlock(&zone->zone_lock);
+    return ret;
+}
+
+
+/**
+ * Handle TCP connection.
+ *
+ */
+static void
+dnshandler_handle_tcp(dnshandler_client_type* client)
+{
+    struct timeval tv;
+    uint16_t len = 0;
+    tv.tv_sec = DNS_TCP_TIMEOUT;
+    tv.tv_usec = 0;
+    (void) setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    (void) setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    while (!client->dnshandler->need_to_exit) {
+        if (dnshandler_readn(client->fd, &len, sizeof(len)) == -1) {
+            return;
+        }
+        len = ntohs(len);
+        if (len < BUFFER_PKT_HEADER_SIZE) {
+            ods_log_warning("[%s] short query (%u bytes)", logstr,
+                (unsigned) len);
+            return;
+        }
+        buffer_clear(client->query);
+        if (dnshandler_readn(client->fd, buffer_begin(client->query), len)
+            == -1) {
+            return;
+        }
+        buffer_set_limit(client->query, len);
+        if (dnshandler_process_query(client) != 0) {
+            dnshandler_answer_drop(client);
+            return;
+        }
+        if (dnshandler_answer_flush(client) != 0) {
+            return;
+        }
+    }
+    return;
+}
+
+
+/**
+ * Create client for an accepted connection.
+ *
+ */
+static dnshandler_client_type*
+dnshandler_client_create(dnshandler_type* dnshandler, int fd)
+{
+    region_type* region = NULL;
+    dnshandler_client_type* client = NULL;
+    region = region_create();
+    if (!region) {
+        return NULL;
+    }
+    client = (dnshandler_client_type*) region_alloc(region,
+        sizeof(dnshandler_client_type));
+    client->dnshandler = dnshandler;
+    client->region = region;
+    client->query = buffer_create(region, PACKET_BUFFER_SIZE);
+    client->answer = buffer_create(region, PACKET_BUFFER_SIZE);
+    client->msg_region = region_create();
+    client->msgs = NULL;
+    client->msgs_last = NULL;
+    client->fd = fd;
+    if (!client->query || !client->answer || !client->msg_region) {
+        region_cleanup(client->msg_region);
+        region_cleanup(region);
+        return NULL;
+    }
+    return client;
+}
+
+
+/**
+ * Clean up client, closes the connection.
+ *
+ */
+static void
+dnshandler_client_cleanup(dnshandler_client_type* client)
+{
+    dnshandler_type* dnshandler = client->dnshandler;
+    close(client->fd);
+    region_cleanup(client->msg_region);
+    region_cleanup(client->region);
+    lock_basic_lock(&dnshandler->client_lock);
+    dnshandler->num_clients--;
+    lock_basic_unlock(&dnshandler->client_lock);
+    return;
+}
+
+
+/**
+ * Serve client.
+ *
+ */
+static void*
+dnshandler_serve_client(void* arg)
+{
+    dnshandler_client_type* client = (dnshandler_client_type*) arg;
+    ods_thread_blocksigs();
+    ods_thread_detach(client->thread_id);
+    dnshandler_handle_tcp(client);
+    dnshandler_client_cleanup(client);
+    return NULL;
+}
+
+
+/**
+ * Hand an accepted connection to a new thread, so that one slow client
+ * does not hold up the others.
+ *
+ */
+static void
+dnshandler_accept_client(dnshandler_type* dnshandler, int fd)
+{
+    dnshandler_client_type* client = NULL;
+    lock_basic_lock(&dnshandler->client_lock);
+    if (dnshandler->num_clients >= DNS_TCP_MAX_CLIENTS) {
+        lock_basic_unlock(&dnshandler->client_lock);
+        ods_log_warning("[%s] too many clients, connection refused",
+            logstr);
+        close(fd);
+        return;
+    }
+    dnshandler->num_clients++;
+    lock_basic_unlock(&dnshandler->client_lock);
+    client = dnshandler_client_create(dnshandler, fd);
+    if (!client) {
+        ods_log_error("[%s] create client failed", logstr);
+        lock_basic_lock(&dnshandler->client_lock);
+        dnshandler->num_clients--;
+        lock_basic_unlock(&dnshandler->client_lock);
+        close(fd);
+        return;
+    }
+    ods_thread_create(&client->thread_id, dnshandler_serve_client,
+        (void*) client);
+    return;
+}
+
+
+/**
+ * Wait for the clients to finish, they notice need_to_exit within
+ * DNS_TCP_TIMEOUT seconds.
+ *
+ */
+static void
+dnshandler_wait_clients(dnshandler_type* dnshandler)
+{
+    int num_clients = 0;
+    while (1) {
+        lock_basic_lock(&dnshandler->client_lock);
+        num_clients = dnshandler->num_clients;
+        lock_basic_unlock(&dnshandler->client_lock);
+        if (num_clients <= 0) {
+            return;
+        }
+        ods_log_debug("[%s] waiting for %i clients", logstr, num_clients);
+        sleep(1);
+    }
+    return;
+}
+
+
+/**
+ * Start dns handler.
+ *
+ */
+void
+dnshandler_start(dnshandler_type* dnshandler)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    struct timeval tv;
+    fd_set rset;
+    interface_type* ifs = NULL;
+    size_t i = 0;
+    int maxfd = -1;
+    int connfd = -1;
+    int ret = 0;
+    ods_log_assert(dnshandler);
+    ods_log_assert(dnshandler->engine);
+    ods_log_assert(dnshandler->interfaces);
+    ods_log_debug("[%s] start", logstr);
+    while (!dnshandler->need_to_exit) {
+        FD_ZERO(&rset);
+        maxfd = -1;
+        for (i=0; i < dnshandler->interfaces->count; i++) {
+            ifs = &dnshandler->interfaces->interfaces[i];
+            if (ifs->fd >= 0) {
+                FD_SET(ifs->fd, &rset);
+                if (ifs->fd > maxfd) {
+                    maxfd = ifs->fd;
+                }
+            }
+        }
+        /* wake up every second to check if we need to exit */
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        ret = select(maxfd+1, &rset, NULL, NULL, &tv);
+        if (ret < 0) {
+            if (errno != EINTR && errno != EWOULDBLOCK) {
+                ods_log_warning("[%s] select() error: %s", logstr,
+                   strerror(errno));
+            }
+            continue;
+        }
+        for (i=0; ret > 0 && i < dnshandler->interfaces->count; i++) {
+            ifs = &dnshandler->interfaces->interfaces[i];
+            if (ifs->fd < 0 || !FD_ISSET(ifs->fd, &rset)) {
+                continue;
+            }
+            addrlen = sizeof(addr);
+            connfd = accept(ifs->fd, (struct sockaddr*) &addr, &addrlen);
+            if (connfd < 0) {
+                if (errno != EINTR && errno != EWOULDBLOCK) {
+                    ods_log_warning("[%s] accept() error: %s", logstr,
+                        strerror(errno));
+                }
+                continue;
+            }
+            dnshandler_accept_client(dnshandler, connfd);
+        }
+    }
+    dnshandler_wait_clients(dnshandler);
+    ods_log_debug("[%s] done", logstr);
+    return;
+}
+
+
+/**
+ * Clean up dns handler.
+ *
+ */
+void
+dnshandler_cleanup(dnshandler_type* dnshandler)
+{
+    size_t i = 0;
+    if (!dnshandler || !dnshandler->interfaces) {
+        return;
+    }
+    for (i=0; i < dnshandler->interfaces->count; i++) {
+        if (dnshandler->interfaces->interfaces[i].fd >= 0) {
+            close(dnshandler->interfaces->interfaces[i].fd);
+            dnshandler->interfaces->interfaces[i].fd = -1;
+        }
+    }
+    lock_basic_destroy(&dnshandler->client_lock);
+    return;
+}
@@ -0,0 +1,113 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * DNS handler.
+ *
+ */
+
+#ifndef DAEMON_DNSHANDLER_H
+#define DAEMON_DNSHANDLER_H
+
+#include "util/locks.h"
+#include "util/region.h"
+#include "util/status.h"
+#include "wire/buffer.h"
+#include "wire/listener.h"
+
+struct engine_struct;
+
+#define DNS_TCP_BACKLOG 5
+#define DNS_TCP_TIMEOUT 10
+#define DNS_TCP_MAX_CLIENTS 32
+
+/* Answer message, rendered under the zone locks and sent without them */
+typedef struct dnshandler_msg_struct dnshandler_msg_type;
+struct dnshandler_msg_struct {
+    dnshandler_msg_type* next;
+    uint8_t* data;
+    size_t len;
+};
+
+typedef struct dnshandler_struct dnshandler_type;
+struct dnshandler_struct {
+    struct engine_struct* engine;
+    listener_type* interfaces;
+    lock_basic_type client_lock;
+    int num_clients;
+    ods_thread_type thread_id;
+    int need_to_exit;
+};
+
+/* Transfer client, each connection is served by its own thread */
+typedef struct dnshandler_client_struct dnshandler_client_type;
+struct dnshandler_client_struct {
+    dnshandler_type* dnshandler;
+    region_type* region;
+    buffer_type* query;
+    buffer_type* answer;
+    region_type* msg_region;
+    dnshandler_msg_type* msgs;
+    dnshandler_msg_type* msgs_last;
+    ods_thread_type thread_id;
+    int fd;
+};
+
+/**
+ * Create dns handler.
+ * @param r:          memory region.
+ * @param interfaces: list of interfaces.
+ * @return:           (dnshandler_type*) dns handler.
+ *
+ */
+dnshandler_type* dnshandler_create(region_type* r, listener_type* interfaces);
+
+/**
+ * Open the listening sockets for the dns handler.
+ * @param dnshandler: dns handler.
+ * @return:           (ods_status) status.
+ *
+ */
+ods_status dnshandler_listen(dnshandler_type* dnshandler);
+
+/**
+ * Start dns handler. Serves zone transfers over TCP for zones that have
+ * a dns output adapter.
+ * @param dnshandler: dns handler.
+ *
+ */
+void dnshandler_start(dnshandler_type* dnshandler);
+
+/**
+ * Clean up dns handler.
+ * @param dnshandler: dns handler.
+ *
+ */
+void dnshandler_cleanup(dnshandler_type* dnshandler);
+
+#endif /* DAEMON_DNSHANDLER_H */
@@ -33,6 +33,9 @@
 
 #include "config.h"
 #include "daemon/engine.h"
+#include "parser/confparser.h"
+#include "signer/signconf.h"
+#include "signer/stats.h"
 #include "util/duration.h"
 #include "util/file.h"
 #include "util/hsms.h"
@@ -44,6 +47,7 @@
 #include <errno.h>
 #include <libxml/parser.h>
 #include <signal.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -81,6 +85,8 @@ engine_cleanup(engine_type* engine)
     schedule_cleanup(engine->taskq);
     fifoq_cleanup(engine->signq);
     cmdhandler_cleanup(engine->cmdhandler);
+    dnshandler_cleanup(engine->dnshandler);
+    watcher_cleanup(engine->watcher);
     /* destroy locks and region */
     lock_basic_destroy(&signal_lock);
     lock_basic_off(&signal_cond);
@@ -103,7 +109,8 @@ engine_init(engine_type* engine)
     engine->drudgers = NULL;
     engine->cmdhandler = NULL;
     engine->cmdhandler_done = 0;
-    /* [TODO] dnshandler */
+    engine->dnshandler = NULL;
+    engine->watcher = NULL;
     /* [TODO] xfrhandler */
     engine->pid = -1;
     engine->uid = -1;
@@ -282,6 +289,88 @@ engine_stop_cmdhandler(engine_type* engine)
 }
 
 
+/**
+ * Start dns handler.
+ *
+ */
+static void*
+dnshandler_thread_start(void* arg)
+{
+    dnshandler_type* dnshandler = (dnshandler_type*) arg;
+    ods_thread_blocksigs();
+    dnshandler_start(dnshandler);
+    return NULL;
+}
+static void
+engine_start_dnshandler(engine_type* engine)
+{
+    if (!engine || !engine->dnshandler) {
+        return;
+    }
+    ods_log_debug("[%s] start dns handler", logstr);
+    engine->dnshandler->engine = engine;
+    ods_thread_create(&engine->dnshandler->thread_id,
+        dnshandler_thread_start, engine->dnshandler);
+    return;
+}
+/**
+ * Stop dns handler.
+ *
+ */
+static void
+engine_stop_dnshandler(engine_type* engine)
+{
+    if (!engine || !engine->dnshandler) {
+        return;
+    }
+    ods_log_debug("[%s] stop dns handler", logstr);
+    engine->dnshandler->need_to_exit = 1;
+    ods_thread_join(engine->dnshandler->thread_id);
+    return;
+}
+
+
+/**
+ * Start file watcher.
+ *
+ */
+static void*
+watcher_thread_start(void* arg)
+{
+    watcher_type* watcher = (watcher_type*) arg;
+    ods_thread_blocksigs();
+    watcher_start(watcher);
+    return NULL;
+}
+static void
+engine_start_watcher(engine_type* engine)
+{
+    if (!engine || !engine->watcher) {
+        return;
+    }
+    ods_log_debug("[%s] start file watcher", logstr);
+    engine->watcher->engine = engine;
+    ods_thread_create(&engine->watcher->thread_id,
+        watcher_thread_start, engine->watcher);
+    return;
+}
+/**
+ * Stop file watcher.
+ *
+ */
+static void
+engine_stop_watcher(engine_type* engine)
+{
+    if (!engine || !engine->watcher) {
+        return;
+    }
+    ods_log_debug("[%s] stop file watcher", logstr);
+    engine->watcher->need_to_exit = 1;
+    ods_thread_join(engine->watcher->thread_id);
+    return;
+}
+
+
 
 /**
  * Start/stop workers and drudgers.
@@ -424,6 +513,21 @@ engine_setup(engine_type* engine)
         ods_log_error("[%s] create commandhandler failed", logstr);
         return ODS_STATUS_CMDHDLRERR;
     }
+    if (engine->cfg->interfaces && engine->cfg->interfaces->count > 0) {
+        engine->dnshandler = dnshandler_create(engine->region,
+            engine->cfg->interfaces);
+        if (!engine->dnshandler) {
+            ods_log_error("[%s] create dnshandler failed", logstr);
+            return ODS_STATUS_MALLOCERR;
+        }
+        /* bind before dropping privileges, port 53 is privileged */
+        status = dnshandler_listen(engine->dnshandler);
+        if (status != ODS_STATUS_OK) {
+            ods_log_error("[%s] setup dnshandler failed: %s", logstr,
+                ods_status2str(status));
+            return status;
+        }
+    }
     /* privdrop */
     engine->uid = privuid(engine->cfg->username);
     engine->gid = privgid(engine->cfg->group);
@@ -444,6 +548,9 @@ engine_setup(engine_type* engine)
             ods_status2str(status));
         return ODS_STATUS_PRIVDROPERR;
     }
+    /* watch files, relative names are relative to the working directory */
+    engine->watcher = watcher_create(engine->region,
+        engine->cfg->zonelist_filename);
     /* daemonize */
     if (engine->daemonize) {
         switch ((engine->pid = fork())) {
@@ -468,6 +575,8 @@ engine_setup(engine_type* engine)
     engine->pid = getpid();
     ods_log_verbose("[%s] running as pid %lu", logstr,
         (unsigned long) engine->pid);
+    /* threads do not survive the fork, start the log writer now */
+    ods_log_start();
     /* catch signals */
     action.sa_handler = signal_handler;
     sigfillset(&action.sa_mask);
@@ -499,6 +608,74 @@ engine_setup(engine_type* engine)
 }
 
 
+/**
+ * Dump the zone statistics in the Prometheus text format. The file is
+ * replaced with a rename, so that readers never see a partial file.
+ *
+ */
+static void
+engine_dump_stats(engine_type* engine)
+{
+    FILE* fd = NULL;
+    region_type* region = NULL;
+    zlist_stats_type* zstats = NULL;
+    size_t nzones = 0;
+    size_t i;
+    region = region_create();
+    if (!region) {
+        ods_log_warning("[%s] unable to write statistics to %s: "
+            "region_create() failed", logstr, STATS_FILENAME);
+        return;
+    }
+    fd = ods_fopen(STATS_FILENAME ".tmp", NULL, "w");
+    if (!fd) {
+        ods_log_warning("[%s] unable to write statistics to %s", logstr,
+            STATS_FILENAME);
+        region_cleanup(region);
+        return;
+    }
+    /* do not hold the zone list lock during file i/o */
+    zstats = zlist_stats(engine->zlist, region, &nzones);
+    stats_print_prometheus_help(fd);
+    for (i=0; i < nzones; i++) {
+        stats_print_prometheus(fd, zstats[i].name, &zstats[i].stats);
+    }
+    region_cleanup(region);
+    ods_fclose(fd);
+    if (rename(STATS_FILENAME ".tmp", STATS_FILENAME) != 0) {
+        ods_log_warning("[%s] unable to write statistics to %s: %s", logstr,
+            STATS_FILENAME, strerror(errno));
+    }
+    return;
+}
+
+
+/**
+ * Have all zones been written, or given up on, at least once?
+ *
+ */
+static int
+engine_all_zones_done(engine_type* engine)
+{
+    tree_node* node = TREE_NULL;
+    zone_type* zone = NULL;
+    int done = 1;
+    lock_basic_lock(&engine->zlist->zl_lock);
+    node = engine->zlist->zones ? tree_first(engine->zlist->zones) : TREE_NULL;
+    while (done && node && node != TREE_NULL) {
+        zone = (zone_type*) node->data;
+        if (zone->zl_status != ZONE_ZL_REMOVED && zone->task &&
+            !zone->stats.phase_count[STATS_PHASE_WRITE] &&
+            !zone->task->backoff) {
+            done = 0;
+        }
+        node = tree_next(node);
+    }
+    lock_basic_unlock(&engine->zlist->zl_lock);
+    return done;
+}
+
+
 /**
  * Run signer engine.
  *
@@ -534,15 +711,18 @@ engine_run(engine_type* engine, int single_run)
         }
         lock_basic_unlock(&engine->signal_lock);
 
-        if (single_run) {
-            ods_log_warning("[%s] SINGLE RUN NOT IMPLEMENTED", logstr);
+        if (single_run && engine_all_zones_done(engine)) {
+            ods_log_info("[%s] single run: all zones done", logstr);
+            engine->need_to_exit = 1;
         }
         lock_basic_lock(&engine->signal_lock);
-        if (engine->signal == SIGNAL_RUN && !single_run) {
+        if (engine->signal == SIGNAL_RUN && !engine->need_to_exit) {
            ods_log_debug("[%s] taking a break", logstr);
-           lock_basic_sleep(&engine->signal_cond, &engine->signal_lock, 3600);
+           lock_basic_sleep(&engine->signal_cond, &engine->signal_lock,
+               single_run ? 1 : STATS_INTERVAL);
         }
         lock_basic_unlock(&engine->signal_lock);
+        engine_dump_stats(engine);
     }
     ods_log_debug("[%s] signer halted", logstr);
     engine_stop_drudgers(engine);
@@ -594,6 +774,8 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
     xmlInitGlobals();
     xmlInitParser();
     xmlInitThreads();
+    parser_init();
+    signconf_cache_init();
     engine = engine_create();
     if (!engine) {
         ods_fatal_exit("[%s] create failed", logstr);
@@ -626,12 +808,12 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
     }
     /* run */
     engine_start_cmdhandler(engine);
+    engine_start_dnshandler(engine);
+    engine_start_watcher(engine);
     while (!engine->need_to_exit) {
-        /* update zone list */
-        lock_basic_lock(&engine->zlist->zl_lock);
+        /* update zone list, takes the zone list lock for the merge */
         zl_changed = zlist_update(engine->zlist,
             engine->cfg->zonelist_filename);
-        lock_basic_unlock(&engine->zlist->zl_lock);
         /* start/reload */
         if (engine->need_to_reload) {
             ods_log_info("[%s] reload signer", logstr);
@@ -651,6 +833,8 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
     /* shutdown */
     ods_log_info("[%s] shutdown signer", logstr);
     engine_stop_cmdhandler(engine);
+    engine_stop_dnshandler(engine);
+    engine_stop_watcher(engine);
     ods_log_verbose("[%s] close hsm", logstr);
     hsm_close();
     if (engine && engine->cfg) {
@@ -662,7 +846,9 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize,
         }
     }
     engine_cleanup(engine);
+    signconf_cache_cleanup();
     ods_log_close();
+    parser_cleanup();
     xmlCleanupParser();
     xmlCleanupGlobals();
     xmlCleanupThreads();
@@ -694,27 +880,31 @@ set_notify_ns(zone_type* zone, const char* cmd)
 void
 engine_update_zones(engine_type* engine, ods_status zl_changed)
 {
-    tree_node* node = TREE_NULL;
     ods_status status = ODS_STATUS_OK;
     time_t now = time_now();
+    size_t i, kept = 0;
     if (!engine || !engine->zlist || !engine->zlist->zones) {
         return;
     }
     ods_log_debug("[%s] commit zone list changes", logstr);
     lock_basic_lock(&engine->zlist->zl_lock);
-    node = tree_first(engine->zlist->zones);
-    while (node && node != TREE_NULL) {
-        zone_type* zone = (zone_type*) node->data;
+    for (i=0; i < engine->zlist->changed_count; i++) {
+        zone_type* zone = engine->zlist->changed[i];
         task_type* task = NULL;
-        if (zone->zl_status == ZONE_ZL_REMOVED) {
-            node = tree_next(node);
+        status = ODS_STATUS_OK;
+        if (zone->zl_status == ZONE_ZL_OK) {
+            /* already committed */
+            continue;
+        } else if (zone->zl_status == ZONE_ZL_REMOVED) {
             lock_basic_lock(&zone->zone_lock);
             (void)zlist_del_zone(engine->zlist, zone);
             /* [TODO] clean up task */
             lock_basic_unlock(&zone->zone_lock);
+            watcher_forget_zone(engine->watcher, zone->name);
             /* [TODO] remove netio handler */
             zone_cleanup(zone);
             zone = NULL;
+            engine->zlist->changed[i] = NULL;
             continue;
         } else if (zone->zl_status == ZONE_ZL_ADDED) {
             lock_basic_lock(&zone->zone_lock);
@@ -729,7 +919,6 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
             if (!task) {
                 ods_log_crit("[%s] create task for zone %s failed", logstr,
                     zone->name);
-                node = tree_next(node);
                 continue;
             }
         }
@@ -742,11 +931,16 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
             lock_basic_lock(&engine->taskq->s_lock);
             status = schedule_task(engine->taskq, task, 0);
             lock_basic_unlock(&engine->taskq->s_lock);
-        } else if (zl_changed == ODS_STATUS_OK) {
-            /* always try to update signconf */
+            (void)watcher_watch_zone(engine->watcher, zone);
+        } else if (zl_changed == ODS_STATUS_OK ||
+            zone->zl_status == ZONE_ZL_UPDATED) {
+            /* zonelist entry changed, update signconf */
             lock_basic_lock(&zone->zone_lock);
             status = zone_reschedule_task(zone, engine->taskq, TASK_CONF);
             lock_basic_unlock(&zone->zone_lock);
+            /* signconf or input file may have moved */
+            watcher_forget_zone(engine->watcher, zone->name);
+            (void)watcher_watch_zone(engine->watcher, zone);
         }
         if (status != ODS_STATUS_OK) {
             ods_log_crit("[%s] schedule task for zone %s failed: %s",
@@ -756,12 +950,37 @@ engine_update_zones(engine_type* engine, ods_status zl_changed)
         } else {
             zone->zl_status = ZONE_ZL_OK;
         }
-        node = tree_next(node);
     }
+    /* keep the zones that failed, they are retried on the next update */
+    for (i=0; i < engine->zlist->changed_count; i++) {
+        zone_type* zone = engine->zlist->changed[i];
+        if (!zone) {
+            continue;
+        } else if (zone->zl_status == ZONE_ZL_OK) {
+            zone->zl_marked = 0;
+            continue;
+        }
+        engine->zlist->changed[kept++] = zone;
+    }
+    engine->zlist->changed_count = kept;
     lock_basic_unlock(&engine->zlist->zl_lock);
     return;
 }
 
 
+/**
+ * Wake up all workers.
+ *
+ */
+void
+engine_wakeup_workers(engine_type* engine)
+{
+    ods_log_assert(engine);
+    ods_log_assert(engine->taskq);
+    worker_notify_all(&engine->taskq->s_lock, &engine->taskq->s_cond);
+    return;
+}
+
+
 /* [TODO] recover engine */
 
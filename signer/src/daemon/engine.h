@@ -36,7 +36,9 @@
 
 #include "daemon/cfg.h"
 #include "daemon/cmdhandler.h"
+#include "daemon/dnshandler.h"
 #include "daemon/signal.h"
+#include "daemon/watcher.h"
 #include "daemon/worker.h"
 #include "schedule/fifoq.h"
 #include "schedule/schedule.h"
@@ -55,6 +57,8 @@ struct engine_struct {
     cfg_type* cfg;
     zlist_type* zlist;
     cmdhandler_type* cmdhandler;
+    dnshandler_type* dnshandler;
+    watcher_type* watcher;
     worker_type** workers;
     worker_type** drudgers;
     schedule_type* taskq;
@@ -0,0 +1,619 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * File watcher.
+ *
+ */
+
+#include "config.h"
+#include "daemon/engine.h"
+#include "daemon/watcher.h"
+#include "signer/zlist.h"
+#include "util/log.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+#endif
+
+static const char* logstr = "watcher";
+
+#define WATCHER_EVENTS_SIZE 4096
+#define WATCHER_MAX_HITS 64
+
+
+/**
+ * Hash a string (FNV-1a).
+ *
+ */
+static uint32_t
+watcher_hash(const char* str)
+{
+    uint32_t hash = 2166136261U;
+    while (*str) {
+        hash = (hash ^ (uint8_t) *str++) * 16777619U;
+    }
+    return hash % WATCHER_TABLE_SIZE;
+}
+
+
+/**
+ * Normalize a file name, so that it matches the name built from an event:
+ * the directory, a slash and the file name.
+ *
+ */
+static int
+watcher_path(const char* file, char* buf, size_t len)
+{
+    int n;
+    if (strchr(file, '/')) {
+        n = snprintf(buf, len, "%s", file);
+    } else {
+        n = snprintf(buf, len, "./%s", file);
+    }
+    return n > 0 && (size_t) n < len;
+}
+
+
+/**
+ * Watch the directory of a file. Directories are watched instead of files,
+ * so that files that are replaced by a rename are still noticed.
+ *
+ */
+static ods_status
+watcher_watch_dir(watcher_type* watcher, const char* path)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    char dir[ODS_SE_MAXLINE];
+    char* slash = NULL;
+    char** dirs = NULL;
+    int* wds = NULL;
+    size_t max = 0;
+    size_t i;
+    int wd;
+    (void)strlcpy(dir, path, sizeof(dir));
+    slash = strrchr(dir, '/');
+    if (!slash) {
+        return ODS_STATUS_ASSERT;
+    }
+    if (slash == dir) {
+        slash++;
+    }
+    *slash = '\0';
+    wd = inotify_add_watch(watcher->fd, dir,
+        IN_CLOSE_WRITE|IN_MOVED_TO|IN_ATTRIB);
+    if (wd < 0) {
+        ods_log_error("[%s] unable to watch directory %s: %s", logstr, dir,
+            strerror(errno));
+        return ODS_STATUS_FOPENERR;
+    }
+    for (i=0; i < watcher->num_dirs; i++) {
+        if (watcher->wds[i] == wd) {
+            /* already watched */
+            return ODS_STATUS_OK;
+        }
+    }
+    if (watcher->num_dirs >= watcher->max_dirs) {
+        max = watcher->max_dirs ? watcher->max_dirs * 2 : 16;
+        dirs = (char**) realloc(watcher->dirs, max * sizeof(char*));
+        if (dirs) {
+            watcher->dirs = dirs;
+        }
+        wds = (int*) realloc(watcher->wds, max * sizeof(int));
+        if (wds) {
+            watcher->wds = wds;
+        }
+        if (!dirs || !wds) {
+            ods_log_error("[%s] unable to watch directory %s: insufficient "
+                "memory", logstr, dir);
+            return ODS_STATUS_MALLOCERR;
+        }
+        watcher->max_dirs = max;
+    }
+    watcher->dirs[watcher->num_dirs] = strdup(dir);
+    if (!watcher->dirs[watcher->num_dirs]) {
+        return ODS_STATUS_MALLOCERR;
+    }
+    watcher->wds[watcher->num_dirs] = wd;
+    watcher->num_dirs++;
+    ods_log_debug("[%s] watching directory %s", logstr, dir);
+    return ODS_STATUS_OK;
+#else
+    (void) watcher;
+    (void) path;
+    return ODS_STATUS_NOTIMPL;
+#endif
+}
+
+
+/**
+ * Watch a file for a zone, the watcher is locked.
+ *
+ */
+static ods_status
+watcher_add_file(watcher_type* watcher, const char* file,
+    const char* zone_name, task_id what)
+{
+    watcher_file_type* wf = NULL;
+    char path[ODS_SE_MAXLINE];
+    ods_status status;
+    uint32_t b;
+    if (!watcher_path(file, path, sizeof(path))) {
+        ods_log_error("[%s] unable to watch file %s: name too long", logstr,
+            file);
+        return ODS_STATUS_STRFORMERR;
+    }
+    status = watcher_watch_dir(watcher, path);
+    if (status != ODS_STATUS_OK) {
+        return status;
+    }
+    wf = (watcher_file_type*) malloc(sizeof(watcher_file_type));
+    if (!wf) {
+        return ODS_STATUS_MALLOCERR;
+    }
+    wf->path = strdup(path);
+    wf->zone_name = zone_name ? strdup(zone_name) : NULL;
+    if (!wf->path || (zone_name && !wf->zone_name)) {
+        free((void*) wf->path);
+        free((void*) wf->zone_name);
+        free((void*) wf);
+        return ODS_STATUS_MALLOCERR;
+    }
+    wf->what = what;
+    b = watcher_hash(wf->path);
+    wf->next_path = watcher->by_path[b];
+    watcher->by_path[b] = wf;
+    if (zone_name) {
+        b = watcher_hash(zone_name);
+        wf->next_zone = watcher->by_zone[b];
+        watcher->by_zone[b] = wf;
+    } else {
+        wf->next_zone = NULL;
+    }
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Create file watcher.
+ *
+ */
+watcher_type*
+watcher_create(region_type* r, const char* zlfile)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    watcher_type* watcher = NULL;
+    ods_status status = ODS_STATUS_OK;
+    ods_log_assert(r);
+    ods_log_assert(zlfile);
+    watcher = (watcher_type*) region_alloc(r, sizeof(watcher_type));
+    watcher->engine = NULL;
+    watcher->need_to_exit = 0;
+    watcher->wds = NULL;
+    watcher->dirs = NULL;
+    watcher->num_dirs = 0;
+    watcher->max_dirs = 0;
+    watcher->by_path = (watcher_file_type**) calloc(WATCHER_TABLE_SIZE,
+        sizeof(watcher_file_type*));
+    watcher->by_zone = (watcher_file_type**) calloc(WATCHER_TABLE_SIZE,
+        sizeof(watcher_file_type*));
+    if (!watcher->by_path || !watcher->by_zone) {
+        ods_log_error("[%s] create watcher failed: insufficient memory",
+            logstr);
+        free((void*) watcher->by_path);
+        free((void*) watcher->by_zone);
+        return NULL;
+    }
+    watcher->fd = inotify_init();
+    if (watcher->fd < 0) {
+        ods_log_warning("[%s] inotify_init() failed: %s, polling for file "
+            "changes", logstr, strerror(errno));
+        free((void*) watcher->by_path);
+        free((void*) watcher->by_zone);
+        return NULL;
+    }
+    lock_basic_init(&watcher->w_lock);
+    status = watcher_add_file(watcher, zlfile, NULL, TASK_NONE);
+    if (status != ODS_STATUS_OK) {
+        ods_log_warning("[%s] unable to watch zonelist %s: %s, polling for "
+            "file changes", logstr, zlfile, ods_status2str(status));
+        watcher_cleanup(watcher);
+        return NULL;
+    }
+    return watcher;
+#else
+    ods_log_verbose("[%s] no file events available, polling for file "
+        "changes", logstr);
+    (void) r;
+    (void) zlfile;
+    return NULL;
+#endif
+}
+
+
+/**
+ * Watch the files of a zone.
+ *
+ */
+ods_status
+watcher_watch_zone(watcher_type* watcher, zone_type* zone)
+{
+    ods_status status = ODS_STATUS_OK;
+    if (!watcher || !zone || !zone->name) {
+        return ODS_STATUS_ASSERT;
+    }
+    lock_basic_lock(&watcher->w_lock);
+    if (zone->signconf_filename) {
+        status = watcher_add_file(watcher, zone->signconf_filename,
+            zone->name, TASK_CONF);
+    }
+    if (status == ODS_STATUS_OK && zone->adapter_in &&
+        zone->adapter_in->type != ADAPTER_DNS) {
+        status = watcher_add_file(watcher, zone->adapter_in->configstr,
+            zone->name, TASK_READ);
+    }
+    lock_basic_unlock(&watcher->w_lock);
+    if (status != ODS_STATUS_OK) {
+        ods_log_warning("[%s] unable to watch files of zone %s: %s", logstr,
+            zone->name, ods_status2str(status));
+    }
+    return status;
+}
+
+
+/**
+ * Whether the input of a zone is watched.
+ *
+ */
+int
+watcher_zone_watched(watcher_type* watcher, const char* name)
+{
+    watcher_file_type* wf = NULL;
+    int watched = 0;
+    if (!watcher || !name) {
+        return 0;
+    }
+    lock_basic_lock(&watcher->w_lock);
+    for (wf = watcher->by_zone[watcher_hash(name)]; wf; wf = wf->next_zone) {
+        if (wf->what == TASK_READ && strcmp(wf->zone_name, name) == 0) {
+            watched = 1;
+            break;
+        }
+    }
+    lock_basic_unlock(&watcher->w_lock);
+    return watched;
+}
+
+
+/**
+ * Stop watching the files of a zone.
+ *
+ */
+void
+watcher_forget_zone(watcher_type* watcher, const char* name)
+{
+    watcher_file_type** pz = NULL;
+    watcher_file_type** pp = NULL;
+    watcher_file_type* wf = NULL;
+    if (!watcher || !name) {
+        return;
+    }
+    lock_basic_lock(&watcher->w_lock);
+    pz = &watcher->by_zone[watcher_hash(name)];
+    while (*pz) {
+        wf = *pz;
+        if (strcmp(wf->zone_name, name) != 0) {
+            pz = &wf->next_zone;
+            continue;
+        }
+        *pz = wf->next_zone;
+        for (pp = &watcher->by_path[watcher_hash(wf->path)]; *pp;
+            pp = &(*pp)->next_path) {
+            if (*pp == wf) {
+                *pp = wf->next_path;
+                break;
+            }
+        }
+        free((void*) wf->path);
+        free((void*) wf->zone_name);
+        free((void*) wf);
+    }
+    lock_basic_unlock(&watcher->w_lock);
+    return;
+}
+
+
+/**
+ * Handle a changed file: schedule the tasks for the zones that use it.
+ *
+ */
+static void
+watcher_handle_file(watcher_type* watcher, const char* path)
+{
+    engine_type* engine = (engine_type*) watcher->engine;
+    watcher_file_type* wf = NULL;
+    zone_type* zone = NULL;
+    char* names[WATCHER_MAX_HITS];
+    task_id whats[WATCHER_MAX_HITS];
+    size_t hits = 0;
+    size_t scheduled = 0;
+    size_t i;
+    int reload = 0;
+    /* collect the zones, without holding other locks */
+    lock_basic_lock(&watcher->w_lock);
+    for (wf = watcher->by_path[watcher_hash(path)]; wf; wf = wf->next_path) {
+        if (strcmp(wf->path, path) != 0) {
+            continue;
+        }
+        if (!wf->zone_name) {
+            reload = 1;
+        } else if (hits < WATCHER_MAX_HITS) {
+            names[hits] = strdup(wf->zone_name);
+            whats[hits] = wf->what;
+            if (names[hits]) {
+                hits++;
+            }
+        } else {
+            ods_log_warning("[%s] file %s is used by more than %d zones, "
+                "leaving the others to the next update", logstr, path,
+                WATCHER_MAX_HITS);
+            break;
+        }
+    }
+    lock_basic_unlock(&watcher->w_lock);
+    if (reload) {
+        ods_log_verbose("[%s] zonelist %s changed", logstr, path);
+        engine->need_to_reload = 1;
+        lock_basic_lock(&engine->signal_lock);
+        lock_basic_alarm(&engine->signal_cond);
+        lock_basic_unlock(&engine->signal_lock);
+    }
+    if (!hits) {
+        return;
+    }
+    /* schedule */
+    lock_basic_lock(&engine->zlist->zl_lock);
+    lock_basic_lock(&engine->taskq->s_lock);
+    for (i=0; i < hits; i++) {
+        zone = zlist_lookup_zone_by_name(engine->zlist, names[i],
+            LDNS_RR_CLASS_IN);
+        if (zone && zone->task && zone->zl_status != ZONE_ZL_REMOVED) {
+            ods_log_verbose("[%s] file %s changed, schedule %s for zone %s",
+                logstr, path, task_what2str(whats[i]), zone->name);
+            if (zone_reschedule_task_locked(zone, engine->taskq, whats[i])
+                == ODS_STATUS_OK) {
+                scheduled++;
+            }
+        }
+        free((void*) names[i]);
+    }
+    lock_basic_unlock(&engine->taskq->s_lock);
+    lock_basic_unlock(&engine->zlist->zl_lock);
+    if (scheduled) {
+        engine_wakeup_workers(engine);
+    }
+    return;
+}
+
+
+/**
+ * Handle an event queue overflow: the changed files are unknown, so
+ * recheck the zonelist and reconfigure every watched zone, which also
+ * rereads its input.
+ *
+ */
+static void
+watcher_handle_overflow(watcher_type* watcher)
+{
+    engine_type* engine = (engine_type*) watcher->engine;
+    watcher_file_type* wf = NULL;
+    zone_type** zones = NULL;
+    zone_type* zone = NULL;
+    tree_node* node = TREE_NULL;
+    size_t nzones = 0;
+    size_t scheduled = 0;
+    size_t i;
+    ods_log_warning("[%s] event queue overflow, recheck zonelist and "
+        "all watched zones", logstr);
+    engine->need_to_reload = 1;
+    lock_basic_lock(&engine->signal_lock);
+    lock_basic_alarm(&engine->signal_cond);
+    lock_basic_unlock(&engine->signal_lock);
+    lock_basic_lock(&engine->zlist->zl_lock);
+    if (engine->zlist->zones && tree_count(engine->zlist->zones) > 0) {
+        zones = (zone_type**) malloc(tree_count(engine->zlist->zones) *
+            sizeof(zone_type*));
+        if (!zones) {
+            ods_log_error("[%s] unable to recheck zones: insufficient "
+                "memory", logstr);
+        }
+    }
+    /* collect the watched zones, zl_lock may be held with w_lock */
+    lock_basic_lock(&watcher->w_lock);
+    node = zones ? tree_first(engine->zlist->zones) : TREE_NULL;
+    while (node && node != TREE_NULL) {
+        zone = (zone_type*) node->data;
+        node = tree_next(node);
+        if (!zone->task || zone->zl_status == ZONE_ZL_REMOVED) {
+            continue;
+        }
+        for (wf = watcher->by_zone[watcher_hash(zone->name)]; wf;
+            wf = wf->next_zone) {
+            if (strcmp(wf->zone_name, zone->name) == 0) {
+                zones[nzones++] = zone;
+                break;
+            }
+        }
+    }
+    lock_basic_unlock(&watcher->w_lock);
+    /* schedule */
+    lock_basic_lock(&engine->taskq->s_lock);
+    for (i=0; i < nzones; i++) {
+        if (zone_reschedule_task_locked(zones[i], engine->taskq, TASK_CONF)
+            == ODS_STATUS_OK) {
+            scheduled++;
+        }
+    }
+    lock_basic_unlock(&engine->taskq->s_lock);
+    lock_basic_unlock(&engine->zlist->zl_lock);
+    free((void*) zones);
+    if (scheduled) {
+        ods_log_verbose("[%s] scheduled %lu zones after event queue "
+            "overflow", logstr, (unsigned long) scheduled);
+        engine_wakeup_workers(engine);
+    }
+    return;
+}
+
+
+/**
+ * Start file watcher.
+ *
+ */
+void
+watcher_start(watcher_type* watcher)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    union {
+        struct inotify_event event;
+        char buf[WATCHER_EVENTS_SIZE];
+    } events;
+    struct inotify_event* event = NULL;
+    char path[ODS_SE_MAXLINE];
+    const char* dir = NULL;
+    struct timeval tv;
+    fd_set rset;
+    ssize_t len = 0;
+    ssize_t off = 0;
+    size_t i;
+    int ret;
+    ods_log_assert(watcher);
+    ods_log_assert(watcher->engine);
+    ods_log_debug("[%s] start", logstr);
+    while (!watcher->need_to_exit) {
+        FD_ZERO(&rset);
+        FD_SET(watcher->fd, &rset);
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        ret = select(watcher->fd+1, &rset, NULL, NULL, &tv);
+        if (ret < 0) {
+            if (errno != EINTR) {
+                ods_log_error("[%s] select() failed: %s", logstr,
+                    strerror(errno));
+            }
+            continue;
+        } else if (ret == 0) {
+            continue;
+        }
+        len = read(watcher->fd, events.buf, sizeof(events.buf));
+        if (len <= 0) {
+            if (len < 0 && errno != EINTR && errno != EAGAIN) {
+                ods_log_error("[%s] read() failed: %s", logstr,
+                    strerror(errno));
+            }
+            continue;
+        }
+        for (off = 0; off + (ssize_t) sizeof(struct inotify_event) <= len;
+            off += sizeof(struct inotify_event) + event->len) {
+            event = (struct inotify_event*) (events.buf + off);
+            if (event->mask & IN_Q_OVERFLOW) {
+                watcher_handle_overflow(watcher);
+                continue;
+            }
+            if (!event->len) {
+                continue;
+            }
+            /* the directory table grows while zones are added */
+            dir = NULL;
+            lock_basic_lock(&watcher->w_lock);
+            for (i=0; i < watcher->num_dirs; i++) {
+                if (watcher->wds[i] == event->wd) {
+                    dir = watcher->dirs[i];
+                    (void)snprintf(path, sizeof(path), "%s%s%s", dir,
+                        dir[strlen(dir)-1] == '/' ? "" : "/", event->name);
+                    break;
+                }
+            }
+            lock_basic_unlock(&watcher->w_lock);
+            if (!dir) {
+                continue;
+            }
+            watcher_handle_file(watcher, path);
+        }
+    }
+    ods_log_debug("[%s] stop", logstr);
+#else
+    (void) watcher;
+    (void) watcher_handle_file;
+    (void) watcher_handle_overflow;
+#endif
+    return;
+}
+
+
+/**
+ * Clean up file watcher.
+ *
+ */
+void
+watcher_cleanup(watcher_type* watcher)
+{
+    watcher_file_type* wf = NULL;
+    watcher_file_type* next = NULL;
+    size_t i;
+    if (!watcher) {
+        return;
+    }
+    if (watcher->fd >= 0) {
+        close(watcher->fd);
+        watcher->fd = -1;
+    }
+    for (i=0; i < WATCHER_TABLE_SIZE; i++) {
+        for (wf = watcher->by_path[i]; wf; wf = next) {
+            next = wf->next_path;
+            free((void*) wf->path);
+            free((void*) wf->zone_name);
+            free((void*) wf);
+        }
+    }
+    for (i=0; i < watcher->num_dirs; i++) {
+        free((void*) watcher->dirs[i]);
+    }
+    free((void*) watcher->dirs);
+    free((void*) watcher->wds);
+    free((void*) watcher->by_path);
+    free((void*) watcher->by_zone);
+    lock_basic_destroy(&watcher->w_lock);
+    return;
+}
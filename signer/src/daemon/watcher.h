@@ -0,0 +1,133 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * File watcher.
+ *
+ */
+
+#ifndef DAEMON_WATCHER_H
+#define DAEMON_WATCHER_H
+
+#include "schedule/task.h"
+#include "signer/zone.h"
+#include "util/locks.h"
+#include "util/region.h"
+#include "util/status.h"
+
+struct engine_struct;
+
+#define WATCHER_TABLE_SIZE 16384
+
+/**
+ * Watched file.
+ *
+ */
+typedef struct watcher_file_struct watcher_file_type;
+struct watcher_file_struct {
+    char* path;
+    char* zone_name;               /* NULL for the zonelist */
+    task_id what;                  /* task to schedule on change */
+    watcher_file_type* next_path;
+    watcher_file_type* next_zone;
+};
+
+/**
+ * File watcher.
+ *
+ */
+typedef struct watcher_struct watcher_type;
+struct watcher_struct {
+    struct engine_struct* engine;
+    ods_thread_type thread_id;
+    int need_to_exit;
+    int fd;
+    /* watched directories */
+    int* wds;
+    char** dirs;
+    size_t num_dirs;
+    size_t max_dirs;
+    /* watched files, by path and by zone */
+    watcher_file_type** by_path;
+    watcher_file_type** by_zone;
+    lock_basic_type w_lock;
+};
+
+/**
+ * Create file watcher.
+ * @param r:      memory region.
+ * @param zlfile: zonelist file name.
+ * @return:       (watcher_type*) file watcher, NULL if file events are not
+ *                available and the signer should keep polling.
+ *
+ */
+watcher_type* watcher_create(region_type* r, const char* zlfile);
+
+/**
+ * Watch the files of a zone: the signconf file and the input file.
+ * @param watcher: file watcher.
+ * @param zone:    zone.
+ * @return:        (ods_status) status.
+ *
+ */
+ods_status watcher_watch_zone(watcher_type* watcher, zone_type* zone);
+
+/**
+ * Whether the input of a zone is watched.
+ * @param watcher: file watcher.
+ * @param name:    zone name.
+ * @return:        (int) 1 if changes to the input file are noticed, 0 if
+ *                 the zone has to be polled.
+ *
+ */
+int watcher_zone_watched(watcher_type* watcher, const char* name);
+
+/**
+ * Stop watching the files of a zone.
+ * @param watcher: file watcher.
+ * @param name:    zone name.
+ *
+ */
+void watcher_forget_zone(watcher_type* watcher, const char* name);
+
+/**
+ * Start file watcher. Schedules the task that a file change requires for
+ * the zones that use the file.
+ * @param watcher: file watcher.
+ *
+ */
+void watcher_start(watcher_type* watcher);
+
+/**
+ * Clean up file watcher.
+ * @param watcher: file watcher.
+ *
+ */
+void watcher_cleanup(watcher_type* watcher);
+
+#endif /* DAEMON_WATCHER_H */
@@ -103,6 +103,37 @@ worker_working_with(worker_type* worker, task_id with, task_id next,
 }
 
 
+/**
+ * Whether changes to the zone files are only noticed by polling.
+ *
+ */
+static int
+worker_zone_polled(worker_type* worker, zone_type* zone)
+{
+    engine_type* engine = (engine_type*) worker->engine;
+    return !engine->watcher ||
+        !watcher_zone_watched(engine->watcher, zone->name);
+}
+
+
+/**
+ * Time until the zone needs to be looked at again. Without a file watcher,
+ * changed files are only noticed by polling, so check back every minute.
+ *
+ */
+static time_t
+worker_recheck_interval(worker_type* worker, zone_type* zone)
+{
+    time_t resign = 0;
+    if (worker_zone_polled(worker, zone) || !zone->signconf ||
+        !zone->signconf->last_modified) {
+        return 60;
+    }
+    resign = duration2time(&zone->signconf->sig_resign_interval);
+    return resign > 60 ? resign : 60;
+}
+
+
 /**
  * Perform task.
  *
@@ -113,6 +144,7 @@ worker_perform_task(worker_type* worker)
     zone_type* zone;
     task_id what = TASK_NONE;
     time_t when = 0;
+    uint64_t start = 0;
     ods_status status = ODS_STATUS_OK;
     ods_log_assert(worker);
     ods_log_assert(worker->task);
@@ -134,7 +166,9 @@ worker_perform_task_conf:
             /* perform 'load signconf' task */
             worker_working_with(worker, TASK_CONF, TASK_READ, "configure",
                 task_who2str(worker->task), &what, &when);
+            start = stats_now_usec();
             status = tools_conf(zone);
+            stats_phase_done(&zone->stats, STATS_PHASE_CONF, start);
             if (status == ODS_STATUS_OK) {
                 worker->task->halted = TASK_NONE;
                 worker->task->interrupt = TASK_NONE;
@@ -170,7 +204,9 @@ worker_perform_task_read:
                     worker->thread_num, task_who2str(worker->task));
                 goto worker_perform_task_conf;
             }
+            start = stats_now_usec();
             status = tools_read(zone);
+            stats_phase_done(&zone->stats, STATS_PHASE_READ, start);
             if (status == ODS_STATUS_UNCHANGED) {
                 status = ODS_STATUS_OK;
             }
@@ -201,7 +237,9 @@ worker_perform_task_write:
             /* perform 'write' task */
             worker_working_with(worker, TASK_WRITE, TASK_SIGN, "write",
                 task_who2str(worker->task), &what, &when);
+            start = stats_now_usec();
             status = tools_write(zone);
+            stats_phase_done(&zone->stats, STATS_PHASE_WRITE, start);
             if (status == ODS_STATUS_OK) {
                 if (worker->task->interrupt > TASK_CONF) {
                     worker->task->interrupt = TASK_NONE;
@@ -213,13 +251,14 @@ worker_perform_task_write:
                 goto worker_perform_task_continue;
             }
 
-            when += 60;
+            when += worker_recheck_interval(worker, zone);
             break;
         case TASK_NONE:
         default:
             ods_log_warning("[%s[%i]] task %s not supported",
                 worker2str(worker->type), worker->thread_num,
                 task_what2str(worker->task->what));
+            when = time_now() + worker_recheck_interval(worker, zone);
             break;
     }
     /* no error */
@@ -295,6 +334,7 @@ worker_work(worker_type* worker)
     task_type* task;
     ods_status status;
     time_t timeout = 1;
+    int clear = 0;
     ods_log_assert(worker);
     ods_log_assert(worker->engine);
     ods_log_assert(worker->type == WORKER_WORKER);
@@ -325,12 +365,22 @@ worker_work(worker_type* worker)
                 &engine->taskq->s_lock, timeout);
             worker->task = (task_type*) schedule_next(engine->taskq);
         }
+        clear = 0;
+        if (worker->task) {
+            /* a clear command found the zone busy */
+            zone = (zone_type*) worker->task->zone;
+            clear = zone->clear_pending;
+            zone->clear_pending = 0;
+        }
         lock_basic_unlock(&engine->taskq->s_lock);
 
         /* do some work */
         if (worker->task) {
             zone = (zone_type*) worker->task->zone;
             lock_basic_lock(&zone->zone_lock);
+            if (clear) {
+                zone_clear(zone);
+            }
             ods_log_debug("[%s[%i]] start working on zone %s",
                 worker2str(worker->type), worker->thread_num, zone->name);
             worker->clock_in = now;
@@ -340,7 +390,9 @@ worker_work(worker_type* worker)
 
             /* schedule new task */
             lock_basic_lock(&engine->taskq->s_lock);
-            worker->task->when += 60;
+            if (worker_zone_polled(worker, zone)) {
+                worker->task->when += 60;
+            }
             status = schedule_task(engine->taskq, worker->task, 1);
             if (status != ODS_STATUS_OK) {
                 ods_log_crit("[%s[%i]] schedule task for zone %s failed: "
@@ -200,7 +200,7 @@ dname_name(const dname_type* dname)
  * Create domain name from data.
  *
  */
-static dname_type*
+dname_type*
 dname_create_frm_data(region_type* region, const uint8_t* wire)
 {
     uint8_t label_offsets[DNAME_MAXLEN];
@@ -441,7 +441,7 @@ dname_leftchop(region_type* region, dname_type* dname)
  */
 void dname_print(FILE* fd, dname_type* dname)
 {
-    static char buf[DNAME_MAXLEN*5];
+    char buf[DNAME_MAXLEN*5];
     size_t i;
     size_t labels_to_convert;
     char* dst;
@@ -537,6 +537,9 @@ void
 dname_log(dname_type* dname, const char* pre, int level)
 {
     char str[DNAME_MAXLEN*5];
+    if (!ods_log_enabled(level)) {
+        return;
+    }
     dname_str(dname, &str[0]);
     if (level == LOG_EMERG) {
         ods_fatal_exit("%s: %s",  pre?pre:"", str);
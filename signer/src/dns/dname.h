@@ -156,6 +156,16 @@ const uint8_t* dname_name(const dname_type* dname);
  */
 dname_type* dname_create(region_type* r, const char* str);
 
+/**
+ * Create new domain name from wire format.
+ * @param r:           memory region.
+ * @param wire:        uncompressed wire format.
+ * @return:            (dname_type*) created domain name, NULL if the wire
+ *                     format contains pointers or is too long.
+ *
+ */
+dname_type* dname_create_frm_data(region_type* r, const uint8_t* wire);
+
 /**
  * Clone domain name.
  * @param r:           memory region.
@@ -195,6 +195,22 @@ static rrstruct_type dns_rrstructs[(DNS_NUMRRTYPES+1)] = {
 };
 
 
+/* Perfect hash of the RR type mnemonics above, see dns_rrtype_hash():
+ * maps the hash value to the index in dns_rrstructs. Regenerate it when
+ * adding types; a name that is not found here is looked up the slow way. */
+static const uint8_t dns_rrtype_hashtable[256] = {
+    [  3] = 21, [ 12] = 25, [ 15] = 13, [ 23] = 20, [ 43] = 11, [ 44] =  6,
+    [ 51] = 32, [ 56] =  9, [ 59] = 43, [ 62] = 10, [ 82] = 50, [ 84] =  7,
+    [ 88] = 42, [ 89] =  2, [ 94] = 30, [ 98] = 49, [ 99] = 27, [108] =  8,
+    [111] = 45, [115] = 28, [117] = 14, [118] = 26, [129] = 41, [138] = 17,
+    [139] = 37, [140] = 12, [145] =  3, [160] = 22, [163] = 47, [164] = 44,
+    [170] = 51, [174] = 48, [175] = 33, [185] = 40, [189] = 31, [191] = 16,
+    [202] = 39, [204] = 29, [205] =  4, [207] = 24, [225] = 35, [229] = 18,
+    [230] = 46, [231] = 36, [233] =  5, [235] = 19, [237] = 15, [239] = 23,
+    [243] =  1, [245] = 34, [255] = 38,
+};
+
+
 /**
  * Get RR class by name.
  *
@@ -227,6 +243,21 @@ dns_rrclass_by_type(uint16_t type)
 }
 
 
+/**
+ * Hash a RR type mnemonic, case insensitive.
+ *
+ */
+static uint8_t
+dns_rrtype_hash(const char* name)
+{
+    uint32_t h = 0;
+    while (*name) {
+        h = h * 106 + (uint8_t) (*name++ | 0x20);
+    }
+    return (uint8_t) ((h * 0x9e3779b1) >> 24);
+}
+
+
 /**
  * Get RR structure by name.
  *
@@ -234,7 +265,10 @@ dns_rrclass_by_type(uint16_t type)
 rrstruct_type*
 dns_rrstruct_by_name(const char* name)
 {
-    int i;
+    int i = dns_rrtype_hashtable[dns_rrtype_hash(name)];
+    if (i && strcasecmp(dns_rrstructs[i].name, name) == 0) {
+        return &dns_rrstructs[i];
+    }
     for (i = 1; i < DNS_NUMRRTYPES; i++) {
         if (dns_rrstructs[i].name &&
             strcasecmp(dns_rrstructs[i].name, name) == 0) {
@@ -100,6 +100,22 @@
 #define DNS_TYPE_NSEC3      50   /* RFC 5155: Next hashed domain */
 #define DNS_TYPE_NSEC3PARAM 51   /* RFC 5155: NSEC3 parameters */
 
+/** Query TYPE */
+#define DNS_TYPE_IXFR      251   /* RFC 1995: incremental zone transfer */
+#define DNS_TYPE_AXFR      252   /* RFC 1035: transfer of an entire zone */
+
+/** OPCODE */
+#define DNS_OPCODE_QUERY     0   /* RFC 1035: standard query */
+
+/** RCODE */
+#define DNS_RCODE_NOERROR    0   /* RFC 1035: no error */
+#define DNS_RCODE_FORMERR    1   /* RFC 1035: format error */
+#define DNS_RCODE_SERVFAIL   2   /* RFC 1035: server failure */
+#define DNS_RCODE_NXDOMAIN   3   /* RFC 1035: name error */
+#define DNS_RCODE_NOTIMPL    4   /* RFC 1035: not implemented */
+#define DNS_RCODE_REFUSED    5   /* RFC 1035: refused */
+#define DNS_RCODE_NOTAUTH    9   /* RFC 2136: not authoritative */
+
 #define DNS_NUMRRCLASSES DNS_CLASS_HS+1 /* +1 for CLASS0 */
 #define DNS_NUMRRTYPES   DNS_TYPE_NSEC3PARAM+1  /* +1 for TYPE0 */
 
@@ -141,6 +157,7 @@ typedef enum dns_rdata_format_enum dns_rdata_format;
 
 #define DNS_RDATA_MAX 9
 #define DNS_STRLEN_MAX 256
+#define DNS_IPV4_ADDRLEN (32/8)
 #define DNS_IPV6_ADDRLEN (128/8)
 #define DNS_RDLEN_MAX 65535
 #define DNS_APL_N_MASK 0x80U
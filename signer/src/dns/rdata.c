@@ -61,6 +61,21 @@ rdata_init_data(region_type *region, const void *data, size_t size)
 }
 
 
+/**
+ * Allocate rdata.
+ *
+ */
+uint16_t*
+rdata_alloc_data(region_type *region, size_t size)
+{
+    uint16_t *result = region_alloc(region, sizeof(uint16_t) + size);
+    if (result) {
+        *result = size;
+    }
+    return result;
+}
+
+
 /**
  * Get size of rdata element.
  *
@@ -61,6 +61,14 @@ union rdata_union {
  */
 uint16_t* rdata_init_data(region_type* region, const void* data, size_t size);
 
+/**
+ * Allocate rdata for size bytes of data, to be filled in by the caller.
+ * @param region: memory region.
+ * @param size:   size of data.
+ *
+ */
+uint16_t* rdata_alloc_data(region_type* region, size_t size);
+
 /**
  * Get size of rdata element.
  * @param rdata:  rdata.
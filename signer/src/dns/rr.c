@@ -33,6 +33,7 @@
 
 #include "dns/dns.h"
 #include "dns/rr.h"
+#include "wire/buffer.h"
 
 /*
 static const char* logstr = "rr";
@@ -45,15 +46,29 @@ static const char* logstr = "rr";
  */
 rr_type*
 rr_clone(region_type* region, rr_type* rr)
+{
+    ods_log_assert(region);
+    ods_log_assert(rr);
+    return rr_clone_owner(region, rr, dname_clone(region, rr->owner));
+}
+
+
+/**
+ * Clone record, sharing the owner name.
+ *
+ */
+rr_type*
+rr_clone_owner(region_type* region, rr_type* rr, dname_type* owner)
 {
     size_t i;
     rrstruct_type* rrstruct;
     rr_type* clone;
     ods_log_assert(region);
     ods_log_assert(rr);
+    ods_log_assert(owner);
     rrstruct = dns_rrstruct_by_type(rr->type);
     clone = (rr_type*) region_alloc(region, sizeof(rr_type));
-    clone->owner = dname_clone(region, rr->owner);
+    clone->owner = owner;
     clone->rdata = (rdata_type*) region_alloc(region,
         rr->rdlen * sizeof(rdata_type));
     clone->ttl = rr->ttl;
@@ -150,6 +165,186 @@ rr_compare_rdata(rr_type* rr1, rr_type* rr2)
 }
 
 
+/**
+ * Does the rr type have domain names in RDATA that are lowercased in
+ * canonical form (RFC 4034, section 6.2 and RFC 6840, section 5.1)?
+ *
+ */
+static int
+rr_lowercase_rdata(uint16_t type)
+{
+    switch (type) {
+        case DNS_TYPE_NS:
+        case DNS_TYPE_MD:
+        case DNS_TYPE_MF:
+        case DNS_TYPE_CNAME:
+        case DNS_TYPE_SOA:
+        case DNS_TYPE_MB:
+        case DNS_TYPE_MG:
+        case DNS_TYPE_MR:
+        case DNS_TYPE_PTR:
+        case DNS_TYPE_MINFO:
+        case DNS_TYPE_MX:
+        case DNS_TYPE_RP:
+        case DNS_TYPE_AFSDB:
+        case DNS_TYPE_RT:
+        case DNS_TYPE_SIG:
+        case DNS_TYPE_PX:
+        case DNS_TYPE_NXT:
+        case DNS_TYPE_NAPTR:
+        case DNS_TYPE_KX:
+        case DNS_TYPE_SRV:
+        case DNS_TYPE_DNAME:
+        case DNS_TYPE_A6:
+        case DNS_TYPE_RRSIG:
+            return 1;
+        default:
+            break;
+    }
+    return 0;
+}
+
+
+/**
+ * Write domain name to buffer, lowercased if requested. The caller checks
+ * that there is room in the buffer.
+ *
+ */
+static void
+rr_write_dname(buffer_type* buffer, dname_type* dname, unsigned lowercase)
+{
+    const uint8_t* name = dname_name(dname);
+    uint8_t* p = buffer_current(buffer);
+    size_t len = dname_len(dname);
+    size_t i;
+    if (!lowercase) {
+        buffer_write(buffer, name, len);
+        return;
+    }
+    /* label lengths are below 'A', so they are left alone */
+    for (i=0; i < len; i++) {
+        p[i] = (name[i] >= 'A' && name[i] <= 'Z') ? name[i] + ('a' - 'A') :
+            name[i];
+    }
+    buffer_skip(buffer, len);
+    return;
+}
+
+
+/**
+ * Write rdlength and RDATA in wire format.
+ *
+ */
+static int
+rr_write_rdata(rr_type* rr, buffer_type* buffer, unsigned canonical)
+{
+    size_t i;
+    size_t mark;
+    size_t rdpos;
+    size_t len;
+    const void* data;
+    dname_type* dname;
+    unsigned lowercase = canonical && rr_lowercase_rdata(rr->type);
+    rrstruct_type* rrstruct;
+    mark = buffer_position(buffer);
+    if (!buffer_available(buffer, 2)) {
+        return 0;
+    }
+    rdpos = buffer_position(buffer);
+    buffer_write_u16(buffer, 0);
+    rrstruct = dns_rrstruct_by_type(rr->type);
+    for (i=0; i < rr->rdlen; i++) {
+        dname = NULL;
+        data = NULL;
+        len = 0;
+        switch (rrstruct->rdata[i]) {
+            case DNS_RDATA_COMPRESSED_DNAME:
+            case DNS_RDATA_UNCOMPRESSED_DNAME:
+                dname = rdata_get_dname(&rr->rdata[i]);
+                break;
+            case DNS_RDATA_IPSECGATEWAY:
+                /* no gateway (0) or a domain name (3) */
+                if (rr->rdlen > 1 && rdata_get_data(&rr->rdata[1])[0] == 3) {
+                    dname = rdata_get_dname(&rr->rdata[i]);
+                } else if (rr->rdlen > 1 &&
+                    rdata_get_data(&rr->rdata[1])[0] != 0) {
+                    len = rdata_size(&rr->rdata[i]);
+                    data = rdata_get_data(&rr->rdata[i]);
+                }
+                break;
+            case DNS_RDATA_BASE32HEX:
+                /* kept without its length octet */
+                len = rdata_size(&rr->rdata[i]);
+                data = rdata_get_data(&rr->rdata[i]);
+                if (!buffer_available(buffer, 1)) {
+                    buffer_set_position(buffer, mark);
+                    return 0;
+                }
+                buffer_write_u8(buffer, (uint8_t) len);
+                break;
+            default:
+                len = rdata_size(&rr->rdata[i]);
+                data = rdata_get_data(&rr->rdata[i]);
+                break;
+        }
+        if (dname) {
+            len = dname_len(dname);
+        }
+        if (!buffer_available(buffer, len)) {
+            buffer_set_position(buffer, mark);
+            return 0;
+        }
+        if (dname) {
+            rr_write_dname(buffer, dname, lowercase);
+        } else if (len) {
+            buffer_write(buffer, data, len);
+        }
+    }
+    buffer_write_u16_at(buffer, rdpos,
+        (uint16_t) (buffer_position(buffer) - rdpos - 2));
+    return 1;
+}
+
+
+/**
+ * Write rr in uncompressed wire format.
+ *
+ */
+int
+rr_write_wire(rr_type* rr, buffer_type* buffer)
+{
+    size_t mark;
+    ods_log_assert(rr);
+    ods_log_assert(buffer);
+    mark = buffer_position(buffer);
+    if (!buffer_available(buffer, dname_len(rr->owner) + 8)) {
+        return 0;
+    }
+    buffer_write(buffer, dname_name(rr->owner), dname_len(rr->owner));
+    buffer_write_u16(buffer, rr->type);
+    buffer_write_u16(buffer, rr->klass);
+    buffer_write_u32(buffer, rr->ttl);
+    if (!rr_write_rdata(rr, buffer, 0)) {
+        buffer_set_position(buffer, mark);
+        return 0;
+    }
+    return 1;
+}
+
+
+/**
+ * Write rdlength and RDATA in canonical form.
+ *
+ */
+int
+rr_write_rdata_canonical(rr_type* rr, buffer_type* buffer)
+{
+    ods_log_assert(rr);
+    ods_log_assert(buffer);
+    return rr_write_rdata(rr, buffer, 1);
+}
+
+
 /**
  * Print RRtype.
  *
@@ -225,6 +420,9 @@ rr_log(rr_type* rr, const char* pre, int level)
     char rrklass[11];
     ods_log_assert(rr);
     ods_log_assert(rr->owner);
+    if (!ods_log_enabled(level)) {
+        return;
+    }
     dname_str(rr->owner, &str[0]);
     (void)snprintf(&rrtype[0], 10, "TYPE%u", (unsigned) rr->type);
     (void)snprintf(&rrklass[0], 10, "CLASS%u", (unsigned) rr->klass);
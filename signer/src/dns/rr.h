@@ -41,6 +41,7 @@
 
 #include <stdio.h>
 
+struct buffer_struct;
 
 /**
  * Resource record structure.
@@ -64,6 +65,17 @@ struct rr_struct {
  */
 rr_type* rr_clone(region_type* region, rr_type* rr);
 
+/**
+ * Clone record, but share an owner name that is already stored in the
+ * region, such as the name of the domain the record goes into.
+ * @param region: memory region.
+ * @param rr:     rr.
+ * @param owner:  owner name to use.
+ * @return:       (rr_type*) cloned rr.
+ *
+ */
+rr_type* rr_clone_owner(region_type* region, rr_type* rr, dname_type* owner);
+
 /**
  * Compare records.
  * @param rr1:    one record.
@@ -73,6 +85,28 @@ rr_type* rr_clone(region_type* region, rr_type* rr);
  */
 int rr_compare_rdata(rr_type* rr1, rr_type* rr2);
 
+/**
+ * Write rr in uncompressed wire format to buffer.
+ * @param rr:     rr.
+ * @param buffer: buffer.
+ * @return:       (int) 1 if written, 0 if the buffer has no room left (the
+ *                buffer position is left unchanged).
+ *
+ */
+int rr_write_wire(rr_type* rr, struct buffer_struct* buffer);
+
+/**
+ * Write rdlength and RDATA in canonical form (RFC 4034, section 6.2) to
+ * buffer: uncompressed, with domain names lowercased for the rr types
+ * that require it.
+ * @param rr:     rr.
+ * @param buffer: buffer.
+ * @return:       (int) 1 if written, 0 if the buffer has no room left (the
+ *                buffer position is left unchanged).
+ *
+ */
+int rr_write_rdata_canonical(rr_type* rr, struct buffer_struct* buffer);
+
 /**
  * Print rr type.
  * @param fd:     file descriptor.
@@ -0,0 +1,319 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * OpenDNSSEC zone file checker.
+ *
+ */
+
+#include "config.h"
+#include "dns/dns.h"
+#include "rzonec/rzonec.h"
+#include "util/locks.h"
+#include "util/log.h"
+
+#include <getopt.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define AUTHOR_NAME "Jelte Jansen, Matthijs Mekking"
+#define COPYRIGHT_STR "Copyright (C) 2008-2013 NLnet Labs OpenDNSSEC"
+#define ZONECHECK_MAX_JOBS 256
+
+/**
+ * Result of checking one zone file.
+ *
+ */
+typedef struct zonecheck_struct zonecheck_type;
+struct zonecheck_struct {
+    const char* file;
+    unsigned int errors;
+    unsigned int numrrs;
+    unsigned int rrcount[DNS_NUMRRTYPES];
+};
+
+static zonecheck_type* zonecheck_files = NULL;
+static size_t zonecheck_count = 0;
+static size_t zonecheck_next = 0;
+static const char* zonecheck_origin = NULL;
+static int zonecheck_quiet = 0;
+static lock_basic_type zonecheck_lock;
+
+
+/**
+ * Prints usage.
+ *
+ */
+static void
+usage(FILE* out)
+{
+    fprintf(out, "Usage: %s [OPTIONS] <zonefile>...\n", "ttods-zonecheck");
+    fprintf(out, "Check the syntax and rdata of unsigned zone files.\n\n");
+    fprintf(out, "Supported options:\n");
+    fprintf(out, " -j | --jobs <num>       Check this many files in "
+                 "parallel.\n");
+    fprintf(out, " -o | --origin <zone>    Zone name, default is the file "
+                 "name\n"
+                 "                         without a .zone suffix.\n");
+    fprintf(out, " -q | --quiet            Only report errors.\n");
+    fprintf(out, " -h | --help             Show this help and exit.\n");
+    fprintf(out, " -v | --verbose          Increase verbosity.\n");
+    fprintf(out, " -V | --version          Show version and exit.\n");
+    fprintf(out, "\nBSD licensed, see LICENSE in source package for "
+                 "details.\n");
+    fprintf(out, "Version %s. Report bugs to <%s>.\n",
+        PACKAGE_VERSION, PACKAGE_BUGREPORT);
+}
+
+
+/**
+ * Prints version.
+ *
+ */
+static void
+version(FILE* out)
+{
+    fprintf(out, "%s version %s\n", PACKAGE_NAME, PACKAGE_VERSION);
+    fprintf(out, "Written by %s.\n\n", AUTHOR_NAME);
+    fprintf(out, "%s.  This is free software.\n", COPYRIGHT_STR);
+    fprintf(out, "See source files for more license information\n");
+    exit(0);
+}
+
+
+/**
+ * Check one zone file.
+ *
+ */
+static void
+zonecheck_file(zonecheck_type* zc)
+{
+    char origin[DNAME_MAXLEN*5];
+    char path[ODS_SE_MAXLINE];
+    char* base = NULL;
+    size_t len;
+    zparser_type* parser = NULL;
+
+    if (zonecheck_origin) {
+        (void)strlcpy(origin, zonecheck_origin, sizeof(origin));
+    } else {
+        (void)strlcpy(path, zc->file, sizeof(path));
+        base = basename(path);
+        (void)strlcpy(origin, base, sizeof(origin));
+        len = strlen(origin);
+        if (len > 5 && strcmp(origin + len - 5, ".zone") == 0) {
+            origin[len - 5] = '\0';
+        }
+    }
+    if (access(zc->file, R_OK) != 0) {
+        ods_log_error("[zonecheck] error: %s: cannot read file", zc->file);
+        zc->errors++;
+        return;
+    }
+    parser = zparser_create_check(origin);
+    if (!parser) {
+        ods_log_error("[zonecheck] error: %s: bad origin %s", zc->file,
+            origin);
+        zc->errors++;
+        return;
+    }
+    (void)zparser_read_zone(parser, zc->file);
+    zc->errors += parser->totalerrors;
+    zc->numrrs = parser->numrrs;
+    memcpy(zc->rrcount, parser->rrcount, sizeof(zc->rrcount));
+    if (zc->rrcount[DNS_TYPE_SOA] != 1) {
+        ods_log_error("[zonecheck] error: %s: zone has %u soa records, "
+            "expected one", zc->file, zc->rrcount[DNS_TYPE_SOA]);
+        zc->errors++;
+    }
+    zparser_cleanup(parser);
+    return;
+}
+
+
+/**
+ * Check zone files until there are none left.
+ *
+ */
+static void*
+zonecheck_worker(void* arg)
+{
+    zonecheck_type* zc = NULL;
+    size_t i;
+    (void)arg;
+    while ((i = __sync_fetch_and_add(&zonecheck_next, 1)) < zonecheck_count) {
+        zc = &zonecheck_files[i];
+        zonecheck_file(zc);
+        if (zc->errors || !zonecheck_quiet) {
+            lock_basic_lock(&zonecheck_lock);
+            fprintf(stdout, "%s: %u records, %u errors\n", zc->file,
+                zc->numrrs, zc->errors);
+            lock_basic_unlock(&zonecheck_lock);
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Print the number of records per type over all files.
+ *
+ */
+static void
+zonecheck_summary(unsigned int failed)
+{
+    unsigned int rrcount[DNS_NUMRRTYPES];
+    unsigned int numrrs = 0;
+    size_t i, t;
+    rrstruct_type* rs = NULL;
+
+    memset(rrcount, 0, sizeof(rrcount));
+    for (i = 0; i < zonecheck_count; i++) {
+        numrrs += zonecheck_files[i].numrrs;
+        for (t = 0; t < DNS_NUMRRTYPES; t++) {
+            rrcount[t] += zonecheck_files[i].rrcount[t];
+        }
+    }
+    for (t = 1; t < DNS_NUMRRTYPES; t++) {
+        if (rrcount[t]) {
+            rs = dns_rrstruct_by_type((uint16_t) t);
+            fprintf(stdout, "%-10s %u\n", rs->name, rrcount[t]);
+        }
+    }
+    fprintf(stdout, "%u files, %u records, %u files with errors\n",
+        (unsigned) zonecheck_count, numrrs, failed);
+    return;
+}
+
+
+/**
+ * Main. Check the zone files.
+ *
+ */
+int
+main(int argc, char* argv[])
+{
+    int c;
+    int options_index = 0;
+    int cmdline_verbosity = 0;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int failed = 0;
+    size_t i;
+    ods_thread_type* threads = NULL;
+    static struct option long_options[] = {
+        {"jobs", required_argument, 0, 'j'},
+        {"origin", required_argument, 0, 'o'},
+        {"quiet", no_argument, 0, 'q'},
+        {"help", no_argument, 0, 'h'},
+        {"verbose", no_argument, 0, 'v'},
+        {"version", no_argument, 0, 'V'},
+        { 0, 0, 0, 0}
+    };
+    /* parse the commandline */
+    while ((c=getopt_long(argc, argv, "j:o:qhvV",
+        long_options, &options_index)) != -1) {
+        switch (c) {
+            case 'j':
+                jobs = atol(optarg);
+                break;
+            case 'o':
+                zonecheck_origin = optarg;
+                break;
+            case 'q':
+                zonecheck_quiet = 1;
+                break;
+            case 'h':
+                usage(stdout);
+                exit(0);
+                break;
+            case 'v':
+                cmdline_verbosity++;
+                break;
+            case 'V':
+                version(stdout);
+                exit(0);
+                break;
+            default:
+                usage(stderr);
+                exit(2);
+                break;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc == 0) {
+        usage(stderr);
+        exit(2);
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    } else if (jobs > ZONECHECK_MAX_JOBS) {
+        jobs = ZONECHECK_MAX_JOBS;
+    }
+    if ((size_t) jobs > (size_t) argc) {
+        jobs = argc;
+    }
+
+    /* errors go to stderr */
+    ods_log_init(NULL, 0, cmdline_verbosity);
+    zonecheck_count = (size_t) argc;
+    zonecheck_files = (zonecheck_type*) calloc(zonecheck_count,
+        sizeof(zonecheck_type));
+    threads = (ods_thread_type*) calloc((size_t) jobs,
+        sizeof(ods_thread_type));
+    if (!zonecheck_files || !threads) {
+        fprintf(stderr, "ttods-zonecheck: out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < zonecheck_count; i++) {
+        zonecheck_files[i].file = argv[i];
+    }
+    lock_basic_init(&zonecheck_lock);
+    for (i = 0; i < (size_t) jobs; i++) {
+        ods_thread_create(&threads[i], zonecheck_worker, NULL);
+    }
+    for (i = 0; i < (size_t) jobs; i++) {
+        ods_thread_join(threads[i]);
+    }
+    lock_basic_destroy(&zonecheck_lock);
+
+    for (i = 0; i < zonecheck_count; i++) {
+        if (zonecheck_files[i].errors) {
+            failed++;
+        }
+    }
+    if (!zonecheck_quiet) {
+        zonecheck_summary(failed);
+    }
+    free(threads);
+    free(zonecheck_files);
+    return failed ? 1 : 0;
+}
@@ -33,55 +33,71 @@
 
 #include "config.h"
 #include "parser/confparser.h"
+#include "util/locks.h"
 #include "util/log.h"
 #include "util/status.h"
 
-#include <libxml/xpath.h>
 #include <libxml/relaxng.h>
 #include <libxml/xmlreader.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 
 static const char* logstr = "parser";
 
 
+#define PARSER_MAX_SCHEMAS 4
+#define PARSER_PATH_SIZE 128
+
 /**
- * Check config file with rng file.
+ * Compiled RelaxNG schemas, one per rng file. Schemas are compiled the
+ * first time they are needed and kept until parser_cleanup().
  *
  */
-ods_status
-parser_filecheck(const char* cfgfile, const char* rngfile)
+typedef struct parser_schema_struct parser_schema_type;
+struct parser_schema_struct {
+    char* rngfile;
+    xmlRelaxNGPtr schema;
+};
+static parser_schema_type parser_schemas[PARSER_MAX_SCHEMAS];
+static lock_basic_type parser_lock;
+
+
+/**
+ * Initialize the parser.
+ *
+ */
+void
+parser_init(void)
+{
+    memset(parser_schemas, 0, sizeof(parser_schemas));
+    lock_basic_init(&parser_lock);
+    return;
+}
+
+
+/**
+ * Compile a RelaxNG schema.
+ *
+ */
+static xmlRelaxNGPtr
+parser_schema_compile(const char* rngfile)
 {
-    xmlDocPtr doc = NULL;
     xmlDocPtr rngdoc = NULL;
     xmlRelaxNGParserCtxtPtr rngpctx = NULL;
-    xmlRelaxNGValidCtxtPtr rngctx = NULL;
     xmlRelaxNGPtr schema = NULL;
-    int status = 0;
-    ods_log_debug("[%s] check cfgfile %s with rngfile %s", logstr,
-        cfgfile, rngfile);
-    ods_log_assert(cfgfile);
-    ods_log_assert(rngfile);
-    /* Load xml document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] parse cfgfile %s failed", logstr, cfgfile);
-        return ODS_STATUS_XMLERR;
-    }
     /* Load rng document */
     rngdoc = xmlParseFile(rngfile);
     if (rngdoc == NULL) {
         ods_log_error("[%s] parse rngfile %s failed", logstr, rngfile);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_XMLERR;
+        return NULL;
     }
     /* Create an XML RelaxNGs parser context for the relax-ng document. */
     rngpctx = xmlRelaxNGNewDocParserCtxt(rngdoc);
     if (rngpctx == NULL) {
         ods_log_error("[%s] create parser failed", logstr);
         xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_XMLERR;
+        return NULL;
     }
     /* Parse a schema definition resource and
      * build an internal XML schema structure.
@@ -89,322 +105,357 @@ parser_filecheck(const char* cfgfile, const char* rngfile)
     schema = xmlRelaxNGParse(rngpctx);
     if (schema == NULL) {
         ods_log_error("[%s] relaxng parse failed", logstr);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNGERR;
     }
-    /* Create an XML RelaxNGs validation context. */
-    rngctx = xmlRelaxNGNewValidCtxt(schema);
-    if (rngctx == NULL) {
-        ods_log_error("[%s] relaxng create failed", logstr);
-        xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNGERR;
-    }
-    /* Validate a document tree in memory. */
-    status = xmlRelaxNGValidateDoc(rngctx,doc);
-    if (status != 0) {
-        ods_log_error("[%s] relaxng validate failed", logstr);
-        xmlRelaxNGFreeValidCtxt(rngctx);
-        xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNGERR;
-    }
-    xmlRelaxNGFreeValidCtxt(rngctx);
-    xmlRelaxNGFree(schema);
     xmlRelaxNGFreeParserCtxt(rngpctx);
     xmlFreeDoc(rngdoc);
-    xmlFreeDoc(doc);
-    return ODS_STATUS_OK;
+    return schema;
 }
 
 
 /**
- * Parse elements from the configuration file, given an expression.
+ * Look up the compiled schema for a rng file, compile it if needed.
  *
  */
-const char*
-parser_conf_string(const char* cfgfile, const char* expr, int required)
+static xmlRelaxNGPtr
+parser_schema(const char* rngfile)
 {
-    xmlDocPtr doc = NULL;
-    xmlXPathContextPtr xpathCtx = NULL;
-    xmlXPathObjectPtr xpathObj = NULL;
-    xmlChar *xexpr = NULL;
-    const char* string = NULL;
-    ods_log_assert(cfgfile);
-    ods_log_assert(expr);
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] parse cfgfile %s failed", logstr, cfgfile);
-        return NULL;
-    }
-    /* Create xpath evaluation context */
-    xpathCtx = xmlXPathNewContext(doc);
-    if (xpathCtx == NULL) {
-        ods_log_error("[%s] create ctx failed", logstr);
-        xmlFreeDoc(doc);
-        return NULL;
-    }
-    /* Get string */
-    xexpr = (unsigned char*) expr;
-    xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
-    if (xpathObj == NULL || xpathObj->nodesetval == NULL ||
-        xpathObj->nodesetval->nodeNr <= 0) {
-        if (required) {
-            ods_log_error("[%s] unable to evaluate expression %s in cfgile %s",
-                logstr, (char*) xexpr, cfgfile);
-        }
-        xmlXPathFreeContext(xpathCtx);
-        if (xpathObj) {
-            xmlXPathFreeObject(xpathObj);
+    xmlRelaxNGPtr schema = NULL;
+    int i;
+    lock_basic_lock(&parser_lock);
+    for (i=0; i < PARSER_MAX_SCHEMAS && parser_schemas[i].rngfile; i++) {
+        if (strcmp(parser_schemas[i].rngfile, rngfile) == 0) {
+            schema = parser_schemas[i].schema;
+            lock_basic_unlock(&parser_lock);
+            return schema;
         }
-        xmlFreeDoc(doc);
-        return NULL;
     }
-    if (xpathObj->nodesetval != NULL &&
-        xpathObj->nodesetval->nodeNr > 0) {
-        string = (const char*) xmlXPathCastToString(xpathObj);
-        xmlXPathFreeContext(xpathCtx);
-        xmlXPathFreeObject(xpathObj);
-        xmlFreeDoc(doc);
-        return string;
+    schema = parser_schema_compile(rngfile);
+    if (schema && i < PARSER_MAX_SCHEMAS) {
+        parser_schemas[i].rngfile = strdup(rngfile);
+        if (parser_schemas[i].rngfile) {
+            parser_schemas[i].schema = schema;
+            lock_basic_unlock(&parser_lock);
+            return schema;
+        }
     }
-    xmlXPathFreeContext(xpathCtx);
-    xmlXPathFreeObject(xpathObj);
-    xmlFreeDoc(doc);
-    return NULL;
+    lock_basic_unlock(&parser_lock);
+    /* not cached: caller owns the schema */
+    return schema;
 }
 
 
 /**
- * Parse string elements from the configuration file.
+ * Is this schema in the cache?
  *
  */
-const char*
-parser_conf_log_filename(region_type* r, const char* cfgfile)
+static int
+parser_schema_cached(xmlRelaxNGPtr schema)
 {
-    const char* dup = NULL;
-    const char* str = parser_conf_string(cfgfile,
-        "//Configuration/Common/Logging/Syslog/Facility",
-        0);
-    ods_log_assert(r);
-    if (!str) {
-        str = parser_conf_string(cfgfile,
-            "//Configuration/Common/Logging/File/Filename",
-            0);
-    }
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    int i;
+    int cached = 0;
+    lock_basic_lock(&parser_lock);
+    for (i=0; i < PARSER_MAX_SCHEMAS; i++) {
+        if (parser_schemas[i].schema == schema) {
+            cached = 1;
+            break;
+        }
     }
-    return dup; /* NULL, Facility or Filename */
+    lock_basic_unlock(&parser_lock);
+    return cached;
 }
 
-const char*
-parser_conf_zonelist_filename(region_type* r, const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Common/ZoneListFile",
-        1);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
-    }
-    return dup;
-}
 
-const char*
-parser_conf_clisock_filename(region_type* r, const char* cfgfile)
+/**
+ * Load a configuration file and validate it against a rng file.
+ *
+ */
+ods_status
+parser_doc_load(const char* cfgfile, const char* rngfile, xmlDocPtr* doc)
 {
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/SocketFile",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
-    } else {
-        dup = region_strdup(r, ODS_SE_SOCKFILE);
+    xmlRelaxNGValidCtxtPtr rngctx = NULL;
+    xmlRelaxNGPtr schema = NULL;
+    int status = 0;
+    ods_log_assert(cfgfile);
+    ods_log_assert(doc);
+    /* Load xml document */
+    *doc = xmlParseFile(cfgfile);
+    if (*doc == NULL) {
+        ods_log_error("[%s] parse cfgfile %s failed", logstr, cfgfile);
+        return ODS_STATUS_XMLERR;
     }
-    return dup;
-
-}
-
-const char*
-parser_conf_notify_command(region_type* r, const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/NotifyCommand",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    if (!rngfile) {
+        return ODS_STATUS_OK;
     }
-    return dup;
-}
-
-const char*
-parser_conf_pid_filename(region_type* r, const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/PidFile",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
-    } else {
-        dup = region_strdup(r, ODS_SE_PIDFILE);
+    ods_log_debug("[%s] check cfgfile %s with rngfile %s", logstr,
+        cfgfile, rngfile);
+    schema = parser_schema(rngfile);
+    if (schema == NULL) {
+        xmlFreeDoc(*doc);
+        *doc = NULL;
+        return ODS_STATUS_RNGERR;
     }
-    return dup;
-}
-
-const char*
-parser_conf_working_dir(region_type* r, const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/WorkingDirectory",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    /* Create an XML RelaxNGs validation context. */
+    rngctx = xmlRelaxNGNewValidCtxt(schema);
+    if (rngctx == NULL) {
+        ods_log_error("[%s] relaxng create failed", logstr);
+        status = -1;
     } else {
-        dup = region_strdup(r, ODS_SE_WORKDIR);
+        /* Validate a document tree in memory. */
+        status = xmlRelaxNGValidateDoc(rngctx, *doc);
+        if (status != 0) {
+            ods_log_error("[%s] relaxng validate failed", logstr);
+        }
+        xmlRelaxNGFreeValidCtxt(rngctx);
     }
-    return dup;
-}
-
-const char*
-parser_conf_username(region_type* r, const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/Privileges/User",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    if (!parser_schema_cached(schema)) {
+        xmlRelaxNGFree(schema);
+    }
+    if (status != 0) {
+        xmlFreeDoc(*doc);
+        *doc = NULL;
+        return ODS_STATUS_RNGERR;
     }
-    return dup;
+    return ODS_STATUS_OK;
 }
 
-const char*
-parser_conf_group(region_type* r, const char* cfgfile)
+
+/**
+ * Validate a document against a rng file while it is read.
+ *
+ */
+ods_status
+parser_reader_validate(xmlTextReaderPtr reader, const char* rngfile)
 {
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/Privileges/Group",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    xmlRelaxNGPtr schema = NULL;
+    ods_log_assert(reader);
+    ods_log_assert(rngfile);
+    schema = parser_schema(rngfile);
+    if (schema == NULL) {
+        return ODS_STATUS_RNGERR;
     }
-    return dup;
+    if (!parser_schema_cached(schema)) {
+        /* the reader keeps using the schema, it must stay around */
+        ods_log_error("[%s] schema cache full, unable to validate with %s",
+            logstr, rngfile);
+        xmlRelaxNGFree(schema);
+        return ODS_STATUS_RNGERR;
+    }
+    if (xmlTextReaderRelaxNGSetSchema(reader, schema) != 0) {
+        ods_log_error("[%s] relaxng set schema %s failed", logstr, rngfile);
+        return ODS_STATUS_RNGERR;
+    }
+    return ODS_STATUS_OK;
 }
 
-const char*
-parser_conf_chroot(region_type* r, const char* cfgfile)
+
+/**
+ * Clean up the parser.
+ *
+ */
+void
+parser_cleanup(void)
 {
-    const char* dup = NULL;
-    const char* str = parser_conf_string(
-        cfgfile,
-        "//Configuration/Signer/Privileges/Directory",
-        0);
-    ods_log_assert(r);
-    if (str) {
-        dup = region_strdup(r, str);
-        free((void*)str);
+    int i;
+    for (i=0; i < PARSER_MAX_SCHEMAS; i++) {
+        if (parser_schemas[i].schema) {
+            xmlRelaxNGFree(parser_schemas[i].schema);
+        }
+        free((void*) parser_schemas[i].rngfile);
     }
-    return dup;
+    memset(parser_schemas, 0, sizeof(parser_schemas));
+    lock_basic_destroy(&parser_lock);
+    return;
 }
 
 
 /**
- * Parse elements from the configuration file.
+ * Configuration elements, relative to /Configuration.
  *
  */
-int
-parser_conf_use_syslog(const char* cfgfile)
+enum parser_conf_kind_enum {
+    CONF_STRING = 0,
+    CONF_INT,
+    CONF_INTERFACE
+};
+typedef enum parser_conf_kind_enum parser_conf_kind;
+
+typedef struct parser_conf_elem_struct parser_conf_elem;
+struct parser_conf_elem_struct {
+    const char* path;
+    parser_conf_kind kind;
+    size_t offset;
+};
+
+static const parser_conf_elem parser_conf_elems[] = {
+    { "Common/Logging/Syslog/Facility", CONF_STRING,
+      offsetof(parser_conf_type, syslog_facility) },
+    { "Common/Logging/File/Filename", CONF_STRING,
+      offsetof(parser_conf_type, log_filename) },
+    { "Common/Logging/Verbosity", CONF_INT,
+      offsetof(parser_conf_type, verbosity) },
+    { "Common/ZoneListFile", CONF_STRING,
+      offsetof(parser_conf_type, zonelist_filename) },
+    { "Signer/SocketFile", CONF_STRING,
+      offsetof(parser_conf_type, clisock_filename) },
+    { "Signer/NotifyCommand", CONF_STRING,
+      offsetof(parser_conf_type, notify_command) },
+    { "Signer/PidFile", CONF_STRING,
+      offsetof(parser_conf_type, pid_filename) },
+    { "Signer/WorkingDirectory", CONF_STRING,
+      offsetof(parser_conf_type, working_dir) },
+    { "Signer/Privileges/User", CONF_STRING,
+      offsetof(parser_conf_type, username) },
+    { "Signer/Privileges/Group", CONF_STRING,
+      offsetof(parser_conf_type, group) },
+    { "Signer/Privileges/Directory", CONF_STRING,
+      offsetof(parser_conf_type, chroot) },
+    { "Signer/WorkerThreads", CONF_INT,
+      offsetof(parser_conf_type, num_worker_threads) },
+    { "Signer/SignerThreads", CONF_INT,
+      offsetof(parser_conf_type, num_signer_threads) },
+    { "Signer/Listener/Interface", CONF_INTERFACE,
+      offsetof(parser_conf_type, interfaces) },
+    { NULL, CONF_STRING, 0 }
+};
+
+
+/**
+ * Add a listener interface.
+ *
+ */
+static void
+parser_conf_interface(region_type* r, xmlNodePtr node,
+    listener_type** listener)
 {
-    const char* str = parser_conf_string(cfgfile,
-        "//Configuration/Common/Logging/Syslog/Facility",
-        0);
-    if (str) {
-        free((void*)str);
-        return 1;
+    xmlChar* address = NULL;
+    xmlChar* port = NULL;
+    for (node = node->children; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+        if (!address && xmlStrEqual(node->name, (const xmlChar*)"Address")) {
+            address = xmlNodeGetContent(node);
+        } else if (!port && xmlStrEqual(node->name,
+            (const xmlChar*)"Port")) {
+            port = xmlNodeGetContent(node);
+        }
     }
-    return 0;
+    if (!*listener) {
+        *listener = listener_create(r);
+    }
+    (void) listener_push(r, *listener, (char*) address, (char*) port);
+    xmlFree(address);
+    xmlFree(port);
+    return;
 }
 
-int
-parser_conf_verbosity(const char* cfgfile)
+
+/**
+ * Store the value of a configuration element.
+ *
+ */
+static void
+parser_conf_elem_set(region_type* r, const parser_conf_elem* elem,
+    xmlNodePtr node, parser_conf_type* conf)
 {
-    int verbosity = ODS_SE_VERBOSITY;
-    const char* str = parser_conf_string(cfgfile,
-        "//Configuration/Common/Logging/Verbosity",
-        0);
-    if (str) {
-        if (strlen(str) > 0) {
-            verbosity = atoi(str);
-        }
-        free((void*)str);
+    char* field = ((char*) conf) + elem->offset;
+    xmlChar* str = NULL;
+    if (elem->kind == CONF_INTERFACE) {
+        parser_conf_interface(r, node, (listener_type**) field);
+        return;
+    }
+    str = xmlNodeGetContent(node);
+    if (!str) {
+        return;
     }
-    return verbosity;
+    switch (elem->kind) {
+        case CONF_STRING:
+            *((const char**) field) = region_strdup(r, (const char*) str);
+            break;
+        case CONF_INT:
+            if (xmlStrlen(str) > 0) {
+                *((int*) field) = atoi((const char*) str);
+            }
+            break;
+        default:
+            break;
+    }
+    xmlFree(str);
+    return;
 }
 
-int
-parser_conf_worker_threads(const char* cfgfile)
+
+/**
+ * Walk the configuration elements, storing the ones that are known.
+ *
+ */
+static void
+parser_conf_walk(region_type* r, xmlNodePtr node, char* path,
+    size_t pathlen, parser_conf_type* conf)
 {
-    int numwt = ODS_SE_WORKERTHREADS;
-    const char* str = parser_conf_string(cfgfile,
-        "//Configuration/Signer/WorkerThreads",
-        0);
-    if (str) {
-        if (strlen(str) > 0) {
-            numwt = atoi(str);
+    size_t len;
+    int i;
+    for (; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+        len = strlen((const char*) node->name);
+        if (pathlen + len + 2 > PARSER_PATH_SIZE) {
+            continue;
         }
-        free((void*)str);
+        if (pathlen > 0) {
+            path[pathlen] = '/';
+            memcpy(path + pathlen + 1, node->name, len + 1);
+            len += pathlen + 1;
+        } else {
+            memcpy(path, node->name, len + 1);
+        }
+        for (i=0; parser_conf_elems[i].path; i++) {
+            if (strcmp(parser_conf_elems[i].path, path) == 0) {
+                parser_conf_elem_set(r, &parser_conf_elems[i], node, conf);
+                break;
+            }
+        }
+        if (node->children) {
+            parser_conf_walk(r, node->children, path, len, conf);
+        }
+        path[pathlen] = '\0';
     }
-    return numwt;
+    return;
 }
 
-int
-parser_conf_signer_threads(const char* cfgfile)
+
+/**
+ * Parse the configuration file in one pass.
+ *
+ */
+ods_status
+parser_conf_read(region_type* r, const char* cfgfile, const char* rngfile,
+    parser_conf_type* conf)
 {
-    int numwt = ODS_SE_WORKERTHREADS;
-    const char* str = parser_conf_string(cfgfile,
-        "//Configuration/Signer/SignerThreads",
-        0);
-    if (str) {
-        if (strlen(str) > 0) {
-            numwt = atoi(str);
-        }
-        free((void*)str);
-        return numwt;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root = NULL;
+    char path[PARSER_PATH_SIZE];
+    ods_status status = ODS_STATUS_OK;
+    ods_log_assert(r);
+    ods_log_assert(cfgfile);
+    ods_log_assert(conf);
+    status = parser_doc_load(cfgfile, rngfile, &doc);
+    if (status != ODS_STATUS_OK) {
+        return status;
+    }
+    root = xmlDocGetRootElement(doc);
+    if (!root || !xmlStrEqual(root->name, (const xmlChar*) "Configuration")) {
+        ods_log_error("[%s] no Configuration in %s", logstr, cfgfile);
+        xmlFreeDoc(doc);
+        return ODS_STATUS_CFGERR;
     }
-    /* no SignerThreads value configured, look at WorkerThreads */
-    return parser_conf_worker_threads(cfgfile);
+    memset(conf, 0, sizeof(parser_conf_type));
+    conf->verbosity = -1;
+    conf->num_worker_threads = -1;
+    conf->num_signer_threads = -1;
+    path[0] = '\0';
+    parser_conf_walk(r, root->children, path, 0, conf);
+    xmlFreeDoc(doc);
+    return ODS_STATUS_OK;
 }
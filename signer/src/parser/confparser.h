@@ -36,58 +36,80 @@
 
 #include "util/region.h"
 #include "util/status.h"
+#include "wire/listener.h"
+
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+
+/**
+ * Settings read from the configuration file. Elements that are not
+ * present are NULL, or -1 for the numbers.
+ *
+ */
+typedef struct parser_conf_struct parser_conf_type;
+struct parser_conf_struct {
+    const char* syslog_facility;
+    const char* log_filename;
+    const char* zonelist_filename;
+    const char* clisock_filename;
+    const char* notify_command;
+    const char* pid_filename;
+    const char* working_dir;
+    const char* username;
+    const char* group;
+    const char* chroot;
+    listener_type* interfaces;
+    int verbosity;
+    int num_worker_threads;
+    int num_signer_threads;
+};
+
+/**
+ * Initialize the parser.
+ *
+ */
+void parser_init(void);
 
 /**
- * Check config file with rng file.
+ * Load a configuration file and validate it against a rng file. The
+ * RelaxNG schema is compiled once and reused for later documents.
  * @param cfgfile: the configuration file name.
- * @param rngfile: the rng file name.
+ * @param rngfile: the rng file name, NULL to skip validation.
+ * @param doc:     the loaded document, to be freed with xmlFreeDoc().
  * @return:        (ods_status) status.
  *
  */
-ods_status parser_filecheck(const char* cfgfile, const char* rngfile);
+ods_status parser_doc_load(const char* cfgfile, const char* rngfile,
+    xmlDocPtr* doc);
 
 /**
- * Parse elements from the configuration file, given an expression.
- * @param cfgfile:  configuration file.
- * @param expr:     xml expression.
- * @param required: if the element is required.
- * @return:         (const char*) string value.
+ * Validate a document against a rng file while it is read. The RelaxNG
+ * schema is shared with parser_doc_load().
+ * @param reader:  the text reader, before the first read.
+ * @param rngfile: the rng file name.
+ * @return:        (ods_status) status.
  *
  */
-const char* parser_conf_string(const char* cfgfile, const char* expr,
-    int required);
+ods_status parser_reader_validate(xmlTextReaderPtr reader,
+    const char* rngfile);
 
 /**
- * Parse string elements from the configuration file.
+ * Parse the configuration file. The file is loaded and validated once,
+ * and all settings are taken from a single walk over the document.
+ * @param r:       memory region.
  * @param cfgfile: configuration file.
- * @return:        (const char*) string.
+ * @param rngfile: rng file, NULL to skip validation.
+ * @param conf:    settings found in the file.
+ * @return:        (ods_status) status.
  *
  */
-/** Common specific */
-const char* parser_conf_log_filename(region_type* r, const char* cfgfile);
-const char* parser_conf_zonelist_filename(region_type* r, const char* cfgfile);
-/** Signer specific */
-const char* parser_conf_clisock_filename(region_type* r, const char* cfgfile);
-const char* parser_conf_notify_command(region_type* r, const char* cfgfile);
-const char* parser_conf_pid_filename(region_type* r, const char* cfgfile);
-const char* parser_conf_working_dir(region_type* r, const char* cfgfile);
-const char* parser_conf_username(region_type* r, const char* cfgfile);
-const char* parser_conf_group(region_type* r, const char* cfgfile);
-const char* parser_conf_chroot(region_type* r, const char* cfgfile);
+ods_status parser_conf_read(region_type* r, const char* cfgfile,
+    const char* rngfile, parser_conf_type* conf);
 
 /**
- * Parse integer elements from the configuration file.
- * @param cfgfile: configuration file.
- * @return:        (int) integer.
+ * Clean up the parser, releasing the compiled schemas.
  *
  */
-
-/** Common */
-int parser_conf_use_syslog(const char* cfgfile);
-int parser_conf_verbosity(const char* cfgfile);
-
-/** Signer specific */
-int parser_conf_worker_threads(const char* cfgfile);
-int parser_conf_signer_threads(const char* cfgfile);
+void parser_cleanup(void);
 
 #endif /* PARSE_CONFPARSER_H */
@@ -39,213 +39,251 @@
 #include "util/log.h"
 
 #include <libxml/parser.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
-#include <libxml/xmlreader.h>
+#include <libxml/tree.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 static const char* logstr = "parser";
 
-static ods_status
-parser_sc_duration(const char* cfgfile, duration_type* d, const char* expr)
-{
-    ods_status status;
-    const char* str = parser_conf_string(cfgfile, expr, 1);
-    if (!str) {
-        ods_log_error("[%s] failed to parse %s in %s", logstr, expr, cfgfile);
-        return ODS_STATUS_CFGERR;
-    }
-    status = str2duration(str, d);
-    free((void*)str);
-    return status;
-}
+/**
+ * Signer configuration elements, relative to
+ * /SignerConfiguration/Zone.
+ *
+ */
+enum parser_sc_kind_enum {
+    SC_DURATION = 0,
+    SC_UINT32,
+    SC_FLAG,
+    SC_STRING,
+    SC_NSEC,
+    SC_NSEC3
+};
+typedef enum parser_sc_kind_enum parser_sc_kind;
 
+/* when an element must be present */
+enum parser_sc_need_enum {
+    SC_OPTIONAL = 0,
+    SC_REQUIRED,
+    SC_REQUIRED_NSEC3
+};
+typedef enum parser_sc_need_enum parser_sc_need;
 
+typedef struct parser_sc_elem_struct parser_sc_elem;
+struct parser_sc_elem_struct {
+    const char* path;
+    parser_sc_kind kind;
+    size_t offset;
+    size_t size;
+    parser_sc_need need;
+};
 
+static const parser_sc_elem parser_sc_elems[] = {
+    { "Signatures/Resign", SC_DURATION,
+      offsetof(signconf_type, sig_resign_interval), 0, SC_REQUIRED },
+    { "Signatures/Refresh", SC_DURATION,
+      offsetof(signconf_type, sig_refresh_interval), 0, SC_REQUIRED },
+    { "Signatures/Validity/Default", SC_DURATION,
+      offsetof(signconf_type, sig_validity_default), 0, SC_REQUIRED },
+    { "Signatures/Validity/Denial", SC_DURATION,
+      offsetof(signconf_type, sig_validity_denial), 0, SC_REQUIRED },
+    { "Signatures/Jitter", SC_DURATION,
+      offsetof(signconf_type, sig_jitter), 0, SC_REQUIRED },
+    { "Signatures/InceptionOffset", SC_DURATION,
+      offsetof(signconf_type, sig_inception_offset), 0, SC_REQUIRED },
+    { "Denial/NSEC", SC_NSEC,
+      offsetof(signconf_type, nsec_type), 0, SC_OPTIONAL },
+    { "Denial/NSEC3", SC_NSEC3,
+      offsetof(signconf_type, nsec_type), 0, SC_OPTIONAL },
+    { "Denial/NSEC3/OptOut", SC_FLAG,
+      offsetof(signconf_type, nsec3_optout), 0, SC_OPTIONAL },
+    { "Denial/NSEC3/Hash/Algorithm", SC_UINT32,
+      offsetof(signconf_type, nsec3_algo), 0, SC_OPTIONAL },
+    { "Denial/NSEC3/Hash/Iterations", SC_UINT32,
+      offsetof(signconf_type, nsec3_iterations), 0, SC_OPTIONAL },
+    { "Denial/NSEC3/Hash/Salt", SC_STRING,
+      offsetof(signconf_type, nsec3_salt), SC_SALT_SIZE, SC_REQUIRED_NSEC3 },
+    { "Keys/TTL", SC_DURATION,
+      offsetof(signconf_type, dnskey_ttl), 0, SC_REQUIRED },
+    { "SOA/TTL", SC_DURATION,
+      offsetof(signconf_type, soa_ttl), 0, SC_REQUIRED },
+    { "SOA/Minimum", SC_DURATION,
+      offsetof(signconf_type, soa_min), 0, SC_REQUIRED },
+    { "SOA/Serial", SC_STRING,
+      offsetof(signconf_type, soa_serial), SC_SERIAL_SIZE, SC_REQUIRED },
+    { NULL, SC_DURATION, 0, 0, SC_OPTIONAL }
+};
 
-/**
- * Parse durations from the configuration file.
- *
- */
-ods_status
-parser_sc_sig_resign_interval(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/Resign");
-}
-ods_status
-parser_sc_sig_refresh_interval(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/Refresh");
-}
-ods_status
-parser_sc_sig_validity_default(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/Validity/Default");
-}
-ods_status
-parser_sc_sig_validity_denial(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/Validity/Denial");
-}
-ods_status
-parser_sc_sig_jitter(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/Jitter");
-}
-ods_status
-parser_sc_sig_inception_offset(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Signatures/InceptionOffset");
-}
-ods_status
-parser_sc_dnskey_ttl(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/Keys/TTL");
-}
-ods_status
-parser_sc_soa_ttl(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/SOA/TTL");
-}
-ods_status
-parser_sc_soa_min(const char* cfgfile, duration_type* d)
-{
-    return parser_sc_duration(cfgfile, d,
-        "//SignerConfiguration/Zone/SOA/Minimum");
-}
+#define SC_PATH_SIZE 128
 
 
 /**
- * Parse denial of existence type from the configuration file.
+ * Store the value of a signer configuration element.
  *
  */
-ldns_rr_type
-parser_sc_nsec_type(const char* cfgfile)
+static ods_status
+parser_sc_elem_set(const parser_sc_elem* elem, xmlNodePtr node,
+    const char* cfgfile, signconf_type* sc)
 {
-    const char* str = parser_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3",
-        0);
-    if (str) {
-        free((void*)str);
-        return LDNS_RR_TYPE_NSEC3;
+    char* field = ((char*) sc) + elem->offset;
+    char* str = NULL;
+    ods_status status = ODS_STATUS_OK;
+    switch (elem->kind) {
+        case SC_NSEC:
+            *((ldns_rr_type*) field) = LDNS_RR_TYPE_NSEC;
+            return ODS_STATUS_OK;
+        case SC_NSEC3:
+            *((ldns_rr_type*) field) = LDNS_RR_TYPE_NSEC3;
+            return ODS_STATUS_OK;
+        case SC_FLAG:
+            *((int*) field) = 1;
+            return ODS_STATUS_OK;
+        default:
+            break;
+    }
+    str = (char*) xmlNodeGetContent(node);
+    if (!str) {
+        ods_log_error("[%s] failed to parse %s in %s", logstr, elem->path,
+            cfgfile);
+        return ODS_STATUS_CFGERR;
     }
-    str = parser_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC",
-        0);
-    if (str) {
-        free((void*)str);
-        return LDNS_RR_TYPE_NSEC;
+    switch (elem->kind) {
+        case SC_DURATION:
+            status = str2duration(str, (duration_type*) field);
+            if (status != ODS_STATUS_OK) {
+                ods_log_error("[%s] failed to parse %s in %s", logstr,
+                    elem->path, cfgfile);
+            }
+            break;
+        case SC_UINT32:
+            *((uint32_t*) field) = strlen(str) > 0 ?
+                (uint32_t) atoi(str) : 0;
+            break;
+        case SC_STRING:
+            if (strlen(str)+1 <= elem->size) {
+                strlcpy(field, str, elem->size);
+            } else {
+                ods_log_error("[%s] %s %s in %s is too long: maximum length "
+                    "of %d allowed", logstr, elem->path, str, cfgfile,
+                    (int) elem->size-1);
+                status = ODS_STATUS_CFGERR;
+            }
+            break;
+        default:
+            break;
     }
-    return LDNS_RR_TYPE_FIRST;
+    xmlFree((xmlChar*) str);
+    return status;
 }
 
 
 /**
- * Parse uint32_t values from the configuration file.
+ * Walk the elements below a node, storing the ones that are known.
  *
  */
-uint32_t
-parser_sc_nsec3_algorithm(const char* cfgfile)
+static ods_status
+parser_sc_walk(xmlNodePtr node, char* path, size_t pathlen,
+    const char* cfgfile, signconf_type* sc, int* seen)
 {
-    int ret = 0;
-    const char* str = parser_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Algorithm",
-        1);
-    if (str) {
-        if (strlen(str) > 0) {
-            ret = atoi(str);
+    ods_status status = ODS_STATUS_OK;
+    size_t len;
+    int i;
+    for (; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE) {
+            continue;
         }
-        free((void*)str);
-    }
-    return ret;
-}
-uint32_t
-parser_sc_nsec3_iterations(const char* cfgfile)
-{
-    int ret = 0;
-    const char* str = parser_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Iterations",
-        1);
-    if (str) {
-        if (strlen(str) > 0) {
-            ret = atoi(str);
+        len = strlen((const char*) node->name);
+        if (pathlen + len + 2 > SC_PATH_SIZE) {
+            continue;
         }
-        free((void*)str);
-    }
-    return ret;
-}
-
-
-/**
- * Parse NSEC3 Opt-Out from the configuration file.
- *
- */
-int
-parser_sc_nsec3_optout(const char* cfgfile)
-{
-    int ret = 0;
-    const char* str = parser_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/OptOut",
-        0);
-    if (str) {
-        ret = 1;
-        free((void*)str);
+        if (pathlen > 0) {
+            path[pathlen] = '/';
+            memcpy(path + pathlen + 1, node->name, len + 1);
+            len += pathlen + 1;
+        } else {
+            memcpy(path, node->name, len + 1);
+        }
+        for (i=0; parser_sc_elems[i].path; i++) {
+            if (strcmp(parser_sc_elems[i].path, path) == 0) {
+                status = parser_sc_elem_set(&parser_sc_elems[i], node,
+                    cfgfile, sc);
+                if (status != ODS_STATUS_OK) {
+                    return status;
+                }
+                seen[i] = 1;
+                break;
+            }
+        }
+        if (node->children) {
+            status = parser_sc_walk(node->children, path, len, cfgfile, sc,
+                seen);
+            if (status != ODS_STATUS_OK) {
+                return status;
+            }
+        }
+        path[pathlen] = '\0';
     }
-    return ret;
+    return ODS_STATUS_OK;
 }
 
 
 /**
- * Parse strings from the configuration file.
+ * Parse the signer configuration file in one pass.
  *
  */
 ods_status
-parser_sc_soa_serial(const char* cfgfile, char* buf)
+parser_sc_read(const char* cfgfile, const char* rngfile, signconf_type* sc)
 {
-    const char* expr = "//SignerConfiguration/Zone/SOA/Serial";
-    const char* str = parser_conf_string(cfgfile, expr, 1);
-    if (str) {
-        ods_status status = ODS_STATUS_OK;
-        if (strlen(str)+1 <= SC_SERIAL_SIZE) {
-            strlcpy(buf, str, strlen(str)+1);
-        } else {
-            ods_log_error("[%s] serial %s in %s is too long: maximum length of "
-                "%d allowed", logstr, str, cfgfile, SC_SERIAL_SIZE-1);
-            status = ODS_STATUS_CFGERR;
-        }
-        free((void*)str);
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node = NULL;
+    char path[SC_PATH_SIZE];
+    int seen[sizeof(parser_sc_elems)/sizeof(parser_sc_elems[0])];
+    ods_status status = ODS_STATUS_OK;
+    int i;
+    ods_log_assert(cfgfile);
+    ods_log_assert(sc);
+    status = parser_doc_load(cfgfile, rngfile, &doc);
+    if (status != ODS_STATUS_OK) {
         return status;
     }
-    ods_log_error("[%s] failed to parse %s in %s", logstr, expr, cfgfile);
-    return ODS_STATUS_CFGERR;
-
-}
-ods_status
-parser_sc_nsec3_salt(const char* cfgfile, char* buf)
-{
-    const char* expr = "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Salt";
-    const char* str = parser_conf_string(cfgfile, expr, 1);
-    if (str) {
-        ods_status status = ODS_STATUS_OK;
-        if (strlen(str)+1 <= SC_SALT_SIZE) {
-            strlcpy(buf, str, strlen(str)+1);
-        } else {
-            ods_log_error("[%s] salt %s in %s is too long: maximum length of "
-                "%d allowed", logstr, str, cfgfile, SC_SALT_SIZE-1);
-            status = ODS_STATUS_CFGERR;
+    node = xmlDocGetRootElement(doc);
+    if (!node || !xmlStrEqual(node->name,
+        (const xmlChar*) "SignerConfiguration")) {
+        ods_log_error("[%s] no SignerConfiguration in %s", logstr, cfgfile);
+        xmlFreeDoc(doc);
+        return ODS_STATUS_CFGERR;
+    }
+    for (node = node->children; node; node = node->next) {
+        if (node->type == XML_ELEMENT_NODE &&
+            xmlStrEqual(node->name, (const xmlChar*) "Zone")) {
+            break;
         }
-        free((void*)str);
+    }
+    if (!node) {
+        ods_log_error("[%s] no Zone in %s", logstr, cfgfile);
+        xmlFreeDoc(doc);
+        return ODS_STATUS_CFGERR;
+    }
+    memset(seen, 0, sizeof(seen));
+    sc->nsec_type = LDNS_RR_TYPE_FIRST;
+    sc->nsec3_optout = 0;
+    sc->nsec3_algo = 0;
+    sc->nsec3_iterations = 0;
+    sc->nsec3_salt[0] = '\0';
+    path[0] = '\0';
+    status = parser_sc_walk(node->children, path, 0, cfgfile, sc, seen);
+    xmlFreeDoc(doc);
+    if (status != ODS_STATUS_OK) {
         return status;
     }
-    ods_log_error("[%s] failed to parse %s in %s", logstr, expr, cfgfile);
-    return ODS_STATUS_CFGERR;
+    for (i=0; parser_sc_elems[i].path; i++) {
+        if (!seen[i] && (parser_sc_elems[i].need == SC_REQUIRED ||
+            (parser_sc_elems[i].need == SC_REQUIRED_NSEC3 &&
+            sc->nsec_type == LDNS_RR_TYPE_NSEC3))) {
+            ods_log_error("[%s] failed to parse %s in %s", logstr,
+                parser_sc_elems[i].path, cfgfile);
+            return ODS_STATUS_CFGERR;
+        }
+    }
+    return ODS_STATUS_OK;
 }
-
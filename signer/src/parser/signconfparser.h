@@ -35,66 +35,22 @@
 #define PARSER_SIGNCONFPARSER_H
 
 #include "parser/confparser.h"
+#include "signer/signconf.h"
 #include "util/duration.h"
 #include "util/status.h"
 
 #include <ldns/ldns.h>
 
 /**
- * Parse durations from the configuration file.
+ * Parse the signer configuration file. The file is loaded and validated
+ * once, and all settings are taken from a single walk over the document.
  * @param cfgfile: configuration file name.
- * @param d:       duration.
+ * @param rngfile: rng file name.
+ * @param sc:      signer configuration to store the settings in.
  * @return:        (ods_status) status.
  *
  */
-ods_status parser_sc_sig_resign_interval(const char* cfgfile,
-     duration_type* d);
-ods_status parser_sc_sig_refresh_interval(const char* cfgfile,
-    duration_type* d);
-ods_status parser_sc_sig_validity_default(const char* cfgfile,
-    duration_type* d);
-ods_status parser_sc_sig_validity_denial(const char* cfgfile,
-    duration_type* d);
-ods_status parser_sc_sig_jitter(const char* cfgfile, duration_type* d);
-ods_status parser_sc_sig_inception_offset(const char* cfgfile,
-    duration_type* d);
-ods_status parser_sc_dnskey_ttl(const char* cfgfile, duration_type* d);
-ods_status parser_sc_soa_ttl(const char* cfgfile, duration_type* d);
-ods_status parser_sc_soa_min(const char* cfgfile, duration_type* d);
-
-/**
- * Parse denial of existence type from the configuration file.
- * @param cfgfile: configuration file name.
- * @return:        (ldns_rr_type) rr type.
- *
- */
-ldns_rr_type parser_sc_nsec_type(const char* cfgfile);
-
-/**
- * Parse uint32_t values from the configuration file.
- * @param cfgfile: configuration file name.
- * @return:        (uint32_t) value.
- *
- */
-uint32_t parser_sc_nsec3_algorithm(const char* cfgfile);
-uint32_t parser_sc_nsec3_iterations(const char* cfgfile);
-
-/**
- * Parse NSEC3 Opt-Out from the configuration file.
- * @param cfgfile: configuration file name.
- * @return:        (int) 1 if Opt-Out, 0 otherwise.
- *
- */
-int parser_sc_nsec3_optout(const char* cfgfile);
-
-/**
- * Parse strings from the configuration file.
- * @param cfgfile: configuration file name.
- * @param buf:     string buffer.
- * @return:        (ods_status) status.
- *
- */
-ods_status parser_sc_soa_serial(const char* cfgfile, char* buf);
-ods_status parser_sc_nsec3_salt(const char* cfgfile, char* buf);
+ods_status parser_sc_read(const char* cfgfile, const char* rngfile,
+    signconf_type* sc);
 
 #endif /* PARSER_SIGNCONFPARSER_H */
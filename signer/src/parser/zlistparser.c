@@ -33,139 +33,130 @@
 
 #include "config.h"
 #include "adapter/adapter.h"
+#include "parser/confparser.h"
 #include "parser/zlistparser.h"
-#include "util/file.h"
 #include "util/log.h"
 #include "util/status.h"
 #include "util/str.h"
-#include "signer/zlist.h"
-#include "signer/zone.h"
 
-#include <libxml/xpath.h>
 #include <libxml/xmlreader.h>
 #include <stdlib.h>
 #include <string.h>
 
 static const char* logstr = "parser";
 
+#define PZL_FNV_OFFSET 0xcbf29ce484222325ULL
+#define PZL_FNV_PRIME 0x100000001b3ULL
+
 
 /**
- * Parse expr inside XPath Context.
+ * Hash a string into the zone entry digest (FNV-1a).
  *
  */
-static const char*
-parser_zlist_element(xmlXPathContextPtr xpathCtx, xmlChar* expr)
+static uint64_t
+pzl_hash(uint64_t hash, const char* str)
 {
-    xmlXPathObjectPtr xpathObj = NULL;
-    const char* str = NULL;
-    ods_log_assert(xpathCtx);
-    ods_log_assert(expr);
-    xpathObj = xmlXPathEvalExpression(expr, xpathCtx);
-    if (xpathObj == NULL) {
-        ods_log_error("[%s] failed to evaluate xpath expression %s",
-            logstr, expr);
-        return NULL;
+    const unsigned char* p = (const unsigned char*) str;
+    if (p) {
+        while (*p) {
+            hash ^= *p++;
+            hash *= PZL_FNV_PRIME;
+        }
     }
-    str = (const char*) xmlXPathCastToString(xpathObj);
-    xmlXPathFreeObject(xpathObj);
-    return str;
+    /* separator, so that "ab","c" differs from "a","bc" */
+    hash ^= 0xff;
+    hash *= PZL_FNV_PRIME;
+    return hash;
 }
 
 
 /**
- * Create adapter from configuration.
+ * Hash a zone entry.
  *
  */
-static adapter_type*
-pzl_adapter(xmlNode* curNode, region_type* r, adapter_mode type, unsigned in)
+static uint64_t
+pzl_entry_hash(zlist_entry_type* entry)
 {
-    const char* file = NULL;
-    adapter_type* adapter = NULL;
-    ods_log_assert(curNode);
-    ods_log_assert(r);
-    file = (const char*) xmlNodeGetContent(curNode);
-    if (!file) {
-        ods_log_error("[%s] read %s adapter failed", logstr,
-            in?"input":"output");
-        return NULL;
-    }
-    adapter = adapter_create(r, file, type, in);
-    free((void*)file);
-    return adapter;
+    char type[2];
+    uint64_t hash = PZL_FNV_OFFSET;
+    hash = pzl_hash(hash, entry->policy_name);
+    hash = pzl_hash(hash, entry->signconf_filename);
+    type[1] = '\0';
+    type[0] = (char) ('0' + entry->adapter_in->type);
+    hash = pzl_hash(hash, type);
+    hash = pzl_hash(hash, entry->adapter_in->configstr);
+    type[0] = (char) ('0' + entry->adapter_out->type);
+    hash = pzl_hash(hash, type);
+    hash = pzl_hash(hash, entry->adapter_out->configstr);
+    return hash;
 }
 
 
 /**
- * Parse adapter.
+ * Read the text content of the current element into the region.
  *
  */
-adapter_type*
-parser_zlist_adapter(xmlXPathContextPtr xpathCtx, xmlChar* expr,
-    region_type* r, int in)
+static const char*
+pzl_string(xmlTextReaderPtr reader, region_type* r)
 {
-    xmlXPathObjectPtr xpathObj = NULL;
-    xmlNode* curNode = NULL;
-    xmlChar* type = NULL;
-    adapter_type* adapter = NULL;
-    int i = 0;
-    if (!xpathCtx || !expr || !r) {
-        return NULL;
-    }
-    xpathObj = xmlXPathEvalExpression(expr, xpathCtx);
-    if (xpathObj == NULL) {
-        ods_log_error("[%s] xmlPathEvalExpression() failed (expr=%s)",
-            logstr, expr);
-        return NULL;
+    const char* dup = NULL;
+    xmlChar* str = xmlTextReaderReadString(reader);
+    if (str) {
+        dup = region_strdup(r, (const char*) str);
+        xmlFree(str);
+    } else {
+        dup = region_strdup(r, "");
     }
-    if (xpathObj->nodesetval) {
-        for (i=0; i < xpathObj->nodesetval->nodeNr; i++) {
-            curNode = xpathObj->nodesetval->nodeTab[i]->xmlChildrenNode;
-            while (curNode) {
-                if (xmlStrEqual(curNode->name, (const xmlChar*)"File")) {
-                    adapter = pzl_adapter(curNode, r, ADAPTER_FILE, in);
-                } else if (xmlStrEqual(curNode->name,
-                    (const xmlChar*)"Adapter")) {
-                    type = xmlGetProp(curNode, (const xmlChar*)"type");
-                    if (xmlStrEqual(type, (const xmlChar*)"File")) {
-                        adapter = pzl_adapter(curNode, r, ADAPTER_FILE, in);
-                    } else if (xmlStrEqual(type, (const xmlChar*)"DNS")) {
-                        adapter = pzl_adapter(curNode, r, ADAPTER_DNS, in);
-                    } else if (xmlStrEqual(type, (const xmlChar*)"Update")) {
-                        adapter = pzl_adapter(curNode, r, ADAPTER_UPDATE, in);
-                    } else {
-                        ods_log_error("[%s] unable to parse %s adapter: "
-                            "unknown type", logstr, (const char*) type);
-                    }
-                    free((void*)type);
-                    type = NULL;
-                }
-                if (adapter) {
-                    break;
-                }
-                curNode = curNode->next;
-            }
-        }
-    }
-    xmlXPathFreeObject(xpathObj);
-    return adapter;
+    return dup;
 }
 
 
 /**
- * Parse the adapters.
+ * Create adapter from the current element.
  *
  */
-static void
-parser_zlist_adapters(xmlXPathContextPtr xpathCtx, zone_type* z)
+static adapter_type*
+pzl_adapter(xmlTextReaderPtr reader, region_type* r, const char* name,
+    unsigned in)
 {
-    xmlChar* i_expr = (xmlChar*) "//Zone/Adapters/Input";
-    xmlChar* o_expr = (xmlChar*) "//Zone/Adapters/Output";
-    if (!xpathCtx || !z) {
-        return;
+    adapter_type* adapter = NULL;
+    adapter_mode mode = ADAPTER_FILE;
+    xmlChar* type = NULL;
+    xmlChar* file = NULL;
+    if (ods_strcmp(name, "Adapter") == 0) {
+        type = xmlTextReaderGetAttribute(reader, (const xmlChar*) "type");
+        if (xmlStrEqual(type, (const xmlChar*)"File")) {
+            mode = ADAPTER_FILE;
+        } else if (xmlStrEqual(type, (const xmlChar*)"DNS")) {
+            mode = ADAPTER_DNS;
+        } else if (xmlStrEqual(type, (const xmlChar*)"Update")) {
+            mode = ADAPTER_UPDATE;
+        } else if (xmlStrEqual(type, (const xmlChar*)"Wire")) {
+            mode = ADAPTER_WIRE;
+        } else {
+            ods_log_error("[%s] unable to parse %s adapter: unknown type %s",
+                logstr, in?"input":"output", type?(const char*)type:"(null)");
+            xmlFree(type);
+            return NULL;
+        }
+        xmlFree(type);
+        if (mode == ADAPTER_WIRE && !in) {
+            ods_log_error("[%s] unable to parse output adapter: wire "
+                "adapter is input only", logstr);
+            return NULL;
+        }
+    } else if (ods_strcmp(name, "File") != 0) {
+        return NULL;
+    }
+    file = xmlTextReaderReadString(reader);
+    if (!file) {
+        ods_log_error("[%s] read %s adapter failed", logstr,
+            in?"input":"output");
+        return NULL;
     }
-    z->adapter_in = parser_zlist_adapter(xpathCtx, i_expr, z->region, 1);
-    z->adapter_out = parser_zlist_adapter(xpathCtx, o_expr, z->region, 0);
-    return;
+    adapter = adapter_create(r, (const char*) file, mode, in);
+    xmlFree(file);
+    return adapter;
 }
 
 
@@ -174,111 +165,120 @@ parser_zlist_adapters(xmlXPathContextPtr xpathCtx, zone_type* z)
  *
  */
 ods_status
-parser_zlist_zones(struct zlist_struct* zlist, const char* zlfile)
+parser_zlist_entries(region_type* r, const char* zlfile, const char* rngfile,
+    zlist_entry_type** entries, size_t* count)
 {
-    char* tag_name = NULL;
+    xmlTextReaderPtr reader = NULL;
+    zlist_entry_type* entry = NULL;
+    zlist_entry_type* last = NULL;
+    const char* name = NULL;
     char* zone_name = NULL;
-    zone_type* new_zone = NULL;
+    size_t len = 0;
+    int in = -1;
+    int depth = 0;
+    int type = 0;
     int ret = 0;
     int error = 0;
-    xmlTextReaderPtr reader = NULL;
-    xmlDocPtr doc = NULL;
-    xmlXPathContextPtr xpathCtx = NULL;
-    xmlChar* name_expr = (unsigned char*) "name";
-    xmlChar* policy_expr = (unsigned char*) "//Zone/Policy";
-    xmlChar* signconf_expr = (unsigned char*) "//Zone/SignerConfiguration";
-
-    ods_log_assert(zlist);
+    ods_log_assert(r);
     ods_log_assert(zlfile);
+    ods_log_assert(entries);
+    ods_log_assert(count);
+    *entries = NULL;
+    *count = 0;
     reader = xmlNewTextReaderFilename(zlfile);
     if (!reader) {
         ods_log_error("[%s] failed to open file %s", logstr, zlfile);
         return ODS_STATUS_XMLERR;
     }
-    ret = xmlTextReaderRead(reader);
-    while (ret == XML_READER_TYPE_ELEMENT) {
-        tag_name = (char*) xmlTextReaderLocalName(reader);
-        if (ods_strcmp(tag_name, "Zone") == 0 &&
-            ods_strcmp(tag_name, "ZoneList") != 0 &&
-            xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT) {
-            /* Found a zone */
+    if (rngfile && parser_reader_validate(reader, rngfile) != ODS_STATUS_OK) {
+        xmlFreeTextReader(reader);
+        return ODS_STATUS_RNGERR;
+    }
+    while (!error && (ret = xmlTextReaderRead(reader)) == 1) {
+        type = xmlTextReaderNodeType(reader);
+        depth = xmlTextReaderDepth(reader);
+        name = (const char*) xmlTextReaderConstLocalName(reader);
+        if (type == XML_READER_TYPE_END_ELEMENT) {
+            if (depth == 1 && entry && ods_strcmp(name, "Zone") == 0) {
+                /* end of zone */
+                if (!entry->policy_name || !entry->signconf_filename ||
+                    !entry->adapter_in || !entry->adapter_out) {
+                    ods_log_crit("[%s] unable to create zone %s", logstr,
+                        entry->name);
+                    error = 1;
+                    break;
+                }
+                entry->hash = pzl_entry_hash(entry);
+                if (last) {
+                    last->next = entry;
+                } else {
+                    *entries = entry;
+                }
+                last = entry;
+                (*count)++;
+                entry = NULL;
+            } else if (depth == 3) {
+                in = -1;
+            }
+            continue;
+        }
+        if (type != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+        if (depth == 1 && ods_strcmp(name, "Zone") == 0) {
+            /* found a zone */
+            entry = NULL;
             zone_name = (char*) xmlTextReaderGetAttribute(reader,
-                name_expr);
+                (const xmlChar*) "name");
             if (!zone_name || strlen(zone_name) <= 0) {
                 ods_log_alert("[%s] failed to extract zone name from "
                     "zonelist %s, skipping...", logstr, zlfile);
-                if (zone_name) {
-                    free((void*) zone_name);
-                }
-                free((void*) tag_name);
-                ret = xmlTextReaderRead(reader);
+                xmlFree((xmlChar*) zone_name);
                 continue;
             }
-            /* Expand this node to get the rest of the info */
-            xmlTextReaderExpand(reader);
-            doc = xmlTextReaderCurrentDoc(reader);
-            if (doc) {
-                xpathCtx = xmlXPathNewContext(doc);
-            }
-            if (doc == NULL || xpathCtx == NULL) {
-                ods_log_alert("[%s] failed to read zone %s, skipping...",
-                   logstr, zone_name);
-                ret = xmlTextReaderRead(reader);
-                free((void*) zone_name);
-                free((void*) tag_name);
-                continue;
+            /* drop trailing dot in domain name */
+            len = strlen(zone_name);
+            if (len > 1 && zone_name[len-1] == '.') {
+                zone_name[len-1] = '\0';
             }
-            /* That worked, now read out the contents... */
-            new_zone = zone_create(zone_name, LDNS_RR_CLASS_IN);
-            if (new_zone) {
-                new_zone->policy_name = parser_zlist_element(xpathCtx,
-                    policy_expr);
-                new_zone->signconf_filename = parser_zlist_element(xpathCtx,
-                    signconf_expr);
-                parser_zlist_adapters(xpathCtx, new_zone);
-                if (!new_zone->policy_name || !new_zone->signconf_filename
-                  || !new_zone->adapter_in || !new_zone->adapter_out) {
-                    zone_cleanup(new_zone);
-                    new_zone = NULL;
-                    ods_log_crit("[%s] unable to create zone %s", logstr,
-                        zone_name);
-                    error = 1;
-                } else if (zlist_add_zone((zlist_type*) zlist, new_zone)
-                    == NULL) {
-                    ods_log_crit("[%s] unable to add zone %s", logstr,
-                        zone_name);
-                    zone_cleanup(new_zone);
-                    new_zone = NULL;
-                    error = 1;
-                }
-            } else {
+            entry = (zlist_entry_type*) region_alloc(r,
+                sizeof(zlist_entry_type));
+            memset(entry, 0, sizeof(zlist_entry_type));
+            entry->name = region_strdup(r, zone_name);
+            xmlFree((xmlChar*) zone_name);
+            if (xmlTextReaderIsEmptyElement(reader)) {
                 ods_log_crit("[%s] unable to create zone %s", logstr,
-                    zone_name);
+                    entry->name);
                 error = 1;
             }
-            xmlXPathFreeContext(xpathCtx);
-            xpathCtx = NULL;
-            free((void*) zone_name);
-            if (error) {
-                free((void*) tag_name);
-                tag_name = NULL;
-                ret = 1;
-                break;
-            }
-            ods_log_debug("[%s] zone %s added", logstr, new_zone->name);
+        } else if (!entry) {
+            continue;
+        } else if (depth == 2 && ods_strcmp(name, "Policy") == 0) {
+            entry->policy_name = pzl_string(reader, r);
+        } else if (depth == 2 &&
+            ods_strcmp(name, "SignerConfiguration") == 0) {
+            entry->signconf_filename = pzl_string(reader, r);
+        } else if (depth == 3 && ods_strcmp(name, "Input") == 0) {
+            in = 1;
+        } else if (depth == 3 && ods_strcmp(name, "Output") == 0) {
+            in = 0;
+        } else if (depth == 4 && in == 1 && !entry->adapter_in) {
+            entry->adapter_in = pzl_adapter(reader, r, name, 1);
+        } else if (depth == 4 && in == 0 && !entry->adapter_out) {
+            entry->adapter_out = pzl_adapter(reader, r, name, 0);
         }
-        free((void*) tag_name);
-        ret = xmlTextReaderRead(reader);
     }
-    /* no more zones */
-    ods_log_debug("[%s] no more zones", logstr);
-    xmlFreeTextReader(reader);
-    if (doc) {
-        xmlFreeDoc(doc);
+    if (!error && rngfile && xmlTextReaderIsValid(reader) != 1) {
+        ods_log_error("[%s] relaxng validate failed", logstr);
+        xmlFreeTextReader(reader);
+        return ODS_STATUS_RNGERR;
     }
-    if (ret != 0) {
+    xmlFreeTextReader(reader);
+    if (error || ret != 0) {
         ods_log_error("[%s] parse error in %s", logstr, zlfile);
         return ODS_STATUS_PARSERR;
     }
+    ods_log_debug("[%s] read %u zones from %s", logstr, (unsigned) *count,
+        zlfile);
     return ODS_STATUS_OK;
 }
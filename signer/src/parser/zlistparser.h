@@ -34,20 +34,39 @@
 #ifndef PARSER_ZLISTPARSER_H
 #define PARSER_ZLISTPARSER_H
 
+#include "adapter/adapter.h"
+#include "util/region.h"
 #include "util/status.h"
 
-#include <libxml/xpath.h>
-#include <libxml/xmlreader.h>
+#include <stdint.h>
 
-struct zlist_struct;
+/**
+ * Zone entry from the zonelist file.
+ *
+ */
+typedef struct zlist_entry_struct zlist_entry_type;
+struct zlist_entry_struct {
+    const char* name;
+    const char* policy_name;
+    const char* signconf_filename;
+    adapter_type* adapter_in;
+    adapter_type* adapter_out;
+    uint64_t hash;                 /* digest of the zone settings */
+    zlist_entry_type* next;
+};
 
 /**
- * Parse the zonelist file.
- * @param zlist:  zone list storage.
- * @param zlfile: zonelist file name.
- * @return:       (ods_status) status.
+ * Parse the zonelist file. The file is streamed, and validated against
+ * the rng file while it is read.
+ * @param r:       memory region for the entries.
+ * @param zlfile:  zonelist file name.
+ * @param rngfile: rng file name, NULL to skip validation.
+ * @param entries: the zone entries, in file order.
+ * @param count:   number of zone entries.
+ * @return:        (ods_status) status.
  *
  */
-ods_status parser_zlist_zones(struct zlist_struct* zlist, const char* zlfile);
+ods_status parser_zlist_entries(region_type* r, const char* zlfile,
+    const char* rngfile, zlist_entry_type** entries, size_t* count);
 
 #endif /* PARSER_ZLISTPARSER_H */
@@ -0,0 +1,99 @@
+/*
+ * rzone.c -- store the records of the zone parser in a zone.
+ *
+ * Copyright (c) 2013, NLnet Labs. All rights reserved.
+ *
+ * See LICENSE for the license.
+ *
+ */
+
+#include "config.h"
+#include "dns/wf.h"
+#include "rzonec/rzonec.h"
+#include "signer/zone.h"
+#include "util/log.h"
+
+static const char* logstr = "rzonec";
+
+
+/**
+ * Add resource record to the zone.
+ *
+ */
+static ods_status
+rzone_add(zparser_type* parser, rr_type* rr)
+{
+    return zone_add_rr(parser->zone, rr, 1);
+}
+
+
+/**
+ * Process resource record that is part of an incremental zone transfer.
+ *
+ */
+static ods_status
+rzone_add_ixfr(zparser_type* parser, rr_type* rr)
+{
+    uint32_t serial;
+    if (parser->ixfr_done) {
+        ods_log_error("[%s] error: rr after final soa in ixfr", logstr);
+        return ODS_STATUS_ZPARSERERR;
+    }
+    if (rr->type == DNS_TYPE_SOA) {
+        serial = wf_read_uint32(rdata_get_data(&rr->rdata[2]));
+        parser->ixfr_soas++;
+        if (parser->ixfr_soas == 1) {
+            /* the first soa carries the serial we end up with */
+            parser->ixfr_serial = serial;
+            return ODS_STATUS_OK;
+        }
+        if (parser->ixfr_soas > 2 && !parser->ixfr_del &&
+            serial == parser->ixfr_serial) {
+            parser->ixfr_done = 1;
+            return ODS_STATUS_OK;
+        }
+        /* an old soa starts deletions, a new soa starts additions */
+        parser->ixfr_del = !parser->ixfr_del;
+    } else if (parser->ixfr_soas < 2) {
+        ods_log_error("[%s] error: ixfr does not start with two soa rrs",
+            logstr);
+        return ODS_STATUS_ZPARSERERR;
+    }
+    if (parser->ixfr_del) {
+        return zone_del_rr(parser->zone, rr, 1);
+    }
+    return zone_add_rr(parser->zone, rr, 1);
+}
+
+
+/**
+ * Create parser.
+ *
+ */
+zparser_type*
+zparser_create(zone_type* zone)
+{
+    zparser_type* parser = zparser_create_apex(zone->name,
+        zone->default_ttl, zone->klass);
+    if (parser) {
+        parser->zone = zone;
+        parser->add_rr = rzone_add;
+    }
+    return parser;
+}
+
+
+/**
+ * Create parser for incremental zone transfers.
+ *
+ */
+zparser_type*
+zparser_create_ixfr(zone_type* zone)
+{
+    zparser_type* parser = zparser_create(zone);
+    if (parser) {
+        parser->ixfr = 1;
+        parser->add_rr = rzone_add_ixfr;
+    }
+    return parser;
+}
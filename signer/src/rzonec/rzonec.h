@@ -13,11 +13,13 @@
 #include <stdint.h>
 
 #include "rzonec/zonec.h"
-#include "signer/zone.h"
 #include "util/region.h"
+#include "util/status.h"
 
 #define RZONEC_STACK_MAX 8
 
+struct zone_struct;
+
 /**
  * Zone parser structure.
  *
@@ -25,9 +27,15 @@
 typedef struct zparser zparser_type;
 struct zparser {
     region_type* region;      /* global memory region */
+    region_type* rr_region;   /* scratch region, reset after each rr */
+    dname_type* apex;         /* zone apex */
     dname_type* origin;       /* current origin */
     dname_type* previous;     /* previous rr owner */
-    zone_type* zone;          /* currently parsed zone */
+    struct zone_struct* zone; /* currently parsed zone, NULL when checking */
+    const char* name;         /* zone name, for messages */
+    const char* file;         /* file being parsed */
+    /* store a record in the zone, NULL when checking */
+    ods_status (*add_rr)(zparser_type* parser, rr_type* rr);
     /* We could handle ttl as a duration */
     uint64_t ttl;             /* current ttl */
     uint32_t klass;           /* zone class */
@@ -65,16 +73,62 @@ struct zparser {
     /* Temporary storage: resource records */
     rr_type current_rr;
     rdata_type* tmp_rdata;
+    uint8_t previous_owner[sizeof(dname_type) + 2 * DNAME_MAXLEN];
+
+    /* Incremental zone transfer */
+    uint32_t ixfr_serial;     /* serial of the final soa */
+    unsigned int ixfr_soas;   /* number of soas seen */
+    unsigned ixfr : 1;        /* input is an ixfr */
+    unsigned ixfr_del : 1;    /* in the deletion part of a difference */
+    unsigned ixfr_done : 1;   /* final soa seen */
+
+    /* Check mode */
+    unsigned int rrcount[DNS_NUMRRTYPES]; /* number of rrs per type */
+    unsigned check : 1;       /* only check the input, there is no zone */
 };
 
 
 /**
- * Create parser.
+ * Create parser for a zone with the given apex. The caller sets up how
+ * records are stored, or marks the parser as checking only.
+ * @param name:  zone name.
+ * @param ttl:   default ttl.
+ * @param klass: zone class.
+ * @return: (zparser_type*) parser, NULL on error.
+ *
+ */
+zparser_type* zparser_create_apex(const char* name, uint64_t ttl,
+    uint32_t klass);
+
+/**
+ * Create parser. Defined in rzonec/rzone.c, so that the parser itself
+ * does not depend on the zone.
  * @param zone: zone to be parsed.
  * @return: (zparser_type*) parser.
  *
  */
-zparser_type* zparser_create(zone_type* zone);
+zparser_type* zparser_create(struct zone_struct* zone);
+
+/**
+ * Create parser for incremental zone transfers. The input is read as a
+ * sequence of differences in IXFR format (RFC 1995): the new SOA, followed
+ * by one or more sequences of old SOA, deleted RRs, new SOA and added RRs,
+ * ending with the new SOA again.
+ * @param zone: zone to be updated.
+ * @return: (zparser_type*) parser.
+ *
+ */
+zparser_type* zparser_create_ixfr(struct zone_struct* zone);
+
+/**
+ * Create parser that only checks the input. Records are checked and
+ * counted per type, but not stored, so any input size is parsed in
+ * constant memory.
+ * @param origin: zone name.
+ * @return: (zparser_type*) parser, NULL on error.
+ *
+ */
+zparser_type* zparser_create_check(const char* origin);
 
 /**
  * Cleanup parser.
@@ -13,6 +13,7 @@
 #include "rzonec/rzonec.h"
 #include "util/log.h"
 #include "util/status.h"
+#include "util/util.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -24,7 +25,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
-#define MAX_BUFSIZE 1024
+#define MAX_BUFSIZE 65536
 
 static const char* logstr = "rzonec";
 
@@ -43,11 +44,11 @@ static const char* logstr = "rzonec";
 
 
 /**
- * Create parser.
+ * Create parser for a zone with the given apex.
  *
  */
 zparser_type*
-zparser_create(zone_type* zone)
+zparser_create_apex(const char* name, uint64_t ttl, uint32_t klass)
 {
     zparser_type* parser;
     region_type* r = region_create();
@@ -57,14 +58,24 @@ zparser_create(zone_type* zone)
     parser = (zparser_type*) region_alloc(r, sizeof(zparser_type));
     parser->tmp_rdata = (rdata_type*) region_alloc(r, DNS_RDATA_MAX *
         sizeof(rdata_type));
+    parser->rr_region = region_create();
+    parser->apex = dname_create(r, name);
+    parser->name = region_strdup(r, name);
+    if (!parser->rr_region || !parser->apex || !parser->name) {
+        region_cleanup(parser->rr_region);
+        region_cleanup(r);
+        return NULL;
+    }
     parser->top = 0;
     parser->cs = 0;
     parser->region = r;
-    parser->zone = zone;
-    parser->origin = dname_clone(r, zone->apex);
+    parser->zone = NULL;
+    parser->add_rr = NULL;
+    parser->file = "-";
+    parser->origin = parser->apex;
     parser->previous = NULL;
-    parser->ttl = zone->default_ttl;
-    parser->klass = zone->klass;
+    parser->ttl = ttl;
+    parser->klass = klass;
     parser->cs = zparser_start;
     parser->line = 1;
     parser->line_update = 10000;
@@ -87,6 +98,31 @@ zparser_create(zone_type* zone)
     parser->current_rr.klass = DNS_CLASS_IN;
     parser->current_rr.rdlen = 0;
     parser->current_rr.rdata = parser->tmp_rdata;
+    /* incremental zone transfer */
+    parser->ixfr_serial = 0;
+    parser->ixfr_soas = 0;
+    parser->ixfr = 0;
+    parser->ixfr_del = 0;
+    parser->ixfr_done = 0;
+    /* check mode */
+    memset(parser->rrcount, 0, sizeof(parser->rrcount));
+    parser->check = 0;
+    return parser;
+}
+
+
+/**
+ * Create parser that only checks the input.
+ *
+ */
+zparser_type*
+zparser_create_check(const char* origin)
+{
+    zparser_type* parser = zparser_create_apex(origin, DEFAULT_TTL,
+        DNS_CLASS_IN);
+    if (parser) {
+        parser->check = 1;
+    }
     return parser;
 }
 
@@ -98,6 +134,7 @@ zparser_create(zone_type* zone)
 void
 zparser_cleanup(zparser_type* parser)
 {
+    region_cleanup(parser->rr_region);
     region_cleanup(parser->region);
     return;
 }
@@ -117,6 +154,7 @@ zparser_read_zone(zparser_type* parser, const char* file)
     if (fd == -1) {
         return ODS_STATUS_FOPENERR;
     }
+    parser->file = file;
     while (1) {
         char* p;
         char* pe;
@@ -159,6 +197,34 @@ zparser_read_zone(zparser_type* parser, const char* file)
 }
 
 
+/**
+ * Check resource record, without adding it to a zone.
+ *
+ */
+static int
+zparser_check_rr(zparser_type* parser)
+{
+    rr_type* rr = &parser->current_rr;
+    char str[DNAME_MAXLEN*5];
+    if (!dname_is_subdomain(rr->owner, parser->apex)) {
+        dname_str(rr->owner, &str[0]);
+        ods_log_error("[%s] error: %s:%d: %s is out of zone", logstr,
+            parser->file, parser->line, str);
+        return 0;
+    }
+    if (rr->type == DNS_TYPE_SOA &&
+        dname_compare(rr->owner, parser->apex) != 0) {
+        dname_str(rr->owner, &str[0]);
+        ods_log_error("[%s] error: %s:%d: soa %s is not at the apex", logstr,
+            parser->file, parser->line, str);
+        return 0;
+    }
+    parser->rrcount[rr->type < DNS_NUMRRTYPES ? rr->type : 0]++;
+    parser->numrrs++;
+    return 1;
+}
+
+
 /**
  * Process resource record.
  *
@@ -167,6 +233,7 @@ int
 zparser_process_rr(zparser_type* parser)
 {
     ods_status status;
+    const char* name = parser->name;
 
     /* supported CLASS */
     if (parser->current_rr.klass != DNS_CLASS_IN) {
@@ -179,27 +246,32 @@ zparser_process_rr(zparser_type* parser)
      || parser->current_rr.type == DNS_TYPE_NSAP_PTR) {
         rrstruct_type* rrstruct = dns_rrstruct_by_type(parser->current_rr.type);
         ods_log_warning("[%s] warning: type %s in zone %s is obsoleted",
-            logstr, rrstruct->name, parser->zone->name);
+            logstr, rrstruct->name, name);
     } else if (parser->current_rr.type == DNS_TYPE_MB
            ||  parser->current_rr.type == DNS_TYPE_MG
            ||  parser->current_rr.type == DNS_TYPE_MR
            ||  parser->current_rr.type == DNS_TYPE_MINFO) {
         rrstruct_type* rrstruct = dns_rrstruct_by_type(parser->current_rr.type);
         ods_log_warning("[%s] warning: type %s in zone %s is experimental",
-            logstr, rrstruct->name, parser->zone->name);
+            logstr, rrstruct->name, name);
     } else if (parser->current_rr.type == DNS_TYPE_AFSDB) {
         rrstruct_type* rrstruct = dns_rrstruct_by_type(parser->current_rr.type);
         ods_log_warning("[%s] warning: type %s in zone %s is deprecated",
-            logstr, rrstruct->name, parser->zone->name);
+            logstr, rrstruct->name, name);
     }
     
     /* if soa: update new serial */
 
-    /* add rr to zone */
-    status = zone_add_rr(parser->zone, &parser->current_rr, 1);
-    if (status != ODS_STATUS_OK) {
-        ods_log_error("[%s] error: adding rr failed: %s", logstr,
-            ods_status2str(status));
+    /* check only: the record is valid if it belongs to the zone */
+    if (parser->check || !parser->add_rr) {
+        return zparser_check_rr(parser);
+    }
+
+    /* add rr to zone, or apply difference */
+    status = parser->add_rr(parser, &parser->current_rr);
+    if (status != ODS_STATUS_OK && status != ODS_STATUS_UNCHANGED) {
+        ods_log_error("[%s] error: %s rr failed: %s", logstr,
+            parser->ixfr_del?"deleting":"adding", ods_status2str(status));
         return 0;
     }
 
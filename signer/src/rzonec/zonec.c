@@ -168,19 +168,28 @@ zonec_rdata_apl(region_type* region, const char* buf)
  *
  */
 static uint16_t*
-zonec_rdata_base32hex(region_type* region, const char* buf)
+zonec_rdata_base32hex(region_type* region, const char* buf, size_t buflen)
 {
-    uint8_t rdata[DNS_RDLEN_MAX];
+    /* five bits per character, decoded in place */
+    size_t size = (buflen * 5 + 7) / 8;
     uint16_t* r = NULL;
     int i;
-    bzero(rdata, sizeof(rdata));
-    i = util_base32hex_pton(buf, rdata, DNS_RDLEN_MAX);
+    if (size > DNS_RDLEN_MAX) {
+        ods_log_error("[%s] error: base32hex too long (%u characters)",
+            logstr, (unsigned) buflen);
+        return NULL;
+    }
+    r = rdata_alloc_data(region, size);
+    if (!r) {
+        return NULL;
+    }
+    i = util_base32hex_pton(buf, (uint8_t*) (r+1), size);
     if (i < 0) {
         ods_log_error("[%s] error: invalid base32hex '%s' (ret %d)",
             logstr, buf, i);
-    } else {
-        r = rdata_init_data(region, rdata, i);
+        return NULL;
     }
+    *r = i;
     return r;
 }
 
@@ -190,19 +199,26 @@ zonec_rdata_base32hex(region_type* region, const char* buf)
  *
  */
 static uint16_t*
-zonec_rdata_base64(region_type* region, const char* buf)
+zonec_rdata_base64(region_type* region, const char* buf, size_t buflen)
 {
-    uint8_t rdata[DNS_RDLEN_MAX];
+    /* at most three bytes per four characters, decoded in place */
+    size_t size = (buflen + 3) / 4 * 3;
     uint16_t* r = NULL;
     int i;
-    bzero(rdata, sizeof(rdata));
-    i = b64_pton(buf, rdata, DNS_RDLEN_MAX);
+    if (size > DNS_RDLEN_MAX) {
+        size = DNS_RDLEN_MAX;
+    }
+    r = rdata_alloc_data(region, size);
+    if (!r) {
+        return NULL;
+    }
+    i = b64_pton(buf, (uint8_t*) (r+1), size);
     if (i < 0) {
         ods_log_error("[%s] error: invalid base64 '%s' (ret %d)",
             logstr, buf, i);
-    } else {
-        r = rdata_init_data(region, rdata, i);
+        return NULL;
     }
+    *r = i;
     return r;
 }
 
@@ -214,7 +230,7 @@ zonec_rdata_base64(region_type* region, const char* buf)
 static uint16_t*
 zonec_rdata_bitmap_nsec(region_type* region, const char* buf)
 {
-    static char rdata[DNS_RDLEN_MAX];
+    char* rdata = NULL;
     char* next = NULL;
     char* delim;
     char* rrtype;
@@ -230,8 +246,11 @@ zonec_rdata_bitmap_nsec(region_type* region, const char* buf)
     (void)memset(bitmap, 0, sizeof(bitmap));
     (void)memset(window, 0, sizeof(window));
     (void)memset(length, 0, sizeof(length));
-    (void)memset(rdata, 0, sizeof(rdata));
-    (void)memmove(rdata, buf, strlen(buf));
+    /* copy in the region, parsers run concurrently */
+    rdata = region_strdup(region, buf);
+    if (!rdata) {
+        return NULL;
+    }
     (void)ods_strtriml(rdata);
     ods_strreplace(rdata, '\t', sep);
     rrtype = rdata;
@@ -292,7 +311,7 @@ zonec_rdata_bitmap_nsec(region_type* region, const char* buf)
 static uint16_t*
 zonec_rdata_bitmap_nxt(region_type* region, const char* buf)
 {
-    static char rdata[DNS_RDLEN_MAX];
+    char* rdata = NULL;
     char* next = NULL;
     char* delim;
     char* rrtype;
@@ -303,8 +322,10 @@ zonec_rdata_bitmap_nxt(region_type* region, const char* buf)
     uint16_t last = 0;
 
     (void)memset(bitmap, 0, sizeof(bitmap));
-    (void)memset(rdata, 0, sizeof(rdata));
-    (void)memmove(rdata, buf, strlen(buf));
+    rdata = region_strdup(region, buf);
+    if (!rdata) {
+        return NULL;
+    }
     (void)ods_strtriml(rdata);
     ods_strreplace(rdata, '\t', sep);
     rrtype = rdata;
@@ -393,7 +414,6 @@ zonec_rdata_hex(region_type* region, const char* buf, size_t buflen)
 {
     uint16_t* r = NULL;
     uint8_t* t;
-    int i;
 
     if (buflen % 2 != 0) {
         ods_log_error("[%s] error: invalid hex length %u (must be a multiple "
@@ -403,15 +423,10 @@ zonec_rdata_hex(region_type* region, const char* buf, size_t buflen)
         *r = buflen/2;
         t = (uint8_t*) (r+1);
         while (*buf) {
-            i = 16;
-            *t = 0;
-            while (i >= 1) {
-                ods_log_assert(isxdigit((int)*buf));
-                *t += util_hexdigit2int(*buf) * i;
-                i -= 15;
-                buf++;
-            }
-            t++;
+            ods_log_assert(isxdigit((int)buf[0]) && isxdigit((int)buf[1]));
+            *t++ = (util_hexdigit2int(buf[0]) << 4) |
+                util_hexdigit2int(buf[1]);
+            buf += 2;
         }
     }
     return r;
@@ -428,7 +443,6 @@ zonec_rdata_hexlen(region_type* region, const char* buf, size_t buflen)
     uint16_t* r = NULL;
     uint8_t* t;
     uint8_t* l;
-    int i;
 
     if (ods_strcmp(buf, "-") == 0) {
         return rdata_init_data(region, "", 1);
@@ -446,15 +460,10 @@ zonec_rdata_hexlen(region_type* region, const char* buf, size_t buflen)
         l = t++;
         *l = '\0';
         while (*buf) {
-            i = 16;
-            *t = 0;
-            while (i >= 1) {
-                ods_log_assert(isxdigit((int)*buf));
-                *t += util_hexdigit2int(*buf) * i;
-                i -= 15;
-                buf++;
-            }
-            t++;
+            ods_log_assert(isxdigit((int)buf[0]) && isxdigit((int)buf[1]));
+            *t++ = (util_hexdigit2int(buf[0]) << 4) |
+                util_hexdigit2int(buf[1]);
+            buf += 2;
             ++*l;
         }
     }
@@ -829,7 +838,7 @@ zonec_rdata_rrtype(region_type* region, const char* buf)
 static uint16_t*
 zonec_rdata_services(region_type* region, const char* buf)
 {
-    static char rdata[DNS_RDLEN_MAX];
+    char* rdata = NULL;
     char sep = ' ';
     uint16_t* r = NULL;
     uint8_t* protocol;
@@ -843,8 +852,10 @@ zonec_rdata_services(region_type* region, const char* buf)
     size_t offset = 0;
 
     (void)memset(bitmap, 0, sizeof(bitmap));
-    (void)memset(rdata, 0, sizeof(rdata));
-    (void)memmove(rdata, buf, strlen(buf));
+    rdata = region_strdup(region, buf);
+    if (!rdata) {
+        return NULL;
+    }
     (void)ods_strtriml(rdata);
     ods_strreplace(rdata, '\t', sep);
     service = rdata;
@@ -1011,10 +1022,10 @@ zonec_rdata_add(region_type* region, rr_type* rr, dns_rdata_format rdformat,
             d = zonec_rdata_rrtype(region, rdbuf);
             break;
         case DNS_RDATA_BASE32HEX:
-            d = zonec_rdata_base32hex(region, rdbuf);
+            d = zonec_rdata_base32hex(region, rdbuf, rdsize);
             break;
         case DNS_RDATA_BASE64:
-            d = zonec_rdata_base64(region, rdbuf);
+            d = zonec_rdata_base64(region, rdbuf, rdsize);
             break;
         case DNS_RDATA_HEX:
             d = zonec_rdata_hex(region, rdbuf, rdsize);
@@ -1081,3 +1092,48 @@ zonec_rdata_add(region_type* region, rr_type* rr, dns_rdata_format rdformat,
 */
     return 1;
 }
+
+
+/**
+ * Add wire format RDATA element.
+ *
+ */
+int
+zonec_rdata_add_data(region_type* region, rr_type* rr, const void* data,
+    size_t size)
+{
+    uint16_t* d = NULL;
+    if (rr->rdlen >= DNS_RDATA_MAX) {
+        ods_log_error("[%s] error: too many rdata elements", logstr);
+        return 0;
+    }
+    d = rdata_init_data(region, data, size);
+    if (!d) {
+        ods_log_error("[%s] error: unable to add rdata element", logstr);
+        return 0;
+    }
+    rr->rdata[rr->rdlen].data = d;
+    rr->rdlen++;
+    return 1;
+}
+
+
+/**
+ * Add domain name RDATA element.
+ *
+ */
+int
+zonec_rdata_add_dname(rr_type* rr, dname_type* name)
+{
+    if (rr->rdlen >= DNS_RDATA_MAX) {
+        ods_log_error("[%s] error: too many rdata elements", logstr);
+        return 0;
+    }
+    if (!name) {
+        ods_log_error("[%s] error: bad rdata dname", logstr);
+        return 0;
+    }
+    rr->rdata[rr->rdlen].dname = name;
+    rr->rdlen++;
+    return 1;
+}
@@ -33,5 +33,27 @@ int zonec_rdata_add(region_type* region, rr_type* rr,
    dns_rdata_format rdformat, dname_type* name,
    const char* rdbuf, size_t rdlen);
 
+/**
+ * Add RDATA element that is already in wire format into currently parsed
+ * resource record.
+ * @param region:   memory region.
+ * @param rr:       currently parsed resource record.
+ * @param data:     wire format RDATA element.
+ * @param size:     size of data.
+ * @return:         (int) 1 on success, 0 on failure.
+ *
+ */
+int zonec_rdata_add_data(region_type* region, rr_type* rr,
+   const void* data, size_t size);
+
+/**
+ * Add domain name RDATA element into currently parsed resource record.
+ * @param rr:       currently parsed resource record.
+ * @param name:     parsed dname.
+ * @return:         (int) 1 on success, 0 on failure.
+ *
+ */
+int zonec_rdata_add_dname(rr_type* rr, dname_type* name);
+
 #endif /* RZONEC_ZONEC_H */
 
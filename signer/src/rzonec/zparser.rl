@@ -22,6 +22,7 @@
     # Actions: line parsing.
     action zparser_reinitialize {
         parser->group_lines = 0;
+        region_free(parser->rr_region);
     }
     action zparser_newline {
         if (parser->line > parser->line_update) {
@@ -35,8 +36,8 @@
     }
     action zparser_parentheses_open {
         if (parser->group_lines) {
-            ods_log_error("[zparser] line %d: nested parentheses",
-                parser->line);
+            ods_log_error("[zparser] %s:%d: nested parentheses",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -45,8 +46,8 @@
     }
     action zparser_parentheses_close {
         if (!parser->group_lines) {
-            ods_log_error("[zparser] line %d: closing parentheses without "
-                "opening parentheses", parser->line);
+            ods_log_error("[zparser] %s:%d: closing parentheses without "
+                "opening parentheses", parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -107,8 +108,8 @@
             parser->rdbuf[parser->rdsize] = fc;
             parser->rdsize++;
         } else {
-            ods_log_error("[zparser] error: line %d: character string overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: character string overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -118,8 +119,8 @@
             parser->rdbuf[parser->dname_size] = 0;
             parser->rdsize++;
         } else {
-            ods_log_error("[zparser] error: line %d: character string overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: character string overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -140,8 +141,8 @@
             parser->dname_wire[parser->dname_size] = fc;
             parser->dname_size++;
         } else {
-            ods_log_error("[zparser] error: line %d: domain name overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: domain name overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -151,8 +152,8 @@
             parser->dname_wire[parser->dname_size] = 0;
             parser->dname_size++;
         } else {
-            ods_log_error("[zparser] error: line %d: domain name overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: domain name overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -188,8 +189,8 @@
         if (parser->dname_size < DNAME_MAXLEN) {
             parser->dname_wire[parser->dname_size] = 0;
         } else {
-            ods_log_error("[zparser] line %d: domain name overflow",
-                parser->line);
+            ods_log_error("[zparser] %s:%d: domain name overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -200,16 +201,16 @@
                     dname_name(parser->origin), dname_len(parser->origin));
                 parser->dname_size += (dname_len(parser->origin) - 1);
             } else{
-                ods_log_error("[zparser] line %d: domain name overflow",
-                    parser->line);
+                ods_log_error("[zparser] %s:%d: domain name overflow",
+                    parser->file, parser->line);
                 parser->totalerrors++;
                 fhold; fgoto line_error;
             }
         }
         while (1) {
             if (label_is_pointer(parser->label)) {
-                ods_log_error("[zparser] line %d: domain has pointer label",
-                    parser->line);
+                ods_log_error("[zparser] %s:%d: domain has pointer label",
+                    parser->file, parser->line);
                 parser->totalerrors++;
                 fhold; fgoto line_error;
             }
@@ -229,12 +230,12 @@
                 parser->label_offsets[parser->label_count - i - 1];
             parser->label_offsets[parser->label_count - i - 1] = tmp;
         }
-        parser->dname = (dname_type *) region_alloc(parser->region,
+        parser->dname = (dname_type *) region_alloc(parser->rr_region,
             (sizeof(dname_type) +
             (parser->label_count + parser->dname_size) * sizeof(uint8_t)));
         if (!parser->dname) {
-            ods_log_error("[zparser] line %d: domain create failed",
-                parser->line);
+            ods_log_error("[zparser] %s:%d: domain create failed",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -339,14 +340,13 @@
                     snprintf(&t[0], 10, "TYPE%u",
                         (unsigned) parser->current_rr.type);
                 }
-                ods_log_error("[zparser] line %d: rrtype %s not supported",
-                    parser->line, rs->name?rs->name:&t[0]);
+                ods_log_error("[zparser] %s:%d: rrtype %s not supported",
+                    parser->file, parser->line, rs->name?rs->name:&t[0]);
                 parser->totalerrors++;
                 fgoto line_error;
        }
     }
     action zparser_rdata_start {
-        bzero(&parser->rdbuf[0], DNS_RDLEN_MAX);
         parser->rdsize = 0;
     }
     action zparser_rdata_char {
@@ -354,8 +354,8 @@
             parser->rdbuf[parser->rdsize] = fc;
             parser->rdsize++;
         } else {
-            ods_log_error("[zparser] error: line %d: rdata overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: rdata overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -367,21 +367,8 @@
                 parser->rdsize++;
             }
         } else {
-            ods_log_error("[zparser] error: line %d: rdata overflow",
-                parser->line);
-            parser->totalerrors++;
-            fhold; fgoto line_error;
-        }
-    }
-    action zparser_rdata_char_hex {
-        if (parser->rdsize <= DNS_RDLEN_MAX) {
-            if (isxdigit((int) fc)) {
-                parser->rdbuf[parser->rdsize] = fc;
-                parser->rdsize++;
-            }
-        } else {
-            ods_log_error("[zparser] error: line %d: rdata overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: rdata overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -393,8 +380,8 @@
                 parser->rdsize++;
             }
         } else {
-            ods_log_error("[zparser] error: line %d: rdata overflow",
-                parser->line);
+            ods_log_error("[zparser] error: %s:%d: rdata overflow",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -402,25 +389,137 @@
     action zparser_rdata_end {
         rrstruct_type* rs = dns_rrstruct_by_type(parser->current_rr.type);
         parser->rdbuf[parser->rdsize] = '\0';
-        if (!zonec_rdata_add(parser->region, &parser->current_rr,
+        if (!zonec_rdata_add(parser->rr_region, &parser->current_rr,
             rs->rdata[parser->current_rr.rdlen], parser->dname,
             parser->rdbuf, parser->rdsize)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
     }
     action zparser_rdata_str_end {
         parser->rdbuf[parser->rdsize] = '\0';
-        if (!zonec_rdata_add(parser->region, &parser->current_rr,
+        if (!zonec_rdata_add(parser->rr_region, &parser->current_rr,
             DNS_RDATA_TEXT, parser->dname, parser->rdbuf, parser->rdsize)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
     }
     action zparser_rdata_apl_end {
         parser->rdbuf[parser->rdsize] = '\0';
-        if (!zonec_rdata_add(parser->region, &parser->current_rr,
+        if (!zonec_rdata_add(parser->rr_region, &parser->current_rr,
             DNS_RDATA_APLS, parser->dname, parser->rdbuf, parser->rdsize)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+
+    # Actions: rdata that is written in wire format while it is scanned,
+    # for the fields of the common record types.
+    action zparser_rdata_wire_start {
+        parser->rdsize = 0;
+        parser->rdbuf[0] = '\0';
+        parser->number = 0;
+    }
+    action zparser_ipv4_digit {
+        parser->number = parser->number * 10 + (fc - '0');
+        if (parser->number > 255) {
+            ods_log_error("[zparser] error: %s:%d: bad ipv4 address",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_ipv4_octet {
+        parser->rdbuf[parser->rdsize++] = (char) parser->number;
+        parser->number = 0;
+    }
+    action zparser_rdata_ipv4_end {
+        parser->rdbuf[parser->rdsize++] = (char) parser->number;
+        if (!zonec_rdata_add_data(parser->rr_region, &parser->current_rr,
+            parser->rdbuf, DNS_IPV4_ADDRLEN)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_int_digit {
+        parser->number = parser->number * 10 + (fc - '0');
+        if (parser->number > 65535) {
+            ods_log_error("[zparser] error: %s:%d: number out of range",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_rdata_int8_end {
+        if (parser->number > 255) {
+            ods_log_error("[zparser] error: %s:%d: number out of range",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+        parser->rdbuf[0] = (char) parser->number;
+        if (!zonec_rdata_add_data(parser->rr_region, &parser->current_rr,
+            parser->rdbuf, 1)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_rdata_int16_end {
+        parser->rdbuf[0] = (char) (parser->number >> 8);
+        parser->rdbuf[1] = (char) (parser->number & 0xff);
+        if (!zonec_rdata_add_data(parser->rr_region, &parser->current_rr,
+            parser->rdbuf, 2)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_hex_digit {
+        if (parser->rdsize / 2 >= DNS_RDLEN_MAX) {
+            ods_log_error("[zparser] error: %s:%d: rdata overflow",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+        if (parser->rdsize % 2 == 0) {
+            parser->rdbuf[parser->rdsize / 2] =
+                (char) (util_hexdigit2int(fc) << 4);
+        } else {
+            parser->rdbuf[parser->rdsize / 2] |= util_hexdigit2int(fc);
+        }
+        parser->rdsize++;
+    }
+    action zparser_rdata_hex_end {
+        if (parser->rdsize % 2 != 0) {
+            ods_log_error("[zparser] error: %s:%d: invalid hex length %u "
+                "(must be a multiple of 2)", parser->file, parser->line,
+                (unsigned) parser->rdsize);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+        if (!zonec_rdata_add_data(parser->rr_region, &parser->current_rr,
+            parser->rdbuf, parser->rdsize / 2)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
+            parser->totalerrors++;
+            fhold; fgoto line_error;
+        }
+    }
+    action zparser_rdata_dname_end {
+        if (!zonec_rdata_add_dname(&parser->current_rr, parser->dname)) {
+            ods_log_error("[zparser] error: %s:%d: bad rdata",
+                parser->file, parser->line);
             parser->totalerrors++;
             fhold; fgoto line_error;
         }
@@ -448,115 +547,129 @@
     action zparser_rr_end {
         if (!parser->group_lines) {
             if (!zparser_process_rr(parser)) {
-                ods_log_error("[zparser] error: line %d: unable to process rr",
-                    parser->line);
+                ods_log_error("[zparser] error: %s:%d: unable to process rr",
+                    parser->file, parser->line);
                 parser->totalerrors++;
                 fhold; fgoto line_error;
             }
-            parser->previous = parser->current_rr.owner;
+            /* the owner outlives the scratch region of this rr */
+            if (parser->current_rr.owner != parser->previous) {
+                memcpy(parser->previous_owner, parser->current_rr.owner,
+                    dname_total_size(parser->current_rr.owner));
+                parser->previous = (dname_type*) parser->previous_owner;
+            }
+            region_free(parser->rr_region);
         }
     }
     # Actions: errors.
     action zerror_entry {
-        ods_log_error("[zparser] error: line %d: bad entry (fc=%c)", 
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad entry (fc=%c)", 
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_dollar_origin {
-        ods_log_error("[zparser] error: line %d: bad $origin directive (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad $origin directive (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_dollar_ttl {
-        ods_log_error("[zparser] error: line %d: bad $ttl directive (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad $ttl directive (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_timeformat {
-        ods_log_error("[zparser] error: line %d: ttl time format error (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: ttl time format error (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_text_ddd {
-        ods_log_error("[zparser] error: line %d: bad octet in text",
-            parser->line);
+        ods_log_error("[zparser] error: %s:%d: bad octet in text",
+            parser->file, parser->line);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_float {
-        ods_log_error("[zparser] error: line %d: bad float number",
-            parser->line);
+        ods_log_error("[zparser] error: %s:%d: bad float number",
+            parser->file, parser->line);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_text_x {
-        ods_log_error("[zparser] error: line %d: bad escape in text",
-            parser->line);
+        ods_log_error("[zparser] error: %s:%d: bad escape in text",
+            parser->file, parser->line);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_str_seq {
-        ods_log_error("[zparser] error: line %d: bad character string (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad character string (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_label_ddd {
-        ods_log_error("[zparser] error: line %d: bad octet in label (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad octet in label (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_label_x {
-        ods_log_error("[zparser] error: line %d: bad escape in label (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad escape in label (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_label_char {
-        ods_log_error("[zparser] error: line %d: bad char in label (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad char in label (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_label_overflow {
-        ods_log_error("[zparser] error: line %d: label overflow (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: label overflow (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_rr {
-        ods_log_error("[zparser] error: line %d: bad rr format (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad rr format (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_rr_typedata {
-        ods_log_error("[zparser] error: line %d: bad rr typedata (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad rr typedata (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_rdata {
-        ods_log_error("[zparser] error: line %d: bad rdata (fc=%c)",
-            parser->line, fc);
+        ods_log_error("[zparser] error: %s:%d: bad rdata (fc=%c)",
+            parser->file, parser->line, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
     action zerror_rdata_err {
         rrstruct_type* rs = dns_rrstruct_by_type(parser->current_rr.type);
         parser->rdbuf[parser->rdsize] = '\0';
-        ods_log_error("[zparser] error: line %d: bad %s rdata %s (fc=%c)",
-            parser->line,
+        ods_log_error("[zparser] error: %s:%d: bad %s rdata %s (fc=%c)",
+            parser->file, parser->line,
             dns_rdata_format_str(rs->rdata[parser->current_rr.rdlen]),
             parser->rdbuf, fc);
         parser->totalerrors++;
         fhold; fgoto line_error;
     }
+    action zerror_rdata_wire {
+        rrstruct_type* rs = dns_rrstruct_by_type(parser->current_rr.type);
+        ods_log_error("[zparser] error: %s:%d: bad %s rdata (fc=%c)",
+            parser->file, parser->line,
+            dns_rdata_format_str(rs->rdata[parser->current_rr.rdlen]), fc);
+        parser->totalerrors++;
+        fhold; fgoto line_error;
+    }
 
     ## Utility parsing, newline, comments, delimeters, numbers, time values.
 
@@ -719,26 +832,36 @@
     ipv6_addr        = ( ipv6_xxxxxxxx | ipv6_compressed | ipv6_mapped );
 
     ## RDATA parsing.
-    rd_ipv4          = ipv4_addr
-                     >zparser_rdata_start $zparser_rdata_char
-                     %zparser_rdata_end   $!zerror_rdata_err;
+    rd_ipv4          = ( (digit{1,3} $zparser_ipv4_digit
+                         . '.' @zparser_ipv4_octet){3}
+                       . digit{1,3} $zparser_ipv4_digit )
+                     >zparser_rdata_wire_start
+                     %zparser_rdata_ipv4_end $!zerror_rdata_wire;
 
     rd_ipv6          = ipv6_addr
                      >zparser_rdata_start $zparser_rdata_char
                      %zparser_rdata_end   $!zerror_rdata_err;
 
     rd_abs_dname     = (abs_dname)
-                     >zparser_rdata_start $zparser_rdata_char
-                     %zparser_rdata_end   $!zerror_rdata_err;
+                     >zparser_rdata_wire_start
+                     %zparser_rdata_dname_end $!zerror_rdata_wire;
 
     rd_dname         = (abs_dname | rel_dname)
-                     >zparser_rdata_start $zparser_rdata_char
-                     %zparser_rdata_end   $!zerror_rdata_err;
+                     >zparser_rdata_wire_start
+                     %zparser_rdata_dname_end $!zerror_rdata_wire;
 
     rd_int           = digit+
                      >zparser_rdata_start $zparser_rdata_char
                      %zparser_rdata_end   $!zerror_rdata_err;
 
+    rd_int8          = digit+
+                     >zparser_rdata_wire_start $zparser_int_digit
+                     %zparser_rdata_int8_end $!zerror_rdata_wire;
+
+    rd_int16         = digit+
+                     >zparser_rdata_wire_start $zparser_int_digit
+                     %zparser_rdata_int16_end $!zerror_rdata_wire;
+
     rd_float         = str_float
                      >zparser_rdata_start
                      %zparser_rdata_end $!zerror_rdata_err;
@@ -800,9 +923,9 @@
                      >zparser_rdata_start $zparser_rdata_char
                      %zparser_rdata_apl_end $!zerror_rdata_err;
 
-    rd_hex           = (xdigit+ . delim?)+
-                     >zparser_rdata_start $zparser_rdata_char_hex
-                     %zparser_rdata_end   $!zerror_rdata_err;
+    rd_hex           = ((xdigit $zparser_hex_digit)+ . delim?)+
+                     >zparser_rdata_wire_start
+                     %zparser_rdata_hex_end $!zerror_rdata_wire;
 
     rd_hexlen        = (xdigit+ | '-')
                      >zparser_rdata_start $zparser_rdata_char
@@ -866,7 +989,7 @@
     rdata_minfo     := ( rd_dname . delim . rd_dname )
                      %zparser_hold_ret . special_char;
 
-    rdata_mx        := ( rd_int . delim . rd_dname )
+    rdata_mx        := ( rd_int16 . delim . rd_dname )
                      %zparser_hold_ret . special_char;
 
     rdata_txt       := ( rd_str . (delim . rd_str)* . delim? )
@@ -906,7 +1029,7 @@
     rdata_nxt       := ( rd_dname . rd_bitmap )
                      %zparser_hold_ret . special_char_end;
 
-    rdata_srv       := ( (rd_int . delim){3} . rd_dname )
+    rdata_srv       := ( (rd_int16 . delim){3} . rd_dname )
                      %zparser_hold_ret . special_char;
 
     rdata_naptr     := ( (rd_int . delim){2} . (rd_str . delim){3}
@@ -923,7 +1046,7 @@
     rdata_apl       := ( rd_apl? . ( delim . rd_apl)* . delim? )
                     %zparser_hold_ret . special_char_end;
 
-    rdata_ds        := ( rd_int . delim . rd_algorithm . delim . rd_int
+    rdata_ds        := ( rd_int16 . delim . rd_algorithm . delim . rd_int8
                        . delim . rd_hex . delim? )
                     %zparser_hold_ret . special_char_end;
 
@@ -168,6 +168,9 @@ void
 task_log(task_type* task)
 {
     char* strtime = NULL;
+    if (!ods_log_enabled(LOG_DEBUG)) {
+        return;
+    }
     if (task) {
         strtime = ctime(&task->when);
         if (strtime) {
@@ -48,10 +48,11 @@ domain_create(struct zone_struct* zone, dname_type* dname)
 {
     domain_type* domain = NULL;
     ods_log_assert(zone);
-    ods_log_assert(zone->region);
+    ods_log_assert(zone->namedb);
     ods_log_assert(dname);
-    domain = (domain_type*) region_alloc(zone->region, sizeof(domain_type));
-    domain->dname = dname_clone(zone->region, dname);
+    domain = (domain_type*) region_alloc(zone->namedb->region,
+        sizeof(domain_type));
+    domain->dname = dname_clone(zone->namedb->region, dname);
     domain->zone = zone;
     domain->node = NULL; /* not in db yet */
     domain->parent = NULL;
@@ -167,12 +168,50 @@ domain_del_rrset(domain_type* domain, ldns_rr_type rrtype)
 void
 domain_diff(domain_type* domain, unsigned incremental, unsigned more_coming)
 {
+    rrset_type** p;
     rrset_type* rrset;
     ods_log_assert(domain);
-    rrset = domain->rrsets;
-    while (rrset) {
+    p = &domain->rrsets;
+    while (*p) {
+        rrset = *p;
         rrset_diff(rrset, incremental, more_coming);
-        rrset = rrset->next;
+        if (rrset->rr_count == 0) {
+            /* all records removed */
+            *p = rrset->next;
+            rrset->next = NULL;
+            rrset_log(domain->dname, rrset->rrtype, "[namedb] -RRSET",
+                LOG_DEEEBUG);
+            rrset_cleanup(rrset);
+            continue;
+        }
+        p = &rrset->next;
+    }
+    return;
+}
+
+
+/**
+ * Rollback differences in domain.
+ *
+ */
+void
+domain_rollback(domain_type* domain)
+{
+    rrset_type** p;
+    rrset_type* rrset;
+    ods_log_assert(domain);
+    p = &domain->rrsets;
+    while (*p) {
+        rrset = *p;
+        rrset_rollback(rrset);
+        if (rrset->rr_count == 0) {
+            /* rrset was created by the differences */
+            *p = rrset->next;
+            rrset->next = NULL;
+            rrset_cleanup(rrset);
+            continue;
+        }
+        p = &rrset->next;
     }
     return;
 }
@@ -106,6 +106,13 @@ void domain_add_rrset(domain_type* domain, rrset_type* rrset);
 void domain_diff(domain_type* domain, unsigned incremental,
     unsigned more_coming);
 
+/**
+ * Rollback differences in domain.
+ * @param domain: domain.
+ *
+ */
+void domain_rollback(domain_type* domain);
+
 /**
  * Print domain.
  * @param fd:     file descriptor.
@@ -0,0 +1,697 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Journal of zone differences.
+ *
+ */
+
+#include "config.h"
+#include "dns/dns.h"
+#include "dns/rdata.h"
+#include "dns/wf.h"
+#include "signer/journal.h"
+#include "signer/zone.h"
+#include "util/file.h"
+#include "util/log.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char* logstr = "journal";
+
+
+/**
+ * Write integers to journal file.
+ *
+ */
+static int
+journal_write_u8(FILE* fd, uint8_t data)
+{
+    return fwrite(&data, sizeof(data), 1, fd) == 1;
+}
+static int
+journal_write_u16(FILE* fd, uint16_t data)
+{
+    data = htons(data);
+    return fwrite(&data, sizeof(data), 1, fd) == 1;
+}
+static int
+journal_write_u32(FILE* fd, uint32_t data)
+{
+    data = htonl(data);
+    return fwrite(&data, sizeof(data), 1, fd) == 1;
+}
+
+
+/**
+ * Read integers from journal file.
+ *
+ */
+static int
+journal_read_u8(FILE* fd, uint8_t* data)
+{
+    return fread(data, sizeof(*data), 1, fd) == 1;
+}
+static int
+journal_read_u16(FILE* fd, uint16_t* data)
+{
+    if (fread(data, sizeof(*data), 1, fd) != 1) {
+        return 0;
+    }
+    *data = ntohs(*data);
+    return 1;
+}
+static int
+journal_read_u32(FILE* fd, uint32_t* data)
+{
+    if (fread(data, sizeof(*data), 1, fd) != 1) {
+        return 0;
+    }
+    *data = ntohl(*data);
+    return 1;
+}
+
+
+/**
+ * Is the RDATA element at this position a domain name?
+ *
+ */
+static int
+journal_rdata_is_dname(rr_type* rr, size_t pos)
+{
+    rrstruct_type* rrstruct = dns_rrstruct_by_type(rr->type);
+    uint8_t gateway;
+    if (rrstruct->rdata[pos] == DNS_RDATA_COMPRESSED_DNAME ||
+        rrstruct->rdata[pos] == DNS_RDATA_UNCOMPRESSED_DNAME) {
+        return 1;
+    }
+    if (rrstruct->rdata[pos] == DNS_RDATA_IPSECGATEWAY) {
+        gateway = rdata_get_data(&rr->rdata[1])[0];
+        return gateway == 0 || gateway == 3;
+    }
+    return 0;
+}
+
+
+/**
+ * Write record to journal file. Each RDATA element is stored with its
+ * size, so that the record can be read back without parsing the RDATA.
+ *
+ */
+static int
+journal_write_rr(FILE* fd, rr_type* rr)
+{
+    dname_type* dname;
+    size_t i;
+    if (fwrite(dname_name(rr->owner), dname_len(rr->owner), 1, fd) != 1 ||
+        !journal_write_u16(fd, rr->type) ||
+        !journal_write_u16(fd, rr->klass) ||
+        !journal_write_u32(fd, rr->ttl) ||
+        !journal_write_u8(fd, (uint8_t) rr->rdlen)) {
+        return 0;
+    }
+    for (i=0; i < rr->rdlen; i++) {
+        if (journal_rdata_is_dname(rr, i)) {
+            dname = rdata_get_dname(&rr->rdata[i]);
+            if (!journal_write_u8(fd, 1) ||
+                !journal_write_u16(fd, (uint16_t) dname_len(dname)) ||
+                fwrite(dname_name(dname), dname_len(dname), 1, fd) != 1) {
+                return 0;
+            }
+        } else {
+            if (!journal_write_u8(fd, 0) ||
+                !journal_write_u16(fd, rdata_size(&rr->rdata[i]))) {
+                return 0;
+            }
+            if (rdata_size(&rr->rdata[i]) > 0 &&
+                fwrite(rdata_get_data(&rr->rdata[i]),
+                rdata_size(&rr->rdata[i]), 1, fd) != 1) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Read domain name from journal file.
+ *
+ */
+static dname_type*
+journal_read_dname(FILE* fd, region_type* r)
+{
+    uint8_t wire[DNAME_MAXLEN+1];
+    size_t len = 0;
+    uint8_t label = 0;
+    while (1) {
+        if (!journal_read_u8(fd, &label) || (label & 0xc0) ||
+            len + label + 1 > DNAME_MAXLEN) {
+            return NULL;
+        }
+        wire[len++] = label;
+        if (label == 0) {
+            break;
+        }
+        if (fread(&wire[len], label, 1, fd) != 1) {
+            return NULL;
+        }
+        len += label;
+    }
+    return dname_create_frm_data(r, wire);
+}
+
+
+/**
+ * Read next record from the journal file.
+ *
+ */
+rr_type*
+journal_read_rr(FILE* fd, region_type* r)
+{
+    uint16_t* data;
+    rr_type* rr;
+    uint8_t rdlen = 0;
+    uint8_t kind = 0;
+    uint16_t size = 0;
+    size_t i;
+    ods_log_assert(fd);
+    ods_log_assert(r);
+    rr = (rr_type*) region_alloc(r, sizeof(rr_type));
+    rr->owner = journal_read_dname(fd, r);
+    if (!rr->owner ||
+        !journal_read_u16(fd, &rr->type) ||
+        !journal_read_u16(fd, &rr->klass) ||
+        !journal_read_u32(fd, &rr->ttl) ||
+        !journal_read_u8(fd, &rdlen) || rdlen > DNS_RDATA_MAX) {
+        return NULL;
+    }
+    rr->rdlen = rdlen;
+    rr->rdata = (rdata_type*) region_alloc(r, rdlen * sizeof(rdata_type));
+    for (i=0; i < rr->rdlen; i++) {
+        if (!journal_read_u8(fd, &kind) || !journal_read_u16(fd, &size)) {
+            return NULL;
+        }
+        if (kind) {
+            rr->rdata[i].dname = journal_read_dname(fd, r);
+            if (!rr->rdata[i].dname) {
+                return NULL;
+            }
+        } else {
+            /* read straight into the region, not onto the stack */
+            data = rdata_alloc_data(r, size);
+            if (!data ||
+                (size > 0 && fread(data + 1, size, 1, fd) != 1)) {
+                return NULL;
+            }
+            rr->rdata[i].data = data;
+        }
+    }
+    return rr;
+}
+
+
+/**
+ * Index the entries in the journal file. A trailing entry that was not
+ * completely written is cut off.
+ *
+ */
+static void
+journal_load(journal_type* journal)
+{
+    journal_entry_type entry;
+    uint32_t magic = 0;
+    long size = 0;
+    FILE* fd;
+    fd = ods_fopen(journal->filename, NULL, "r");
+    if (!fd) {
+        return;
+    }
+    if (fseek(fd, 0, SEEK_END) != 0 || (size = ftell(fd)) < 0) {
+        ods_fclose(fd);
+        return;
+    }
+    entry.offset = 0;
+    while (entry.offset < size) {
+        if (fseek(fd, entry.offset, SEEK_SET) != 0 ||
+            !journal_read_u32(fd, &magic) ||
+            !journal_read_u32(fd, &entry.length) ||
+            !journal_read_u32(fd, &entry.serial_from) ||
+            !journal_read_u32(fd, &entry.serial_to) ||
+            !journal_read_u32(fd, &entry.num_del) ||
+            !journal_read_u32(fd, &entry.num_add) ||
+            magic != JOURNAL_MAGIC ||
+            entry.offset + JOURNAL_HEADER_SIZE + (long) entry.length > size) {
+            break;
+        }
+        if (journal->count == JOURNAL_MAX_ENTRIES) {
+            memmove(&journal->entries[0], &journal->entries[1],
+                (JOURNAL_MAX_ENTRIES-1) * sizeof(journal_entry_type));
+            journal->count--;
+        }
+        journal->entries[journal->count++] = entry;
+        entry.offset += JOURNAL_HEADER_SIZE + entry.length;
+    }
+    ods_fclose(fd);
+    if (entry.offset < size) {
+        ods_log_warning("[%s] journal %s is truncated at offset %ld", logstr,
+            journal->filename, entry.offset);
+        if (truncate(journal->filename, (off_t) entry.offset) != 0) {
+            ods_log_error("[%s] truncate journal %s failed: %s", logstr,
+                journal->filename, strerror(errno));
+            journal_purge(journal);
+        }
+    }
+    return;
+}
+
+
+/**
+ * Create journal.
+ *
+ */
+journal_type*
+journal_create(region_type* r, const char* zonename)
+{
+    journal_type* journal;
+    char* filename;
+    ods_log_assert(r);
+    ods_log_assert(zonename);
+    journal = (journal_type*) region_alloc(r, sizeof(journal_type));
+    filename = (char*) region_alloc(r,
+        strlen(zonename) + strlen(JOURNAL_SUFFIX) + 1);
+    (void)strcpy(filename, zonename);
+    (void)strcat(filename, JOURNAL_SUFFIX);
+    journal->filename = filename;
+    journal->count = 0;
+    journal_load(journal);
+    ods_log_debug("[%s] journal %s has %u entries", logstr, journal->filename,
+        (unsigned) journal->count);
+    return journal;
+}
+
+
+/**
+ * Compact journal: drop the oldest half of the entries.
+ *
+ */
+static ods_status
+journal_compact(journal_type* journal)
+{
+    char tmpfile[PATH_MAX];
+    char buf[BUFSIZ];
+    size_t keep = JOURNAL_MAX_ENTRIES/2;
+    size_t drop = journal->count - keep;
+    size_t n;
+    long base;
+    FILE* in;
+    FILE* out;
+    size_t i;
+    if (journal->count <= keep) {
+        return ODS_STATUS_OK;
+    }
+    (void)snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", journal->filename);
+    in = ods_fopen(journal->filename, NULL, "r");
+    out = ods_fopen(tmpfile, NULL, "w");
+    base = journal->entries[drop].offset;
+    if (!in || !out || fseek(in, base, SEEK_SET) != 0) {
+        goto compact_failed;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) {
+            goto compact_failed;
+        }
+    }
+    if (ferror(in) || fflush(out) != 0 || fsync(fileno(out)) != 0) {
+        goto compact_failed;
+    }
+    ods_fclose(in);
+    ods_fclose(out);
+    if (rename(tmpfile, journal->filename) != 0) {
+        ods_log_error("[%s] rename %s failed: %s", logstr, tmpfile,
+            strerror(errno));
+        journal_purge(journal);
+        return ODS_STATUS_JOURNALERR;
+    }
+    for (i=0; i < keep; i++) {
+        journal->entries[i] = journal->entries[drop + i];
+        journal->entries[i].offset -= base;
+    }
+    journal->count = keep;
+    ods_log_debug("[%s] compacted journal %s to %u entries", logstr,
+        journal->filename, (unsigned) journal->count);
+    return ODS_STATUS_OK;
+
+compact_failed:
+    ods_log_error("[%s] compact journal %s failed: %s", logstr,
+        journal->filename, strerror(errno));
+    if (in) {
+        ods_fclose(in);
+    }
+    if (out) {
+        ods_fclose(out);
+    }
+    (void)unlink(tmpfile);
+    journal_purge(journal);
+    return ODS_STATUS_JOURNALERR;
+}
+
+
+/**
+ * Write the deleted or added records in the zone, except for the SOA.
+ *
+ */
+static int
+journal_write_diff(FILE* fd, zone_type* zone, int del, uint32_t* count)
+{
+    tree_node* node;
+    domain_type* domain;
+    rrset_type* rrset;
+    record_type* record;
+    size_t i;
+    node = tree_first(zone->namedb->domains);
+    while (node && node != TREE_NULL) {
+        domain = (domain_type*) node->data;
+        for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+            if (domain->is_apex && rrset->rrtype == DNS_TYPE_SOA) {
+                continue;
+            }
+            for (i=0; i < rrset->rr_count; i++) {
+                record = &rrset->rrs[i];
+                if (del ? (record->is_removed && record->exists) :
+                          (record->is_added && !record->exists)) {
+                    if (fd && !journal_write_rr(fd, record->rr)) {
+                        return 0;
+                    }
+                    (*count)++;
+                }
+            }
+        }
+        node = tree_next(node);
+    }
+    return 1;
+}
+
+
+/**
+ * Record the uncommitted differences in the zone as a new journal entry.
+ *
+ */
+ods_status
+journal_commit(journal_type* journal, struct zone_struct* zone)
+{
+    journal_entry_type entry;
+    domain_type* apex;
+    rrset_type* rrset = NULL;
+    rr_type* old_soa = NULL;
+    rr_type* new_soa = NULL;
+    ods_status status;
+    FILE* fd;
+    uint32_t n = 0;
+    size_t i;
+    ods_log_assert(journal);
+    ods_log_assert(zone);
+    ods_log_assert(zone->namedb);
+    apex = namedb_lookup_domain(zone->namedb, zone->apex);
+    if (apex) {
+        rrset = domain_lookup_rrset(apex, DNS_TYPE_SOA);
+    }
+    for (i=0; rrset && i < rrset->rr_count; i++) {
+        if (rrset->rrs[i].exists) {
+            old_soa = rrset->rrs[i].rr;
+        }
+        if (rrset->rrs[i].exists ? !rrset->rrs[i].is_removed :
+                                   rrset->rrs[i].is_added) {
+            if (!new_soa || !rrset->rrs[i].exists) {
+                new_soa = rrset->rrs[i].rr;
+            }
+        }
+    }
+    if (!old_soa || !new_soa) {
+        /* first version of the zone: keep the journal if it leads here */
+        if (journal->count && (!new_soa ||
+            journal->entries[journal->count-1].serial_to !=
+            wf_read_uint32(rdata_get_data(&new_soa->rdata[2])))) {
+            journal_purge(journal);
+        }
+        return ODS_STATUS_OK;
+    }
+    entry.serial_from = wf_read_uint32(rdata_get_data(&old_soa->rdata[2]));
+    entry.serial_to = wf_read_uint32(rdata_get_data(&new_soa->rdata[2]));
+    entry.num_del = 1;
+    entry.num_add = 1;
+    (void)journal_write_diff(NULL, zone, 1, &entry.num_del);
+    (void)journal_write_diff(NULL, zone, 0, &entry.num_add);
+    if (entry.serial_from == entry.serial_to) {
+        if (entry.num_del > 1 || entry.num_add > 1) {
+            ods_log_warning("[%s] zone %s changed without a serial increase, "
+                "purge journal", logstr, zone->name);
+            journal_purge(journal);
+        }
+        return ODS_STATUS_UNCHANGED;
+    }
+    if (journal->count &&
+        journal->entries[journal->count-1].serial_to != entry.serial_from) {
+        ods_log_verbose("[%s] journal %s does not end at serial %u, purge",
+            logstr, journal->filename, entry.serial_from);
+        journal_purge(journal);
+    }
+    if (journal->count == JOURNAL_MAX_ENTRIES) {
+        status = journal_compact(journal);
+        if (status != ODS_STATUS_OK) {
+            return status;
+        }
+    }
+    /* append entry, the magic is written last */
+    fd = ods_fopen(journal->filename, NULL, "r+");
+    if (!fd) {
+        fd = ods_fopen(journal->filename, NULL, "w+");
+    }
+    if (!fd) {
+        ods_log_error("[%s] open journal %s failed: %s", logstr,
+            journal->filename, strerror(errno));
+        return ODS_STATUS_FOPENERR;
+    }
+    if (fseek(fd, 0, SEEK_END) != 0 || (entry.offset = ftell(fd)) < 0 ||
+        !journal_write_u32(fd, 0) ||
+        !journal_write_u32(fd, 0) ||
+        !journal_write_u32(fd, entry.serial_from) ||
+        !journal_write_u32(fd, entry.serial_to) ||
+        !journal_write_u32(fd, entry.num_del) ||
+        !journal_write_u32(fd, entry.num_add) ||
+        !journal_write_rr(fd, old_soa) ||
+        !journal_write_diff(fd, zone, 1, &n) ||
+        !journal_write_rr(fd, new_soa) ||
+        !journal_write_diff(fd, zone, 0, &n)) {
+        goto commit_failed;
+    }
+    entry.length = (uint32_t) (ftell(fd) - entry.offset - JOURNAL_HEADER_SIZE);
+    if (fseek(fd, entry.offset, SEEK_SET) != 0 ||
+        !journal_write_u32(fd, JOURNAL_MAGIC) ||
+        !journal_write_u32(fd, entry.length) ||
+        fflush(fd) != 0 || fsync(fileno(fd)) != 0) {
+        goto commit_failed;
+    }
+    ods_fclose(fd);
+    journal->entries[journal->count++] = entry;
+    ods_log_verbose("[%s] zone %s journal serial %u -> %u: %u deleted, "
+        "%u added", logstr, zone->name, entry.serial_from, entry.serial_to,
+        entry.num_del - 1, entry.num_add - 1);
+    return ODS_STATUS_OK;
+
+commit_failed:
+    ods_log_error("[%s] write journal %s failed: %s", logstr,
+        journal->filename, strerror(errno));
+    ods_fclose(fd);
+    journal_purge(journal);
+    return ODS_STATUS_JOURNALERR;
+}
+
+
+/**
+ * Look up the journal entry that starts at serial.
+ *
+ */
+int
+journal_lookup(journal_type* journal, uint32_t serial)
+{
+    size_t i;
+    if (!journal) {
+        return -1;
+    }
+    for (i=0; i < journal->count; i++) {
+        if (journal->entries[i].serial_from == serial) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Open the journal file for reading the records of an entry.
+ *
+ */
+FILE*
+journal_open_entry(journal_type* journal, size_t idx)
+{
+    FILE* fd;
+    ods_log_assert(journal);
+    ods_log_assert(idx < journal->count);
+    fd = ods_fopen(journal->filename, NULL, "r");
+    if (!fd) {
+        ods_log_error("[%s] open journal %s failed: %s", logstr,
+            journal->filename, strerror(errno));
+        return NULL;
+    }
+    if (fseek(fd, journal->entries[idx].offset + JOURNAL_HEADER_SIZE,
+        SEEK_SET) != 0) {
+        ods_log_error("[%s] seek journal %s failed: %s", logstr,
+            journal->filename, strerror(errno));
+        ods_fclose(fd);
+        return NULL;
+    }
+    return fd;
+}
+
+
+/**
+ * Read the new SOA of the last journal entry.
+ *
+ */
+static rr_type*
+journal_last_soa(journal_type* journal, region_type* r)
+{
+    journal_entry_type* entry = &journal->entries[journal->count-1];
+    rr_type* rr = NULL;
+    FILE* fd;
+    uint32_t i;
+    fd = journal_open_entry(journal, journal->count-1);
+    if (!fd) {
+        return NULL;
+    }
+    for (i=0; i <= entry->num_del; i++) {
+        rr = journal_read_rr(fd, r);
+        if (!rr) {
+            break;
+        }
+    }
+    ods_fclose(fd);
+    return rr;
+}
+
+
+/**
+ * Export journal entries in IXFR format.
+ *
+ */
+ods_status
+journal_export(journal_type* journal, uint32_t serial, FILE* out)
+{
+    ods_status status = ODS_STATUS_OK;
+    region_type* region;
+    region_type* tmp;
+    rr_type* last_soa;
+    rr_type* rr;
+    FILE* fd;
+    uint32_t j;
+    int idx;
+    size_t i;
+    ods_log_assert(journal);
+    ods_log_assert(out);
+    idx = journal_lookup(journal, serial);
+    if (idx < 0) {
+        return ODS_STATUS_UNCHANGED;
+    }
+    region = region_create();
+    tmp = region_create();
+    if (!region || !tmp) {
+        ods_log_crit("[%s] region create failed", logstr);
+        region_cleanup(region);
+        region_cleanup(tmp);
+        return ODS_STATUS_MALLOCERR;
+    }
+    last_soa = journal_last_soa(journal, region);
+    if (!last_soa) {
+        status = ODS_STATUS_JOURNALERR;
+        goto export_done;
+    }
+    rr_print(out, last_soa);
+    for (i=(size_t) idx; i < journal->count; i++) {
+        fd = journal_open_entry(journal, i);
+        if (!fd) {
+            status = ODS_STATUS_JOURNALERR;
+            goto export_done;
+        }
+        for (j=0; j < journal->entries[i].num_del +
+            journal->entries[i].num_add; j++) {
+            rr = journal_read_rr(fd, tmp);
+            if (!rr) {
+                ods_log_error("[%s] read journal %s entry %u failed", logstr,
+                    journal->filename, (unsigned) i);
+                status = ODS_STATUS_JOURNALERR;
+                break;
+            }
+            rr_print(out, rr);
+            region_free(tmp);
+        }
+        ods_fclose(fd);
+        if (status != ODS_STATUS_OK) {
+            goto export_done;
+        }
+    }
+    rr_print(out, last_soa);
+
+export_done:
+    region_cleanup(tmp);
+    region_cleanup(region);
+    return status;
+}
+
+
+/**
+ * Remove all entries from the journal.
+ *
+ */
+void
+journal_purge(journal_type* journal)
+{
+    if (!journal) {
+        return;
+    }
+    journal->count = 0;
+    if (unlink(journal->filename) != 0 && errno != ENOENT) {
+        ods_log_error("[%s] unlink journal %s failed: %s", logstr,
+            journal->filename, strerror(errno));
+    }
+    return;
+}
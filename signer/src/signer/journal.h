@@ -0,0 +1,142 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Journal of zone differences.
+ *
+ */
+
+#ifndef SIGNER_JOURNAL_H
+#define SIGNER_JOURNAL_H
+
+#include "config.h"
+#include "dns/rr.h"
+#include "util/region.h"
+#include "util/status.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define JOURNAL_MAGIC       0x544a4e4cU /* "TJNL" */
+#define JOURNAL_SUFFIX      ".ixfr"
+#define JOURNAL_MAX_ENTRIES 64 /* compact when full */
+#define JOURNAL_HEADER_SIZE 24
+
+struct zone_struct;
+
+/**
+ * Journal entry: the differences between two zone versions. In the file,
+ * an entry is a header followed by the old SOA and the deleted records,
+ * and then the new SOA and the added records.
+ *
+ */
+typedef struct journal_entry_struct journal_entry_type;
+struct journal_entry_struct {
+    long offset;          /* offset of entry header in file */
+    uint32_t length;      /* length of entry body */
+    uint32_t serial_from;
+    uint32_t serial_to;
+    uint32_t num_del;     /* including old SOA */
+    uint32_t num_add;     /* including new SOA */
+};
+
+/**
+ * Journal.
+ *
+ */
+typedef struct journal_struct journal_type;
+struct journal_struct {
+    const char* filename;
+    journal_entry_type entries[JOURNAL_MAX_ENTRIES];
+    size_t count;
+};
+
+/**
+ * Create journal. Existing entries in the journal file are indexed.
+ * @param r:        memory region.
+ * @param zonename: zone name, used for the journal file name.
+ * @return:         (journal_type*) journal.
+ *
+ */
+journal_type* journal_create(region_type* r, const char* zonename);
+
+/**
+ * Record the uncommitted differences in the zone as a new journal entry.
+ * Must be called before the differences are applied to the zone.
+ * @param journal: journal.
+ * @param zone:    zone.
+ * @return:        (ods_status) status.
+ *
+ */
+ods_status journal_commit(journal_type* journal, struct zone_struct* zone);
+
+/**
+ * Look up the journal entry that starts at serial.
+ * @param journal: journal.
+ * @param serial:  serial.
+ * @return:        (int) index of entry, -1 if not in the journal.
+ *
+ */
+int journal_lookup(journal_type* journal, uint32_t serial);
+
+/**
+ * Open the journal file for reading the records of an entry.
+ * @param journal: journal.
+ * @param idx:     entry index.
+ * @return:        (FILE*) file positioned at the first record of the entry.
+ *
+ */
+FILE* journal_open_entry(journal_type* journal, size_t idx);
+
+/**
+ * Read next record from the journal file.
+ * @param fd: journal file.
+ * @param r:  memory region for the record.
+ * @return:   (rr_type*) record, NULL on error.
+ *
+ */
+rr_type* journal_read_rr(FILE* fd, region_type* r);
+
+/**
+ * Export journal entries in IXFR format, starting at serial.
+ * @param journal: journal.
+ * @param serial:  serial.
+ * @param out:     output file.
+ * @return:        (ods_status) status.
+ *
+ */
+ods_status journal_export(journal_type* journal, uint32_t serial, FILE* out);
+
+/**
+ * Remove all entries from the journal.
+ * @param journal: journal.
+ *
+ */
+void journal_purge(journal_type* journal);
+
+#endif /* SIGNER_JOURNAL_H */
@@ -61,13 +61,19 @@ domain_compare(const void* a, const void* b)
 namedb_type*
 namedb_create(struct zone_struct* zone)
 {
+    region_type* region = NULL;
     namedb_type* db = NULL;
     ods_log_assert(zone);
-    ods_log_assert(zone->region);
-
-    db = (namedb_type*) region_alloc(zone->region, sizeof(namedb_type));
+    /* the domains have their own region, so that they can be freed */
+    region = region_create();
+    if (!region) {
+        ods_log_crit("[%s] create region failed", logstr);
+        exit(1);
+    }
+    db = (namedb_type*) region_alloc(region, sizeof(namedb_type));
     db->zone = zone;
-    db->domains = tree_create(zone->region, domain_compare);
+    db->region = region;
+    db->domains = tree_create(region, domain_compare);
     return db;
 }
 
@@ -150,9 +156,9 @@ namedb_lookup_domain(namedb_type* db, dname_type* dname)
  *
  */
 static tree_node*
-domain2node(domain_type* domain)
+domain2node(namedb_type* db, domain_type* domain)
 {
-    tree_node* node = (tree_node*) region_alloc(domain->zone->region,
+    tree_node* node = (tree_node*) region_alloc(db->region,
         sizeof(tree_node));
     node->key = domain->dname;
     node->data = domain;
@@ -172,7 +178,7 @@ namedb_add_domain(namedb_type* db, dname_type* dname)
     ods_log_assert(db);
     ods_log_assert(dname);
     domain = domain_create(db->zone, dname);
-    node = domain2node(domain);
+    node = domain2node(db, domain);
     if (!tree_insert(db->domains, node)) {
         dname_log(domain->dname, "[namedb] add domain failed: already present",
             LOG_WARNING);
@@ -208,6 +214,7 @@ namedb_diff(namedb_type* db, unsigned incremental, unsigned more_coming)
         domain = (domain_type*) node->data;
         node = tree_next(node);
         domain_diff(domain, incremental, more_coming);
+        domain->is_new = 0;
     }
     if (!node || node == TREE_NULL) {
         return;
@@ -221,6 +228,37 @@ namedb_diff(namedb_type* db, unsigned incremental, unsigned more_coming)
 }
 
 
+/**
+ * Rollback differences in namedb.
+ *
+ */
+void
+namedb_rollback(namedb_type* db)
+{
+    tree_node* node;
+    domain_type* domain;
+    ods_log_assert(db);
+    if (!db->domains) {
+        return;
+    }
+    node = tree_first(db->domains);
+    while (node && node != TREE_NULL) {
+        domain = (domain_type*) node->data;
+        node = tree_next(node);
+        domain_rollback(domain);
+        if (domain->is_new) {
+            /* domain or empty non-terminal created by the differences */
+            ods_log_assert(!domain->rrsets);
+            tree_delete(db->domains, domain->dname);
+            domain->node = NULL;
+            dname_log(domain->dname, "[namedb] -DOMAIN", LOG_DEEEBUG);
+            domain_cleanup(domain);
+        }
+    }
+    return;
+}
+
+
 /**
  * Nsecify namedb.
  *
@@ -262,6 +300,7 @@ namedb_cleanup(namedb_type* db)
 {
     if (db) {
         tree_cleanup(db->domains);
+        region_cleanup(db->region);
     }
     return;
 }
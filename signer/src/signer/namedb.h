@@ -53,6 +53,7 @@ struct zone_struct;
 typedef struct namedb_struct namedb_type;
 struct namedb_struct {
     struct zone_struct* zone;
+    region_type* region;
     tree_type* domains;
 };
 
@@ -102,6 +103,13 @@ domain_type* namedb_add_domain(namedb_type* db, dname_type* dname);
  */
 void namedb_diff(namedb_type* db, unsigned incremental, unsigned more_coming);
 
+/**
+ * Rollback differences in namedb.
+ * @param db: namedb.
+ *
+ */
+void namedb_rollback(namedb_type* db);
+
 /**
  * Nsecify namedb.
  * @param db: namedb.
@@ -36,6 +36,9 @@
 #include "signer/rrset.h"
 #include "signer/zone.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 static const char* logstr = "rrset";
 
 
@@ -49,6 +52,9 @@ rrset_log(dname_type* dname, uint16_t type, const char* pre, int level)
     rrstruct_type* rrstruct = dns_rrstruct_by_type(type);
     char str[DNAME_MAXLEN*5];
     char rrtype[10];
+    if (!ods_log_enabled(level)) {
+        return;
+    }
     dname_str(dname, &str[0]);
     (void)snprintf(&rrtype[0], 10, "TYPE%u", (unsigned) type);
     if (level == LOG_EMERG) {
@@ -96,9 +102,9 @@ rrset_create(struct domain_struct* domain, uint16_t type)
     rrset_type* rrset = NULL;
     ods_log_assert(domain);
     ods_log_assert(domain->zone);
-    ods_log_assert(domain->zone->region);
+    ods_log_assert(domain->zone->namedb);
     ods_log_assert(type);
-    rrset = (rrset_type*) region_alloc(domain->zone->region,
+    rrset = (rrset_type*) region_alloc(domain->zone->namedb->region,
         sizeof(rrset_type));
     rrset->domain = domain;
     rrset->next = NULL;
@@ -144,7 +150,7 @@ rrset_add_rr(rrset_type* rrset, rr_type* rr)
     ods_log_assert(rrset->rrtype == rr->type);
     zone = (zone_type*) rrset->domain->zone;
     rrs_old = rrset->rrs;
-    rrset->rrs = (rr_type*) region_alloc(zone->region,
+    rrset->rrs = (rr_type*) region_alloc(zone->namedb->region,
         (rrset->rr_count + 1) * sizeof(rr_type));
     if (rrs_old) {
         memcpy(rrset->rrs, rrs_old, (rrset->rr_count) * sizeof(rr_type));
@@ -159,6 +165,28 @@ rrset_add_rr(rrset_type* rrset, rr_type* rr)
 }
 
 
+/**
+ * Delete RR from RRset.
+ *
+ */
+record_type*
+rrset_del_rr(rrset_type* rrset, rr_type* rr)
+{
+    record_type* record = NULL;
+    ods_log_assert(rrset);
+    ods_log_assert(rr);
+    ods_log_assert(rrset->rrtype == rr->type);
+    record = rrset_lookup_rr(rrset, rr);
+    if (!record) {
+        return NULL;
+    }
+    record->is_added = 0;
+    record->is_removed = 1;
+    rrset->needs_singing = 1;
+    return record;
+}
+
+
 /**
  * Apply differences in rrset.
  *
@@ -166,18 +194,587 @@ rrset_add_rr(rrset_type* rrset, rr_type* rr)
 void
 rrset_diff(rrset_type* rrset, unsigned incremental, unsigned more_coming)
 {
-    uint16_t i;
+    size_t i;
+    size_t j = 0;
     ods_log_assert(rrset);
     for (i=0; i < rrset->rr_count; i++) {
+        if (rrset->rrs[i].is_removed) {
+            rr_log(rrset->rrs[i].rr, "[namedb] -RR", LOG_DEEEBUG);
+            continue;
+        }
         if (rrset->rrs[i].is_added) {
             rrset->rrs[i].exists = 1;
             rrset->rrs[i].is_added = 0;
         }
+        if (i != j) {
+            rrset->rrs[j] = rrset->rrs[i];
+        }
+        j++;
+    }
+    rrset->rr_count = j;
+    return;
+}
+
+
+/**
+ * Rollback differences in rrset.
+ *
+ */
+void
+rrset_rollback(rrset_type* rrset)
+{
+    size_t i;
+    size_t j = 0;
+    ods_log_assert(rrset);
+    for (i=0; i < rrset->rr_count; i++) {
+        if (!rrset->rrs[i].exists) {
+            /* added in this update, even if deleted again since */
+            continue;
+        }
+        rrset->rrs[i].is_added = 0;
+        rrset->rrs[i].is_removed = 0;
+        if (i != j) {
+            rrset->rrs[j] = rrset->rrs[i];
+        }
+        j++;
+    }
+    rrset->rr_count = j;
+    return;
+}
+
+
+/**
+ * Compare records in canonical form on RDATA. Each record is the RDATA
+ * length followed by the RDATA.
+ *
+ */
+static int
+rrset_wire_compare(const uint8_t* base, uint16_t off1, uint16_t off2)
+{
+    const uint8_t* rd1 = base + off1;
+    const uint8_t* rd2 = base + off2;
+    size_t len1 = read_uint16(rd1);
+    size_t len2 = read_uint16(rd2);
+    int res = memcmp(rd1 + 2, rd2 + 2, len1 < len2 ? len1 : len2);
+    if (res) {
+        return res;
+    }
+    return (int) len1 - (int) len2;
+}
+
+
+/**
+ * Restore the heap below root.
+ *
+ */
+static void
+rrset_wire_sift(const uint8_t* base, uint16_t* offsets, size_t root,
+    size_t end)
+{
+    size_t child;
+    uint16_t tmp;
+    while ((child = 2*root + 1) < end) {
+        if (child + 1 < end &&
+            rrset_wire_compare(base, offsets[child], offsets[child+1]) < 0) {
+            child++;
+        }
+        if (rrset_wire_compare(base, offsets[root], offsets[child]) >= 0) {
+            return;
+        }
+        tmp = offsets[root];
+        offsets[root] = offsets[child];
+        offsets[child] = tmp;
+        root = child;
+    }
+    return;
+}
+
+
+/**
+ * Sort records in canonical form on RDATA.
+ *
+ */
+static void
+rrset_wire_sort(const uint8_t* base, uint16_t* offsets, size_t count)
+{
+    size_t i, j;
+    uint16_t tmp;
+    if (count <= 8) {
+        /* most rrsets are small */
+        for (i=1; i < count; i++) {
+            tmp = offsets[i];
+            for (j=i; j > 0 &&
+                rrset_wire_compare(base, offsets[j-1], tmp) > 0; j--) {
+                offsets[j] = offsets[j-1];
+            }
+            offsets[j] = tmp;
+        }
+        return;
+    }
+    for (i = count/2; i > 0; i--) {
+        rrset_wire_sift(base, offsets, i-1, count);
+    }
+    for (i = count-1; i > 0; i--) {
+        tmp = offsets[0];
+        offsets[0] = offsets[i];
+        offsets[i] = tmp;
+        rrset_wire_sift(base, offsets, 0, i);
     }
     return;
 }
 
 
+/**
+ * Write domain name in canonical form.
+ *
+ */
+static size_t
+rrset_wire_dname(uint8_t* wire, dname_type* dname)
+{
+    const uint8_t* name = dname_name(dname);
+    size_t len = dname_len(dname);
+    size_t i;
+    for (i=0; i < len; i++) {
+        wire[i] = (name[i] >= 'A' && name[i] <= 'Z') ?
+            name[i] + ('a' - 'A') : name[i];
+    }
+    return len;
+}
+
+
+/**
+ * Offsets of the records, in the second half of scratch.
+ *
+ */
+static uint16_t*
+rrset_wire_offsets(buffer_type* scratch)
+{
+    return (uint16_t*) (buffer_begin(scratch) + buffer_capacity(scratch) / 2);
+}
+
+
+/**
+ * Sort the RDATA of the records in canonical form.
+ * Returns the number of records, the offsets are in scratch.
+ *
+ */
+static size_t
+rrset_wire_collect(rrset_type* rrset, buffer_type* scratch, uint16_t* klass,
+    int* fits)
+{
+    uint16_t* offsets;
+    size_t count = 0;
+    size_t i;
+    ods_log_assert(buffer_capacity(scratch) % 4 == 0);
+    ods_log_assert(buffer_capacity(scratch) <= RRSET_SCRATCH_SIZE);
+    /* the RDATA goes in the first half, the offsets of each record in
+     * the second: every record has at least two bytes of RDATA */
+    buffer_clear(scratch);
+    buffer_set_limit(scratch, buffer_capacity(scratch) / 2);
+    offsets = rrset_wire_offsets(scratch);
+    *klass = DNS_CLASS_IN;
+    *fits = 1;
+    for (i=0; i < rrset->rr_count; i++) {
+        if (rrset->rrs[i].is_removed) {
+            continue;
+        }
+        offsets[count] = (uint16_t) buffer_position(scratch);
+        if (!rr_write_rdata_canonical(rrset->rrs[i].rr, scratch)) {
+            *fits = 0;
+            return 0;
+        }
+        *klass = rrset->rrs[i].rr->klass;
+        count++;
+    }
+    rrset_wire_sort(buffer_begin(scratch), offsets, count);
+    return count;
+}
+
+
+/**
+ * Write owner, type, class and ttl of a record in canonical form.
+ *
+ */
+static size_t
+rrset_wire_header(uint8_t* wire, const uint8_t* owner, size_t owner_len,
+    uint16_t rrtype, uint16_t klass, uint32_t ttl)
+{
+    memcpy(wire, owner, owner_len);
+    write_uint16(wire + owner_len, rrtype);
+    write_uint16(wire + owner_len + 2, klass);
+    write_uint32(wire + owner_len + 4, ttl);
+    return owner_len + 8;
+}
+
+
+/**
+ * Write the records sorted by rrset_wire_collect(), without duplicates.
+ *
+ */
+static int
+rrset_wire_records(rrset_type* rrset, buffer_type* scratch, size_t count,
+    uint16_t klass, uint32_t ttl, buffer_type* buffer)
+{
+    uint8_t owner[MAXDOMAINLEN+1];
+    size_t owner_len;
+    uint16_t* offsets;
+    uint8_t* base;
+    size_t mark;
+    size_t len;
+    size_t i;
+    base = buffer_begin(scratch);
+    offsets = rrset_wire_offsets(scratch);
+    owner_len = rrset_wire_dname(owner, rrset->domain->dname);
+    mark = buffer_position(buffer);
+    for (i=0; i < count; i++) {
+        if (i > 0 &&
+            rrset_wire_compare(base, offsets[i-1], offsets[i]) == 0) {
+            continue;
+        }
+        len = 2 + read_uint16(base + offsets[i]);
+        if (!buffer_available(buffer, owner_len + 8 + len)) {
+            buffer_set_position(buffer, mark);
+            return 0;
+        }
+        buffer_skip(buffer, rrset_wire_header(buffer_current(buffer), owner,
+            owner_len, rrset->rrtype, klass, ttl));
+        buffer_write(buffer, base + offsets[i], len);
+    }
+    return 1;
+}
+
+
+/**
+ * Write rrset in canonical form.
+ *
+ */
+int
+rrset_wire_canonical(rrset_type* rrset, uint32_t ttl, buffer_type* buffer,
+    buffer_type* scratch)
+{
+    uint16_t klass;
+    size_t count;
+    int fits;
+    ods_log_assert(rrset);
+    ods_log_assert(rrset->domain);
+    ods_log_assert(buffer);
+    ods_log_assert(scratch);
+    count = rrset_wire_collect(rrset, scratch, &klass, &fits);
+    if (!fits) {
+        return 0;
+    }
+    return rrset_wire_records(rrset, scratch, count, klass, ttl, buffer);
+}
+
+
+/**
+ * Buffers to sign rrsets with, one set for each thread.
+ *
+ */
+typedef struct rrset_signbuf_struct rrset_signbuf_type;
+struct rrset_signbuf_struct {
+    buffer_type buffer;
+    buffer_type scratch;
+    /* grown when an rrset does not fit, up to RRSET_SCRATCH_SIZE */
+    uint16_t* scratch_data;
+    size_t scratch_size;
+    uint8_t data[RRSET_SIGN_BUFSIZE];
+    uint8_t owner[MAXDOMAINLEN+1];
+    hsm_digest_ctx_t* digest;
+    /* the whole message, for algorithms without a separate digest */
+    uint8_t* message;
+    size_t message_size;
+};
+
+#ifdef HAVE_PTHREAD
+static pthread_key_t rrset_signbuf_key;
+static pthread_once_t rrset_signbuf_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * Release the sign buffers of an exiting thread.
+ *
+ */
+static void
+rrset_signbuf_release(void* arg)
+{
+    rrset_signbuf_type* sb = (rrset_signbuf_type*) arg;
+    if (sb) {
+        hsm_digest_ctx_free(sb->digest);
+        free((void*) sb->scratch_data);
+        free((void*) sb->message);
+    }
+    free(arg);
+    return;
+}
+
+
+/**
+ * Create the key for the sign buffers.
+ *
+ */
+static void
+rrset_signbuf_init(void)
+{
+    if (pthread_key_create(&rrset_signbuf_key, rrset_signbuf_release) != 0) {
+        ods_log_crit("[%s] unable to create key for sign buffers", logstr);
+    }
+    return;
+}
+#else
+static rrset_signbuf_type* rrset_signbuf = NULL;
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Grow the scratch space of the sign buffers, starting at
+ * RRSET_SCRATCH_INIT and doubling up to RRSET_SCRATCH_SIZE.
+ *
+ */
+static int
+rrset_signbuf_grow(rrset_signbuf_type* sb)
+{
+    uint16_t* grown;
+    size_t size;
+    ods_log_assert(sb->scratch_size < RRSET_SCRATCH_SIZE);
+    size = sb->scratch_size ? 2 * sb->scratch_size : RRSET_SCRATCH_INIT;
+    if (size > RRSET_SCRATCH_SIZE) {
+        size = RRSET_SCRATCH_SIZE;
+    }
+    grown = (uint16_t*) realloc((void*) sb->scratch_data, size);
+    if (!grown) {
+        return 0;
+    }
+    sb->scratch_data = grown;
+    sb->scratch_size = size;
+    buffer_create_from(&sb->scratch, sb->scratch_data, sb->scratch_size);
+    return 1;
+}
+
+
+/**
+ * Get the sign buffers of the calling thread.
+ *
+ */
+static rrset_signbuf_type*
+rrset_signbuf_get(void)
+{
+    rrset_signbuf_type* sb = NULL;
+#ifdef HAVE_PTHREAD
+    (void) pthread_once(&rrset_signbuf_once, rrset_signbuf_init);
+    sb = (rrset_signbuf_type*) pthread_getspecific(rrset_signbuf_key);
+#else
+    sb = rrset_signbuf;
+#endif /* HAVE_PTHREAD */
+    if (sb) {
+        return sb;
+    }
+    sb = (rrset_signbuf_type*) malloc(sizeof(rrset_signbuf_type));
+    if (!sb) {
+        return NULL;
+    }
+    buffer_create_from(&sb->buffer, sb->data, sizeof(sb->data));
+    sb->scratch_data = NULL;
+    sb->scratch_size = 0;
+    sb->message = NULL;
+    sb->message_size = 0;
+    sb->digest = hsm_digest_ctx_new();
+    if (!sb->digest) {
+        free((void*) sb);
+        return NULL;
+    }
+    if (!rrset_signbuf_grow(sb)) {
+        hsm_digest_ctx_free(sb->digest);
+        free((void*) sb);
+        return NULL;
+    }
+#ifdef HAVE_PTHREAD
+    if (pthread_setspecific(rrset_signbuf_key, sb) != 0) {
+        hsm_digest_ctx_free(sb->digest);
+        free((void*) sb->scratch_data);
+        free((void*) sb);
+        return NULL;
+    }
+#else
+    rrset_signbuf = sb;
+#endif /* HAVE_PTHREAD */
+    return sb;
+}
+
+
+/**
+ * Whether the algorithm signs the whole message in one part, without a
+ * separate digest step (EdDSA, RFC 8080).
+ *
+ */
+static int
+rrset_sign_oneshot(uint8_t algorithm)
+{
+    switch (algorithm) {
+#if LDNS_BUILD_CONFIG_USE_ED25519
+        case LDNS_ED25519:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED448
+        case LDNS_ED448:
+#endif
+#if LDNS_BUILD_CONFIG_USE_ED25519 || LDNS_BUILD_CONFIG_USE_ED448
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+/**
+ * Sign rrset in one part, for algorithms without a separate digest.
+ * The RRSIG RDATA without signature is in the sign buffer, the records
+ * collected in scratch.
+ *
+ */
+static ods_status
+rrset_sign_message(hsm_ctx_t* ctx, rrset_type* rrset, hsm_key_t* key,
+    rrsig_params_type* params, rrset_signbuf_type* sb, size_t count,
+    uint16_t klass, uint8_t* sig, size_t* siglen)
+{
+    dname_type* owner = rrset->domain->dname;
+    buffer_type message;
+    uint8_t* grown;
+    size_t size;
+    /* RDATA plus owner, type, class and ttl for each record */
+    size = buffer_position(&sb->buffer) + buffer_position(&sb->scratch) +
+        count * (dname_len(owner) + 8);
+    if (size > sb->message_size) {
+        grown = (uint8_t*) realloc((void*) sb->message, size);
+        if (!grown) {
+            ods_log_crit("[%s] unable to allocate sign buffers", logstr);
+            return ODS_STATUS_MALLOCERR;
+        }
+        sb->message = grown;
+        sb->message_size = size;
+    }
+    buffer_create_from(&message, sb->message, sb->message_size);
+    buffer_write(&message, buffer_begin(&sb->buffer),
+        buffer_position(&sb->buffer));
+    if (!rrset_wire_records(rrset, &sb->scratch, count, klass, params->ttl,
+        &message)) {
+        rrset_log(owner, rrset->rrtype, "[rrset] rrset too large to sign",
+            LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    if (hsm_sign_data(ctx, buffer_begin(&message), buffer_position(&message),
+        key, (ldns_algorithm) params->algorithm, sig, siglen) != 0) {
+        rrset_log(owner, rrset->rrtype, "[rrset] hsm sign failed", LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Sign rrset.
+ *
+ */
+ods_status
+rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, hsm_key_t* key,
+    rrsig_params_type* params, uint8_t* sig, size_t* siglen)
+{
+    rrset_signbuf_type* sb = NULL;
+    dname_type* owner = NULL;
+    uint16_t* offsets;
+    uint8_t* base;
+    uint16_t klass;
+    size_t owner_len;
+    size_t header_len;
+    size_t count;
+    size_t i;
+    uint8_t labels;
+    int fits;
+    ods_log_assert(rrset);
+    ods_log_assert(rrset->domain);
+    ods_log_assert(key);
+    ods_log_assert(params);
+    ods_log_assert(params->signer);
+    ods_log_assert(sig);
+    ods_log_assert(siglen);
+    sb = rrset_signbuf_get();
+    if (!sb) {
+        ods_log_crit("[%s] unable to allocate sign buffers", logstr);
+        return ODS_STATUS_MALLOCERR;
+    }
+    owner = rrset->domain->dname;
+    count = rrset_wire_collect(rrset, &sb->scratch, &klass, &fits);
+    while (!fits && sb->scratch_size < RRSET_SCRATCH_SIZE) {
+        if (!rrset_signbuf_grow(sb)) {
+            ods_log_crit("[%s] unable to allocate sign buffers", logstr);
+            return ODS_STATUS_MALLOCERR;
+        }
+        count = rrset_wire_collect(rrset, &sb->scratch, &klass, &fits);
+    }
+    if (!fits) {
+        rrset_log(owner, rrset->rrtype, "[rrset] rrset too large to sign",
+            LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    /* labels, not counting the root and a leading wildcard */
+    labels = owner->label_count - 1;
+    if (labels > 0 && dname_label(owner, labels)[0] == 1 &&
+        dname_label(owner, labels)[1] == '*') {
+        labels--;
+    }
+    /* RRSIG RDATA without signature */
+    buffer_clear(&sb->buffer);
+    buffer_write_u16(&sb->buffer, rrset->rrtype);
+    buffer_write_u8(&sb->buffer, params->algorithm);
+    buffer_write_u8(&sb->buffer, labels);
+    buffer_write_u32(&sb->buffer, params->ttl);
+    buffer_write_u32(&sb->buffer, params->expiration);
+    buffer_write_u32(&sb->buffer, params->inception);
+    buffer_write_u16(&sb->buffer, params->keytag);
+    buffer_skip(&sb->buffer, rrset_wire_dname(buffer_current(&sb->buffer),
+        params->signer));
+    if (rrset_sign_oneshot(params->algorithm)) {
+        return rrset_sign_message(ctx, rrset, key, params, sb, count, klass,
+            sig, siglen);
+    }
+    if (hsm_digest_init(ctx, sb->digest, key,
+        (ldns_algorithm) params->algorithm) != 0) {
+        rrset_log(owner, rrset->rrtype, "[rrset] hsm digest failed", LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    if (hsm_digest_update(ctx, sb->digest, key, buffer_begin(&sb->buffer),
+        buffer_position(&sb->buffer)) != 0) {
+        rrset_log(owner, rrset->rrtype, "[rrset] hsm digest failed", LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    /* the records, straight from the sorted RDATA */
+    base = buffer_begin(&sb->scratch);
+    offsets = rrset_wire_offsets(&sb->scratch);
+    owner_len = rrset_wire_dname(sb->owner, owner);
+    header_len = rrset_wire_header(buffer_begin(&sb->buffer), sb->owner,
+        owner_len, rrset->rrtype, klass, params->ttl);
+    for (i=0; i < count; i++) {
+        if (i > 0 &&
+            rrset_wire_compare(base, offsets[i-1], offsets[i]) == 0) {
+            continue;
+        }
+        if (hsm_digest_update(ctx, sb->digest, key, buffer_begin(&sb->buffer),
+                header_len) != 0 ||
+            hsm_digest_update(ctx, sb->digest, key, base + offsets[i],
+                2 + read_uint16(base + offsets[i])) != 0) {
+            rrset_log(owner, rrset->rrtype, "[rrset] hsm digest failed",
+                LOG_ERR);
+            return ODS_STATUS_HSMSIGNERR;
+        }
+    }
+    if (hsm_sign_digest(ctx, sb->digest, key, sig, siglen) != 0) {
+        rrset_log(owner, rrset->rrtype, "[rrset] hsm sign failed", LOG_ERR);
+        return ODS_STATUS_HSMSIGNERR;
+    }
+    return ODS_STATUS_OK;
+}
+
+
 /**
  * Print rrset.
  *
@@ -37,7 +37,18 @@
 #include "config.h"
 #include "dns/rr.h"
 #include "dns/dname.h"
+#include "util/hsms.h"
 #include "util/status.h"
+#include "wire/buffer.h"
+
+/* Canonical RDATA of all records in an rrset, as for a DNS message */
+#define RRSET_WIRE_MAX (MAX_PACKET_SIZE + 1)
+/* Scratch space to sort the records: RDATA plus an offset per record */
+#define RRSET_SCRATCH_SIZE (2 * RRSET_WIRE_MAX)
+/* Scratch space to start with, enough for all but the largest rrsets */
+#define RRSET_SCRATCH_INIT 4096
+/* RRSIG RDATA without signature, or owner, type, class and ttl */
+#define RRSET_SIGN_BUFSIZE (18 + MAXDOMAINLEN + 1)
 
 struct domain_struct;
 
@@ -67,6 +78,20 @@ struct rrset_struct {
     unsigned needs_singing : 1;
 };
 
+/**
+ * RRSIG fields other than the signature.
+ *
+ */
+typedef struct rrsig_params_struct rrsig_params_type;
+struct rrsig_params_struct {
+    dname_type* signer;  /* signer name */
+    uint32_t ttl;        /* original ttl */
+    uint32_t expiration;
+    uint32_t inception;
+    uint16_t keytag;
+    uint8_t algorithm;
+};
+
 /**
  * Log rrset.
  * @param dname: domain name.
@@ -104,6 +129,15 @@ record_type* rrset_lookup_rr(rrset_type* rrset, rr_type* rr);
  */
 record_type* rrset_add_rr(rrset_type* rrset, rr_type* rr);
 
+/**
+ * Mark rr in rrset for removal.
+ * @param rrset: rrset.
+ * @param rr:    rr.
+ * @return:      (record_type*) removed record, NULL if not found.
+ *
+ */
+record_type* rrset_del_rr(rrset_type* rrset, rr_type* rr);
+
 /**
  * Apply differences in rrset.
  * @param rrset:       rrset.
@@ -113,6 +147,51 @@ record_type* rrset_add_rr(rrset_type* rrset, rr_type* rr);
  */
 void rrset_diff(rrset_type* rrset, unsigned incremental, unsigned more_coming);
 
+/**
+ * Rollback differences in rrset: drop records that were added and
+ * unmark records that were removed.
+ * @param rrset: rrset.
+ *
+ */
+void rrset_rollback(rrset_type* rrset);
+
+/**
+ * Write rrset in canonical form (RFC 4034, section 6.3) to buffer: owner
+ * and domain names in RDATA lowercased, the original ttl, and the records
+ * sorted on RDATA with duplicates left out. Records marked for removal
+ * are skipped.
+ * @param rrset:   rrset.
+ * @param ttl:     original ttl.
+ * @param buffer:  buffer, the records are written at the current position.
+ * @param scratch: buffer to sort the records in, 2-byte aligned and a
+ *                 multiple of 4 bytes, at most RRSET_SCRATCH_SIZE. The
+ *                 RDATA goes in the first half.
+ * @return:        (int) 1 if written, 0 if the buffer has no room left or
+ *                 the RDATA does not fit in scratch (the buffer position
+ *                 is left unchanged).
+ *
+ */
+int rrset_wire_canonical(rrset_type* rrset, uint32_t ttl, buffer_type* buffer,
+    buffer_type* scratch);
+
+/**
+ * Sign rrset. The RRSIG RDATA without signature and the rrset in canonical
+ * form are fed to the digest record by record from buffers of the calling
+ * thread, and the digest is signed by the HSM. EdDSA has no separate
+ * digest, the whole message is built in a buffer of the calling thread
+ * and signed in one part.
+ * @param ctx:    HSM context.
+ * @param rrset:  rrset.
+ * @param key:    key to sign with.
+ * @param params: RRSIG fields.
+ * @param sig:    signature, room for HSM_MAX_SIGNATURE_LENGTH bytes.
+ * @param siglen: signature length.
+ * @return:       (ods_status) status.
+ *
+ */
+ods_status rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, hsm_key_t* key,
+    rrsig_params_type* params, uint8_t* sig, size_t* siglen);
+
 /**
  * Print rrset.
  * @param fd:       file descriptor.
@@ -35,21 +35,45 @@
 #include "parser/signconfparser.h"
 #include "signer/signconf.h"
 #include "util/file.h"
+#include "util/locks.h"
 #include "util/log.h"
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
 static const char* logstr = "signconf";
 
 
+#define SC_TABLE_SIZE 1024
+/* the settings are the fields before last_modified */
+#define SC_SETTINGS_SIZE offsetof(signconf_type, last_modified)
+
 /**
- * Create a new signer configuration with the 'empty' settings.
+ * Signer configuration file that was read.
  *
  */
-signconf_type*
-signconf_create(region_type* r)
-{
+typedef struct signconf_file_struct signconf_file_type;
+struct signconf_file_struct {
+    char* filename;
+    time_t last_modified;
     signconf_type* sc;
-    ods_log_assert(r);
-    sc = (signconf_type*) region_alloc(r, sizeof(signconf_type));
+    signconf_file_type* next;
+};
+
+static signconf_type* signconf_table[SC_TABLE_SIZE];
+static signconf_file_type* signconf_files[SC_TABLE_SIZE];
+static lock_basic_type signconf_lock;
+
+
+/**
+ * Initialize signer configuration with the 'empty' settings.
+ *
+ */
+static void
+signconf_init(signconf_type* sc)
+{
+    memset(sc, 0, sizeof(signconf_type));
     sc->last_modified = 0;
     /* Signatures */
     duration_init(&(sc->sig_resign_interval));
@@ -65,10 +89,152 @@ signconf_create(region_type* r)
     duration_init(&(sc->soa_ttl));
     duration_init(&(sc->soa_min));
     /* Other useful information */
+    sc->refcount = 0;
+    sc->next = NULL;
+    return;
+}
+
+
+/**
+ * Create a new signer configuration with the 'empty' settings.
+ *
+ */
+signconf_type*
+signconf_create(region_type* r)
+{
+    signconf_type* sc;
+    ods_log_assert(r);
+    sc = (signconf_type*) region_alloc(r, sizeof(signconf_type));
+    signconf_init(sc);
     return sc;
 }
 
 
+/**
+ * Initialize the table of shared signer configurations.
+ *
+ */
+void
+signconf_cache_init(void)
+{
+    memset(signconf_table, 0, sizeof(signconf_table));
+    memset(signconf_files, 0, sizeof(signconf_files));
+    lock_basic_init(&signconf_lock);
+    return;
+}
+
+
+/**
+ * Hash a string or the settings (FNV-1a).
+ *
+ */
+static uint32_t
+signconf_hash(const uint8_t* data, size_t len)
+{
+    uint32_t hash = 2166136261U;
+    size_t i;
+    for (i=0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+
+/**
+ * Get a reference to the shared configuration with these settings,
+ * the table is locked.
+ *
+ */
+static signconf_type*
+signconf_intern(signconf_type* sc)
+{
+    signconf_type* shared = NULL;
+    uint32_t hash = signconf_hash((const uint8_t*) sc, SC_SETTINGS_SIZE);
+    for (shared = signconf_table[hash % SC_TABLE_SIZE]; shared;
+        shared = shared->next) {
+        if (shared->hash == hash &&
+            memcmp(shared, sc, SC_SETTINGS_SIZE) == 0) {
+            shared->refcount++;
+            return shared;
+        }
+    }
+    shared = (signconf_type*) malloc(sizeof(signconf_type));
+    if (!shared) {
+        ods_log_crit("[%s] unable to share signconf: insufficient memory",
+            logstr);
+        return NULL;
+    }
+    memcpy(shared, sc, sizeof(signconf_type));
+    shared->hash = hash;
+    shared->refcount = 1;
+    shared->next = signconf_table[hash % SC_TABLE_SIZE];
+    signconf_table[hash % SC_TABLE_SIZE] = shared;
+    return shared;
+}
+
+
+/**
+ * Release a reference to a shared configuration, the table is locked.
+ *
+ */
+static void
+signconf_release(signconf_type* sc)
+{
+    signconf_type** p = NULL;
+    if (!sc || !sc->refcount) {
+        return;
+    }
+    sc->refcount--;
+    if (sc->refcount) {
+        return;
+    }
+    for (p = &signconf_table[sc->hash % SC_TABLE_SIZE]; *p;
+        p = &(*p)->next) {
+        if (*p == sc) {
+            *p = sc->next;
+            break;
+        }
+    }
+    free((void*) sc);
+    return;
+}
+
+
+/**
+ * Look up the file that was read, the table is locked.
+ *
+ */
+static signconf_file_type*
+signconf_file_lookup(const char* scfile, int create)
+{
+    signconf_file_type* file = NULL;
+    uint32_t b = signconf_hash((const uint8_t*) scfile, strlen(scfile)) %
+        SC_TABLE_SIZE;
+    for (file = signconf_files[b]; file; file = file->next) {
+        if (strcmp(file->filename, scfile) == 0) {
+            return file;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    file = (signconf_file_type*) malloc(sizeof(signconf_file_type));
+    if (!file) {
+        return NULL;
+    }
+    file->filename = strdup(scfile);
+    if (!file->filename) {
+        free((void*) file);
+        return NULL;
+    }
+    file->last_modified = 0;
+    file->sc = NULL;
+    file->next = signconf_files[b];
+    signconf_files[b] = file;
+    return file;
+}
+
+
 /**
  * Read signer configuration.
  *
@@ -78,108 +244,15 @@ signconf_read(signconf_type* sc, const char* scfile)
 {
     const char* rngfile = ODS_SE_RNGDIR "/signconf.rng";
     ods_status status = ODS_STATUS_OK;
-    FILE* fd = NULL;
-    char salt[SC_SALT_SIZE];
-    char serial[SC_SERIAL_SIZE];
-    ldns_rr_type nsectype;
-    duration_type resign, refresh, valdefault, valdenial, jitter, inception,
-        dnskeyttl, soattl, soamin;
     ods_log_assert(sc);
     ods_log_assert(scfile);
-    status = parser_filecheck(scfile, rngfile);
-    if (parser_filecheck(scfile, rngfile) != ODS_STATUS_OK) {
+    ods_log_debug("[%s] read signconf file %s", logstr, scfile);
+    signconf_init(sc);
+    status = parser_sc_read(scfile, rngfile, sc);
+    if (status != ODS_STATUS_OK) {
         ods_log_error("[%s] parse error in %s", logstr, scfile);
-        return status;
-    }
-    /* open file */
-    fd = ods_fopen(scfile, NULL, "r");
-    if (fd) {
-        ods_log_debug("[%s] read signconf file %s", logstr, scfile);
-        duration_init(&resign);
-        duration_init(&refresh);
-        duration_init(&valdefault);
-        duration_init(&valdenial);
-        duration_init(&jitter);
-        duration_init(&inception);
-        duration_init(&dnskeyttl);
-        duration_init(&soattl);
-        duration_init(&soamin);
-        status = parser_sc_sig_resign_interval(scfile, &resign);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_sig_refresh_interval(scfile, &refresh);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_sig_validity_default(scfile, &valdefault);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_sig_validity_denial(scfile, &valdenial);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_sig_jitter(scfile, &jitter);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_sig_inception_offset(scfile, &inception);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_dnskey_ttl(scfile, &dnskeyttl);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        nsectype = parser_sc_nsec_type(scfile);
-        if (nsectype == LDNS_RR_TYPE_NSEC3) {
-            status = parser_sc_nsec3_salt(scfile, &salt[0]);
-            if (status != ODS_STATUS_OK) {
-                goto signconf_read_done;
-            }
-        }
-        status = parser_sc_soa_ttl(scfile, &soattl);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_soa_min(scfile, &soamin);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-        status = parser_sc_soa_serial(scfile, &serial[0]);
-        if (status != ODS_STATUS_OK) {
-            goto signconf_read_done;
-        }
-
-signconf_read_done:
-        if (status == ODS_STATUS_OK) {
-            duration_copy(&(sc->sig_resign_interval), &resign);
-            duration_copy(&(sc->sig_refresh_interval), &refresh);
-            duration_copy(&(sc->sig_validity_default), &valdefault);
-            duration_copy(&(sc->sig_validity_denial), &valdenial);
-            duration_copy(&(sc->sig_jitter), &jitter);
-            duration_copy(&(sc->sig_inception_offset), &inception);
-            sc->nsec_type = nsectype;
-            if (sc->nsec_type == LDNS_RR_TYPE_NSEC3) {
-                sc->nsec3_optout = parser_sc_nsec_type(scfile);
-                /* nsec3 algo */
-                /* nsec3 iter */
-                strlcpy(&(sc->nsec3_salt[0]), &salt[0], strlen(salt)+1);
-                /* nsec3 params */
-            }
-            /* keys */
-            duration_copy(&(sc->dnskey_ttl), &dnskeyttl);
-            duration_copy(&(sc->soa_ttl), &soattl);
-            duration_copy(&(sc->soa_min), &soamin);
-            strlcpy(&(sc->soa_serial[0]), &serial[0], strlen(serial)+1);
-        }
-        ods_fclose(fd);
-        return status;
     }
-    ods_log_error("[%s] open signconf file %s failed: %s",
-        logstr, scfile, strerror(errno));
-    return ODS_STATUS_FOPENERR;
+    return status;
 }
 
 
@@ -188,28 +261,68 @@ signconf_read_done:
  *
  */
 ods_status
-signconf_update(signconf_type* sc, const char* scfile)
+signconf_update(signconf_type** sc, const char* scfile,
+    time_t* last_modified)
 {
+    signconf_type new_sc;
+    signconf_type* shared = NULL;
+    signconf_file_type* file = NULL;
     time_t st_mtime = 0;
     ods_status status = ODS_STATUS_OK;
     ods_log_assert(sc);
+    ods_log_assert(*sc);
     ods_log_assert(scfile);
+    ods_log_assert(last_modified);
     /* is the file updated? */
     st_mtime = ods_fstat(scfile);
-    if (st_mtime <= sc->last_modified) {
+    if (st_mtime <= *last_modified) {
         ods_log_verbose("[%s] file %s not modified since %u", logstr,
-            scfile, (unsigned) sc->last_modified);
+            scfile, (unsigned) *last_modified);
         return ODS_STATUS_UNCHANGED;
     }
-    /* if so, read the new signer configuration */
-    status = signconf_read(sc, scfile);
-    if (status == ODS_STATUS_OK) {
-        sc->last_modified = st_mtime;
-    } else {
-        ods_log_error("[%s] failed to read file %s: %s", logstr, scfile,
-            ods_status2str(status));
+    /* did another zone already read this version of the file? */
+    lock_basic_lock(&signconf_lock);
+    file = signconf_file_lookup(scfile, 0);
+    if (file && file->sc && file->last_modified == st_mtime) {
+        shared = file->sc;
+        shared->refcount++;
     }
-    return status;
+    lock_basic_unlock(&signconf_lock);
+    if (!shared) {
+        /* if not, read the new signer configuration */
+        status = signconf_read(&new_sc, scfile);
+        if (status != ODS_STATUS_OK) {
+            ods_log_error("[%s] failed to read file %s: %s", logstr, scfile,
+                ods_status2str(status));
+            return status;
+        }
+        new_sc.last_modified = st_mtime;
+        lock_basic_lock(&signconf_lock);
+        shared = signconf_intern(&new_sc);
+        if (!shared) {
+            lock_basic_unlock(&signconf_lock);
+            return ODS_STATUS_MALLOCERR;
+        }
+        file = signconf_file_lookup(scfile, 1);
+        if (file) {
+            shared->refcount++;
+            signconf_release(file->sc);
+            file->sc = shared;
+            file->last_modified = st_mtime;
+        }
+        lock_basic_unlock(&signconf_lock);
+    }
+    *last_modified = st_mtime;
+    if (shared == *sc) {
+        /* same settings */
+        lock_basic_lock(&signconf_lock);
+        signconf_release(shared);
+        lock_basic_unlock(&signconf_lock);
+        return ODS_STATUS_UNCHANGED;
+    }
+    signconf_cleanup(*sc);
+    *sc = shared;
+    return ODS_STATUS_OK;
 }
 
 
@@ -274,7 +387,39 @@ signconf_log(signconf_type* sc, const char* name)
  *
  */
 void
-signconf_cleanup(signconf_type* ATTR_UNUSED(sc))
+signconf_cleanup(signconf_type* sc)
 {
+    if (!sc || !sc->refcount) {
+        return;
+    }
+    lock_basic_lock(&signconf_lock);
+    signconf_release(sc);
+    lock_basic_unlock(&signconf_lock);
+    return;
+}
+
+
+/**
+ * Clean up the table of shared signer configurations.
+ *
+ */
+void
+signconf_cache_cleanup(void)
+{
+    signconf_file_type* file = NULL;
+    signconf_file_type* next = NULL;
+    size_t i;
+    lock_basic_lock(&signconf_lock);
+    for (i=0; i < SC_TABLE_SIZE; i++) {
+        for (file = signconf_files[i]; file; file = next) {
+            next = file->next;
+            signconf_release(file->sc);
+            free((void*) file->filename);
+            free((void*) file);
+        }
+        signconf_files[i] = NULL;
+    }
+    lock_basic_unlock(&signconf_lock);
+    lock_basic_destroy(&signconf_lock);
     return;
 }
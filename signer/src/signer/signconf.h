@@ -68,13 +68,23 @@ struct signconf_struct {
     duration_type soa_ttl;
     duration_type soa_min;
     char soa_serial[SC_SERIAL_SIZE];
-    /* Other useful information */
+    /* Other useful information, not part of the settings */
     time_t last_modified;
+    /* Sharing */
+    uint32_t hash;
+    unsigned refcount;             /* 0 if not shared */
+    signconf_type* next;
 
-    /* 2x str, 5x int, 9x duration */
-    /* est.mem: SC: 1056 */
+    /* 2x str, 7x int, 9x duration, 1x ptr */
+    /* est.mem: SC: 1072, once per distinct configuration */
 };
 
+/**
+ * Initialize the table of shared signer configurations.
+ *
+ */
+void signconf_cache_init(void);
+
 /**
  * Create a new signer configuration with the 'empty' settings.
  * @param r: memory region.
@@ -84,13 +94,19 @@ struct signconf_struct {
 signconf_type* signconf_create(region_type* r);
 
 /**
- * Update signer configuration.
- * @param sc:     signer configuration.
- * @param scfile: signer configuration file name.
- * @return:       (ods_status) status.
+ * Update signer configuration. Configurations with identical settings
+ * are shared: *sc is replaced by a reference to the shared configuration,
+ * which must not be modified. A file is only parsed once per
+ * modification, however many zones use it.
+ * @param sc:            signer configuration, replaced if the file changed.
+ * @param scfile:        signer configuration file name.
+ * @param last_modified: when scfile was last read for this zone, updated.
+ * @return:              (ods_status) status, ODS_STATUS_UNCHANGED if the
+ *                       file or the settings did not change.
  *
  */
-ods_status signconf_update(signconf_type* sc, const char* scfile);
+ods_status signconf_update(signconf_type** sc, const char* scfile,
+    time_t* last_modified);
 
 /**
  * Log signer configuration.
@@ -101,10 +117,17 @@ ods_status signconf_update(signconf_type* sc, const char* scfile);
 void signconf_log(signconf_type* sc, const char* name);
 
 /**
- * Clean up signer configuration.
+ * Clean up signer configuration, releasing the reference to a shared
+ * configuration.
  * @param sc: signconf to cleanup.
  *
  */
 void signconf_cleanup(signconf_type* sc);
 
+/**
+ * Clean up the table of shared signer configurations.
+ *
+ */
+void signconf_cache_cleanup(void);
+
 #endif /* SIGNER_SIGNCONF_H */
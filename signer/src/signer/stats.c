@@ -0,0 +1,230 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Zone statistics.
+ *
+ */
+
+#include "config.h"
+#include "signer/stats.h"
+
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const char* stats_phase_str[STATS_PHASE_MAX] = {
+    "conf", "read", "write"
+};
+
+
+/**
+ * Initialize statistics.
+ *
+ */
+void
+stats_init(stats_type* stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(stats_type));
+    return;
+}
+
+
+/**
+ * Monotonic clock, for measuring durations.
+ *
+ */
+uint64_t
+stats_now_usec(void)
+{
+    struct timeval tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+#endif
+    if (gettimeofday(&tv, NULL) != 0) {
+        return 0;
+    }
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+/**
+ * Account time spent in a task phase.
+ *
+ */
+void
+stats_phase_done(stats_type* stats, stats_phase phase, uint64_t start)
+{
+    uint64_t now = stats_now_usec();
+    if (!stats || phase >= STATS_PHASE_MAX) {
+        return;
+    }
+    stats_add(stats->phase_count[phase], 1);
+    stats_add(stats->phase_usec[phase], now > start ? now - start : 0);
+    return;
+}
+
+
+/**
+ * Take a copy of the statistics. Counters are read one by one, so a copy
+ * taken while the zone is worked on may be off by the operations in
+ * flight.
+ *
+ */
+void
+stats_snapshot(stats_type* stats, stats_type* copy)
+{
+    const volatile uint64_t* from = (const volatile uint64_t*) stats;
+    uint64_t* to = (uint64_t*) copy;
+    size_t i;
+    if (!stats || !copy) {
+        return;
+    }
+    for (i=0; i < sizeof(stats_type) / sizeof(uint64_t); i++) {
+        to[i] = from[i];
+    }
+    return;
+}
+
+
+/**
+ * Print statistics for humans.
+ *
+ */
+void
+stats_str(char* buf, size_t len, const char* name, stats_type* stats)
+{
+    size_t n = 0;
+    size_t i;
+#define STATS_STR(...) do { \
+        if (n < len) { \
+            int ret = snprintf(buf + n, len - n, __VA_ARGS__); \
+            n += ret > 0 ? (size_t) ret : 0; \
+        } \
+    } while (0)
+    STATS_STR("Zone %s:\n", name);
+    STATS_STR("  records read %llu, bytes written %llu\n",
+        (unsigned long long) stats->rr_read,
+        (unsigned long long) stats->bytes_written);
+    STATS_STR("  time");
+    for (i=0; i < STATS_PHASE_MAX; i++) {
+        STATS_STR(" %s %.3fs/%llu", stats_phase_str[i],
+            (double) stats->phase_usec[i] / 1000000.0,
+            (unsigned long long) stats->phase_count[i]);
+    }
+    STATS_STR("\n");
+#undef STATS_STR
+    if (n >= len && len > 1) {
+        buf[len-2] = '\n';
+    }
+    return;
+}
+
+
+/**
+ * Print zone name as a Prometheus label value.
+ *
+ */
+static void
+stats_print_label(FILE* fd, const char* name)
+{
+    for (; *name; name++) {
+        if (*name == '\\' || *name == '"') {
+            fputc('\\', fd);
+        } else if (*name == '\n') {
+            fputs("\\n", fd);
+            continue;
+        }
+        fputc(*name, fd);
+    }
+    return;
+}
+
+
+/**
+ * Print one Prometheus counter.
+ *
+ */
+static void
+stats_print_metric(FILE* fd, const char* metric, const char* name,
+    const char* extra, uint64_t value)
+{
+    fprintf(fd, "ttods_signer_%s{zone=\"", metric);
+    stats_print_label(fd, name);
+    fprintf(fd, "\"%s} %llu\n", extra ? extra : "",
+        (unsigned long long) value);
+    return;
+}
+
+
+/**
+ * Print the Prometheus metric descriptions.
+ *
+ */
+void
+stats_print_prometheus_help(FILE* fd)
+{
+    fprintf(fd,
+        "# TYPE ttods_signer_records_read_total counter\n"
+        "# TYPE ttods_signer_bytes_written_total counter\n"
+        "# TYPE ttods_signer_phase_runs_total counter\n"
+        "# TYPE ttods_signer_phase_seconds_total counter\n");
+    return;
+}
+
+
+/**
+ * Print statistics in the Prometheus text format.
+ *
+ */
+void
+stats_print_prometheus(FILE* fd, const char* name, stats_type* stats)
+{
+    char extra[64];
+    size_t i;
+    stats_print_metric(fd, "records_read_total", name, NULL, stats->rr_read);
+    stats_print_metric(fd, "bytes_written_total", name, NULL,
+        stats->bytes_written);
+    for (i=0; i < STATS_PHASE_MAX; i++) {
+        (void)snprintf(extra, sizeof(extra), ",phase=\"%s\"",
+            stats_phase_str[i]);
+        stats_print_metric(fd, "phase_runs_total", name, extra,
+            stats->phase_count[i]);
+        fprintf(fd, "ttods_signer_phase_seconds_total{zone=\"");
+        stats_print_label(fd, name);
+        fprintf(fd, "\"%s} %.6f\n", extra,
+            (double) stats->phase_usec[i] / 1000000.0);
+    }
+    return;
+}
@@ -0,0 +1,134 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Zone statistics.
+ *
+ */
+
+#ifndef SIGNER_STATS_H
+#define SIGNER_STATS_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_FILENAME     "ttods-signerd.prom" /* in the working directory */
+#define STATS_INTERVAL     60 /* seconds between statistics file dumps */
+
+/**
+ * Task phases.
+ *
+ */
+enum stats_phase_enum {
+    STATS_PHASE_CONF = 0,
+    STATS_PHASE_READ,
+    STATS_PHASE_WRITE,
+    STATS_PHASE_MAX
+};
+typedef enum stats_phase_enum stats_phase;
+
+/**
+ * Zone statistics. The counters are only ever incremented, with atomic
+ * adds, so that they can be read at any time without taking the zone lock.
+ *
+ */
+typedef struct stats_struct stats_type;
+struct stats_struct {
+    uint64_t rr_read;                   /* records read */
+    uint64_t bytes_written;
+    uint64_t phase_count[STATS_PHASE_MAX];
+    uint64_t phase_usec[STATS_PHASE_MAX];
+};
+
+/**
+ * Add to a statistics counter.
+ *
+ */
+#define stats_add(counter, n) ((void) __sync_fetch_and_add(&(counter), \
+    (uint64_t) (n)))
+
+/**
+ * Initialize statistics.
+ * @param stats: statistics.
+ *
+ */
+void stats_init(stats_type* stats);
+
+/**
+ * Monotonic clock, for measuring durations.
+ * @return: (uint64_t) microseconds.
+ *
+ */
+uint64_t stats_now_usec(void);
+
+/**
+ * Account time spent in a task phase.
+ * @param stats: statistics.
+ * @param phase: task phase.
+ * @param start: stats_now_usec() at the start of the phase.
+ *
+ */
+void stats_phase_done(stats_type* stats, stats_phase phase, uint64_t start);
+
+/**
+ * Take a consistent enough copy of the statistics.
+ * @param stats: statistics.
+ * @param copy:  copy.
+ *
+ */
+void stats_snapshot(stats_type* stats, stats_type* copy);
+
+/**
+ * Print statistics for humans.
+ * @param buf:   buffer.
+ * @param len:   buffer length.
+ * @param name:  zone name.
+ * @param stats: statistics snapshot.
+ *
+ */
+void stats_str(char* buf, size_t len, const char* name, stats_type* stats);
+
+/**
+ * Print statistics in the Prometheus text format.
+ * @param fd:    file descriptor.
+ * @param name:  zone name.
+ * @param stats: statistics snapshot.
+ *
+ */
+void stats_print_prometheus(FILE* fd, const char* name, stats_type* stats);
+
+/**
+ * Print the Prometheus metric descriptions.
+ * @param fd: file descriptor.
+ *
+ */
+void stats_print_prometheus_help(FILE* fd);
+
+#endif /* SIGNER_STATS_H */
@@ -32,7 +32,6 @@
  */
 
 #include "config.h"
-#include "parser/confparser.h"
 #include "parser/zlistparser.h"
 #include "signer/zlist.h"
 #include "signer/zone.h"
@@ -40,11 +39,77 @@
 #include "util/file.h"
 #include "util/log.h"
 
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
 static const char* logstr = "zonelist";
 
 
+#define ZLIST_INDEX_MIN 1024
+
+
 /**
- * Compare two zones.
+ * Compare two domain names in wire format, ignoring case.
+ *
+ */
+static int
+zlist_wire_compare(const uint8_t* w1, const uint8_t* w2)
+{
+    uint8_t len = 0;
+    uint8_t i = 0;
+    int c1, c2;
+    while (1) {
+        if (*w1 != *w2) {
+            return (int) *w1 - (int) *w2;
+        }
+        len = *w1;
+        if (len == 0) {
+            return 0;
+        }
+        w1++;
+        w2++;
+        for (i=0; i < len; i++) {
+            c1 = tolower((int) w1[i]);
+            c2 = tolower((int) w2[i]);
+            if (c1 != c2) {
+                return c1 - c2;
+            }
+        }
+        w1 += len;
+        w2 += len;
+    }
+    return 0;
+}
+
+
+/**
+ * Hash a domain name in wire format, ignoring case (FNV-1a).
+ *
+ */
+static uint32_t
+zlist_wire_hash(const uint8_t* wire)
+{
+    uint32_t hash = 2166136261U;
+    uint8_t len = 0;
+    uint8_t i = 0;
+    while (1) {
+        len = *wire++;
+        hash = (hash ^ len) * 16777619U;
+        if (len == 0) {
+            return hash;
+        }
+        for (i=0; i < len; i++) {
+            hash = (hash ^ (uint8_t) tolower((int) wire[i])) * 16777619U;
+        }
+        wire += len;
+    }
+    return hash;
+}
+
+
+/**
+ * Compare two zones, in canonical order of their apex.
  *
  */
 static int
@@ -52,6 +117,13 @@ zone_compare(const void* a, const void* b)
 {
     zone_type* x = (zone_type*)a;
     zone_type* y = (zone_type*)b;
+    const uint8_t* lx;
+    const uint8_t* ly;
+    uint8_t label_count;
+    uint8_t i;
+    int c1, c2;
+    uint8_t len;
+    uint8_t j;
     ods_log_assert(x);
     ods_log_assert(y);
     if (x->klass != y->klass) {
@@ -60,7 +132,130 @@ zone_compare(const void* a, const void* b)
         }
         return 1;
     }
-    return strncmp(x->name, y->name, strlen(x->name));
+    label_count = (x->apex->label_count <= y->apex->label_count ?
+        x->apex->label_count : y->apex->label_count);
+    /* skip the root label by starting at label 1. */
+    for (i = 1; i < label_count; ++i) {
+        lx = dname_label(x->apex, i);
+        ly = dname_label(y->apex, i);
+        len = label_length(lx) < label_length(ly) ?
+            label_length(lx) : label_length(ly);
+        for (j = 0; j < len; j++) {
+            c1 = tolower((int) label_data(lx)[j]);
+            c2 = tolower((int) label_data(ly)[j]);
+            if (c1 != c2) {
+                return c1 - c2;
+            }
+        }
+        if (label_length(lx) != label_length(ly)) {
+            return (int) label_length(lx) - (int) label_length(ly);
+        }
+    }
+    return (int) x->apex->label_count - (int) y->apex->label_count;
+}
+
+
+/**
+ * Grow the zone index.
+ *
+ */
+static void
+zlist_index_grow(zlist_type* zlist)
+{
+    zone_type** index = NULL;
+    zone_type* zone = NULL;
+    zone_type* next = NULL;
+    size_t size = zlist->index_size ? zlist->index_size * 2 :
+        ZLIST_INDEX_MIN;
+    size_t i;
+    uint32_t b;
+    index = (zone_type**) calloc(size, sizeof(zone_type*));
+    if (!index) {
+        ods_log_warning("[%s] unable to grow zone index: insufficient "
+            "memory", logstr);
+        return;
+    }
+    for (i=0; i < zlist->index_size; i++) {
+        for (zone = zlist->index[i]; zone; zone = next) {
+            next = zone->zl_index_next;
+            b = zlist_wire_hash(dname_name(zone->apex)) & (size - 1);
+            zone->zl_index_next = index[b];
+            index[b] = zone;
+        }
+    }
+    free((void*) zlist->index);
+    zlist->index = index;
+    zlist->index_size = size;
+    return;
+}
+
+
+/**
+ * Look up zone in the index.
+ *
+ */
+static zone_type*
+zlist_index_lookup(zlist_type* zlist, const uint8_t* wire, uint16_t klass)
+{
+    zone_type* zone = NULL;
+    if (!zlist->index_size) {
+        return NULL;
+    }
+    zone = zlist->index[zlist_wire_hash(wire) & (zlist->index_size - 1)];
+    for (; zone; zone = zone->zl_index_next) {
+        if (zone->klass == klass &&
+            zlist_wire_compare(dname_name(zone->apex), wire) == 0) {
+            return zone;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Add zone to the index.
+ *
+ */
+static void
+zlist_index_add(zlist_type* zlist, zone_type* zone)
+{
+    uint32_t b;
+    if (zlist->index_count >= zlist->index_size) {
+        zlist_index_grow(zlist);
+        if (!zlist->index_size) {
+            return;
+        }
+    }
+    b = zlist_wire_hash(dname_name(zone->apex)) & (zlist->index_size - 1);
+    zone->zl_index_next = zlist->index[b];
+    zlist->index[b] = zone;
+    zlist->index_count++;
+    return;
+}
+
+
+/**
+ * Remove zone from the index.
+ *
+ */
+static void
+zlist_index_del(zlist_type* zlist, zone_type* zone)
+{
+    zone_type** p = NULL;
+    if (!zlist->index_size) {
+        return;
+    }
+    p = &zlist->index[zlist_wire_hash(dname_name(zone->apex)) &
+        (zlist->index_size - 1)];
+    for (; *p; p = &(*p)->zl_index_next) {
+        if (*p == zone) {
+            *p = zone->zl_index_next;
+            zone->zl_index_next = NULL;
+            zlist->index_count--;
+            return;
+        }
+    }
+    return;
 }
 
 
@@ -79,6 +274,13 @@ zlist_create(region_type* r)
     zlist->just_added = 0;
     zlist->just_updated = 0;
     zlist->just_removed = 0;
+    zlist->generation = 0;
+    zlist->changed = NULL;
+    zlist->changed_count = 0;
+    zlist->changed_max = 0;
+    zlist->index = NULL;
+    zlist->index_size = 0;
+    zlist->index_count = 0;
     lock_basic_init(&zlist->zl_lock);
     return zlist;
 }
@@ -101,17 +303,34 @@ zone2node(zone_type* zone)
 
 
 /**
- * Lookup zone.
+ * Look up zone by apex.
  *
  */
-static zone_type*
-zlist_lookup_zone(zlist_type* zlist, zone_type* zone)
+zone_type*
+zlist_lookup_zone_by_dname(zlist_type* zlist, dname_type* dname,
+    uint16_t klass)
 {
-    tree_node* node = tree_search(zlist->zones, zone);
-    if (node) {
-        return (zone_type*) node->data;
+    ods_log_assert(zlist);
+    ods_log_assert(dname);
+    return zlist_index_lookup(zlist, dname_name(dname), klass);
+}
+
+
+/**
+ * Look up zone by name.
+ *
+ */
+zone_type*
+zlist_lookup_zone_by_name(zlist_type* zlist, const char* name,
+    uint16_t klass)
+{
+    uint8_t wire[DNAME_MAXLEN+1];
+    ods_log_assert(zlist);
+    ods_log_assert(name);
+    if (!dname_str2wire(wire, name)) {
+        return NULL;
     }
-    return NULL;
+    return zlist_index_lookup(zlist, wire, klass);
 }
 
 
@@ -127,7 +346,7 @@ zlist_add_zone(zlist_type* zlist, zone_type* zone)
     ods_log_assert(zlist->zones);
     ods_log_assert(zone);
     /* look up */
-    if (zlist_lookup_zone(zlist, zone) != NULL) {
+    if (zlist_index_lookup(zlist, dname_name(zone->apex), zone->klass)) {
         ods_log_warning("[%s] failed to add zone %s: already present",
             logstr, zone->name);
         zone_cleanup(zone);
@@ -140,6 +359,9 @@ zlist_add_zone(zlist_type* zlist, zone_type* zone)
         zone_cleanup(zone);
         return NULL;
     }
+    zlist_index_add(zlist, zone);
+    /* only zones in the list have a journal file */
+    zone->journal = journal_create(zone->region, zone->name);
     zone->zl_status = ZONE_ZL_ADDED;
     zlist->just_added++;
     return zone;
@@ -157,6 +379,7 @@ zlist_del_zone(zlist_type* zlist, zone_type* zone)
     if (!zlist || !zlist->zones || !zone) {
         goto zlist_del_zone_notpresent;
     }
+    zlist_index_del(zlist, zone);
     old_node = tree_delete(zlist->zones, zone);
     if (!old_node) {
         goto zlist_del_zone_notpresent;
@@ -172,100 +395,150 @@ zlist_del_zone_notpresent:
 
 
 /**
- * Read a zonelist file.
+ * Remember a changed zone.
  *
  */
-static ods_status
-zlist_read(zlist_type* zl, const char* zlfile)
+void
+zlist_mark_changed(zlist_type* zl, zone_type* zone)
 {
-    const char* rngfile = ODS_SE_RNGDIR "/zonelist.rng";
-    ods_status status = ODS_STATUS_OK;
+    zone_type** changed = NULL;
+    size_t max = 0;
     ods_log_assert(zl);
-    ods_log_assert(zlfile);
-    ods_log_verbose("[%s] read file %s", logstr, zlfile);
-    status = parser_filecheck(zlfile, rngfile);
-    if (status != ODS_STATUS_OK) {
-        ods_log_error("[%s] parse error in zonelist %s", logstr, zlfile);
-        return status;
+    ods_log_assert(zone);
+    if (zone->zl_marked) {
+        /* still on the list from an earlier update */
+        return;
+    }
+    if (zl->changed_count >= zl->changed_max) {
+        max = zl->changed_max ? zl->changed_max * 2 : 64;
+        changed = (zone_type**) realloc(zl->changed,
+            max * sizeof(zone_type*));
+        if (!changed) {
+            ods_log_crit("[%s] unable to track change for zone %s: "
+                "insufficient memory", logstr, zone->name);
+            return;
+        }
+        zl->changed = changed;
+        zl->changed_max = max;
+    }
+    zl->changed[zl->changed_count++] = zone;
+    zone->zl_marked = 1;
+    return;
+}
+
+
+/**
+ * Create a zone from a zonelist entry.
+ *
+ */
+static zone_type*
+zlist_entry2zone(zlist_entry_type* entry)
+{
+    zone_type* zone = NULL;
+    char name[ODS_SE_MAXLINE];
+    (void)strlcpy(name, entry->name, sizeof(name));
+    zone = zone_create(name, LDNS_RR_CLASS_IN);
+    if (!zone) {
+        return NULL;
+    }
+    zone->policy_name = strdup(entry->policy_name);
+    zone->signconf_filename = strdup(entry->signconf_filename);
+    zone->adapter_in = adapter_create(zone->region,
+        entry->adapter_in->configstr, entry->adapter_in->type, 1);
+    zone->adapter_out = adapter_create(zone->region,
+        entry->adapter_out->configstr, entry->adapter_out->type, 0);
+    if (!zone->policy_name || !zone->signconf_filename ||
+        !zone->adapter_in || !zone->adapter_out) {
+        ods_log_crit("[%s] unable to create zone %s", logstr, entry->name);
+        zone_cleanup(zone);
+        return NULL;
     }
-    return parser_zlist_zones((struct zlist_struct*) zl, zlfile);
+    zone->zl_hash = entry->hash;
+    return zone;
 }
 
 
 /**
- * Merge zone lists.
+ * Merge the zonelist entries into the zone list. Zones whose entry did
+ * not change are only marked as seen.
  *
  */
 static void
-zlist_merge(zlist_type* zl1, zlist_type* zl2)
+zlist_merge(zlist_type* zl, zlist_entry_type* entries)
 {
-    zone_type* z1 = NULL;
-    zone_type* z2 = NULL;
-    tree_node* n1 = TREE_NULL;
-    tree_node* n2 = TREE_NULL;
-    int ret = 0;
-    ods_log_assert(zl1);
-    ods_log_assert(zl2);
-    ods_log_assert(zl1->zones);
-    ods_log_assert(zl2->zones);
-    ods_log_debug("[%s] merge two zone lists", logstr);
-    n1 = tree_first(zl1->zones);
-    n2 = tree_first(zl2->zones);
-    while (n2 && n2 != TREE_NULL) {
-        z2 = (zone_type*) n2->data;
-        if (n1 && n1 != TREE_NULL) {
-            z1 = (zone_type*) n1->data;
-        } else {
-            z1 = NULL;
-        }
-        if (!z2) {
-            /* no more zones to merge into zl1 */
-            return;
-        } else if (!z1) {
-            /* just add remaining zones from zl2 */
-            z2 = zlist_add_zone(zl1, z2);
-            if (!z2) {
-                ods_log_crit("[%s] merge failed: z2 not added", logstr);
-                return;
+    zlist_entry_type* entry = NULL;
+    zone_type* zone = NULL;
+    zone_type settings;
+    tree_node* node = TREE_NULL;
+    size_t existing = 0;
+    size_t seen = 0;
+    ods_log_assert(zl);
+    ods_log_assert(zl->zones);
+    ods_log_debug("[%s] merge zone list", logstr);
+    existing = tree_count(zl->zones);
+    zl->generation++;
+    memset(&settings, 0, sizeof(settings));
+    for (entry = entries; entry; entry = entry->next) {
+        zone = zlist_lookup_zone_by_name(zl, entry->name,
+            LDNS_RR_CLASS_IN);
+        if (zone) {
+            if (zone->zl_generation == zl->generation) {
+                ods_log_warning("[%s] zone %s listed twice, ignoring "
+                    "duplicate", logstr, entry->name);
+                continue;
+            }
+            zone->zl_generation = zl->generation;
+            seen++;
+            if (zone->zl_status == ZONE_ZL_REMOVED) {
+                /* removal not yet committed, keep the zone after all */
+                zone->zl_status = ZONE_ZL_UPDATED;
+                zone->zl_hash = 0;
+            }
+            if (zone->zl_hash == entry->hash) {
+                /* unchanged */
+                continue;
+            }
+            /* update the zone settings */
+            settings.policy_name = entry->policy_name;
+            settings.signconf_filename = entry->signconf_filename;
+            settings.adapter_in = entry->adapter_in;
+            settings.adapter_out = entry->adapter_out;
+            lock_basic_lock(&zone->zone_lock);
+            zone_merge(zone, &settings);
+            lock_basic_unlock(&zone->zone_lock);
+            zone->zl_hash = entry->hash;
+            if (zone->zl_status == ZONE_ZL_UPDATED) {
+                zl->just_updated++;
+                zlist_mark_changed(zl, zone);
             }
-            n2 = tree_next(n2);
         } else {
-            /* compare the zones z1 and z2 */
-            ret = zone_compare(z1, z2);
-            if (ret < 0) {
-                /* remove zone z1, it is not present in the new list zl2 */
-                z1->zl_status = ZONE_ZL_REMOVED;
-                zl1->just_removed++;
-                n1 = tree_next(n1);
-            } else if (ret > 0) {
-                /* add the new zone z2 */
-                z2 = zlist_add_zone(zl1, z2);
-                if (!z2) {
-                    ods_log_crit("[%s] merge failed: z2 not added", logstr);
-                    return;
-                }
-                n2 = tree_next(n2);
-            } else {
-                /* just update zone z1 */
-                n1 = tree_next(n1);
-                n2 = tree_next(n2);
-                zone_merge(z1, z2);
-                zone_cleanup(z2);
-                if (z1->zl_status == ZONE_ZL_UPDATED) {
-                    zl1->just_updated++;
-                }
-                z1->zl_status = ZONE_ZL_UPDATED;
+            /* add the new zone */
+            zone = zlist_entry2zone(entry);
+            if (!zone || !zlist_add_zone(zl, zone)) {
+                ods_log_crit("[%s] merge failed: zone %s not added", logstr,
+                    entry->name);
+                continue;
             }
+            zone->zl_generation = zl->generation;
+            zlist_mark_changed(zl, zone);
         }
     }
-    /* remove remaining zones from z1 */
-    while (n1 && n1 != TREE_NULL) {
-        z1 = (zone_type*) n1->data;
-        z1->zl_status = ZONE_ZL_REMOVED;
-        zl1->just_removed++;
-        n1 = tree_next(n1);
+    if (seen == existing) {
+        /* all zones are still present */
+        return;
+    }
+    /* remove zones that are not present in the new list */
+    node = tree_first(zl->zones);
+    while (node && node != TREE_NULL) {
+        zone = (zone_type*) node->data;
+        if (zone->zl_generation != zl->generation &&
+            zone->zl_status != ZONE_ZL_REMOVED) {
+            zone->zl_status = ZONE_ZL_REMOVED;
+            zl->just_removed++;
+            zlist_mark_changed(zl, zone);
+        }
+        node = tree_next(node);
     }
-    zl1->last_modified = zl2->last_modified;
     return;
 }
 
@@ -277,8 +550,10 @@ zlist_merge(zlist_type* zl1, zlist_type* zl2)
 ods_status
 zlist_update(zlist_type* zl, const char* zlfile)
 {
+    const char* rngfile = ODS_SE_RNGDIR "/zonelist.rng";
     region_type* r = NULL;
-    zlist_type* new_zlist = NULL;
+    zlist_entry_type* entries = NULL;
+    size_t count = 0;
     time_t st_mtime = 0;
     ods_status status = ODS_STATUS_OK;
     char* datestamp = NULL;
@@ -295,26 +570,29 @@ zlist_update(zlist_type* zl, const char* zlfile)
         free((void*)datestamp);
         return ODS_STATUS_UNCHANGED;
     }
-    /* create new zonelist */
+    /* read zonelist, without holding the zone list lock */
     r = region_create();
     if (!r) {
         ods_log_error("[%s] region create failed", logstr);
         return ODS_STATUS_MALLOCERR;
     }
-    new_zlist = zlist_create(r);
-    if (!new_zlist) {
-        ods_log_error("[%s] create zonelist failed", logstr);
-        return ODS_STATUS_MALLOCERR;
-    }
-    /* read zonelist */
-    status = zlist_read(new_zlist, zlfile);
+    ods_log_verbose("[%s] read file %s", logstr, zlfile);
+    status = parser_zlist_entries(r, zlfile, rngfile, &entries, &count);
     if (status == ODS_STATUS_OK) {
+        lock_basic_lock(&zl->zl_lock);
         zl->just_added = 0;
         zl->just_updated = 0;
         zl->just_removed = 0;
-        new_zlist->last_modified = st_mtime;
-        zlist_merge(zl, new_zlist);
-        (void)time_datestamp(zl->last_modified, "%Y-%m-%d %T", &datestamp);
+        zlist_merge(zl, entries);
+        zl->last_modified = st_mtime;
+        ods_log_info("[%s] zone list %s: %u zones, %d added, %d updated, "
+            "%d removed", logstr, zlfile, (unsigned) count, zl->just_added,
+            zl->just_updated, zl->just_removed);
+        zl->just_removed = 0;
+        zl->just_added = 0;
+        zl->just_updated = 0;
+        lock_basic_unlock(&zl->zl_lock);
+        (void)time_datestamp(st_mtime, "%Y-%m-%d %T", &datestamp);
         ods_log_debug("[%s] file %s is modified since %s", logstr, zlfile,
             datestamp?datestamp:"Unknown");
         free((void*)datestamp);
@@ -322,15 +600,51 @@ zlist_update(zlist_type* zl, const char* zlfile)
         ods_log_error("[%s] read file %s failed (%s)", logstr, zlfile,
             ods_status2str(status));
     }
-    zlist_free(new_zlist);
     region_cleanup(r);
-    zl->just_removed = 0;
-    zl->just_added = 0;
-    zl->just_updated = 0;
     return status;
 }
 
 
+/**
+ * Copy the statistics of the zones.
+ *
+ */
+zlist_stats_type*
+zlist_stats(zlist_type* zl, region_type* r, size_t* count)
+{
+    zlist_stats_type* copies = NULL;
+    tree_node* node = TREE_NULL;
+    zone_type* zone = NULL;
+    size_t n = 0;
+    ods_log_assert(zl);
+    ods_log_assert(r);
+    ods_log_assert(count);
+    lock_basic_lock(&zl->zl_lock);
+    if (zl->zones && tree_count(zl->zones) > 0) {
+        copies = (zlist_stats_type*) region_alloc(r,
+            tree_count(zl->zones) * sizeof(zlist_stats_type));
+        node = copies ? tree_first(zl->zones) : TREE_NULL;
+    }
+    while (node && node != TREE_NULL) {
+        zone = (zone_type*) node->data;
+        node = tree_next(node);
+        if (zone->zl_status == ZONE_ZL_REMOVED) {
+            continue;
+        }
+        copies[n].name = region_strdup(r, zone->name);
+        if (!copies[n].name) {
+            break;
+        }
+        /* counters are atomic, no need for the zone lock */
+        stats_snapshot(&zone->stats, &copies[n].stats);
+        n++;
+    }
+    lock_basic_unlock(&zl->zl_lock);
+    *count = n;
+    return n ? copies : NULL;
+}
+
+
 /**
  * Free zonelist.
  *
@@ -344,6 +658,10 @@ zlist_free(zlist_type* zl)
     if (zl->zones) {
         tree_cleanup(zl->zones);
     }
+    free((void*) zl->changed);
+    zl->changed = NULL;
+    free((void*) zl->index);
+    zl->index = NULL;
     lock_basic_destroy(&zl->zl_lock);
     return;
 }
@@ -361,6 +679,10 @@ zlist_cleanup(zlist_type* zl)
     }
     ods_log_debug("[%s] cleanup zones", logstr);
     tree_cleanup(zl->zones);
+    free((void*) zl->changed);
+    zl->changed = NULL;
+    free((void*) zl->index);
+    zl->index = NULL;
     lock_basic_destroy(&zl->zl_lock);
     return;
 }
@@ -55,12 +55,29 @@ struct zlist_struct {
     int just_added;
     int just_updated;
     int just_removed;
+    unsigned generation;
+    zone_type** changed;
+    size_t changed_count;
+    size_t changed_max;
+    zone_type** index;
+    size_t index_size;
+    size_t index_count;
     lock_basic_type zl_lock;
 
-    /* 1x ptr, 5x int */
+    /* 3x ptr, 6x int, 4x size_t */
     /* est.mem: ZL = 28 + N*Z bytes */
 };
 
+/**
+ * Statistics of a zone, copied out of the zone list.
+ *
+ */
+typedef struct zlist_stats_struct zlist_stats_type;
+struct zlist_stats_struct {
+    const char* name;
+    stats_type stats;
+};
+
 /**
  * Create zone list.
  * @return: (zlist_type*) created zone list.
@@ -77,6 +94,28 @@ zlist_type* zlist_create(region_type* r);
  */
 zone_type* zlist_add_zone(zlist_type* zl, zone_type* zone);
 
+/**
+ * Look up zone by apex.
+ * @param zl:    zone list.
+ * @param dname: zone apex.
+ * @param klass: zone class.
+ * @return:      (zone_type*) zone, NULL if not found.
+ *
+ */
+zone_type* zlist_lookup_zone_by_dname(zlist_type* zl, dname_type* dname,
+    uint16_t klass);
+
+/**
+ * Look up zone by name.
+ * @param zl:    zone list.
+ * @param name:  zone name.
+ * @param klass: zone class.
+ * @return:      (zone_type*) zone, NULL if not found.
+ *
+ */
+zone_type* zlist_lookup_zone_by_name(zlist_type* zl, const char* name,
+    uint16_t klass);
+
 /**
  * Delete zone.
  * @param zl:   zone list.
@@ -87,7 +126,19 @@ zone_type* zlist_add_zone(zlist_type* zl, zone_type* zone);
 zone_type* zlist_del_zone(zlist_type* zlist, zone_type* zone);
 
 /**
- * Update zonelist.
+ * Remember that a zone was added, updated or removed by the last zone
+ * list update.
+ * @param zl:   zone list.
+ * @param zone: zone.
+ *
+ */
+void zlist_mark_changed(zlist_type* zl, zone_type* zone);
+
+/**
+ * Update zonelist. Only the zones that were added, updated or removed
+ * are put on the list of changed zones.
+ * The zone list lock is taken while the changes are merged, not while
+ * the file is read.
  * @param zl:     zone list.
  * @param zlfile: zone list filename.
  * @return:       (ods_status) status.
@@ -95,6 +146,19 @@ zone_type* zlist_del_zone(zlist_type* zlist, zone_type* zone);
  */
 ods_status zlist_update(zlist_type* zl, const char* zlfile);
 
+/**
+ * Copy the statistics of the zones in the list. The zone list is only
+ * locked while copying, so that the caller can format the copies without
+ * holding it.
+ * @param zl:    zone list.
+ * @param r:     memory region for the copies.
+ * @param count: number of copies.
+ * @return:      (zlist_stats_type*) copies, NULL if there are none.
+ *
+ */
+zlist_stats_type* zlist_stats(zlist_type* zl, region_type* r,
+    size_t* count);
+
 /**
  * Free zone list.
  * @param zl: zone list.
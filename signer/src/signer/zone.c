@@ -51,14 +51,25 @@ static void
 zone_init(zone_type* zone)
 {
     zone->signconf = signconf_create(zone->region);
+    zone->signconf_modified = 0;
     zone->namedb = namedb_create(zone);
     zone->notify_ns = NULL;
     zone->default_ttl = DEFAULT_TTL;
+    zone->zl_hash = 0;
+    zone->zl_generation = 0;
+    zone->zl_marked = 0;
+    zone->zl_index_next = NULL;
     zone->policy_name = NULL;
     zone->signconf_filename = NULL;
     zone->task = NULL;
     zone->adapter_in = NULL;
     zone->adapter_out = NULL;
+    zone->outbound_serial = 0;
+    zone->xfr_ready = 0;
+    zone->clear_pending = 0;
+    stats_init(&zone->stats);
+    /* opened when the zone is added to the zone list */
+    zone->journal = NULL;
     lock_basic_init(&zone->zone_lock);
     return;
 }
@@ -112,16 +123,17 @@ zone_load_signconf(zone_type* zone)
     ods_log_assert(zone->name);
     ods_log_assert(zone->signconf);
     ods_log_assert(zone->signconf_filename);
-    status = signconf_update(zone->signconf, zone->signconf_filename);
+    status = signconf_update(&zone->signconf, zone->signconf_filename,
+        &zone->signconf_modified);
     if (status == ODS_STATUS_OK) {
-        (void)time_datestamp(zone->signconf->last_modified, "%Y-%m-%d %T",
+        (void)time_datestamp(zone->signconf_modified, "%Y-%m-%d %T",
             &datestamp);
         ods_log_debug("[%s] zone %s signconf file %s is modified since %s",
             logstr, zone->name, zone->signconf_filename,
             datestamp?datestamp:"Unknown");
         free((void*)datestamp);
     } else if (status == ODS_STATUS_UNCHANGED) {
-        (void)time_datestamp(zone->signconf->last_modified,
+        (void)time_datestamp(zone->signconf_modified,
             "%Y-%m-%d %T", &datestamp);
         ods_log_verbose("[%s] zone %s signconf file %s is unchanged since "
             "%s", logstr, zone->name, zone->signconf_filename,
@@ -136,6 +148,28 @@ zone_load_signconf(zone_type* zone)
 
 
 
+/**
+ * Merge adapter settings.
+ *
+ */
+static void
+zone_merge_adapter(zone_type* z1, adapter_type* a1, adapter_type* a2)
+{
+    if (!a1 || !a2) {
+        return;
+    }
+    if (a1->type != a2->type ||
+        ods_strcmp(a1->configstr, a2->configstr) != 0) {
+        a1->type = a2->type;
+        strlcpy(&(a1->configstr[0]), &(a2->configstr[0]), AD_CONFIGSTR_SIZE);
+        a1->config_last_modified = 0;
+        a1->error = 0;
+        z1->zl_status = ZONE_ZL_UPDATED;
+    }
+    return;
+}
+
+
 /**
  * Merge zones.
  *
@@ -184,16 +218,18 @@ zone_merge(zone_type* z1, zone_type* z2)
         }
     }
     /* adapters */
+    zone_merge_adapter(z1, z1->adapter_in, z2->adapter_in);
+    zone_merge_adapter(z1, z1->adapter_out, z2->adapter_out);
     return;
 }
 
 
 /**
- * Reschedule task for zone.
+ * Reschedule task for zone, the schedule is already locked.
  *
  */
 ods_status
-zone_reschedule_task(zone_type* zone, schedule_type* s, int what)
+zone_reschedule_task_locked(zone_type* zone, schedule_type* s, int what)
 {
      task_type* task = NULL;
      ods_status status = ODS_STATUS_OK;
@@ -202,7 +238,6 @@ zone_reschedule_task(zone_type* zone, schedule_type* s, int what)
      ods_log_assert(zone->task);
      ods_log_assert(s);
      ods_log_debug("[%s] reschedule task for zone %s", logstr, zone->name);
-     lock_basic_lock(&s->s_lock);
      task = unschedule_task(s, (task_type*) zone->task);
      if (task != NULL) {
          if (task->what != (task_id) what) {
@@ -225,11 +260,50 @@ zone_reschedule_task(zone_type* zone, schedule_type* s, int what)
          task->interrupt = (task_id) what;
          /* task->halted(_when) set by worker */
      }
+     return status;
+}
+
+
+/**
+ * Reschedule task for zone.
+ *
+ */
+ods_status
+zone_reschedule_task(zone_type* zone, schedule_type* s, int what)
+{
+     ods_status status = ODS_STATUS_OK;
+     ods_log_assert(s);
+     lock_basic_lock(&s->s_lock);
+     status = zone_reschedule_task_locked(zone, s, what);
      lock_basic_unlock(&s->s_lock);
      return status;
 }
 
 
+/**
+ * Clear zone data.
+ *
+ */
+void
+zone_clear(zone_type* zone)
+{
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    namedb_cleanup(zone->namedb);
+    zone->namedb = namedb_create(zone);
+    if (zone->journal) {
+        journal_purge(zone->journal);
+    }
+    zone->xfr_ready = 0;
+    if (zone->adapter_in) {
+        /* make sure the input is read again */
+        zone->adapter_in->config_last_modified = 0;
+    }
+    ods_log_verbose("[%s] cleared zone %s", logstr, zone->name);
+    return;
+}
+
+
 /**
  * Add rr to zone.
  *
@@ -244,10 +318,11 @@ zone_add_rr(zone_type* zone, rr_type* rr, int do_stats)
     rr_type* clone;
     ods_log_assert(zone);
     ods_log_assert(rr);
-    clone = rr_clone(zone->region, rr);
-    domain = namedb_lookup_domain(zone->namedb, clone->owner);
+    stats_add(zone->stats.rr_read, 1);
+    /* look up with the caller's rr, only copy what is new into the zone */
+    domain = namedb_lookup_domain(zone->namedb, rr->owner);
     if (!domain) {
-        domain = namedb_add_domain(zone->namedb, clone->owner);
+        domain = namedb_add_domain(zone->namedb, rr->owner);
         ods_log_assert(domain);
         if (dname_compare(domain->dname, zone->apex) == 0) {
             domain->is_apex = 1;
@@ -262,13 +337,13 @@ zone_add_rr(zone_type* zone, rr_type* rr, int do_stats)
             }
         }
     }
-    rrset = domain_lookup_rrset(domain, clone->type);
+    rrset = domain_lookup_rrset(domain, rr->type);
     if (!rrset) {
-        rrset = rrset_create(domain, clone->type);
+        rrset = rrset_create(domain, rr->type);
         ods_log_assert(rrset);
         domain_add_rrset(domain, rrset);
     }
-    record = rrset_lookup_rr(rrset, clone);
+    record = rrset_lookup_rr(rrset, rr);
     if (record) {
         record->is_added = 1; /* already exists, just mark added */
         record->is_removed = 0; /* unset is_removed */
@@ -276,6 +351,7 @@ zone_add_rr(zone_type* zone, rr_type* rr, int do_stats)
         rrset->needs_singing = 1;
         return ODS_STATUS_UNCHANGED;
     }
+    clone = rr_clone_owner(zone->namedb->region, rr, domain->dname);
     record = rrset_add_rr(rrset, clone);
     ods_log_assert(record);
     ods_log_assert(record->rr);
@@ -285,6 +361,71 @@ zone_add_rr(zone_type* zone, rr_type* rr, int do_stats)
 }
 
 
+/**
+ * Delete rr from zone.
+ *
+ */
+ods_status
+zone_del_rr(zone_type* zone, rr_type* rr, int do_stats)
+{
+    domain_type* domain;
+    rrset_type* rrset;
+    record_type* record;
+    ods_log_assert(zone);
+    ods_log_assert(rr);
+    domain = namedb_lookup_domain(zone->namedb, rr->owner);
+    if (!domain) {
+        rr_log(rr, "[namedb] delete RR failed: domain not found",
+            LOG_WARNING);
+        return ODS_STATUS_UNCHANGED;
+    }
+    rrset = domain_lookup_rrset(domain, rr->type);
+    if (!rrset) {
+        rr_log(rr, "[namedb] delete RR failed: RRset not found",
+            LOG_WARNING);
+        return ODS_STATUS_UNCHANGED;
+    }
+    record = rrset_del_rr(rrset, rr);
+    if (!record) {
+        rr_log(rr, "[namedb] delete RR failed: RR not found", LOG_WARNING);
+        return ODS_STATUS_UNCHANGED;
+    }
+    ods_log_assert(record->is_removed);
+    rr_log(record->rr, "[namedb] -RR", LOG_DEEEBUG);
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Look up the SOA record of the zone.
+ *
+ */
+rr_type*
+zone_lookup_soa(zone_type* zone)
+{
+    domain_type* domain;
+    rrset_type* rrset;
+    size_t i;
+    ods_log_assert(zone);
+    ods_log_assert(zone->namedb);
+    domain = namedb_lookup_domain(zone->namedb, zone->apex);
+    if (!domain) {
+        return NULL;
+    }
+    rrset = domain_lookup_rrset(domain, DNS_TYPE_SOA);
+    if (!rrset) {
+        return NULL;
+    }
+    /* after a reload the old SOA is still there, pending deletion */
+    for (i=0; i < rrset->rr_count; i++) {
+        if (!rrset->rrs[i].is_removed) {
+            return rrset->rrs[i].rr;
+        }
+    }
+    return NULL;
+}
+
+
 /**
  * Commit differences in zone as a result of reading an unsigned zone.
  *
@@ -292,10 +433,17 @@ zone_add_rr(zone_type* zone, rr_type* rr, int do_stats)
 void
 zone_commit_diff(zone_type* zone, unsigned incremental, unsigned more_coming)
 {
+    ods_status status;
     uint32_t num_added = 0;
     ods_log_assert(zone);
     ods_log_assert(zone->name);
     ods_log_assert(zone->namedb);
+    status = zone->journal ? journal_commit(zone->journal, zone) :
+        ODS_STATUS_UNCHANGED;
+    if (status != ODS_STATUS_OK && status != ODS_STATUS_UNCHANGED) {
+        ods_log_warning("[%s] zone %s journal not updated: %s", logstr,
+            zone->name, ods_status2str(status));
+    }
     namedb_diff(zone->namedb, incremental, more_coming);
     num_added = namedb_nsecify(zone->namedb);
     ods_log_debug("[%s] added %u NSEC[3] rrs to zone %s", logstr, num_added,
@@ -305,7 +453,24 @@ zone_commit_diff(zone_type* zone, unsigned incremental, unsigned more_coming)
 
 
 /**
- * Clean up zone.
+ * Rollback differences in zone.
+ *
+ */
+void
+zone_rollback_diff(zone_type* zone)
+{
+    ods_log_assert(zone);
+    ods_log_assert(zone->name);
+    ods_log_assert(zone->namedb);
+    namedb_rollback(zone->namedb);
+    ods_log_debug("[%s] rolled back differences in zone %s", logstr,
+        zone->name);
+    return;
+}
+
+
+/**
+ * Print zone.
  *
  */
 ods_status
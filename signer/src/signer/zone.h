@@ -39,8 +39,10 @@
 #include "dns/rr.h"
 #include "schedule/schedule.h"
 #include "schedule/task.h"
+#include "signer/journal.h"
 #include "signer/namedb.h"
 #include "signer/signconf.h"
+#include "signer/stats.h"
 #include "util/locks.h"
 #include "util/region.h"
 #include "util/status.h"
@@ -66,8 +68,13 @@ struct zone_struct {
     ldns_rr_class klass;           /* class */
     uint32_t default_ttl;          /* default ttl */
     zone_zl_status zl_status;      /* zonelist status */
+    uint64_t zl_hash;              /* digest of the zonelist entry */
+    unsigned zl_generation;        /* last zonelist update that saw it */
+    int zl_marked;                 /* on the list of changed zones */
+    zone_type* zl_index_next;      /* next zone in zonelist index bucket */
     task_type* task;               /* next assigned task */
-    signconf_type* signconf;       /* signer configuration */
+    signconf_type* signconf;       /* signer configuration, shared */
+    time_t signconf_modified;      /* when the signconf file was read */
     namedb_type* namedb;           /* zone data */
     /* from conf.xml */
     const char* notify_ns;         /* name server reload command */
@@ -79,8 +86,13 @@ struct zone_struct {
     adapter_type* adapter_in;
     adapter_type* adapter_out;
     /* zone transfers */
+    uint32_t outbound_serial;      /* serial provided by outbound xfr */
+    int xfr_ready;                 /* zone can be transferred */
+    journal_type* journal;         /* journal, NULL until listed */
     /* worker variables */
+    int clear_pending;             /* clear before the next task, s_lock */
     /* statistics */
+    stats_type stats;
     lock_basic_type zone_lock;
 
     /* 4x int, 4x ptr, 4x charptr */
@@ -129,6 +141,25 @@ void zone_merge(zone_type* z1, zone_type* z2);
  */
 ods_status zone_reschedule_task(zone_type* zone, schedule_type* s, int what);
 
+/**
+ * Reschedule task for zone. The caller holds the schedule lock, so that
+ * many zones can be rescheduled under one lock acquisition.
+ * @param zone: zone.
+ * @param s:    schedule.
+ * @param what: new task identifier.
+ * @return:     (ods_status) status.
+ *
+ */
+ods_status zone_reschedule_task_locked(zone_type* zone, schedule_type* s,
+    int what);
+
+/**
+ * Clear zone data: the zone will be read and signed from scratch.
+ * @param zone: zone.
+ *
+ */
+void zone_clear(zone_type* zone);
+
 /**
  * Add rr to zone.
  * @param zone:     zone.
@@ -139,8 +170,30 @@ ods_status zone_reschedule_task(zone_type* zone, schedule_type* s, int what);
  */
 ods_status zone_add_rr(zone_type* zone, rr_type* rr, int do_stats);
 
+/**
+ * Delete rr from zone. The rr is marked for removal and taken out when
+ * the differences are committed.
+ * @param zone:     zone.
+ * @param rr:       rr.
+ * @param do_stats: do we need to maintain stats.
+ * @return:         (ods_status) status.
+ *                  ODS_STATUS_OK: rr marked for removal.
+ *                  ODS_STATUS_UNCHANGED: rr not present in zone.
+ *
+ */
+ods_status zone_del_rr(zone_type* zone, rr_type* rr, int do_stats);
+
+/**
+ * Look up the SOA record of the zone, skipping records pending deletion.
+ * @param zone: zone.
+ * @return:     (rr_type*) SOA rr, NULL if the zone has no SOA.
+ *
+ */
+rr_type* zone_lookup_soa(zone_type* zone);
+
 /**
  * Commit differences in zone as a result of reading an unsigned zone.
+ * The differences are recorded in the zone journal first.
  * @param zone:        zone.
  * @param incremental: full (0) or incremental (1) differences.
  * @param more_coming: can we expect more parts?
@@ -149,6 +202,13 @@ ods_status zone_add_rr(zone_type* zone, rr_type* rr, int do_stats);
 void zone_commit_diff(zone_type* zone, unsigned incremental,
      unsigned more_coming);
 
+/**
+ * Rollback differences in zone that have not been committed yet.
+ * @param zone: zone.
+ *
+ */
+void zone_rollback_diff(zone_type* zone);
+
 /**
  * Print zone.
  * @param fd:   file descriptor.
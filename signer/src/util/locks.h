@@ -60,6 +60,8 @@ typedef pthread_cond_t cond_basic_type;
 #define lock_basic_destroy(lock) LOCKRET(pthread_mutex_destroy(lock))
 #define lock_basic_lock(lock) LOCKRET(pthread_mutex_lock(lock))
 #define lock_basic_unlock(lock) LOCKRET(pthread_mutex_unlock(lock))
+/** non-zero if the lock was taken, a busy lock is not an error */
+#define lock_basic_trylock(lock) (pthread_mutex_trylock(lock) == 0)
 
 /** our own alarm clock */
 #define lock_basic_set(cond) LOCKRET(pthread_cond_init(cond, NULL))
@@ -98,6 +100,7 @@ typedef int lock_basic_type;
 #define lock_basic_destroy(lock)        /* nop */
 #define lock_basic_lock(lock)           /* nop */
 #define lock_basic_unlock(lock)         /* nop */
+#define lock_basic_trylock(lock)        (1)
 
 #define lock_basic_set(cond)       /* nop */
 #define lock_basic_sleep(cond, lock, sleep) /* nop */
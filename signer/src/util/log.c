@@ -34,6 +34,7 @@
 #include "config.h"
 #include "util/duration.h"
 #include "util/file.h"
+#include "util/locks.h"
 #include "util/log.h"
 
 #ifdef HAVE_SYSLOG_H
@@ -44,12 +45,52 @@ static int logging_to_syslog = 0;
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static FILE* logfile = NULL;
-static int log_level = LOG_CRIT;
+int ods_log_level = LOG_CRIT;
 
 #define CTIME_LENGTH 26
 
+#ifdef HAVE_PTHREAD
+/**
+ * Asynchronous logging. Every thread queues its messages in its own ring,
+ * the log writer merges the rings in message order and writes them out in
+ * batches. A ring has a single producer and a single consumer, so the rings
+ * need no locks, only memory barriers.
+ *
+ */
+#define LOG_RING_SIZE 128 /* messages, power of two */
+
+typedef struct log_entry_struct log_entry_type;
+struct log_entry_struct {
+    uint64_t seq;
+    time_t now;
+    int priority;
+    const char* t;
+    char message[ODS_SE_MAXLINE];
+};
+
+typedef struct log_ring_struct log_ring_type;
+struct log_ring_struct {
+    volatile size_t head; /* written by the logging thread */
+    volatile size_t tail; /* written by the log writer */
+    volatile int done; /* logging thread has exited */
+    log_ring_type* next;
+    log_entry_type entries[LOG_RING_SIZE];
+};
+
+static pthread_key_t log_ring_key;
+static log_ring_type* log_rings = NULL;
+static lock_basic_type log_lock;
+static cond_basic_type log_cond;
+static ods_thread_type log_writer;
+static volatile int log_async = 0;
+static volatile int log_writer_sleeping = 0;
+static volatile int log_writer_exit = 0;
+static uint64_t log_seq = 0;
+#endif /* HAVE_PTHREAD */
+
 /**
  * Use _r() functions on platforms that have. They are thread safe versions of
  * the normal syslog functions. Platforms without _r() usually have thread safe
@@ -83,13 +124,14 @@ ods_log_init(const char *filename, int use_syslog, int verbosity)
 #ifdef HAVE_SYSLOG_H
     int facility;
 #endif /* HAVE_SYSLOG_H */
+    ods_log_stop();
     ods_log_verbose("[%s] switching log to %s verbosity %i (log level %i)",
         logstr, use_syslog?"syslog":(filename&&filename[0]?filename:"stderr"),
         verbosity, verbosity+2);
     if (logfile && logfile != stderr) {
         ods_fclose(logfile);
     }
-    log_level = verbosity + 2;
+    ods_log_level = verbosity + 2;
 
 #ifdef HAVE_SYSLOG_H
     if(logging_to_syslog) {
@@ -128,6 +170,20 @@ ods_log_init(const char *filename, int use_syslog, int verbosity)
 }
 
 
+/**
+ * Set the verbosity.
+ *
+ */
+void
+ods_log_set_verbosity(int verbosity)
+{
+    (void) __sync_lock_test_and_set(&ods_log_level, verbosity + 2);
+    ods_log_verbose("[%s] verbosity set to %i (log level %i)", logstr,
+        verbosity, verbosity + 2);
+    return;
+}
+
+
 /**
  * Close logging.
  *
@@ -204,23 +260,18 @@ ods_log_get_facility(const char* facility)
 int
 ods_log_get_level(void)
 {
-    return log_level;
+    return ods_log_level;
 }
 
 
 /**
- * Log message wrapper.
+ * Write log message.
  *
  */
 static void
-ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
+ods_log_write(int priority, const char* t, const char* message,
+    const char* nowstr)
 {
-    char message[ODS_SE_MAXLINE];
-    static char nowstr[CTIME_LENGTH];
-    time_t now = time_now();
-
-    vsnprintf(message, sizeof(message), s, args);
-
 #ifdef HAVE_SYSLOG_H
     if (logging_to_syslog) {
 #ifdef HAVE_SYSLOG_R
@@ -235,13 +286,316 @@ ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
     if (!logfile) {
         return;
     }
+    fprintf(logfile, "[%s] %s[%i] %s: %s\n", nowstr,
+        MY_PACKAGE_TARNAME, priority, t, message);
+    return;
+}
 
+
+/**
+ * Format time stamp.
+ *
+ */
+static void
+ods_log_nowstr(time_t now, char* nowstr)
+{
     (void) ctime_r(&now, nowstr);
     nowstr[CTIME_LENGTH-2] = '\0'; /* remove trailing linefeed */
+    return;
+}
 
-    fprintf(logfile, "[%s] %s[%i] %s: %s\n", nowstr,
-        MY_PACKAGE_TARNAME, priority, t, message);
-    fflush(logfile);
+
+#ifdef HAVE_PTHREAD
+/**
+ * Thread exits: the log writer frees the ring once it is drained.
+ *
+ */
+static void
+log_ring_release(void* arg)
+{
+    log_ring_type* ring = (log_ring_type*) arg;
+    __sync_synchronize();
+    ring->done = 1;
+    return;
+}
+
+
+/**
+ * Get the ring of the calling thread.
+ *
+ */
+static log_ring_type*
+log_ring_get(void)
+{
+    log_ring_type* ring = (log_ring_type*) pthread_getspecific(log_ring_key);
+    if (ring) {
+        return ring;
+    }
+    ring = (log_ring_type*) malloc(sizeof(log_ring_type));
+    if (!ring) {
+        return NULL;
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->done = 0;
+    if (pthread_setspecific(log_ring_key, ring) != 0) {
+        free((void*) ring);
+        return NULL;
+    }
+    lock_basic_lock(&log_lock);
+    ring->next = log_rings;
+    log_rings = ring;
+    lock_basic_unlock(&log_lock);
+    return ring;
+}
+
+
+/**
+ * Wake up the log writer, if it is sleeping.
+ *
+ */
+static void
+log_writer_wakeup(void)
+{
+    __sync_synchronize();
+    if (log_writer_sleeping) {
+        lock_basic_lock(&log_lock);
+        lock_basic_alarm(&log_cond);
+        lock_basic_unlock(&log_lock);
+    }
+    return;
+}
+
+
+/**
+ * Queue log message. Returns 0 if the message has to be written directly.
+ *
+ */
+static int
+log_ring_put(int priority, const char* t, const char* s, va_list args)
+{
+    log_ring_type* ring = NULL;
+    log_entry_type* entry = NULL;
+    struct timespec ts;
+    if (!log_async || pthread_equal(pthread_self(), log_writer)) {
+        return 0;
+    }
+    ring = log_ring_get();
+    if (!ring) {
+        return 0;
+    }
+    while (ring->head - ring->tail >= LOG_RING_SIZE) {
+        /* ring is full, give the log writer some time */
+        if (!log_async) {
+            return 0;
+        }
+        log_writer_wakeup();
+        ts.tv_sec = 0;
+        ts.tv_nsec = 1000000;
+        (void) nanosleep(&ts, NULL);
+    }
+    __sync_synchronize();
+    entry = &ring->entries[ring->head & (LOG_RING_SIZE-1)];
+    vsnprintf(entry->message, sizeof(entry->message), s, args);
+    entry->priority = priority;
+    entry->t = t;
+    entry->now = time_now();
+    entry->seq = __sync_fetch_and_add(&log_seq, 1);
+    __sync_synchronize();
+    ring->head++;
+    log_writer_wakeup();
+    return 1;
+}
+
+
+/**
+ * Write out all queued messages, in message order. The log lock is held.
+ *
+ */
+static size_t
+log_rings_drain(void)
+{
+    log_ring_type* ring = NULL;
+    log_ring_type* oldest = NULL;
+    log_ring_type** prev = NULL;
+    log_entry_type* entry = NULL;
+    char nowstr[CTIME_LENGTH];
+    time_t last = 0;
+    size_t count = 0;
+    nowstr[0] = '\0';
+    while (1) {
+        oldest = NULL;
+        for (ring = log_rings; ring; ring = ring->next) {
+            if (ring->tail == ring->head) {
+                continue;
+            }
+            __sync_synchronize();
+            if (!oldest || ring->entries[ring->tail & (LOG_RING_SIZE-1)].seq
+                < oldest->entries[oldest->tail & (LOG_RING_SIZE-1)].seq) {
+                oldest = ring;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        entry = &oldest->entries[oldest->tail & (LOG_RING_SIZE-1)];
+        if (!nowstr[0] || entry->now != last) {
+            last = entry->now;
+            ods_log_nowstr(last, nowstr);
+        }
+        ods_log_write(entry->priority, entry->t, entry->message, nowstr);
+        __sync_synchronize();
+        oldest->tail++;
+        count++;
+    }
+    if (count && logfile) {
+        fflush(logfile);
+    }
+    /* free the rings of exited threads */
+    prev = &log_rings;
+    while (*prev) {
+        ring = *prev;
+        if (ring->done && ring->tail == ring->head) {
+            *prev = ring->next;
+            free((void*) ring);
+        } else {
+            prev = &ring->next;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Log writer.
+ *
+ */
+static void*
+log_writer_start(void* ATTR_UNUSED(arg))
+{
+    ods_thread_blocksigs();
+    lock_basic_lock(&log_lock);
+    while (!log_writer_exit) {
+        if (log_rings_drain()) {
+            continue;
+        }
+        log_writer_sleeping = 1;
+        __sync_synchronize();
+        if (!log_rings_drain()) {
+            lock_basic_sleep(&log_cond, &log_lock, 1);
+        }
+        log_writer_sleeping = 0;
+    }
+    (void) log_rings_drain();
+    lock_basic_unlock(&log_lock);
+    return NULL;
+}
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Start the log writer.
+ *
+ */
+void
+ods_log_start(void)
+{
+#ifdef HAVE_PTHREAD
+    if (log_async) {
+        return;
+    }
+    if (pthread_key_create(&log_ring_key, log_ring_release) != 0) {
+        ods_log_warning("[%s] unable to start log writer, logging "
+            "synchronously", logstr);
+        return;
+    }
+    lock_basic_init(&log_lock);
+    lock_basic_set(&log_cond);
+    log_writer_exit = 0;
+    ods_thread_create(&log_writer, log_writer_start, NULL);
+    log_async = 1;
+    __sync_synchronize();
+    ods_log_debug("[%s] log writer started", logstr);
+#endif /* HAVE_PTHREAD */
+    return;
+}
+
+
+/**
+ * Stop the log writer.
+ *
+ */
+void
+ods_log_stop(void)
+{
+#ifdef HAVE_PTHREAD
+    log_ring_type* ring = NULL;
+    if (!log_async) {
+        return;
+    }
+    log_async = 0;
+    lock_basic_lock(&log_lock);
+    log_writer_exit = 1;
+    lock_basic_alarm(&log_cond);
+    lock_basic_unlock(&log_lock);
+    ods_thread_join(log_writer);
+    /* messages that were queued while the writer stopped */
+    lock_basic_lock(&log_lock);
+    (void) log_rings_drain();
+    while (log_rings) {
+        ring = log_rings;
+        log_rings = ring->next;
+        free((void*) ring);
+    }
+    lock_basic_unlock(&log_lock);
+    (void) pthread_key_delete(log_ring_key);
+    lock_basic_destroy(&log_lock);
+    lock_basic_off(&log_cond);
+#endif /* HAVE_PTHREAD */
+    return;
+}
+
+
+/**
+ * Write out the queued messages now.
+ *
+ */
+static void
+ods_log_flush(void)
+{
+#ifdef HAVE_PTHREAD
+    if (!log_async || pthread_equal(pthread_self(), log_writer)) {
+        return;
+    }
+    /* the log writer only drains while holding the lock */
+    lock_basic_lock(&log_lock);
+    (void) log_rings_drain();
+    lock_basic_unlock(&log_lock);
+#endif /* HAVE_PTHREAD */
+    return;
+}
+
+
+/**
+ * Log message wrapper.
+ *
+ */
+static void
+ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
+{
+    char message[ODS_SE_MAXLINE];
+    char nowstr[CTIME_LENGTH];
+#ifdef HAVE_PTHREAD
+    if (log_ring_put(priority, t, s, args)) {
+        return;
+    }
+#endif /* HAVE_PTHREAD */
+    vsnprintf(message, sizeof(message), s, args);
+    ods_log_nowstr(time_now(), nowstr);
+    ods_log_write(priority, t, message, nowstr);
+    if (logfile) {
+        fflush(logfile);
+    }
     return;
 }
 
@@ -251,11 +605,11 @@ ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
  *
  */
 void
-ods_log_deeebug(const char *format, ...)
+ods_log_deeebug_msg(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_DEEEBUG) {
+    if (ods_log_level >= LOG_DEEEBUG) {
         ods_log_vmsg(LOG_DEBUG, "debug  ", format, args);
     }
     va_end(args);
@@ -268,11 +622,11 @@ ods_log_deeebug(const char *format, ...)
  *
  */
 void
-ods_log_debug(const char *format, ...)
+ods_log_debug_msg(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_DEBUG) {
+    if (ods_log_level >= LOG_DEBUG) {
         ods_log_vmsg(LOG_DEBUG, "debug  ", format, args);
     }
     va_end(args);
@@ -289,7 +643,7 @@ ods_log_verbose(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_INFO) {
+    if (ods_log_level >= LOG_INFO) {
         ods_log_vmsg(LOG_INFO, "verbose", format, args);
     }
     va_end(args);
@@ -306,7 +660,7 @@ ods_log_info(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_NOTICE) {
+    if (ods_log_level >= LOG_NOTICE) {
         ods_log_vmsg(LOG_NOTICE, "msg    ", format, args);
     }
     va_end(args);
@@ -323,7 +677,7 @@ ods_log_warning(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_WARNING) {
+    if (ods_log_level >= LOG_WARNING) {
         ods_log_vmsg(LOG_WARNING, "warning", format, args);
     }
     va_end(args);
@@ -340,7 +694,7 @@ ods_log_error(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_ERR) {
+    if (ods_log_level >= LOG_ERR) {
         ods_log_vmsg(LOG_ERR, "error  ", format, args);
     }
     va_end(args);
@@ -357,7 +711,7 @@ ods_log_crit(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_CRIT) {
+    if (ods_log_level >= LOG_CRIT) {
         ods_log_vmsg(LOG_CRIT, "crit   ", format, args);
     }
     va_end(args);
@@ -374,7 +728,7 @@ ods_log_alert(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_ALERT) {
+    if (ods_log_level >= LOG_ALERT) {
         ods_log_vmsg(LOG_ALERT, "alert  ", format, args);
     }
     va_end(args);
@@ -391,10 +745,11 @@ ods_fatal_exit(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    if (log_level >= LOG_CRIT) {
+    if (ods_log_level >= LOG_CRIT) {
         ods_log_vmsg(LOG_CRIT, "fatal  ", format, args);
     }
     va_end(args);
+    ods_log_flush();
     exit(1);
     return;
 }
@@ -52,8 +52,18 @@
 #endif /* HAVE_SYSLOG_H */
 #define LOG_DEEEBUG 8 /* ods_log_deeebug */
 
+extern int ods_log_level;
+
+/**
+ * Whether messages at this log level are logged. Check this before doing
+ * any work that is only needed for the log message.
+ *
+ */
+#define ods_log_enabled(level) (ods_log_level >= (level))
+
 /**
- * Initialize logging.
+ * Initialize logging. This stops the log writer, so only call it when no
+ * other threads are logging.
  * @param filename: logfile, if NULL use stderr.
  * @param use_syslog: use syslog(3) and ignore filename.
  * @param verbosity: log level.
@@ -61,12 +71,33 @@
  */
 void ods_log_init(const char *filename, int use_syslog, int verbosity);
 
+/**
+ * Set the verbosity. Safe to call while other threads are logging.
+ * @param verbosity: log level.
+ *
+ */
+void ods_log_set_verbosity(int verbosity);
+
 /**
  * Close logging.
  *
  */
 void ods_log_close(void);
 
+/**
+ * Start the log writer. From then on, messages are queued per thread and
+ * written in batches by the log writer thread. Start it after forking.
+ *
+ */
+void ods_log_start(void);
+
+/**
+ * Stop the log writer and write out the queued messages. Call it when the
+ * other threads have stopped.
+ *
+ */
+void ods_log_stop(void);
+
 /**
  * Get the facility by string.
  * @param facility: string-format facility.
@@ -83,18 +114,27 @@ int ods_log_get_facility(const char* facility);
 int ods_log_get_level(void);
 
 /**
- * Heavy debug logging.
+ * Heavy debug logging. The arguments are not evaluated if the message is
+ * not logged.
  * @param format: printf-style format string, arguments follow.
  *
  */
-void ods_log_deeebug(const char *format, ...);
+#define ods_log_deeebug(...) \
+	do { if (ods_log_enabled(LOG_DEEEBUG)) \
+		ods_log_deeebug_msg(__VA_ARGS__); \
+	} while (0)
+void ods_log_deeebug_msg(const char *format, ...);
 
 /**
- * Log debug.
+ * Log debug. The arguments are not evaluated if the message is not logged.
  * @param format: printf-style format string, arguments follow.
  *
  */
-void ods_log_debug(const char *format, ...);
+#define ods_log_debug(...) \
+	do { if (ods_log_enabled(LOG_DEBUG)) \
+		ods_log_debug_msg(__VA_ARGS__); \
+	} while (0)
+void ods_log_debug_msg(const char *format, ...);
 
 /**
  * Log verbose.
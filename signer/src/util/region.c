@@ -79,6 +79,7 @@ region_create_custom(size_t size)
         return NULL;
     }
     r->chunk_size = size;
+    r->recyclebin = NULL;
     region_init(r);
     if (!r->cleanups) {
         ods_log_crit("[%s] calloc failed: insufficient memory", logstr);
@@ -405,8 +406,13 @@ region_free(region_type* r)
         p = np;
     }
     free(r->cleanups);
-    free(r->recyclebin);
     region_init(r);
+    /* keep the recycle bin, the region can be used again */
+    if (r->recyclebin) {
+        memset(r->recyclebin, 0, sizeof(recycle_type*) *
+            (REGION_LARGE_OBJECT_SIZE / ALIGNMENT) );
+    }
+    r->recyclebin_size = 0;
     return;
 }
 
@@ -422,6 +428,8 @@ region_cleanup(region_type* r)
         return;
     }
     region_free(r);
+    free(r->cleanups);
+    free(r->recyclebin);
     free(r);
     return;
 }
@@ -174,7 +174,7 @@ void region_log(region_type* r, const char* str);
 size_t region_size(region_type* r);
 
 /**
- * Free all memory associated with region.
+ * Free all memory associated with region. The region can be used again.
  * @param r: memory region.
  *
  */
@@ -70,6 +70,10 @@ ods_lookup_table ods_status_str[] = {
     { ODS_STATUS_SYNTAXERR, "Syntax error" },
     { ODS_STATUS_ZPARSERERR, "Zone parser error" },
     { ODS_STATUS_ENTIZEERR, "Error adding empty non-terminals" },
+    { ODS_STATUS_SOCKERR, "Socket error" },
+    { ODS_STATUS_XFRERR, "Zone transfer error" },
+    { ODS_STATUS_JOURNALERR, "Journal error" },
+    { ODS_STATUS_HSMSIGNERR, "Unable to sign with HSM" },
 
     { 0, NULL }
 };
@@ -67,7 +67,11 @@ enum ods_enum_status {
     ODS_STATUS_STRFORMERR,
     ODS_STATUS_SYNTAXERR,
     ODS_STATUS_ZPARSERERR,
-    ODS_STATUS_ENTIZEERR
+    ODS_STATUS_ENTIZEERR,
+    ODS_STATUS_SOCKERR,
+    ODS_STATUS_XFRERR,
+    ODS_STATUS_JOURNALERR,
+    ODS_STATUS_HSMSIGNERR
 };
 typedef enum ods_enum_status ods_status;
 
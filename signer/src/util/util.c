@@ -430,22 +430,25 @@ util_base32hex_pton(char const* src, uint8_t* target, size_t targetsize)
 {
     char c;
     size_t p = 0;
-    memset(target,'\0',targetsize);
     while (c = *src++) {
         uint8_t d;
         size_t b, n;
-        if (p+5 >= targetsize*8)       return -1;
+        if (p+5 > targetsize*8)        return -1;
         if (c >= '0' && c <= '9')      d = c-'0';
         else if (c >= 'A' && c <= 'V') d = c-'A'+10;
         else if (c >= 'a' && c <= 'v') d = c-'a'+10;
         else                           return -2;
         b = 7-p % 8;
         n = p/8;
-        if (b >= 4) {
+        /* the first bits of a byte are assigned, so target needs no
+         * clearing beforehand */
+        if (b == 7) {
+            target[n]    = d << (b-4);
+        } else if (b >= 4) {
             target[n]   |= d << (b-4);
         } else {
             target[n]   |= d >> (4-b);
-            target[n+1] |= d << (b+4);
+            target[n+1]  = d << (b+4);
         }
         p += 5;
     }
@@ -137,7 +137,8 @@ void util_setbit(uint8_t bitmap[], size_t index);
  * Encode to base32.
  * @param src:        source string.
  * @param target:     Base32 encoded target.
- * @param targetsize: maximum target size.
+ * @param targetsize: maximum target size, (strlen(src) * 5 + 7) / 8 is
+ *                    enough.
  * @return:           (int) number of target bytes.
  *
  */
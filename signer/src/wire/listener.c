@@ -0,0 +1,82 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Listener.
+ *
+ */
+
+#include "config.h"
+#include "util/log.h"
+#include "wire/listener.h"
+
+#include <string.h>
+
+
+/**
+ * Create listener.
+ *
+ */
+listener_type*
+listener_create(region_type* r)
+{
+    listener_type* listener;
+    ods_log_assert(r);
+    listener = (listener_type*) region_alloc(r, sizeof(listener_type));
+    listener->interfaces = NULL;
+    listener->count = 0;
+    return listener;
+}
+
+
+/**
+ * Push an interface to the listener.
+ *
+ */
+interface_type*
+listener_push(region_type* r, listener_type* listener, const char* address,
+    const char* port)
+{
+    interface_type* ifs_old;
+    interface_type* ifs;
+    ods_log_assert(r);
+    ods_log_assert(listener);
+    ifs_old = listener->interfaces;
+    listener->interfaces = (interface_type*) region_alloc(r,
+        (listener->count + 1) * sizeof(interface_type));
+    if (ifs_old) {
+        memcpy(listener->interfaces, ifs_old,
+            listener->count * sizeof(interface_type));
+    }
+    ifs = &listener->interfaces[listener->count];
+    ifs->address = (address && address[0]) ? region_strdup(r, address) : NULL;
+    ifs->port = region_strdup(r, (port && port[0]) ? port : DNS_PORT_STRING);
+    ifs->fd = -1;
+    listener->count++;
+    return ifs;
+}
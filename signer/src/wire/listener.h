@@ -0,0 +1,83 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Listener.
+ *
+ */
+
+#ifndef WIRE_LISTENER_H
+#define WIRE_LISTENER_H
+
+#include "config.h"
+#include "util/region.h"
+
+#define DNS_PORT_STRING "53"
+
+/**
+ * Interface.
+ *
+ */
+typedef struct interface_struct interface_type;
+struct interface_struct {
+    const char* address;
+    const char* port;
+    int fd;
+};
+
+/**
+ * Listener.
+ *
+ */
+typedef struct listener_struct listener_type;
+struct listener_struct {
+    interface_type* interfaces;
+    size_t count;
+};
+
+/**
+ * Create listener.
+ * @param r: memory region.
+ * @return:  (listener_type*) listener.
+ *
+ */
+listener_type* listener_create(region_type* r);
+
+/**
+ * Push an interface to the listener.
+ * @param r:        memory region.
+ * @param listener: listener.
+ * @param address:  IP address, NULL or empty string for any address.
+ * @param port:     port, NULL for the default DNS port.
+ * @return:         (interface_type*) added interface.
+ *
+ */
+interface_type* listener_push(region_type* r, listener_type* listener,
+    const char* address, const char* port);
+
+#endif /* WIRE_LISTENER_H */